@@ -52,6 +52,7 @@ unsigned int uiAddress = 0x10000;	// last address
 BOOL StartTITextOutput(char *lpszFileName)
 {
 	iPosition = 0;
+	uiAddress = 1;						// (no word starts here: first record gets its @)
 	fOutStream = fopen(lpszFileName, "w");
 	return (fOutStream != NULL);
 }
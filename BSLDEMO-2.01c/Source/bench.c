@@ -0,0 +1,598 @@
+/****************************************************************
+*
+* Project: MSP430 Bootstrap Loader Demonstration Program
+*
+* File:    BENCH.C
+*
+* Throughput benchmark and microbenchmarks (see BENCH.H).
+*
+* For each image of bnImage[], a fresh simulated device is made,
+* the image written to BN_IMAGE_FILE and programmed with the
+* options given, the device's memory compared with it, and the
+* range read back into BN_READ_FILE and compared again.  The
+* baseline file holds a line per result:
+*
+*   {image} {setup|program|readout} {value} {ms|B/s}
+*
+****************************************************************/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <windows.h>
+
+#include "bench.h"
+#include "simdev.h"
+#include "bslcomm.h"
+#include "frameq.h"
+#include "TI_TXT_Files.h"
+
+/* Images: size data bytes from start on; sparse ones have block
+ * bytes at the start of each step bytes. */
+typedef struct
+{
+  const char *name;
+  unsigned long start;
+  long size;
+  long step, block;       /* 0: dense */
+} BN_IMAGE;
+
+static const BN_IMAGE bnImage[]=
+{
+  /* (below the interrupt vectors, which stay erased for the
+   *  password of the readout) */
+  { "dense-1K",     0xFBC0L,   0x400L,   0,  0 },
+  { "dense-8K",     0xDFC0L,  0x2000L,   0,  0 },
+  { "dense-32K",    0x7FC0L,  0x8000L,   0,  0 },
+  { "sparse-8K",    0x7FC0L,  0x2000L, 256, 64 },
+  { "dense-128K",  0x10000L, 0x20000L,   0,  0 },
+  { "dense-512K",  0x10000L, 0x80000L,   0,  0 },
+  { "sparse-128K", 0x10000L, 0x20000L, 256, 64 }
+};
+#define BN_IMAGES  (sizeof(bnImage) / sizeof(bnImage[0]))
+
+/* Results of each image: */
+#define BN_SETUP    0
+#define BN_PROGRAM  1
+#define BN_READOUT  2
+#define BN_RESULTS  3
+
+static const char *bnResult[BN_RESULTS]= { "setup", "program", "readout" };
+static const char *bnUnit[BN_RESULTS]=   { "ms", "B/s", "B/s" };
+
+/*-------------------------------------------------------------*/
+static void bnPrint(BSL_SESSION *s, const char *text)
+{
+}
+
+/*-------------------------------------------------------------*/
+static void bnProgress(BSL_SESSION *s, int bytes)
+{
+}
+
+/*-------------------------------------------------------------*/
+static long bnSpan(const BN_IMAGE *m)
+/* Bytes from the first byte of the image to the last. */
+{
+  if (m->step == 0) return(m->size);
+  return((m->size / m->block - 1) * m->step + m->block);
+}
+
+/*-------------------------------------------------------------*/
+static BOOL bnWriteImage(const BN_IMAGE *m, BYTE data[])
+/* Writes the image into BN_IMAGE_FILE, and its range into data[]
+ * (0xFF between the blocks).
+ */
+{
+  long span= bnSpan(m), off, n, i;
+  unsigned long addr;
+
+  if (!StartTITextOutput(BN_IMAGE_FILE)) return(FALSE);
+  memset(data, 0xFF, span);
+  for (off= 0; off < span; off+= (m->step != 0) ? m->step : n)
+  {
+    n= (m->step != 0) ? m->block : ((span - off > 256) ? 256 : span - off);
+    for (i= 0; i < n; i++)
+    {
+      addr= m->start + off + i;
+      data[off + i]= (BYTE)((addr * 7) ^ (addr >> 8) ^ (addr >> 16));
+    }
+    WriteTITextBytes(m->start + off, (WORD)(n / 2), &data[off]);
+  }
+  return(FinishTITextOutput());
+}
+
+/*-------------------------------------------------------------*/
+static BOOL bnCompareFile(const BYTE data[], long span)
+/* Whether BN_READ_FILE holds data[]. */
+{
+  FILE *f= fopen(BN_READ_FILE, "rb");
+  long i;
+  int c;
+
+  if (f == NULL) return(FALSE);
+  for (i= 0; (i < span) && ((c= fgetc(f)) == data[i]); i++);
+  fclose(f);
+  return(i == span);
+}
+
+/*-------------------------------------------------------------*/
+static int bnSession(void *port, const BSL_OPTIONS *opt, DWORD *time,
+                     DWORD *wire, double *wall)
+/* Runs the program flow on the simulated device.  *time: ms from
+ * the entry sequence to the first block ([0]) and from there to
+ * the end ([1]); *wire: bytes on the line; *wall: s on the PC.
+ */
+{
+  BSL_SESSION s;
+  LARGE_INTEGER freq, start, end;
+  DWORD before= sdWire(port);
+  int error;
+
+  QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&start);
+  if ((error= bslOpen(&s, &sdTransport, port, opt)) != ERR_NONE) return(error);
+  s.print= bnPrint;
+  s.progress= bnProgress;
+  error= bslRun(&s);
+  time[0]= s.Time_PRG_starts - s.Time_BSL_starts;
+  time[1]= s.Time_BSL_stops - s.Time_PRG_starts;
+  bslClose(&s);
+  QueryPerformanceCounter(&end);
+  *wire= sdWire(port) - before;
+  *wall= (double)(end.QuadPart - start.QuadPart) / freq.QuadPart;
+  return(error);
+}
+
+/*-------------------------------------------------------------*/
+static BOOL bnImageRun(const BN_IMAGE *m, const BSL_OPTIONS *opt,
+                       DWORD latency, double value[BN_RESULTS])
+/* Programs and reads out one image.
+ * Return == FALSE: a run failed or the data differs
+ */
+{
+  BSL_OPTIONS run= *opt;
+  long span= bnSpan(m);
+  BOOL wide= (m->start + span > 0x10000L);
+  BYTE *data= (BYTE*)malloc(span);
+  DWORD time[2], wire[2];
+  double wall[2];
+  void *port;
+  int error= ERR_NONE;
+  BOOL ok;
+
+  if ((data == NULL) || !bnWriteImage(m, data) ||
+      ((port= sdOpen(latency, &error)) == NULL))
+  {
+    printf("%-12s ERROR: Can't write \"%s\"!\n", m->name, BN_IMAGE_FILE);
+    free(data);
+    return(FALSE);
+  }
+
+  /* Program (with the flow of the command line): */
+  run.filename= BN_IMAGE_FILE;
+  run.passwdFile= NULL;
+  run.newBSLFile= NULL;     /* (no code runs on the device) */
+  run.fastPatchFile= NULL;
+  run.metrics= FALSE;
+  run.traceFile= NULL;
+  run.toDo.MSP430X|= wide;
+  run.toDo.Dump2file= 0;
+  run.toDo.EraseSegment= 0;
+  run.toDo.Wait= 0;
+  error= bnSession(port, &run, time, &wire[0], &wall[0]);
+  ok= (error == ERR_NONE) && (sdCompare(port, m->start, data, span) < 0);
+  value[BN_SETUP]= time[0];
+  value[BN_PROGRAM]= (time[1] > 0) ? m->size * 1000.0 / time[1] : 0;
+
+  /* Read out: */
+  if (ok)
+  {
+    memset(&run.toDo, 0, sizeof(run.toDo));
+    run.toDo.BSLStart= 1;
+    run.toDo.Dump2file= 1;
+    run.toDo.MSP430X= opt->toDo.MSP430X | wide;
+    run.toDo.SparseRead= opt->toDo.SparseRead;
+    run.toDo.SpeedUp= opt->toDo.SpeedUp;
+    run.readStart= m->start;
+    run.readLen= span;
+    run.readfilename= BN_READ_FILE;
+    error= bnSession(port, &run, time, &wire[1], &wall[1]);
+    ok= (error == ERR_NONE) && bnCompareFile(data, span);
+    value[BN_READOUT]= (time[1] > 0) ? span * 1000.0 / time[1] : 0;
+  }
+  sdFree(port);
+  free(data);
+  remove(BN_IMAGE_FILE);
+  remove(BN_READ_FILE);
+
+  if (!ok)
+  {
+    printf("%-12s ERROR: %s failed (error %d)!\n", m->name,
+           (run.toDo.Dump2file) ? "readout" : "programming", error);
+    return(FALSE);
+  }
+  printf("%-12s %7ld %9.1f %10.1f %10.1f %9.3f %7.3f\n", m->name, m->size,
+         value[BN_SETUP], value[BN_PROGRAM], value[BN_READOUT],
+         (double)wire[0] / m->size, wall[0] + wall[1]);
+  return(TRUE);
+}
+
+/*-------------------------------------------------------------*/
+static BOOL bnWrite(char *filename, double value[][BN_RESULTS],
+                    const BSL_OPTIONS *opt, double latency)
+{
+  FILE *f= fopen(filename, "w");
+  unsigned i, r;
+
+  if (f == NULL) return(FALSE);
+  fprintf(f, "; BSLDEMO -k baseline: -s%d, latency %g ms\n",
+          opt->toDo.SpeedUp ? opt->speed : 0, latency);
+  for (i= 0; i < BN_IMAGES; i++)
+  {
+    for (r= 0; r < BN_RESULTS; r++)
+    {
+      fprintf(f, "%s %s %.1f %s\n", bnImage[i].name, bnResult[r], value[i][r], bnUnit[r]);
+    }
+  }
+  return((fclose(f) == 0));
+}
+
+/*-------------------------------------------------------------*/
+static BOOL bnCompare(FILE *f, double value[][BN_RESULTS], double threshold)
+/* Shows the change of each result against the baseline.
+ * Return == FALSE: worse by more than threshold
+ */
+{
+  char line[200], name[64], result[16];
+  double base[BN_IMAGES][BN_RESULTS], v, change;
+  BOOL have[BN_IMAGES][BN_RESULTS];
+  BOOL ok= TRUE;
+  unsigned i, r;
+
+  memset(have, 0, sizeof(have));
+  while (fgets(line, sizeof(line), f) != NULL)
+  {
+    if (sscanf(line, "%63s %15s %lf", name, result, &v) != 3) continue;
+    for (i= 0; (i < BN_IMAGES) && (strcmp(name, bnImage[i].name) != 0); i++);
+    for (r= 0; (r < BN_RESULTS) && (strcmp(result, bnResult[r]) != 0); r++);
+    if ((i == BN_IMAGES) || (r == BN_RESULTS) || (v <= 0)) continue;
+    base[i][r]= v;
+    have[i][r]= TRUE;
+  }
+  printf("%-12s %9s %10s %10s\n", "change", "setup", "program", "readout");
+  for (i= 0; i < BN_IMAGES; i++)
+  {
+    printf("%-12s", bnImage[i].name);
+    for (r= 0; r < BN_RESULTS; r++)
+    {
+      if (!have[i][r])
+      {
+        printf(" %*s", (r == BN_SETUP) ? 9 : 10, "new");
+        continue;
+      }
+      /* (+: better) */
+      change= (value[i][r] - base[i][r]) * 100.0 / base[i][r];
+      if (r == BN_SETUP) change= -change;
+      printf(" %+*.1f%%", (r == BN_SETUP) ? 8 : 9, change);
+      if (change < -threshold) ok= FALSE;
+    }
+    printf("\n");
+  }
+  return(ok);
+}
+
+/*-------------------------------------------------------------*/
+int bnRun(const BSL_OPTIONS *opt, char *baseline, double threshold,
+          double latency)
+{
+  double value[BN_IMAGES][BN_RESULTS];
+  BOOL failed= FALSE;
+  unsigned i;
+  FILE *f;
+
+  printf("Benchmark on a simulated device (-s%d, latency %g ms):\n",
+         opt->toDo.SpeedUp ? opt->speed : 0, latency);
+  printf("%-12s %7s %9s %10s %10s %9s %7s\n", "image", "bytes",
+         "setup ms", "prog B/s", "read B/s", "wire/byte", "wall s");
+  memset(value, 0, sizeof(value));
+  for (i= 0; i < BN_IMAGES; i++)
+  {
+    if (!bnImageRun(&bnImage[i], opt, (DWORD)(latency * 1000), value[i]))
+      failed= TRUE;
+  }
+  if (failed) return(1);
+
+  if ((f= fopen(baseline, "r")) == NULL)
+  {
+    if (!bnWrite(baseline, value, opt, latency))
+    {
+      printf("ERROR: Can't write \"%s\"!\n", baseline);
+      return(1);
+    }
+    printf("Baseline written to %s.\n", baseline);
+    return(0);
+  }
+  printf("Against %s (threshold %g%%):\n", baseline, threshold);
+  failed= !bnCompare(f, value, threshold);
+  fclose(f);
+  if (failed)
+  {
+    printf("ERROR: Throughput below the baseline!\n");
+    return(1);
+  }
+  return(0);
+}
+
+/***************************************************************
+ * Microbenchmarks (-u):
+ */
+
+/* Corpus: an image of BN_CORPUS bytes, as TI TXT lines (16 bytes,
+ * CR LF, BN_TXT_LINE characters each and a 0, as fgets() reads
+ * them) and as an Intel HEX file. */
+#define BN_CORPUS       0x8000L
+#define BN_CORPUS_ADDR  0x8000L
+#define BN_TXT_LINE     49
+
+static BYTE *bnData;
+static char *bnTxt;
+static char *bnHex;
+static long bnAllocs;           /* strings made by bnHex2Txt() */
+
+/*-------------------------------------------------------------*/
+static void bnParse(void)
+/* fqParseLine() of each line (the sscanf() of programTIText()) */
+{
+  BYTE data[16];
+  long i;
+
+  for (i= 0; i < BN_CORPUS / 16; i++) fqParseLine(&bnTxt[i * (BN_TXT_LINE + 1)], BN_TXT_LINE, data);
+}
+
+/*-------------------------------------------------------------*/
+static void bnChecksum(void)
+/* calcChecksum() of frames of MAX_FRAME_SIZE bytes */
+{
+  long off;
+
+  for (off= 0; off < BN_CORPUS; off+= MAX_FRAME_SIZE)
+    calcChecksum(&bnData[off], MAX_FRAME_SIZE);
+}
+
+/*-------------------------------------------------------------*/
+static void bnFrame(void)
+/* bslFrame() of Transmit Block frames, as the frame queue builds
+ * them (copy, alignment, padding, checksum) */
+{
+  BYTE data[MAX_FRAME_SIZE], txFrame[MAX_FRAME_SIZE];
+  long off, n;
+
+  for (off= 0; off < BN_CORPUS; off+= n)
+  {
+    n= (BN_CORPUS - off > MAX_DATA_BYTES - 10) ? MAX_DATA_BYTES - 10 : BN_CORPUS - off;
+    memcpy(data, &bnData[off], n);
+    bslFrame(BSL_TXBLK, BN_CORPUS_ADDR + off, (WORD)n, data, txFrame);
+  }
+}
+
+/*-------------------------------------------------------------*/
+static void bnTxtOut(void)
+/* WriteTITextBytes() of records of 256 bytes into a file, as the
+ * readout (-r) writes them */
+{
+  long off;
+
+  StartTITextOutput(BN_IMAGE_FILE);
+  for (off= 0; off < BN_CORPUS; off+= 256)
+    WriteTITextBytes(BN_CORPUS_ADDR + off, 128, &bnData[off]);
+  FinishTITextOutput();
+}
+
+/* The script's strings: each one made by & or mid() is a new one,
+ * its parts copied into it, as in VBScript. */
+typedef struct
+{
+  char *s;
+  long len;
+} BN_STR;
+
+/*-------------------------------------------------------------*/
+static void bnSet(BN_STR *to, const char *a, long alen, const char *b, long blen)
+/* to= a & b */
+{
+  char *s= (char*)malloc(alen + blen + 1);
+
+  memcpy(s, a, alen);
+  memcpy(&s[alen], b, blen);
+  s[alen + blen]= 0;
+  free(to->s);
+  to->s= s;
+  to->len= alen + blen;
+  bnAllocs++;
+}
+
+/*-------------------------------------------------------------*/
+static void bnCat(BN_STR *to, const BN_STR *a, const char *b)
+{
+  bnSet(to, a->s, a->len, b, strlen(b));
+}
+
+/*-------------------------------------------------------------*/
+static long bnClng(const char *text, long pos, long n)
+/* clng("&h" & mid(text, pos, n)) */
+{
+  BN_STR mid= { NULL, 0 }, hex= { NULL, 0 };
+  long value;
+
+  bnSet(&mid, &text[pos], n, "", 0);
+  bnSet(&hex, "&h", 2, mid.s, mid.len);
+  value= strtol(&hex.s[2], NULL, 16);
+  free(mid.s);
+  free(hex.s);
+  return(value);
+}
+
+/*-------------------------------------------------------------*/
+static void bnHex2Txt(void)
+/* The conversion of HEX2TXT.vbs (Intel HEX to TI TXT): the output
+ * line and file are strings to which each byte and line is added.
+ */
+{
+  BN_STR fileout= { NULL, 0 }, lineout= { NULL, 0 }, hByte= { NULL, 0 },
+         hexloc= { NULL, 0 };
+  char *colon= strchr(bnHex, ':'), *next;
+  long fPoint, nbytes, location, lastloc= 0, lastnbytes= 0, i, bytetot, hexcheck;
+  int outnum= 1, dirty= 0;
+
+  bnSet(&fileout, "", 0, "", 0);
+  bnSet(&lineout, "", 0, "", 0);
+  while ((next= strchr(colon + 1, ':')) != NULL)
+  {
+    fPoint= colon + 1 - bnHex;
+    nbytes= bnClng(bnHex, fPoint, 2);
+    bnSet(&hexloc, &bnHex[fPoint + 2], 4, "", 0);
+    location= bnClng(hexloc.s, 0, 4);
+    if ((dirty == 0) || (location != lastloc + lastnbytes))
+    { /* newaddress */
+      if (lineout.len > 0) bnCat(&lineout, &lineout, "\r\n");
+      bnCat(&fileout, &fileout, lineout.s);
+      bnCat(&fileout, &fileout, "@");
+      bnCat(&fileout, &fileout, hexloc.s);
+      bnCat(&fileout, &fileout, "\r\n");
+      bnSet(&lineout, "", 0, "", 0);
+      outnum= 1;
+      dirty= 1;
+    }
+    lastloc= location;
+    lastnbytes= nbytes;
+    fPoint+= 8;
+    bnSet(&hByte, &bnHex[fPoint - 2], 2, "", 0);   /* (record type "00") */
+    for (i= 0; i < nbytes; i++, fPoint+= 2)
+    { /* outbyte */
+      bnSet(&hByte, &bnHex[fPoint], 2, "", 0);
+      if (outnum > 1) bnSet(&hByte, " ", 1, hByte.s, hByte.len);
+      bnCat(&lineout, &lineout, hByte.s);
+      if (outnum == 16)
+      {
+        bnCat(&fileout, &fileout, lineout.s);
+        bnCat(&fileout, &fileout, "\r\n");
+        bnSet(&lineout, "", 0, "", 0);
+        outnum= 1;
+      }
+      else outnum++;
+    }
+    /* Line checksum: */
+    hexcheck= bnClng(bnHex, fPoint, 2);
+    for (bytetot= 0, i= colon + 1 - bnHex; i <= colon - bnHex + 7 + nbytes * 2; i+= 2)
+      bytetot+= bnClng(bnHex, i, 2);
+    if (hexcheck != (1 + ((bytetot % 256) ^ 255)) % 256) break;
+    colon= next;
+  }
+  if (lineout.len > 0) bnCat(&lineout, &lineout, "\r\n");
+  bnCat(&fileout, &fileout, lineout.s);
+  bnCat(&fileout, &fileout, "q\r\n");
+  free(fileout.s);
+  free(lineout.s);
+  free(hByte.s);
+  free(hexloc.s);
+}
+
+typedef struct
+{
+  const char *name;
+  void (*run)(void);
+} BN_KERNEL;
+
+static const BN_KERNEL bnKernel[]=
+{
+  { "parse",    bnParse },
+  { "checksum", bnChecksum },
+  { "frame",    bnFrame },
+  { "txtout",   bnTxtOut },
+  { "hex2txt",  bnHex2Txt }
+};
+#define BN_KERNELS  (sizeof(bnKernel) / sizeof(bnKernel[0]))
+
+/*-------------------------------------------------------------*/
+static BOOL bnCorpus(void)
+/* Makes the image and its TI TXT and Intel HEX text. */
+{
+  long i, off;
+  char *t;
+  BYTE sum;
+
+  bnData= (BYTE*)malloc(BN_CORPUS);
+  bnTxt= (char*)malloc(BN_CORPUS / 16 * (BN_TXT_LINE + 1));
+  bnHex= (char*)malloc(BN_CORPUS / 16 * 45 + 16);
+  if ((bnData == NULL) || (bnTxt == NULL) || (bnHex == NULL)) return(FALSE);
+
+  for (i= 0; i < BN_CORPUS; i++)
+  {
+    bnData[i]= (BYTE)(((BN_CORPUS_ADDR + i) * 7) ^ ((BN_CORPUS_ADDR + i) >> 8));
+  }
+  for (t= bnTxt, off= 0; off < BN_CORPUS; off+= 16)
+  {
+    for (i= 0; i < 16; i++)
+    {
+      t+= sprintf(t, (i < 15) ? "%02X " : "%02X\r\n", bnData[off + i]);
+    }
+    t++;                        /* (the 0) */
+  }
+  for (t= bnHex, off= 0; off < BN_CORPUS; off+= 16)
+  {
+    sum= (BYTE)(16 + ((BN_CORPUS_ADDR + off) >> 8) + (BN_CORPUS_ADDR + off));
+    t+= sprintf(t, ":10%04lX00", BN_CORPUS_ADDR + off);
+    for (i= 0; i < 16; i++)
+    {
+      t+= sprintf(t, "%02X", bnData[off + i]);
+      sum+= bnData[off + i];
+    }
+    t+= sprintf(t, "%02X\r\n", (BYTE)-sum);
+  }
+  strcpy(t, ":00000001FF\r\n");
+  return(TRUE);
+}
+
+/*-------------------------------------------------------------*/
+int bnKernels(void)
+{
+  LARGE_INTEGER freq, start, end;
+  double elapsed;
+  long passes, allocs;
+  unsigned i;
+
+  if (!bnCorpus())
+  {
+    printf("ERROR: Not enough memory!\n");
+    return(1);
+  }
+  QueryPerformanceFrequency(&freq);
+  printf("Microbenchmarks, %ld bytes per pass:\n", BN_CORPUS);
+  printf("%-10s %8s %9s %9s %10s\n", "kernel", "passes", "ns/byte", "MB/s", "allocs/KB");
+  for (i= 0; i < BN_KERNELS; i++)
+  {
+    bnAllocs= 0;
+    passes= 0;
+    QueryPerformanceCounter(&start);
+    do
+    {
+      bnKernel[i].run();
+      passes++;
+      QueryPerformanceCounter(&end);
+      elapsed= (double)(end.QuadPart - start.QuadPart) / freq.QuadPart;
+    } while (elapsed < BN_KERNEL_MS / 1000.0);
+    allocs= bnAllocs / passes;
+    printf("%-10s %8ld %9.2f %9.1f %10.1f\n", bnKernel[i].name, passes,
+           elapsed * 1e9 / ((double)passes * BN_CORPUS),
+           (double)passes * BN_CORPUS / elapsed / 1e6,
+           allocs * 1024.0 / BN_CORPUS);
+  }
+  remove(BN_IMAGE_FILE);
+  free(bnData);
+  free(bnTxt);
+  free(bnHex);
+  return(0);
+}
+
+/* EOF */
@@ -0,0 +1,79 @@
+/****************************************************************
+*
+* Project: MSP430 Bootstrap Loader Demonstration Program
+*
+* File:    BENCH.H
+*
+* Throughput benchmark (-k): the program flow is run against the
+* simulated device of SIMDEV.H with a set of generated firmware
+* images, dense and sparse, from 1 KB to 512 KB, below 64 KB and
+* above (MSP430X), at the baudrate of -s and the latency given:
+*
+*   setup    ms from the entry sequence to the first block (sync,
+*            mass erase, password, version, baudrate change)
+*   program  bytes of the image per second for erase check,
+*            program and verify (the options given, +ecpv ...)
+*   readout  bytes per second for -r of the range of the image
+*            (-z: sparse readout)
+*
+* The times are those of the simulated line and device, the same
+* on any PC, so they show what a change of the protocol or of the
+* program flow costs or saves.  The results are compared with a
+* baseline file and written to it if there is none: a result worse
+* than the baseline by more than the threshold given fails the
+* benchmark.
+*
+* The microbenchmarks (-u) time the work of the PC alone, on a
+* fixed image of 32 KB in memory: the parsing of TI TXT lines
+* (fqParseLine()), calcChecksum(), bslFrame(), WriteTITextBytes()
+* and the string building of HEX2TXT.VBS, done in C as VBScript
+* does it, in ns per byte of the image, and the strings made per
+* KB by the latter (the others allocate nothing).
+*
+****************************************************************/
+
+#ifndef Bench__H
+#define Bench__H
+
+#include "session.h"
+
+/* Files used (current directory): */
+#define BN_IMAGE_FILE    "BSLBENCH.TXT"
+#define BN_READ_FILE     "BSLBENCH.BIN"
+#define BN_DEFAULT_FILE  "BSLBENCH.BAS"
+
+/* Defaults of -k: */
+#define BN_THRESHOLD     5.0    /* % */
+#define BN_LATENCY       1.0    /* ms */
+
+/* Time of each microbenchmark: */
+#define BN_KERNEL_MS     250
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-------------------------------------------------------------*/
+int bnKernels(void);
+/* Runs the microbenchmarks and shows their times.
+ * Return == 0: OK
+ * Return == 1: out of memory
+ */
+
+/*-------------------------------------------------------------*/
+int bnRun(const BSL_OPTIONS *opt, char *baseline, double threshold,
+          double latency);
+/* Runs the benchmark with the options of the command line and
+ * compares the results with the file baseline (or writes it).
+ * Return == 0: OK
+ * Return == 1: a result worse than the baseline by more than
+ *              threshold %, or a run failed
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/* EOF */
@@ -0,0 +1,440 @@
+/****************************************************************
+*
+* Project: MSP430 Bootstrap Loader Demonstration Program
+*
+* File:    BSLASYNC.C
+*
+* Asynchronous commands of the ROM BSL (see BSLASYNC.H).
+*
+* Each session has a small state machine: a command goes through
+* AS_SYNC (0x80 sent, DATA_ACK expected), AS_HEADER (frame sent,
+* reply header expected) and AS_FRAME (rest of a data frame), the
+* entry sequence through AS_RESET.  Each state has the time it
+* may wait (as in bslSync() and comTxRx()); the loop waits for the
+* earliest of these times, or for the data of any port, with
+* WaitForMultipleObjects().  The frames are built and checked by
+* the same functions as the blocking commands.
+*
+****************************************************************/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <windows.h>
+
+#include "bslasync.h"
+#include "metrics.h"
+
+#define BSL_SYNC     0x80
+#define SYNC_TRIES   3
+#define SYNC_TIMEOUT 100
+
+/* Poll interval (ms) for transports without rxEvent(): */
+#define POLL_TIME    1
+
+enum { AS_IDLE, AS_DELAY, AS_RESET, AS_SYNC, AS_HEADER, AS_FRAME };
+
+/* One step of the entry sequence: pin ('R': RST, 'T': TEST, 0:
+ * end), level, and the delay after it (ms):
+ */
+typedef struct
+{
+  char pin;
+  BYTE level;
+  WORD delay;
+} RESET_STEP;
+
+/* as bslReset(): */
+static const RESET_STEP invokeSeq[]=
+{
+  {'R', 1, 0}, {'T', 1, 250},                   /* charge capacitor */
+  {'R', 0, 0}, {'T', 1, 10}, {'T', 0, 10}, {'T', 1, 10},
+  {'T', 0, 10}, {'R', 1, 10}, {'T', 1, 250},
+  {0, 0, 0}
+};
+static const RESET_STEP runSeq[]=
+{
+  {'R', 1, 0}, {'T', 1, 250},
+  {'R', 0, 10}, {'R', 1, 250},
+  {0, 0, 0}
+};
+
+struct BSL_ASYNC
+{
+  int      state;
+  BSL_DONE done;
+  void    *context;
+  DWORD    stepEnd;           /* end of the wait of this state */
+  DWORD    deadline;
+  BOOL     hasDeadline;
+  int      tries;
+  const RESET_STEP *reset;
+  BYTE     txFrame[MAX_FRAME_SIZE];
+  int      txLen;
+  BYTE    *blkin;
+  int      rxGot, rxNeed;     /* bytes of s->rxFrame */
+};
+
+/*-------------------------------------------------------------*/
+static long ticksLeft(DWORD now, DWORD end)
+/* ms from now to end (< 0: past), across the wrap of the clock. */
+{
+  DWORD d= end - now;
+
+  return((d & 0x80000000UL) ? -(long)(DWORD)(now - end) : (long)d);
+}
+
+/*-------------------------------------------------------------*/
+static BOOL expired(DWORD now, DWORD end)
+{
+  return(ticksLeft(now, end) <= 0);
+}
+
+/*-------------------------------------------------------------*/
+static BSL_ASYNC *asyncState(BSL_SESSION *s)
+{
+  if (s->async == NULL)
+  {
+    s->async= (BSL_ASYNC*)calloc(1, sizeof(BSL_ASYNC));
+  }
+  return(s->async);
+}
+
+/*-------------------------------------------------------------*/
+static void asyncFinish(BSL_SESSION *s, int error)
+/* Completes the command, calls its callback (which may start the
+ * next one).
+ */
+{
+  BSL_ASYNC *a= s->async;
+
+  a->state= AS_IDLE;
+  s->lastError= error;
+  mxEnd(s, error);
+  if (a->done != NULL)
+  {
+    a->done(s, error, a->context);
+  }
+}
+
+/*-------------------------------------------------------------*/
+static void asyncSync(BSL_SESSION *s, DWORD now)
+/* Sends the synchronization character. */
+{
+  BSL_ASYNC *a= s->async;
+  BYTE ch= BSL_SYNC;
+
+  mxPhase(s, MX_SYNC);
+  s->transport->purge(s->port); /* Clear receiving queue */
+  s->transport->write(s->port, &ch, 1);
+  a->state= AS_SYNC;
+  a->stepEnd= now + SYNC_TIMEOUT;
+}
+
+/*-------------------------------------------------------------*/
+static BOOL asyncPoll(BSL_SESSION *s)
+/* Handles the data received and the times expired.
+ * Returns TRUE if the state has changed.
+ */
+{
+  BSL_ASYNC *a= s->async;
+  DWORD now= comTicks(s);
+  BYTE ch;
+  int n;
+
+  if (a->state == AS_IDLE) return(FALSE);
+
+  if (a->hasDeadline && expired(now, a->deadline))
+  {
+    asyncFinish(s, ERR_DEADLINE);
+    return(TRUE);
+  }
+
+  switch (a->state)
+  {
+    case AS_DELAY:
+      if (!expired(now, a->stepEnd)) return(FALSE);
+      asyncFinish(s, ERR_NONE);
+      return(TRUE);
+
+    case AS_RESET:
+      if (!expired(now, a->stepEnd)) return(FALSE);
+      while (a->reset->pin != 0)
+      {
+        const RESET_STEP *step= a->reset++;
+
+        if (step->pin == 'R')
+          SetRSTpin(s, step->level);
+        else
+          SetTESTpin(s, step->level);
+        if (step->delay > 0)
+        {
+          a->stepEnd= now + step->delay;
+          return(TRUE);
+        }
+      }
+      s->transport->purge(s->port);
+      asyncFinish(s, ERR_NONE);
+      return(TRUE);
+
+    case AS_SYNC:
+      if (comWaitForData(s, 1, 0) >= 1)
+      {
+        s->transport->read(s->port, &ch, 1);
+        if (ch == DATA_ACK)
+        {
+          /* Send frame: */
+          s->transport->purge(s->port);
+          mxPhase(s, MX_TX);
+          s->transport->write(s->port, a->txFrame, a->txLen);
+          mxPhase(s, MX_WAIT);
+          s->rxFrame[2]= 0;
+          s->rxFrame[3]= 0; /* Set lengths of received data to 0! */
+          a->state= AS_HEADER;
+          a->stepEnd= now + s->timeout*s->prolongFactor;
+          return(TRUE);
+        }
+      }
+      else if (!expired(now, a->stepEnd))
+      {
+        return(FALSE);
+      }
+      if (++a->tries < SYNC_TRIES)
+      {
+        mxRetry(s);
+        asyncSync(s, now);
+      }
+      else
+        asyncFinish(s, ERR_BSL_SYNC);
+      return(TRUE);
+
+    case AS_HEADER:
+      if (comWaitForData(s, 1, 0) < 1)
+      {
+        if (!expired(now, a->stepEnd)) return(FALSE);
+        asyncFinish(s, ERR_RX_HDR_TIMEOUT);
+        return(TRUE);
+      }
+      s->transport->read(s->port, &ch, 1);
+      s->seqNo= 0;
+      s->reqNo= 0;
+      switch (ch & 0xf0)
+      {
+        case DATA_ACK:
+          asyncFinish(s, ERR_NONE);
+          break;
+        case DATA_NAK:
+          asyncFinish(s, ERR_RX_NAK);
+          break;
+        case CMD_FAILED:
+          asyncFinish(s, ERR_CMD_FAILED);
+          break;
+        case DATA_FRAME:
+          mxPhase(s, MX_RX);
+          s->rxFrame[0]= DATA_FRAME;
+          a->rxGot= 1;
+          a->rxNeed= 4;
+          a->state= AS_FRAME;
+          a->stepEnd= now + s->timeout;
+          break;
+        default:
+          asyncFinish(s, ERR_COM);
+      }
+      return(TRUE);
+
+    case AS_FRAME:
+      n= comWaitForData(s, a->rxNeed - a->rxGot, 0);
+      if (n > a->rxNeed - a->rxGot) n= a->rxNeed - a->rxGot;
+      if (n <= 0)
+      {
+        if (!expired(now, a->stepEnd)) return(FALSE);
+        asyncFinish(s, ERR_COM);
+        return(TRUE);
+      }
+      a->rxGot+= s->transport->read(s->port, &s->rxFrame[a->rxGot], n);
+      if (a->rxGot < a->rxNeed) return(TRUE);
+      if (a->rxNeed == 4)
+      {
+        if ((s->rxFrame[1] != 0) || (s->rxFrame[2] != s->rxFrame[3]))
+        {
+          asyncFinish(s, ERR_COM);
+          return(TRUE);
+        }
+        a->rxNeed= s->rxFrame[2] + 6;
+        a->stepEnd= now + s->timeout;
+        return(TRUE);
+      }
+      if (!comCheckFrame(s->rxFrame))
+      {
+        asyncFinish(s, ERR_COM);
+        return(TRUE);
+      }
+      if (a->blkin != NULL)
+      { /* Copy received data out of frame buffer into blkin: */
+        memcpy(a->blkin, &s->rxFrame[4], s->rxFrame[2]);
+      }
+      asyncFinish(s, ERR_NONE);
+      return(TRUE);
+  }
+  return(FALSE);
+} /* asyncPoll */
+
+/*-------------------------------------------------------------*/
+static BSL_ASYNC *asyncStart(BSL_SESSION *s, BSL_DONE done, void *context)
+{
+  BSL_ASYNC *a= asyncState(s);
+
+  if ((a == NULL) || (a->state != AS_IDLE)) return(NULL);
+  a->done= done;
+  a->context= context;
+  a->hasDeadline= FALSE;
+  a->tries= 0;
+  return(a);
+}
+
+/*-------------------------------------------------------------*/
+int bslAsyncTxRx(BSL_SESSION *s, BYTE cmd, unsigned long addr, WORD len,
+                 BYTE blkout[], BYTE blkin[], DWORD deadline,
+                 BSL_DONE done, void *context)
+{
+  BYTE data[MAX_DATA_BYTES + 2];
+  BYTE dataOut[MAX_FRAME_SIZE];
+  BSL_ASYNC *a;
+  DWORD now;
+  WORD length;
+
+  if (s->flActive)
+  {
+    return(ERR_CMD_FAILED); /* (fast loader: blocking only) */
+  }
+  if (((blkout != NULL) && (len > MAX_DATA_BYTES)) ||
+      ((a= asyncStart(s, done, context)) == NULL))
+  {
+    return(ERR_COM);
+  }
+
+  if (blkout != NULL)
+  {
+    memcpy(data, blkout, len);
+  }
+  bslAlign(cmd, &addr, &len, data);
+  mxCommand(s, cmd, addr, len);
+  length= bslCmdData(cmd, addr, len, (blkout != NULL) ? data : NULL, dataOut);
+  a->txLen= comBuildFrame(s, cmd, dataOut, (BYTE)length, a->txFrame);
+  a->blkin= blkin;
+
+  now= comTicks(s);
+  if (deadline != 0)
+  {
+    a->deadline= now + deadline;
+    a->hasDeadline= TRUE;
+  }
+  asyncSync(s, now);
+  return(ERR_NONE);
+} /* bslAsyncTxRx */
+
+/*-------------------------------------------------------------*/
+int bslAsyncReset(BSL_SESSION *s, BOOL invokeBSL,
+                  BSL_DONE done, void *context)
+{
+  BSL_ASYNC *a= asyncStart(s, done, context);
+
+  if (a == NULL) return(ERR_COM);
+  a->reset= invokeBSL ? invokeSeq : runSeq;
+  a->state= AS_RESET;
+  a->stepEnd= comTicks(s);
+  return(ERR_NONE);
+} /* bslAsyncReset */
+
+/*-------------------------------------------------------------*/
+int bslAsyncDelay(BSL_SESSION *s, DWORD time,
+                  BSL_DONE done, void *context)
+{
+  BSL_ASYNC *a= asyncStart(s, done, context);
+
+  if (a == NULL) return(ERR_COM);
+  a->state= AS_DELAY;
+  a->stepEnd= comTicks(s) + time;
+  return(ERR_NONE);
+} /* bslAsyncDelay */
+
+/*-------------------------------------------------------------*/
+void bslAsyncDone(BSL_SESSION *s)
+{
+  if (s->async != NULL)
+  {
+    free(s->async);
+    s->async= NULL;
+  }
+} /* bslAsyncDone */
+
+/*-------------------------------------------------------------*/
+void bslLoopInit(BSL_LOOP *loop)
+{
+  memset(loop, 0, sizeof(BSL_LOOP));
+}
+
+/*-------------------------------------------------------------*/
+int bslLoopAdd(BSL_LOOP *loop, BSL_SESSION *s)
+{
+  if ((loop->count >= BSL_LOOP_MAX) || (asyncState(s) == NULL))
+  {
+    return(ERR_COM);
+  }
+  loop->session[loop->count++]= s;
+  return(ERR_NONE);
+}
+
+/*-------------------------------------------------------------*/
+void bslLoopRun(BSL_LOOP *loop)
+{
+  HANDLE event[BSL_LOOP_MAX];
+  BSL_SESSION *s;
+  BSL_ASYNC *a;
+  DWORD events, wait, now;
+  long left;
+  BOOL busy;
+  int i;
+
+  for (;;)
+  {
+    busy= FALSE;
+    events= 0;
+    wait= INFINITE;
+
+    for (i= 0; i < loop->count; i++)
+    {
+      s= loop->session[i];
+      a= s->async;
+      while (asyncPoll(s));
+      if (a->state == AS_IDLE) continue;
+      busy= TRUE;
+
+      /* Earliest time this session must be looked at again: */
+      now= comTicks(s);
+      left= ticksLeft(now, a->stepEnd);
+      if (a->hasDeadline && (ticksLeft(now, a->deadline) < left))
+        left= ticksLeft(now, a->deadline);
+      if (left < 0) left= 0;
+      if ((DWORD)left < wait) wait= (DWORD)left;
+
+      if ((a->state == AS_SYNC) || (a->state == AS_HEADER) || (a->state == AS_FRAME))
+      {
+        HANDLE h= (s->transport->rxEvent != NULL) ?
+                  s->transport->rxEvent(s->port) : NULL;
+        if (h != NULL)
+          event[events++]= h;
+        else if (wait > POLL_TIME)
+          wait= POLL_TIME;
+      }
+    }
+    if (!busy) break;
+
+    if (events > 0)
+      WaitForMultipleObjects(events, event, FALSE, wait);
+    else
+      Sleep(wait);
+  }
+} /* bslLoopRun */
+
+/* EOF */
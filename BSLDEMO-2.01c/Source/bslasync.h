@@ -0,0 +1,105 @@
+/****************************************************************
+*
+* Project: MSP430 Bootstrap Loader Demonstration Program
+*
+* File:    BSLASYNC.H
+*
+* Asynchronous commands of the ROM BSL: a command is started with
+* a callback, and returns at once.  bslLoopRun() waits for the
+* replies of all sessions added to a BSL_LOOP (up to BSL_LOOP_MAX
+* ports), on one thread, and calls the callback of each command
+* when it has completed.  The callback may start the next command
+* of its session, so the program flow of each session is a chain
+* of callbacks (see GANG.C).
+*
+* Each command has the timeouts of the blocking bslTxRx(), and a
+* deadline of its own: if it has not completed by then, it fails
+* with ERR_DEADLINE.
+*
+*   bslLoopInit(&loop);
+*   bslLoopAdd(&loop, &s);           (s opened with bslOpenCom())
+*   bslAsyncReset(&s, TRUE, started, NULL);
+*   bslLoopRun(&loop);
+*
+* The fast loader is not supported: the blocking functions must be
+* used once it has been started.
+*
+****************************************************************/
+
+#ifndef BSLAsync__H
+#define BSLAsync__H
+
+#include "session.h"
+
+/* Max. sessions of one loop (MAXIMUM_WAIT_OBJECTS): */
+#define BSL_LOOP_MAX 64
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Called when a command has completed (error: as bslTxRx()): */
+typedef void (*BSL_DONE)(BSL_SESSION *s, int error, void *context);
+
+typedef struct
+{
+  BSL_SESSION *session[BSL_LOOP_MAX];
+  int count;
+} BSL_LOOP;
+
+/*-------------------------------------------------------------*/
+void bslLoopInit(BSL_LOOP *loop);
+/* Initialises an empty loop.
+ */
+
+/*-------------------------------------------------------------*/
+int bslLoopAdd(BSL_LOOP *loop, BSL_SESSION *s);
+/* Adds an open session to the loop (the state of its commands is
+ * freed by bslClose()).
+ * Return == 0: OK
+ */
+
+/*-------------------------------------------------------------*/
+void bslLoopRun(BSL_LOOP *loop);
+/* Runs until no session of the loop has a command pending.
+ */
+
+/*-------------------------------------------------------------*/
+int bslAsyncTxRx(BSL_SESSION *s, BYTE cmd, unsigned long addr, WORD len,
+                 BYTE blkout[], BYTE blkin[], DWORD deadline,
+                 BSL_DONE done, void *context);
+/* Starts bslTxRx() (with the synchronization before the frame).
+ * blkout is copied at once, blkin is written before done() is
+ * called.  deadline: ms until the command fails (0: none).
+ * Return == 0: started
+ * Return != 0: Error! (done() is not called)
+ */
+
+/*-------------------------------------------------------------*/
+int bslAsyncReset(BSL_SESSION *s, BOOL invokeBSL,
+                  BSL_DONE done, void *context);
+/* Starts bslReset(); the delays of the entry sequence are waited
+ * for by the loop.
+ * Return == 0: started
+ */
+
+/*-------------------------------------------------------------*/
+int bslAsyncDelay(BSL_SESSION *s, DWORD time,
+                  BSL_DONE done, void *context);
+/* Calls done() after time ms.
+ * Return == 0: started
+ */
+
+/*-------------------------------------------------------------*/
+void bslAsyncDone(BSL_SESSION *s);
+/* Frees the state of the asynchronous commands (called by
+ * bslClose()).
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/* EOF */
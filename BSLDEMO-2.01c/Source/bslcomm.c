@@ -40,6 +40,12 @@
 *     - 11/00 FRGR: Added delays in bslReset() routine to meet also
 *       critical customer designs (considering MK's hint).
 *
+*   Change by GH:
+*     - bslTxRx() passes all commands to the fast loader (FASTLOAD.C)
+*       once it has been started.
+*     - All functions work on a session (SESSION.H); SSP.C and
+*       FASTLOAD.C are compiled on their own.
+*
 ****************************************************************/
 
 #include <windows.h>
@@ -47,28 +53,14 @@
 #include <stdio.h>
 #include <fcntl.h>
 
-#include "bslcomm.h"
-#include "ssp.c"
+#include "session.h"
+#include "metrics.h"
 
 
 #define BSL_SYNC 0x80
 
-/* 1: Warning, if access to memory below 0x1000 is possible.
- *    This can happen due to an error in the first version(s) of
- *    the bootstrap loader code in combination with specific
- *    checksum values.
- * 0: No Warning.
- */
-int BSLMemAccessWarning= 0; /* Default: no warning. */
-
-/*  Change by GH */
-
-extern BOOL InvertDTR;
-extern BOOL InvertRTS;
-
-
 /*-------------------------------------------------------------*/
-void SetRSTpin(BOOL level)
+void SetRSTpin(BSL_SESSION *s, BOOL level)
 /* Controls RST/NMI pin (0: GND; 1: VCC) */
 {
   //if (level == TRUE)
@@ -80,14 +72,11 @@ void SetRSTpin(BOOL level)
 
 /*  Change by GH */
 
-  if (InvertDTR) comDCB.fDtrControl = level ? DTR_CONTROL_DISABLE : DTR_CONTROL_ENABLE;
-  else comDCB.fDtrControl = level ? DTR_CONTROL_ENABLE : DTR_CONTROL_DISABLE;
-
-
-  SetCommState(hComPort, &comDCB);
+  if (s->opt.invertDTR) level= !level;
+  comSetLines(s, level ? (s->lines | LINE_DTR) : (s->lines & ~LINE_DTR));
 } /* SetRSTpin */
 
-void SetTESTpin(BOOL level)
+void SetTESTpin(BSL_SESSION *s, BOOL level)
 /* Controls TEST pin (0: VCC; 1: GND) */
 {
   //if (level == TRUE)
@@ -97,15 +86,12 @@ void SetTESTpin(BOOL level)
 
 /*  Change by GH */
 
-  if (InvertRTS) comDCB.fRtsControl = level ? RTS_CONTROL_DISABLE : RTS_CONTROL_ENABLE;
-  else comDCB.fRtsControl = level ? RTS_CONTROL_ENABLE : RTS_CONTROL_DISABLE;
-
-
-  SetCommState(hComPort, &comDCB);
+  if (s->opt.invertRTS) level= !level;
+  comSetLines(s, level ? (s->lines | LINE_RTS) : (s->lines & ~LINE_RTS));
 } /* SetTESTpin */
 
 /*-------------------------------------------------------------*/
-void bslReset(BOOL invokeBSL)
+void bslReset(BSL_SESSION *s, BOOL invokeBSL)
 /* Applies BSL entry sequence on RST/NMI and TEST/VPP pins
  * Parameters: invokeBSL = TRUE:  complete sequence
  *             invokeBSL = FALSE: only RST/NMI pin accessed
@@ -116,36 +102,35 @@ void bslReset(BOOL invokeBSL)
  */
 {
   /* To charge capacitor on boot loader hardware: */
-  SetRSTpin(1);
-  SetTESTpin(1);
-  delay(250);
+  SetRSTpin(s, 1);
+  SetTESTpin(s, 1);
+  comDelay(s, 250);
 
   if (invokeBSL)
   {
-    SetRSTpin(0);    /* RST  pin: GND */
-    SetTESTpin(1); /* TEST pin: GND */   delay(10);   /* delays added to meet also */
-    SetTESTpin(0); /* TEST pin: Vcc */   delay(10);   /* critical layout and/or    */
-    SetTESTpin(1); /* TEST pin: GND */   delay(10);   /* dimensioning problems     */
-    SetTESTpin(0); /* TEST pin: Vcc */   delay(10);   /* (poked by MK)             */
-    SetRSTpin (1); /* RST  pin: Vcc */   delay(10);
-    SetTESTpin(1); /* TEST pin: GND */
+    SetRSTpin(s, 0);    /* RST  pin: GND */
+    SetTESTpin(s, 1); /* TEST pin: GND */   comDelay(s, 10);   /* delays added to meet also */
+    SetTESTpin(s, 0); /* TEST pin: Vcc */   comDelay(s, 10);   /* critical layout and/or    */
+    SetTESTpin(s, 1); /* TEST pin: GND */   comDelay(s, 10);   /* dimensioning problems     */
+    SetTESTpin(s, 0); /* TEST pin: Vcc */   comDelay(s, 10);   /* (poked by MK)             */
+    SetRSTpin (s, 1); /* RST  pin: Vcc */   comDelay(s, 10);
+    SetTESTpin(s, 1); /* TEST pin: GND */
   }
   else
   {
-    SetRSTpin(0);    /* RST  pin: GND */
-    delay(10);       /* delays */
-    SetRSTpin(1);    /* RST  pin: Vcc */
+    SetRSTpin(s, 0);    /* RST  pin: GND */
+    comDelay(s, 10);    /* delays */
+    SetRSTpin(s, 1);    /* RST  pin: Vcc */
   }
   /* Give MSP430's oscillator time to stabilize: */
-  delay(250);
+  comDelay(s, 250);
 
   /* Clear buffers: */
-  PurgeComm(hComPort, PURGE_TXCLEAR);
-  PurgeComm(hComPort, PURGE_RXCLEAR);
+  s->transport->purge(s->port);
 } /* bslReset */
 
 /*-------------------------------------------------------------*/
-int bslSync()
+int bslSync(BSL_SESSION *s)
 /* Transmits Synchronization character and expects to
  * receive Acknowledge character
  * Return == 0: OK
@@ -155,22 +140,22 @@ int bslSync()
   BYTE  ch;
   int rxCount, loopcnt;
   const BYTE cLoopOut = 3; /* Max. trials to get synchronization */
-  DWORD NrTx;
-  DWORD NrRx;
 
+  mxPhase(s, MX_SYNC);
   for (loopcnt=0; loopcnt < cLoopOut; loopcnt++)
   {
-    PurgeComm(hComPort, PURGE_RXCLEAR); /* Clear receiving queue */
+    if (loopcnt > 0) mxRetry(s);
+    s->transport->purge(s->port); /* Clear receiving queue */
 
     /* Send synchronization byte: */
     ch = BSL_SYNC;
-    WriteFile(hComPort, &ch, 1, &NrTx, NULL);
+    s->transport->write(s->port, &ch, 1);
 
     /* Wait for 1 byte; Timeout: 100ms */
-    rxCount= comWaitForData(1, 100);
+    rxCount= comWaitForData(s, 1, 100);
     if (rxCount > 0)
     {
-      ReadFile(hComPort, &ch, 1, &NrRx, NULL);
+      s->transport->read(s->port, &ch, 1);
       if (ch == DATA_ACK)
       { return(ERR_NONE); } /* Sync. successful */
     }
@@ -180,56 +165,57 @@ int bslSync()
 } /* bslSync */
 
 /*-------------------------------------------------------------*/
-int bslTxRx(BYTE cmd, unsigned long addr, WORD len,
-            BYTE* blkout, BYTE* blkin)
-/* Transmits a command (cmd) with its parameters:
- * start-address (addr), length (len) and additional
- * data (blkout) to boot loader.
- * Parameters return by boot loader are passed via blkin.
- * Return == 0: OK
- * Return != 0: Error!
+void bslAlign(BYTE cmd, unsigned long *addr, WORD *len, BYTE* blkout)
+/* Aligns the address and length of Transmit Block (padding
+ * blkout with 0xFF) and Receive Block to words.
  */
 {
-    BYTE dataOut[MAX_FRAME_SIZE];
-    int error;
-    WORD length= 4;
-
     if (cmd == BSL_TXBLK)
     {
       /* Align to even start address */
-      if ((addr % 2) != 0)
+      if ((*addr % 2) != 0)
       {
         /* Decrement address and               */
-        addr--;
+        (*addr)--;
         /* fill first byte of blkout with 0xFF */
-        memmove(&blkout[1], &blkout[0], len);
+        memmove(&blkout[1], &blkout[0], *len);
         blkout[0]= 0xFF;
-        len++;
+        (*len)++;
       }
       /* Make sure that len is even */
-      if ((len % 2) != 0)
+      if ((*len % 2) != 0)
       {
         /* Inc. len and fill last byte of blkout with 0xFF */
-        blkout[(len++)]= 0xFF;
+        blkout[((*len)++)]= 0xFF;
       }
     }
 
     if (cmd == BSL_RXBLK)
     {
       /* Align to even start address */
-      if ((addr % 2) != 0)
+      if ((*addr % 2) != 0)
       {
         /* Decrement address but       */
-        addr--;
+        (*addr)--;
         /* request an additional byte. */
-        len++;
+        (*len)++;
       }
       /* Make sure that len is even */
-      if ((len % 2) != 0)
+      if ((*len % 2) != 0)
       {
-        len++;
+        (*len)++;
       }
     }
+}
+
+/*-------------------------------------------------------------*/
+WORD bslCmdData(BYTE cmd, unsigned long addr, WORD len,
+                BYTE* blkout, BYTE* dataOut)
+/* Puts the parameters and data of a command into dataOut.
+ * Returns the number of bytes.
+ */
+{
+    WORD length= 4;
 
     if ((cmd == BSL_TXBLK) || (cmd == BSL_TXPWORD))
     {
@@ -246,21 +232,108 @@ int bslTxRx(BYTE cmd, unsigned long addr, WORD len,
     { /* Copy data out of blkout into frame: */
       memcpy(&dataOut[4], blkout, len);
     }
+    return(length);
+}
+
+/*-------------------------------------------------------------*/
+int bslTxRx(BSL_SESSION *s, BYTE cmd, unsigned long addr, WORD len,
+            BYTE* blkout, BYTE* blkin)
+/* Transmits a command (cmd) with its parameters:
+ * start-address (addr), length (len) and additional
+ * data (blkout) to boot loader.
+ * Parameters return by boot loader are passed via blkin.
+ * Return == 0: OK
+ * Return != 0: Error!
+ */
+{
+    BYTE dataOut[MAX_FRAME_SIZE];
+    int error;
+    WORD length;
+
+    bslAlign(cmd, &addr, &len, blkout);
+    mxCommand(s, cmd, addr, len);
+
+    if (s->flActive)
+    {
+      return(mxEnd(s, flTxRx(s, cmd, addr, len, blkout, blkin)));
+    }
+
+    length= bslCmdData(cmd, addr, len, blkout, dataOut);
 
-    if (bslSync() != ERR_NONE)
+    if (bslSync(s) != ERR_NONE)
     {
-      return(ERR_BSL_SYNC);
+      return(mxEnd(s, ERR_BSL_SYNC));
     }
 
     /* Send frame: */
-    error = comTxRx(cmd, dataOut, (BYTE)length);
+    error = comTxRx(s, cmd, dataOut, (BYTE)length);
+
+    if (blkin != NULL)
+    { /* Copy received data out of frame buffer into blkin: */
+      memcpy(blkin, &s->rxFrame[4], s->rxFrame[2]);
+    }
+
+    return (mxEnd(s, error));
+}
+
+/*-------------------------------------------------------------*/
+int bslFrame(BYTE cmd, unsigned long addr, WORD len,
+             BYTE* blkout, BYTE* txFrame)
+/* Builds the frame of a command for the ROM BSL into txFrame.
+ * Returns the length of the frame.
+ */
+{
+    BYTE dataOut[MAX_FRAME_SIZE];
+    WORD length;
+
+    bslAlign(cmd, &addr, &len, blkout);
+    length= bslCmdData(cmd, addr, len, blkout, dataOut);
+    return(comFrame(0, cmd, dataOut, (BYTE)length, txFrame));
+}
+
+/*-------------------------------------------------------------*/
+const char *bslCmdName(BYTE cmd)
+/* Name of a BSL command, NULL if unknown.
+ */
+{
+    static const char *name[]=
+    {
+      "TXPWORD", "TXBLK", "RXBLK", "ERASE", "MERAS", "LOADPC",
+      "ECHECK", "RXID", "SPEED"
+    };
+
+    if (cmd == BSL_MEMOFFSET) return("MEMOFFSET");
+    if ((cmd < BSL_TXPWORD) || (cmd > BSL_SPEED) || ((cmd % 2) != 0))
+    {
+      return(NULL);
+    }
+    return(name[(cmd - BSL_TXPWORD) / 2]);
+}
+
+/*-------------------------------------------------------------*/
+int bslTxRxFrame(BSL_SESSION *s, BYTE* txFrame, BYTE* blkin)
+/* Transmits a frame built by bslFrame() to the boot loader.
+ * Return == 0: OK
+ * Return != 0: Error!
+ */
+{
+    int error;
+
+    mxCommand(s, txFrame[1], txFrame[4] | (txFrame[5] << 8),
+              (WORD)(txFrame[6] | (txFrame[7] << 8)));
+    if (bslSync(s) != ERR_NONE)
+    {
+      return(mxEnd(s, ERR_BSL_SYNC));
+    }
+
+    error = comTxRxFrame(s, txFrame);
 
     if (blkin != NULL)
     { /* Copy received data out of frame buffer into blkin: */
-      memcpy(blkin, &rxFrame[4], rxFrame[2]);
+      memcpy(blkin, &s->rxFrame[4], s->rxFrame[2]);
     }
 
-    return (error);
+    return (mxEnd(s, error));
 }
 
 /* EOF */
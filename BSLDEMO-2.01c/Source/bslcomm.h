@@ -34,6 +34,8 @@
 *   Version 1.12 (02/2001 FRGR)
 *     - Added definition of (not released) BSL command
 *       "Erase Check" BSL_ECHECK
+*   Change by GH:
+*     - Functions work on a session (SESSION.H)
 *     
 ****************************************************************/
 
@@ -76,17 +78,21 @@
 extern "C" {
 #endif
 
-extern int BSLMemAccessWarning;
+/*-------------------------------------------------------------*/
+void SetRSTpin(BSL_SESSION *s, BOOL level);
+/* Controls RST/NMI pin (0: GND; 1: VCC) */
+void SetTESTpin(BSL_SESSION *s, BOOL level);
+/* Controls TEST pin (0: VCC; 1: GND) */
 
 /*-------------------------------------------------------------*/
-void bslReset(BOOL invokeBSL);
+void bslReset(BSL_SESSION *s, BOOL invokeBSL);
 /* Applies BSL entry sequence on RST/NMI and TEST/VPP pins
  * Parameters: invokeBSL = TRUE:  complete sequence
  *             invokeBSL = FALSE: only RST/NMI pin accessed
  */
 
 /*-------------------------------------------------------------*/
-int bslSync();
+int bslSync(BSL_SESSION *s);
 /* Transmits Synchronization character and expects to
  * receive Acknowledge character
  * Return == 0: OK
@@ -94,7 +100,20 @@ int bslSync();
  */
 
 /*-------------------------------------------------------------*/
-int bslTxRx(BYTE cmd, unsigned long addr, WORD len, 
+void bslAlign(BYTE cmd, unsigned long *addr, WORD *len, BYTE blkout[]);
+/* Aligns the address and length of Transmit Block (padding
+ * blkout with 0xFF) and Receive Block to words.
+ */
+
+/*-------------------------------------------------------------*/
+WORD bslCmdData(BYTE cmd, unsigned long addr, WORD len,
+                BYTE blkout[], BYTE dataOut[]);
+/* Puts the parameters and data of a command into dataOut.
+ * Returns the number of bytes.
+ */
+
+/*-------------------------------------------------------------*/
+int bslTxRx(BSL_SESSION *s, BYTE cmd, unsigned long addr, WORD len, 
             BYTE blkout[], BYTE blkin[]);
 /* Transmits a command (cmd) with its parameters: 
  * start-address (addr), length (len) and additional 
@@ -104,6 +123,29 @@ int bslTxRx(BYTE cmd, unsigned long addr, WORD len,
  * Return != 0: Error!
  */
 
+/*-------------------------------------------------------------*/
+int bslFrame(BYTE cmd, unsigned long addr, WORD len,
+             BYTE blkout[], BYTE txFrame[]);
+/* Builds the frame of a command for the ROM BSL into txFrame,
+ * aligned as bslTxRx() does (blkout is padded in place).  Can be
+ * called from another thread than the one using the session.
+ * Returns the length of the frame.
+ */
+
+/*-------------------------------------------------------------*/
+const char *bslCmdName(BYTE cmd);
+/* Name of a BSL command ("TXBLK" for BSL_TXBLK), NULL if the
+ * code is unknown.
+ */
+
+/*-------------------------------------------------------------*/
+int bslTxRxFrame(BSL_SESSION *s, BYTE txFrame[], BYTE blkin[]);
+/* Same as bslTxRx(), with a frame built by bslFrame() (ROM BSL
+ * only, not with the fast loader).
+ * Return == 0: OK
+ * Return != 0: Error!
+ */
+
 #ifdef __cplusplus
 }
 #endif
@@ -115,65 +115,71 @@
 *   - added -i Option to invert DTR line (for use with USB-to-Serial adapters)
 *   - added -j Option to invert RTS line (for parts with dedicated JTAG pins)
 *
+*   - added fast RAM loader FastLoader.txt for the -b Option (F1xx, F2xx
+*     and G2xx3 parts with 512 bytes of RAM or more), see FASTLOAD.C
+*   - FastLoader.txt: data sent compressed, copies of flash already written
+*     expanded by the loader
+*   - BSL 1.10 and older: FastLoader.txt (if found) is started once in place
+*     of the workaround patch, which needs a Load PC before every block
+*   - added gang programming: -c given for several ports programs the
+*     devices on all of them at once, see GANG.C
+*
+*   - program flow moved to SESSION.C: all state is kept in a session,
+*     so the flasher can be used by other programs, and gang programming
+*     runs one session per port
+*   - gang programming runs the sessions of all ports on one thread,
+*     with the asynchronous BSL commands of BSLASYNC.C
+*   - the file is parsed and the frames are built on a thread of their
+*     own while the blocks before are sent, see FRAMEQ.C
+*   - -r streams the data into the file frame by frame (250 bytes, any
+*     length), steps the memory offset across 64 KB pages with -x, and
+*     writes binary or Intel HEX for .bin/.hex file names, see READOUT.C
+*   - added -z Option: -r skips the erased ranges, found by halving the
+*     range with Erase Check commands
+*   - added -t Option: times of the commands and their phases, bytes on
+*     the wire and errors per command type; -t{file} writes them with a
+*     trace of all commands as JSON, see METRICS.C
+*   - DEBUGDUMP messages of each block removed: every byte on the wire is
+*     kept in a ring with its time, written to a file on an error or with
+*     the new -d Option, and decoded by the new -l Option, see WIRETRACE.C
+*   - -d records the whole session into the file; added -y Option: replays
+*     such a recording in place of the device, with its timing or a scaled
+*     one, see REPLAY.C
+*   - added -n Option: injects faults into the bytes on the line, and
+*     runs the program flow repeatedly at several fault rates (on the
+*     port, a recording or the simulated device) to time the retries
+*     and recoveries, see FAULTS.C
+*   - added -k Option: benchmark of the program flow against a simulated
+*     device with generated images, compared with a baseline file, see
+*     BENCH.C and SIMDEV.C
+*   - added -u Option: microbenchmarks of the parsing, checksum, frame
+*     building and TI TXT output (and of the HEX2TXT script), see BENCH.C
+*   - added -q Option: job server keeping the ports open, and -o Option:
+*     runs the command line as a job of the server; a device left in the
+*     BSL by a job is used by the next one without entry sequence and
+*     password, see DAEMON.C
+*   - added -g Option: compiles the file into a frame file, which holds
+*     the frames ready to be sent; given in place of a TI TXT file, it
+*     is mapped and sent as it is, see FRAMES.C
+*
 ****************************************************************/
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <conio.h>
 #include <windows.h>
 
-#include "bslcomm.h"
-#include "TI_TXT_Files.h"
-
-/*---------------------------------------------------------------
-* Defines:
-*---------------------------------------------------------------
-*/
-
-/* This definition includes code to load a new BSL into RAM:
-* NOTE: Can only be used with devices with sufficient RAM!
-* The program flow is changed slightly compared to a version
-* without "NEW_BSL" defined.
-* The definition also defines the filename of the TI-TXT file
-* with the new BSL code.
-*/
-#define NEW_BSL
-
-/* The "WORKAROUND" definition includes code for a workaround
-* required by the first version(s) of the bootstrap loader.
-*/
-#define WORKAROUND
-
-/* If "DEBUGDUMP" is defined, all checked and programmed blocks are
-* logged on the screen.
-*/
-#define DEBUGDUMP
-
-/* Additional mass erase cylces required for (some) F149 devices.
-* If ADD_MERASE_CYCLES is not defined only one mass erase
-* cycle is executed.
-* Remove #define for fixed F149 or F11xx devices.
-*/
-#define ADD_MERASE_CYCLES		20
-/* Error: verification failed:		*/
-#define ERR_VERIFY_FAILED		98
-/* Error: erase check failed:		*/
-#define ERR_ERASE_CHECK_FAILED	97
-/* Error: unable to open input file: */
-#define ERR_FILE_OPEN			96
-
-/* Mask: program data:	*/
-#define ACTION_PROGRAM			0x01
-/* Mask: verify data:	*/
-#define ACTION_VERIFY			0x02
-/* Mask: erase check:	*/
-#define ACTION_ERASE_CHECK		0x04
-/* Mask: transmit password:  */
-/* Note: Should not be used in conjunction with any other action! */
-#define ACTION_PASSWD			0x08
-/* Mask: erase check fast:	*/
-#define ACTION_ERASE_CHECK_FAST	0x10
-
+#include "session.h"
+#include "metrics.h"
+#include "wiretrace.h"
+#include "replay.h"
+#include "faults.h"
+#include "simdev.h"
+#include "bench.h"
+#include "daemon.h"
+#include "frames.h"
+#include "gang.h"
 
 /*---------------------------------------------------------------
 * Global Variables:
@@ -183,496 +189,50 @@
 char *programName=	"MSP430 Bootstrap Loader Communication Program";
 char *programVersion= "Version 2.01c";
 
-/* Max. bytes sent within one frame if parsing a TI TXT file.
-* ( >= 16 and == n*16 and <= MAX_DATA_BYTES!)
-*/
-int maxData= 240;
-
-/* Change by GH */
-
-BOOL InvertDTR = FALSE;      /* New flag for -i Option to invert DTR */
-BOOL InvertRTS = FALSE;      /* New flag for -j Option to invert RTS */
-
-/* Buffers used to store data transmitted to and received from BSL: */
-BYTE blkin [MAX_DATA_BYTES]; /* Receive buffer	*/
-BYTE blkout[MAX_DATA_BYTES]; /* Transmit buffer */
-
-#ifdef WORKAROUND
-char *patchFilename = "PATCH.TXT";
-char *patchFile = NULL;
-#endif /* WORKAROUND */
-
-BOOL patchRequired = FALSE;
-BOOL patchLoaded = FALSE;
+/* Options for the session, set by parseCMDLine(): */
+BSL_OPTIONS opt;
 
-WORD bslVer = 0;
-WORD _addr, _len, _err;
-BYTE speed	= 0;		/* default 9600 Baud		*/
-DWORD Time_BSL_starts, Time_PRG_starts, Time_BSL_stops;
-
-char *newBSLFile= NULL;
-char newBSLFilename[256];
-
-
-struct toDoList
-	{
-	unsigned MassErase : 1;
-	unsigned EraseCheck: 1;
-	unsigned FastCheck : 1;
-	unsigned Program : 1;
-	unsigned Verify: 1;
-	unsigned Reset	: 1;
-	unsigned Wait	: 1;    /* Wait for <Enter> at end of program */
-	                        /* (0: no; 1: yes):                   */
-	unsigned OnePass : 1;   /* Do EraseCheck, Program and Verify  */
-	                        /* in one pass (TI TXT file is read   */
-	                        /* only once)                         */
-	unsigned SpeedUp : 1;   /* Change Baudrate                    */
-	unsigned UserCalled: 1; /* Second run without entry sequence  */
-	unsigned BSLStart: 1;   /* Start BSL                          */
-	unsigned Dump2file:1;   /* Dump Memory to file                */
-	unsigned EraseSegment:1;/* Erase Segment                      */
-	unsigned MSP430X:1;     /* Enable MSP430X Ext.Memory support  */
-	unsigned RestoreInfoA:1;/* Save InfoA before mass erase       */
-	} toDo;
-
-
-int error= ERR_NONE;
 int i, j;
 char comPortName[20]= "COM1"; // Default setting.
-char *filename= NULL;
-char *passwdFile= NULL;
 char passwdFilename[256];
-
-BYTE bslVerHi, bslVerLo, devTypeHi, devTypeLo, devProcHi, devProcLo;
-WORD bslerrbuf;
-
-#ifdef ADD_MERASE_CYCLES
-int meraseCycles= ADD_MERASE_CYCLES;
-#else
-const int meraseCycles= 1;
-#endif // ADD_MERASE_CYCLES
-
-
-long readStart = 0;
-long readLen = 0;
-char *readfilename = NULL;
-
-
-void *errData= NULL;
-int byteCtr= 0;
+#ifdef WORKAROUND
+char patchFilename[256];
+#endif /* WORKAROUND */
+char newBSLFilename[256];
+char *wireListFile= NULL; /* -l */
+char *replayFile= NULL;   /* -y */
+double replayScale= 1.0;
+FI_SPEC faultSpec;        /* -n */
+int faultRuns= 1;
+double faultFactor[FI_MAX_FACTORS];
+int faultFactors= 0;
+double faultLatency= -1;  /* -n k */
+char *benchFile= NULL;    /* -k */
+BOOL kernels= FALSE;      /* -u */
+double benchThreshold= BN_THRESHOLD;
+double benchLatency= BN_LATENCY;
+char pipeName[256];
+char *serverPipe= NULL;   /* -q */
+char *clientPipe= NULL;   /* -o */
+char *frameFile= NULL;    /* -g */
 
 /*---------------------------------------------------------------
 * Functions:
 *---------------------------------------------------------------
 */
 
-int preparePatch()
-	{
-	int error= ERR_NONE;
-
-#ifdef WORKAROUND
-	if (patchLoaded)
-		{
-		/* Load PC with 0x0220.
-		* This will invoke the patched bootstrap loader subroutines.
-		*/
-		error= bslTxRx(BSL_LOADPC,	/* Command: Load PC 	*/
-			0x0220, 	/* Address to load into PC */
-			0,			/* No additional data! 	*/
-			NULL, blkin);
-		if (error != ERR_NONE) return(error);
-		BSLMemAccessWarning= 0; /* Error is removed within workaround code */
-		}
-#endif /* WORKAROUND */
-
-	return(error);
-	}
-
-void postPatch()
-	{
-#ifdef WORKAROUND
-	if (patchLoaded)
-		{
-		BSLMemAccessWarning= 1; /* Turn warning back on. */
-		}
-#endif /* WORKAROUND */
-	}
-
-int verifyBlk(unsigned long addr, WORD len, unsigned action)
-	{
-	int i= 0;
-	int error= ERR_NONE;
-
-	if ((action & (ACTION_VERIFY | ACTION_ERASE_CHECK)) != 0)
-		{
-
-#ifdef DEBUGDUMP
-		printf("Check starting at %x, %i bytes... ", addr, len);
-#endif /* DEBUGDUMP */
-
-		error= preparePatch();
-		if (error != ERR_NONE) return(error);
-
-        if (toDo.MSP430X) {
-			if (error = bslTxRx(BSL_MEMOFFSET, 0, (WORD)(addr>>16),	NULL, blkin) !=0)  return (error);
-			addr = addr & 0xFFFF;
-		}
-
-		error= bslTxRx(BSL_RXBLK, addr, len, NULL, blkin);
-
-		postPatch();
-
-#ifdef DEBUGDUMP
-		printf("Error: %i\n", error);
-#endif /* DEBUGDUMP */
-
-		if (error != ERR_NONE)
-			{
-			return(error); /* Cancel, if read error */
-			}
-		else
-			{
-			for (i= 0; i < len; i++)
-				{
-				if ((action & ACTION_VERIFY) != 0)
-					{
-					/* Compare data in blkout and blkin: */
-					if (blkin[i] != blkout[i])
-						{
-						printf("Verification failed at %x (%x, %x)\n", addr+i, blkin[i], blkout[i]);
-						return(ERR_VERIFY_FAILED); /* Verify failed! */
-						}
-					continue;
-					}
-				if ((action & ACTION_ERASE_CHECK) != 0)
-					{
-					/* Compare data in blkin with erase pattern: */
-					if (blkin[i] != 0xff)
-						{
-						printf("Erase Check failed at %x (%x)\n", addr+i, blkin[i]);
-						return(ERR_ERASE_CHECK_FAILED); /* Erase Check failed! */
-						}
-					continue;
-					} /* if ACTION_ERASE_CHECK */
-				} /* for (i) */
-			} /* else */
-        if (toDo.MSP430X)
-			if (error = bslTxRx(BSL_MEMOFFSET, 0, (WORD)(0),NULL, blkin) !=0)  return (error);
-		} /* if ACTION_VERIFY | ACTION_ERASE_CHECK */
-
-
-	else if ((action & ACTION_ERASE_CHECK_FAST) != 0) /* FRGR 02/01 */
-		{
-
-#ifdef DEBUGDUMP
-		printf("Fast Check starting at %x, %i bytes... ", addr, len);
-#endif /* DEBUGDUMP */
-
-		error= preparePatch();
-		if (error != ERR_NONE) return(error);
-
-		error= bslTxRx(BSL_ECHECK, addr, len, NULL, blkin);
-
-		postPatch();
-
-#ifdef DEBUGDUMP
-		printf("Error: %i\n", error);
-#endif /* DEBUGDUMP */
-
-		if (error != ERR_NONE)
-			{
-			return(ERR_ERASE_CHECK_FAILED); /* Erase Check failed! */
-			}
-		} /* if ACTION_ERASE_CHECK_FAST */
-
-
-	return(error);
-	}
-
-int programBlk(unsigned long addr, WORD len, unsigned action)
-	{
-	int i= 0;
-	int error= ERR_NONE;
-
-	if ((action & ACTION_PASSWD) != 0)
-		{
-		return(bslTxRx(BSL_TXPWORD, /* Command: Transmit Password*/
-			addr,		/* Address of interupt vectors */
-			len,		/* Number of bytes 			*/
-			blkout, blkin));
-		} /* if ACTION_PASSWD */
-
-	/* Check, if specified range is erased: */
-	if (action & ACTION_ERASE_CHECK)
-		error= verifyBlk(addr, len, action & ACTION_ERASE_CHECK);
-	else if (action & ACTION_ERASE_CHECK_FAST)
-		error= verifyBlk(addr, len, action & ACTION_ERASE_CHECK_FAST);
-	if (error != ERR_NONE)
-		{
-		return(error);
-		}
-
-	if ((action & ACTION_PROGRAM) != 0)
-		{
-
-#ifdef DEBUGDUMP
-		printf("Program starting at %x, %i bytes... ", addr, len);
-#endif /* DEBUGDUMP */
-
-		error= preparePatch();
-		if (error != ERR_NONE) return(error);
-
-		/* Set Offset: */
-		if (toDo.MSP430X) error= bslTxRx(BSL_MEMOFFSET, 0, (WORD)(addr>>16), blkout, blkin);
-		if (error != ERR_NONE) return(error);
-
-		/* Program block: */
-		error= bslTxRx(BSL_TXBLK, addr, len, blkout, blkin);
-
-		postPatch();
-
-#ifdef DEBUGDUMP
-		printf("Error: %i\n", error);
-#endif /* DEBUGDUMP */
-
-		if (error != ERR_NONE)
-			{
-			return(error); /* Cancel, if error (ACTION_VERIFY is skipped!) */
-			}
-        if (toDo.MSP430X)
-			if (error = bslTxRx(BSL_MEMOFFSET, 0, (WORD)(0),NULL, blkin) !=0)  return (error);
-
-		} /* if ACTION_PROGRAM */
-
-	/* Verify block: */
-	error= verifyBlk(addr, len, action & ACTION_VERIFY);
-	if (error != ERR_NONE)
-		{
-		return(error);
-		}
-
-	return(error);
-	} /* programBlk */
-
-unsigned int readStartAddrTIText(char *filename) /* FRGR */
-	{
-	WORD startAddr=0;
-	char strdata[128];
-	FILE* infile;
-
-	if ((infile = fopen(filename, "rb")) == 0)
-		{
-		errData= filename;
-		return(ERR_FILE_OPEN);
-		}
-
-	/* TXT-File is parsed for first @Addr occurence: */
-	while (TRUE)
-		{
-		/* Read one line: */
-		if (fgets(strdata, 127, infile) == 0)   /* if End Of File                */
-			{
-			break;
-			}
-		if (strdata[0] == '@')				    /* if @ => start address         */
-			{
-			sscanf(&strdata[1], "%x\n", &startAddr);
-			break;
-			}
-		}
-	fclose(infile);
-	return(startAddr);
-	} /* readStartAddrTIText */
-
-int programTIText (char *filename, unsigned action)
-	{
-	int next= 1;
-	int error= ERR_NONE;
-	int linelen= 0;
-	int linepos= 0;
-	int i, KBytes, KBytesbefore= -1;
-	WORD dataframelen=0;
-	unsigned long currentAddr;
-	char strdata[128];
-
-	FILE* infile;
-
-	byteCtr= 0;
-
-	if ((infile = fopen(filename, "rb")) == 0)
-		{
-		errData= filename;
-		return(ERR_FILE_OPEN);
-		}
-
-	/* Convert data for MSP430, TXT-File is parsed line by line: */
-	while (TRUE) /* FRGR */
-		{
-		/* Read one line: */
-		if ((fgets(strdata, 127, infile) == 0) ||
-			/* if End Of File				or */
-			(strdata[0] == 'q'))
-			/* if q (last character in file)	*/
-			{	/* => send frame and quit			*/
-			if (dataframelen > 0) /* Data in frame? */
-				{
-				error= programBlk(currentAddr, dataframelen, action);
-				byteCtr+= dataframelen; /* Byte Counter */
-				dataframelen=0;
-				}
-			break;	   /* FRGR  */
-			}
-
-		linelen= strlen(strdata);
-
-		if (strdata[0] == '@')
-			/* if @ => new address => send frame and set new addr. */
-			{
-			if (dataframelen > 0)
-				{
-				error= programBlk(currentAddr, dataframelen, action);
-				byteCtr+= dataframelen; /* Byte Counter */
-				dataframelen=0;
-				}
-			sscanf(&strdata[1], "%lx\n", &currentAddr);
-			continue;
-			}
-
-		/* Transfer data in line into blkout: */
-		for(linepos= 0;
-		linepos < linelen-3; linepos+= 3, dataframelen++)
-			{
-			sscanf(&strdata[linepos], "%3x", &blkout[dataframelen]);
-			/* (Max 16 bytes per line!) */
-			}
-
-		if (dataframelen > maxData-16)
-			/* if frame is getting full => send frame */
-			{
-			error= programBlk(currentAddr, dataframelen, action);
-			byteCtr+= dataframelen; /* Byte Counter */
-			currentAddr+= dataframelen;
-			dataframelen=0;
-
-			/* bargraph: indicates succession, actualize only when changed. FRGR */
-			KBytes = (byteCtr+512)/1024;
-			if (KBytesbefore != KBytes)
-				{
-				KBytesbefore = KBytes;
-				printf("\r%02d KByte ", KBytes);
-				printf("\xDE");
-				for (i=0;i<KBytes;i+=1) printf("\xB2");
-				printf("\xDD");
-				}
-			}
-
-		if (error != ERR_NONE)
-			{
-			break;	/* FRGR */
-			}
-		}
-	/* clear bargraph, go to left margin */
-	printf("\r \r");
-
-	fclose(infile);
-
-	return(error);
-	} /* programTIText */
-
-int txPasswd(char* passwdFile)
-	{
-	int i;
-
-	if (passwdFile == NULL)
-		{
-		/* Send "standard" password to get access to protected functions. */
-		printf("Transmit standard password...\n");
-		/* Fill blkout with 0xff
-		* (Flash is completely erased, the contents of all Flash cells is 0xff)
-		*/
-		for (i= 0; i < 0x20; i++)
-			{
-			blkout[i]= 0xff;
-			}
-		return(bslTxRx(BSL_TXPWORD, /* Command: Transmit Password  */
-			0xffe0, 	            /* Address of interupt vectors */
-			0x0020, 	            /* Number of bytes             */
-			blkout, blkin));
-		}
-	else
-		{
-		/* Send TI TXT file holding interrupt vector data as password: */
-		printf("Transmit PSW file \"%s\"...\n", passwdFile);
-		return(programTIText(passwdFile, ACTION_PASSWD));
-		}
-	} /* txPasswd */
-
 void WaitForKey() /* FRGR */
 	{
 	printf("----------------------------------------------------------- ");
 	printf("Press any key ... "); getch(); printf("\n");
 	}
 
-int signOff(int error, BOOL passwd)
-	{
-	if (toDo.MSP430X) error= bslTxRx(BSL_MEMOFFSET, 0, (WORD)(0), blkout, blkin);
-
-	if (toDo.Reset)
-		{
-		bslReset(0); /* Reset MSP430 and start user program. */
-		}
-
-	switch (error)
-		{
-		case ERR_NONE:
-			if (toDo.Program) printf("Programming completed.");
-				else if (toDo.Verify)printf("Verification successful.");
-			printf("Prog/Verify: %.1f sec",(float)(Time_BSL_stops-Time_PRG_starts)/1000.0);
-			printf(" - Over all: %.1f sec\n",(float)(Time_BSL_stops-Time_BSL_starts)/1000.0);
-			break;
-		case ERR_BSL_SYNC:
-			printf("ERROR: Synchronization failed!\n");
-			printf("Device with boot loader connected?\n");
-			break;
-		case ERR_VERIFY_FAILED:
-			printf("ERROR: Verification failed!\n");
-			break;
-		case ERR_ERASE_CHECK_FAILED:
-			printf("ERROR: Erase check failed!\n");
-			break;
-		case ERR_FILE_OPEN:
-			printf("ERROR: Unable to open input file \"%s\"!\n", (char*)errData);
-			break;
-		default:
-			if ((passwd) && (error == ERR_RX_NAK))
-				/* If last command == transmit password && Error: */
-				printf("ERROR: Password not accepted!\n");
-			else
-				printf("ERROR: Communication Error!\n");
-		} /* switch */
-
-	if (toDo.Wait)
-		{
-		WaitForKey();
-		}
-
-	comDone();	/* Release serial communication port.	*/
-				/* After having released the serial port,
-				 * the target is no longer supplied via this port!
-	             */
-	if (error == ERR_NONE)
-		return(0);
-	else
-		return(1);
-	} /* signOff */
-
 
 void showHelp()
 	{
 	char *help[]=
 		{
-		"BSLDEMO-2.01c [-h][-c{port}][-p{file}][-w][-1][-m{num}][+aecpvruw] {file}",
+		"BSLDEMO-2.01c [-h][-c{port}][-p{file}][-t{file}][-d{file}][-y{file}][-n{faults}][-k{file}][-u][-g{file}][-q{pipe}][-o{pipe}][-w][-1][-m{num}][+aecpvruw] {file}",
 			"",
 			/*
 			"The last parameter is required: file name of TI-TXT file to be programmed.",
@@ -681,32 +241,62 @@ void showHelp()
 			"Options:",
 			"-h       Shows this help screen.",
 			"-c{port} Specifies the communication port to be used (e.g. -cCOM2).",
+			"         Given for several ports (e.g. -cCOM2 -cCOM3), the devices on all",
+			"         of them are programmed at once. (Not with -r.)",
 #ifdef WORKAROUND
 			"-a{file} Filename of workaround patch (e.g. -aWAROUND.TXT).",
 #endif
 			"-b{file} Filename of complete loader to be loaded into RAM (e.g. -bBSL.TXT).",
+			"         -bFastLoader.txt speeds up programming of F1xx/F2xx/G2xx3 parts.",
+			"-d{file} Records all bytes sent and received with their times into file.",
+			"         (The last 64K are written to BSLDEMO.WTR on an error anyway.)",
 			"-e{startnum}",
 			"         Erase Segment where address does point to.",
 			/*
 			"-f{num}  Max. number of data bytes within one transmitted frame (e.g. -f240).",
 			*/
+			"-g{file} Compiles the TI-TXT file into the frame file {file} (with -f, -x,",
+			"         -p) and exits. Given in place of a TI-TXT file, it is sent as it is.",
 
 /*  Change by GH */
 
 			"-i       Invert polarity of DTR line.",
 			"-j       Invert polarity of RTS line.",
+			"-k{file}[,{percent}[,{ms}]]",
+			"         Benchmark: programs and reads generated images on a simulated",
+			"         device (with -s, +ecpv, -z ...); fails if slower than the baseline",
+			"         file by percent (default 5), writes it if missing. ms: latency.",
+			"-l{file} Lists the frames of a wire trace file (written by -d) and exits.",
+			"-n{faults}",
+			"         Injects faults, e.g. -nc0.001,d0.001,n0.05,s7: rate per byte of",
+			"         c:corrupt d:drop u:double w:delay (l{ms}) p:parity n:NAK for ACK,",
+			"         f{byte} t{byte}: only these bytes, s{num}: seed.  r{num}: runs,",
+			"         x{a}/{b}/..: rates times a, b, ..: shows how many runs succeed.",
+			"         The runs use the port, the recording of -y, or with k{ms} the",
+			"         simulated device of -k with this latency.",
+			"-o{pipe} Runs the command line as a job of the server started with -q.",
 
 #ifdef ADD_MERASE_CYCLES
 			"-m{num}  Number of mass erase cycles (e.g. -m20).",
 #endif /* ADD_MERASE_CYCLES */
 			"-p{file} Specifies a TI-TXT file with the interrupt vectors that are",
 			"         used as password (e.g. -pINT_VECT.TXT).",
+			"-q{pipe} Job server: keeps the ports open and runs the jobs sent with -o",
+			"         (pipe: name of the pipe, default BSLDEMO) until Ctrl+C.",
 			"-r{startnum} {lennum} {file}",
 			"         Read memory from startnum till lennum and write to file as TI.TXT.",
-			"         (Values in hex format.) ",
+			"         (.bin: binary, .hex: Intel HEX.) (Values in hex format.) ",
+			"         Above 0xFFFF with -x.",
 			"-s{num}  Changes the baudrate; num=0:9600, 1:19200, 2:38400 (e.g. -s2).",
+			"-t{file} Shows the times, bytes and errors of the commands at the end.",
+			"         With {file}: written as JSON with a trace for chrome://tracing.",
+			"-u       Microbenchmarks of the work on the PC (ns/byte) and exits.",
 			"-w       Waits for <ENTER> before closing serial port.",
 			"-x       Enable MSP430X Extended Memory support.",
+			"-y{file}[,{scale}]",
+			"         Replays a session recorded with -d in place of the device (no",
+			"         port used), its times multiplied by scale (0: no waits).",
+			"-z       With -r: skip erased ranges (found with Erase Check commands).",
 			"-1       Programming and verification is done in one pass through the file.",
 			"",
 			"Program Flow Specifiers [+aecipvruw]",
@@ -740,27 +330,9 @@ void showHelp()
 */
 int parseCMDLine(int argc, char *argv[])
 {
-   /* Default: all actions turned on: */
-   toDo.MassErase = 1;
-   toDo.EraseCheck= 1;
-   toDo.FastCheck = 0;
-   toDo.Program = 1;
-   toDo.Verify= 1;
-   toDo.Reset   = 1;
-   toDo.SpeedUp = 0; /* Change Baudrate */
-   toDo.UserCalled= 0;
-   toDo.Wait   = 0;  /* Do not wait for <Enter> at the end! */
-   toDo.OnePass = 0; /* Do erase check, program and verify*/
-   toDo.BSLStart= 1;
-   toDo.Dump2file = 0;
-   toDo.EraseSegment = 0;
-   toDo.MSP430X = 0;
-   toDo.RestoreInfoA = 0;
-
-   filename   = NULL;
-   passwdFile = NULL;
-   patchFile = patchFilename;
+   char *ptr;
 
+   bslDefaultOptions(&opt);
 
    if (argc > 1)
       {
@@ -778,53 +350,60 @@ int parseCMDLine(int argc, char *argv[])
 
                   case 'c': case 'C':
                      strcpy(comPortName, "\\\\.\\");  /* Required by Windows */
-                     memcpy(&comPortName[4], &argv[i][2], strlen(argv[i])-2);
+                     strcpy(&comPortName[4], &argv[i][2]);
+                     if (gangPorts < GANG_MAX_PORTS)
+                        {
+                        strcpy(gangPortName[gangPorts], comPortName);
+                        gangPorts++;
+                        }
+                     if (gangPorts > 1)
+                        strcpy(comPortName, gangPortName[0]);
                      break;
 
                   case 'p': case 'P':
                      strcpy(passwdFilename, &argv[i][2]);
-                     passwdFile = passwdFilename;
+                     opt.passwdFile = passwdFilename;
                      break;
 
                   case 'w': case 'W':
-                     toDo.Wait= 1; /* Do wait for <Enter> at the end! */
+                     opt.toDo.Wait= 1; /* Do wait for <Enter> at the end! */
                      break;
 
                   case '1':
-                     toDo.OnePass= 1;
+                     opt.toDo.OnePass= 1;
                      break;
 
 /*  Change by GH */
 
                   case 'i':
-                     InvertDTR = TRUE;
+                     opt.invertDTR = TRUE;
                      break;
 
                   case 'j':
-                     InvertRTS = TRUE;
+                     opt.invertRTS = TRUE;
                      break;
 
 
                   case 's': case 'S':
                      if ((argv[i][2] >= '0') && (argv[i][2] <= '9'))
                         {
-                        speed = argv[i][2] - 0x30;   /* convert ASCII to number */
-                        toDo.SpeedUp= 1;
+                        opt.speed = argv[i][2] - 0x30;   /* convert ASCII to number */
+                        opt.toDo.SpeedUp= 1;
                         }
                      break;
 
                   case 'f': case 'F':
                      if (argv[i][2] != 0)
                         {
-                        sscanf(&argv[i][2], "%i", &maxData);
+                        sscanf(&argv[i][2], "%i", &opt.maxData);
                         /* Make sure that conditions for maxData are met:
                         * ( >= 16 and == n*16 and <= MAX_DATA_BYTES!)
                         */
-                        maxData= (maxData > MAX_DATA_BYTES) ? MAX_DATA_BYTES : maxData;
-                        maxData= (maxData <          16) ?         16 : maxData;
-                        maxData= maxData - (maxData % 16);
+                        opt.maxData= (opt.maxData > MAX_DATA_BYTES) ? MAX_DATA_BYTES : opt.maxData;
+                        opt.maxData= (opt.maxData <          16) ?         16 : opt.maxData;
+                        opt.maxData= opt.maxData - (opt.maxData % 16);
                         printf("Max. number of data bytes within one frame set to %i.\n",
-                           maxData);
+                           opt.maxData);
                         }
                      break;
 
@@ -832,9 +411,9 @@ int parseCMDLine(int argc, char *argv[])
                   case 'm': case 'M':
                      if (argv[i][2] != 0)
                         {
-                        sscanf(&argv[i][2], "%i", &meraseCycles);
-                        meraseCycles= (meraseCycles < 1) ? 1 : meraseCycles;
-                        printf("Number of mass erase cycles set to %i.\n", meraseCycles);
+                        sscanf(&argv[i][2], "%i", &opt.meraseCycles);
+                        opt.meraseCycles= (opt.meraseCycles < 1) ? 1 : opt.meraseCycles;
+                        printf("Number of mass erase cycles set to %i.\n", opt.meraseCycles);
                         }
                      break;
 #endif /* ADD_MERASE_CYCLES */
@@ -842,47 +421,119 @@ int parseCMDLine(int argc, char *argv[])
 #ifdef WORKAROUND
                   case 'a': case 'A':
                      strcpy (patchFilename ,&argv[i][2]);
-                            patchFile=patchFilename;
+                            opt.patchFile=patchFilename;
+#ifdef NEW_BSL
+                     opt.fastPatchFile= NULL;
+#endif /* NEW_BSL */
                      break;
 #endif /* WORKAROUND */
 
 #ifdef NEW_BSL
                   case 'b': case 'B':
                      strcpy (newBSLFilename ,&argv[i][2]);
-                            newBSLFile=newBSLFilename;
+                            opt.newBSLFile=newBSLFilename;
                      break;
 #endif /* NEW_BSL */
                   case 'r': case 'R':
-                     toDo.MassErase = 0;
-                     toDo.EraseCheck= 0;
-                     toDo.FastCheck = 0;
-                     toDo.Program = 0;
-                     toDo.Verify= 0;
-
-                     toDo.Dump2file = 1;
-                     sscanf(&argv[i][2], "%X", &readStart);
+                     opt.toDo.MassErase = 0;
+                     opt.toDo.EraseCheck= 0;
+                     opt.toDo.FastCheck = 0;
+                     opt.toDo.Program = 0;
+                     opt.toDo.Verify= 0;
+
+                     opt.toDo.Dump2file = 1;
+                     if (i + 2 >= argc)
+                     {
+                        printf("ERROR: -r needs {start} {length} {file}!\n");
+                        return(1);
+                     }
+                     sscanf(&argv[i][2], "%X", &opt.readStart);
                      i++;
-                     sscanf(&argv[i][0], "%X", &readLen);
+                     sscanf(&argv[i][0], "%X", &opt.readLen);
                      i++;
-                     readfilename = &argv[i][0];
+                     opt.readfilename = &argv[i][0];
                      break;
                   case 'e': case 'E':
-                     toDo.MassErase = 0;
-                     toDo.EraseCheck= 0;
-                     toDo.FastCheck = 0;
-                     toDo.Program = 0;
-                     toDo.Verify= 0;
-                     toDo.Reset   = 0;
-                     toDo.UserCalled= 0;
-                     toDo.BSLStart= 1;
-                     toDo.Dump2file = 0;
-
-                     toDo.EraseSegment = 1;
-                     sscanf(&argv[i][2], "%X", &readStart);
+                     opt.toDo.MassErase = 0;
+                     opt.toDo.EraseCheck= 0;
+                     opt.toDo.FastCheck = 0;
+                     opt.toDo.Program = 0;
+                     opt.toDo.Verify= 0;
+                     opt.toDo.Reset   = 0;
+                     opt.toDo.UserCalled= 0;
+                     opt.toDo.BSLStart= 1;
+                     opt.toDo.Dump2file = 0;
+
+                     opt.toDo.EraseSegment = 1;
+                     sscanf(&argv[i][2], "%X", &opt.readStart);
                      i++;
                      break;
                   case 'x': case 'X':
-                     toDo.MSP430X = 1;
+                     opt.toDo.MSP430X = 1;
+                     break;
+                  case 'z': case 'Z':
+                     opt.toDo.SparseRead = 1;
+                     break;
+                  case 'd': case 'D':
+                     opt.traceFile = &argv[i][2];
+                     break;
+                  case 'l': case 'L':
+                     wireListFile = &argv[i][2];
+                     break;
+                  case 'y': case 'Y':
+                     replayFile = &argv[i][2];
+                     if ((ptr = strrchr(replayFile, ',')) != NULL)
+                     {
+                        *ptr = 0;
+                        replayScale = atof(&ptr[1]);
+                     }
+                     break;
+                  case 'k': case 'K':
+                     benchFile = (argv[i][2] != 0) ? &argv[i][2] : BN_DEFAULT_FILE;
+                     if ((ptr = strchr(benchFile, ',')) != NULL)
+                     {
+                        *ptr++ = 0;
+                        benchThreshold = atof(ptr);
+                        if ((ptr = strchr(ptr, ',')) != NULL)
+                           benchLatency = atof(&ptr[1]);
+                     }
+                     if (*benchFile == 0) benchFile = BN_DEFAULT_FILE;
+                     break;
+                  case 'n': case 'N':
+                     if (!fiParse(&argv[i][2], &faultSpec, &faultRuns,
+                                  faultFactor, &faultFactors, &faultLatency))
+                     {
+                        printf("ERROR: Illegal fault injection \"%s\"!\n", &argv[i][2]);
+                        return(1);
+                     }
+                     opt.faults = &faultSpec;
+                     break;
+                  case 'u': case 'U':
+                     kernels = TRUE;
+                     break;
+                  case 'g': case 'G':
+                     frameFile = &argv[i][2];
+                     break;
+                  case 'q': case 'Q':
+                  case 'o': case 'O':
+                     if (argv[i][2] == 0)
+                        strcpy(pipeName, DM_DEFAULT_PIPE);
+                     else if (argv[i][2] == '\\')
+                        strcpy(pipeName, &argv[i][2]);
+                     else
+                        {
+                        strcpy(pipeName, "\\\\.\\pipe\\");  /* Required by Windows */
+                        strcat(pipeName, &argv[i][2]);
+                        }
+                     if ((argv[i][1] == 'q') || (argv[i][1] == 'Q'))
+                        serverPipe = pipeName;
+                     else
+                        clientPipe = pipeName;
+                     break;
+                  case 't': case 'T':
+                     opt.metrics = TRUE;
+                     if (argv[i][2] != 0)
+                        opt.metricsFile = &argv[i][2];
                      break;
 
                   default:
@@ -892,15 +543,15 @@ int parseCMDLine(int argc, char *argv[])
 
             case '+':
                      /* Turn all actions off: */
-                     toDo.MassErase = 0;
-                     toDo.EraseCheck= 0;
-                     toDo.FastCheck = 0;
-                     toDo.Program = 0;
-                     toDo.Verify= 0;
-                     toDo.Reset   = 0;
-                     toDo.UserCalled= 0;
-                     toDo.BSLStart= 1;
-					 toDo.RestoreInfoA = 0;
+                     opt.toDo.MassErase = 0;
+                     opt.toDo.EraseCheck= 0;
+                     opt.toDo.FastCheck = 0;
+                     opt.toDo.Program = 0;
+                     opt.toDo.Verify= 0;
+                     opt.toDo.Reset   = 0;
+                     opt.toDo.UserCalled= 0;
+                     opt.toDo.BSLStart= 1;
+					 opt.toDo.RestoreInfoA = 0;
 
                      /* Turn only specified actions back on:             */
                      for (j= 1; j < (int)(strlen(argv[i])); j++)
@@ -909,42 +560,42 @@ int parseCMDLine(int argc, char *argv[])
                            {
                            case 'a': case 'A':
                               /* Restore InfoA Segment              */
-							  toDo.RestoreInfoA = 1;
+							  opt.toDo.RestoreInfoA = 1;
                            case 'e': case 'E':
                               /* Erase Flash                        */
-                              toDo.MassErase = 1;
+                              opt.toDo.MassErase = 1;
                               break;
                            case 'c': case 'C':
                               /* Erase Check (by file)               */
-                              toDo.EraseCheck= 1;
+                              opt.toDo.EraseCheck= 1;
                               break;
                            case 'f': case 'F':
                               /* Fast Erase Check (by file)            */
-                              toDo.FastCheck= 1;
+                              opt.toDo.FastCheck= 1;
                               break;
                            case 'p': case 'P':
                               /* Program file                      */
-                              toDo.Program = 1;
+                              opt.toDo.Program = 1;
                               break;
                            case 'r': case 'R':
                               /* Reset MSP430 before waiting for <Enter>   */
-                              toDo.Reset   = 1;
+                              opt.toDo.Reset   = 1;
                               break;
                            case 'u': case 'U':
                               /* Second run without entry sequence      */
-                              toDo.UserCalled= 1;
+                              opt.toDo.UserCalled= 1;
                               break;
                            case 'v': case 'V':
                               /* Verify file                        */
-                              toDo.Verify= 1;
+                              opt.toDo.Verify= 1;
                               break;
                            case 'w': case 'W':
                               /* Wait for <Enter> before closing serial port */
-                              toDo.Wait   = 1;
+                              opt.toDo.Wait   = 1;
                               break;
                            case 'x': case 'X':
                               /* Start BSL ??? */
-                              toDo.BSLStart   = 0;
+                              opt.toDo.BSLStart   = 0;
                               break;
                            default:
                               printf("ERROR: Illegal action specified!\n");
@@ -953,7 +604,7 @@ int parseCMDLine(int argc, char *argv[])
                      break; /* '+' */
 
                   default:
-                       filename= argv[i];
+                       opt.filename= argv[i];
          } /* switch argv[i][0] */
       } /* for (i) */
    }
@@ -967,586 +618,274 @@ int parseCMDLine(int argc, char *argv[])
 }
 
 /*---------------------------------------------------------------
-* Main:
+* Fault injection:
 *---------------------------------------------------------------
 */
-int main(int argc, char *argv[])
-{
-	const WORD SMALL_RAM_model = 0;
-	const WORD LARGE_RAM_model = 1;
-	const WORD ROM_model = 0x4567;
-	WORD loadedModel = ROM_model;
-	int stat = 0;
-	unsigned char infoA[0x40];
-
-#ifdef NEW_BSL
-	newBSLFile= NULL;
-#endif // NEW_BSL
 
-
-#ifdef WORKAROUND
-	/* Show memory access warning, if working with bootstrap
-	* loader version(s) requiring the workaround patch.
-	* Turn warning on by default until we can determine the
-	* actual version of the bootstrap loader.
-	*/
-	BSLMemAccessWarning= 1;
-#endif /* WORKAROUND */
-
-	printf("%s (%s)\n", programName, programVersion);
-
-    stat = parseCMDLine(argc, argv);
-    if (stat != 0) return(stat);
-
-
-/*-------------------------------------------------------
-* Communication with Bootstrap Loader ...
-*-------------------------------------------------------
-*/
-
-
-	/* Open COMx port (Change COM-port name to your needs!): */
-	if (comInit(comPortName, DEFAULT_TIMEOUT, 4) != 0)
-		{
-		printf("ERROR: Opening COM-Port failed!\n");
-		if (toDo.Wait)
-			{
-			WaitForKey(); /* FRGR */
-			}
-		return(0);
-		}
-
-	if (toDo.UserCalled)
-	{ }
-    else
+static void faultPrint(BSL_SESSION *s, const char *text)
 	{
+	} /* faultPrint */
 
-		bslReset(toDo.BSLStart); /* Invoke the boot loader. */
-		//delay(2000);
-		Time_BSL_starts = GetTickCount();
-	}
-
-
-	Repeat:
-
-#ifdef NEW_BSL
-
-
-
-if ((newBSLFile == NULL) || (passwdFile == NULL))
+static void faultProgress(BSL_SESSION *s, int bytes)
 	{
-	/* If a password file is specified the "new" bootstrap loader can be loaded
-	* (if also specified) before the mass erase is performed. Then the mass
-	* erase can be done using the "new" BSL. Otherwise the mass erase is done
-	* now!
-	*/
-#endif /* NEW_BSL */
-
-
-	if (toDo.RestoreInfoA && toDo.MassErase)
-		{
-
-		/* Read actual InfoA segment Content. */
-		printf("Read InfoA Segment...\n");
-		/* Transmit password to get access to protected BSL functions. */
-		if ((error= txPasswd(passwdFile)) != ERR_NONE)
-			{
-			return(signOff(error, TRUE)); /* Password was transmitted! */
-			}
-		if (toDo.MSP430X) if (bslTxRx(BSL_MEMOFFSET, 0, 0, NULL, blkin) !=0)  return (signOff(error, TRUE));
-		if ((error= bslTxRx(BSL_RXBLK, /* Command: Read/Receive Block 	*/
-			0x010C0,	/* Start address					*/
-			0x40,		/* No. of bytes to read			*/
-			NULL, infoA)) != ERR_NONE)
-			{
-				return(signOff(error, FALSE));
-			}
-		}
-	else
-		{
-		toDo.RestoreInfoA = 0;
-		}
-
-
-	if (toDo.MassErase)
-		{
-		int i;
-		/* Erase the flash memory completely (with mass erase command): */
-		printf("Mass Erase...\n");
-		for (i= 0; i < meraseCycles; i++)
-			{
-			if (i == 1)
+	} /* faultProgress */
+
+int faultSweep(void)
+/* -n with r, x or k: runs the program flow faultRuns times at each
+ * multiple of the rates given (seeds seed, seed+1, ...), quietly,
+ * and shows how many runs got through and how long they took.
+ * Each run opens the port, the recording of -y or (k) a new
+ * simulated device, and is timed by the clock of this transport.
+ */
+	{
+	BSL_SESSION session;
+	void *port;
+	FI_SPEC spec;
+	DWORD count[FI_KINDS], faults, start, time, okTime, maxTime;
+	double factor;
+	int f, run, kind, ok, error, failed= 0;
+
+	if (faultFactors == 0)
+		{
+		faultFactor[0]= 1.0;
+		faultFactors= 1;
+		}
+	opt.faults= &spec;
+	printf("Fault injection, %d runs at each rate:\n", faultRuns);
+	printf(" factor  drop   corr   dup    delay  parity NAK    |  OK    mean s   max s | faults (per run)\n");
+	for (f= 0; f < faultFactors; f++)
+		{
+		factor= faultFactor[f];
+		spec= faultSpec;
+		for (kind= 0; kind < FI_KINDS; kind++) spec.rate[kind]*= factor;
+		ok= 0;
+		faults= okTime= maxTime= 0;
+		for (run= 0; run < faultRuns; run++)
+			{
+			spec.seed= faultSpec.seed + run;
+			port= NULL;
+			if (replayFile != NULL)
 				{
-				printf("Additional mass erase cycles...\n");
+				if ((port= rpOpen(replayFile, replayScale, &error)) == NULL)
+					{
+					printf("ERROR: Can't read recording \"%s\"!\n", replayFile);
+					return(1);
+					}
+				error= bslOpen(&session, &rpTransport, port, &opt);
+				port= NULL; /* (freed by bslClose()) */
 				}
-			if ((error= bslTxRx(BSL_MERAS, /* Command: Mass Erase 			*/
-				0xff00,	/* Any address within flash memory. */
-				0xa506,	/* Required setting for mass erase! */
-				NULL, blkin)) != ERR_NONE)
+			else if (faultLatency >= 0)
 				{
-				return(signOff(error, FALSE));
+				if ((port= sdOpen((DWORD)(faultLatency * 1000), &error)) != NULL)
+					error= bslOpen(&session, &sdTransport, port, &opt);
+				}
+			else
+				error= bslOpenCom(&session, comPortName, &opt);
+			if (error != ERR_NONE)
+				{
+				if (port != NULL) sdFree(port);
+				printf("ERROR: Opening COM-Port failed!\n");
+				return(1);
+				}
+			session.print= faultPrint;
+			session.progress= faultProgress;
+			start= comTicks(&session);
+			error= bslRun(&session);
+			time= comTicks(&session) - start;
+			faults+= fiCount(&session, count);
+			bslClose(&session);
+			if (port != NULL) sdFree(port);
+			if (time > maxTime) maxTime= time;
+			if (error == ERR_NONE)
+				{
+				ok++;
+				okTime+= time;
 				}
 			}
-		passwdFile= NULL; /* No password file required! */
+		printf("%7.3g ", factor);
+		for (kind= 0; kind < FI_KINDS; kind++) printf(" %-6.2g", spec.rate[kind]);
+		printf(" | %3d%%  %7.3f %7.3f | %7.1f\n", ok * 100 / faultRuns,
+			(ok > 0) ? okTime / 1000.0 / ok : 0.0, maxTime / 1000.0,
+			(double)faults / faultRuns);
+		if (ok < faultRuns) failed= 1;
 		}
+	return(failed);
+	} /* faultSweep */
 
-#ifdef NEW_BSL
-	} /* if ((newBSLFile == NULL) || (passwdFile == NULL)) */
-#endif /* NEW_BSL */
-
-/* Transmit password to get access to protected BSL functions. */
-	if (!(toDo.UserCalled))
-		if ((error= txPasswd(passwdFile)) != ERR_NONE)
-			{
-			return(signOff(error, TRUE)); /* Password was transmitted! */
-			}
+/*---------------------------------------------------------------
+* Job server:
+*---------------------------------------------------------------
+*/
 
-/* Read actual bootstrap loader version (FRGR: complete Chip ID). */
-    if (toDo.MSP430X) if (bslTxRx(BSL_MEMOFFSET, 0, 0, NULL, blkin) !=0)  return (signOff(error, TRUE));
-	if ((error= bslTxRx(BSL_RXBLK, /* Command: Read/Receive Block 	*/
-		0x0ff0,	/* Start address					*/
-		14,		/* No. of bytes to read			*/
-		NULL, blkin)) == ERR_NONE)
+static int daemonJob(int argc, char *argv[])
+/* Runs a job of the server (-q): the command line of a client (-o).
+ */
 	{
-	memcpy(&devTypeHi,&blkin[0x00], 1);
-	memcpy(&devTypeLo,&blkin[0x01], 1);
-	memcpy(&devProcHi,&blkin[0x02], 1);
-	memcpy(&devProcLo,&blkin[0x03], 1);
-	memcpy(&bslVerHi, &blkin[0x0A], 1);
-	memcpy(&bslVerLo, &blkin[0x0B], 1);
-
-	printf("BSL version: %X.%02X",	bslVerHi,bslVerLo);
-	printf(" - Family member: %02X%02X", devTypeHi, devTypeLo);
-	printf(" - Process: %02X%02X\n",	devProcHi, devProcLo);
+	int arg;
 
-	bslVer= (bslVerHi << 8) | bslVerLo;
+	wireListFile= NULL;
+	replayFile= NULL;
+	benchFile= NULL;
+	kernels= FALSE;
+	frameFile= NULL;
+	faultRuns= 1;
+	faultFactors= 0;
+	faultLatency= -1;
+	gangPorts= 0;
+	strcpy(comPortName, "COM1");
+	serverPipe= clientPipe= NULL;
 
-	if (bslVer < 0x0150) bslerrbuf = 0x021E; else bslerrbuf = 0x0200;
-
-	if (bslVer <= 0x0110)
+	/* (-h would wait for a key on the console of the server) */
+	for (arg= 1; arg < argc; arg++)
 		{
-
-#ifdef WORKAROUND
-#ifdef NEW_BSL
-		if (newBSLFile == NULL)
+		if ((argv[arg][0] == '-') && ((argv[arg][1] == 'h') || (argv[arg][1] == 'H')))
 			{
-#endif /* NEW_BSL */
-			printf("Patch for flash programming required!\n");
-			patchRequired= TRUE;
-#ifdef NEW_BSL
+			dmPrintf("ERROR: -h can't be used in a job!\n");
+			return(1);
 			}
-#endif /* NEW_BSL */
-#endif /* WORKAROUND */
-
-		BSLMemAccessWarning= 1;
 		}
-	else
+	if ((argc < 2) || (parseCMDLine(argc, argv) != 0))
 		{
-		BSLMemAccessWarning= 0; /* Fixed in newer versions of BSL. */
-		}
-	}
-
-
-	if (patchRequired || ((newBSLFile != NULL) && (bslVer <= 0x0110)))
-	{
-	/* Execute function within bootstrap loader
-	* to prepare stack pointer for the following patch.
-	* This function will lock the protected functions again.
-	*/
-	printf("Load PC with 0x0C22...\n");
-	if ((error= bslTxRx(BSL_LOADPC, /* Command: Load PC		*/
-		0x0C22,	/* Address to load into PC */
-		0,		/* No additional data!	*/
-		NULL, blkin)) != ERR_NONE)
-		{
-		return(signOff(error, FALSE));
+		dmPrintf("ERROR: Illegal command line!\n");
+		return(1);
 		}
-
-	/* Re-send password to re-gain access to protected functions. */
-	if ((error= txPasswd(passwdFile)) != ERR_NONE)
+	if ((wireListFile != NULL) || (replayFile != NULL) || (benchFile != NULL) ||
+		kernels || (frameFile != NULL) || (opt.faults != NULL) || opt.metrics || (opt.traceFile != NULL) ||
+		opt.toDo.Wait || (gangPorts > 1) || (serverPipe != NULL))
 		{
-		return(signOff(error, TRUE)); /* Password was transmitted! */
-		}
-	}
-
-#ifdef NEW_BSL
-	if (newBSLFile != NULL)
-	{
-	WORD startaddr; /* used twice: vector or start address */
-	startaddr = readStartAddrTIText(newBSLFile);
-	if (startaddr == 0)
-		{
-		startaddr = 0x0300;
+		dmPrintf("ERROR: -l, -y, -k, -u, -g, -n, -t, -d, -w, +w, -q and several ports can't be used in a job!\n");
+		return(1);
 		}
 
-	printf("Load");
-	if (bslVer >= 0x0140) printf("/Verify");
-	printf(" new BSL \"%s\" into RAM at 0x%04X...\n", newBSLFile, startaddr);
-	if ((error= programTIText(newBSLFile, /* File to program */
-		ACTION_PROGRAM)) != ERR_NONE)
-		{
-		return(signOff(error, FALSE));
-		}
-	if (bslVer < 0x0140)
-		{
-		printf("Verify new BSL \"%s\"...\n", newBSLFile);
-		if ((error= programTIText(newBSLFile, /* File to verify */
-			ACTION_VERIFY)) != ERR_NONE)
-			{
-			return(signOff(error, FALSE));
-			}
-		}
+	return((dmRun(comPortName, &opt) == ERR_NONE) ? 0 : 1);
+	} /* daemonJob */
 
-	/* Read startvector/loaded model of NEW bootstrap loader: */
-	if ((error= bslTxRx(BSL_RXBLK, startaddr, 4, NULL, blkin)) == ERR_NONE)
-		{
-		memcpy(&startaddr, &blkin[0], 2);
-		memcpy(&loadedModel, &blkin[2], 2);
-		if (loadedModel != SMALL_RAM_model)
-			{
-			loadedModel= LARGE_RAM_model;
-			bslerrbuf = 0x0200;
-			printf("Start new BSL (LARGE model > 1K Bytes) at 0x%04X...\n", startaddr);
-			}
-		else
-			printf("Start new BSL (SMALL model < 512 Bytes) at 0x%04X...\n", startaddr);
+/*---------------------------------------------------------------
+* Main:
+*---------------------------------------------------------------
+*/
+int main(int argc, char *argv[])
+{
+	BSL_SESSION session;
+	BSL_SESSION *sessions[1];
+	void *replay= NULL;
+	int stat = 0;
+	int error;
 
-		error= bslTxRx(BSL_LOADPC, /* Command: Load PC		*/
-			startaddr,/* Address to load into PC */
-			0,		/* No additional data!	*/
-			NULL, blkin);
-		}
-	if (error != ERR_NONE)
-		{
-		return(signOff(error, FALSE));
-		}
+	printf("%s (%s)\n", programName, programVersion);
 
-	/* BSL-Bugs should be fixed within "new" BSL: */
-	BSLMemAccessWarning= 0;
-	patchRequired= FALSE;
-	patchLoaded= FALSE;
+    stat = parseCMDLine(argc, argv);
+    if (stat != 0) return(stat);
 
-	if (loadedModel != SMALL_RAM_model)
-		{
-		/* Re-send password to re-gain access to protected functions. */
-		if ((error= txPasswd(passwdFile)) != ERR_NONE)
-			{
-			return(signOff(error, TRUE)); /* Password was transmitted! */
-			}
-		}
-	}
-#endif/* NEW_BSL */
+    if (clientPipe != NULL) return(dmSubmit(clientPipe, argc, argv));
 
-#ifdef WORKAROUND
-	if (patchRequired)
-	{
-	printf("Load and verify patch \"%s\"...\n", patchFile);
-	/* Programming and verification is done in one pass.
-	* The patch file is only read and parsed once.
-	*/
-	if ((error= programTIText(patchFile, /* File to program */
-		ACTION_PROGRAM | ACTION_VERIFY)) != ERR_NONE)
-		{
-		return(signOff(error, FALSE));
-		}
-	patchLoaded= TRUE;
-	}
-#endif /* WORKAROUND */
+    if (serverPipe != NULL) return(dmServe(serverPipe, daemonJob));
 
-#ifdef NEW_BSL
-	if ((newBSLFile != NULL) && (passwdFile != NULL) && toDo.MassErase)
-	{
-	/* Erase the flash memory completely (with mass erase command): */
-	printf("Mass Erase...\n");
-	if ((error= bslTxRx(BSL_MERAS, /* Command: Mass Erase 			*/
-		0xff00,	/* Any address within flash memory. */
-		0xa506,	/* Required setting for mass erase! */
-		NULL, blkin)) != ERR_NONE)
-		{
-		return(signOff(error, FALSE));
-		}
-	passwdFile= NULL; /* No password file required! */
-	}
-#endif /* NEW_BSL*/
+    if (wireListFile != NULL)
+    {
+        if (wtList(wireListFile)) return(0);
+        printf("ERROR: Can't read wire trace \"%s\"!\n", wireListFile);
+        return(1);
+    }
 
+    if (kernels) return(bnKernels());
 
-/* FRGR */
-	if (toDo.SpeedUp) // 0:9600, 1:19200, 2:38400 (3:56000 not applicable)
-	{
-	DWORD BR; 					// Baudrate
-	if ((devTypeHi == 0xF1) || (devTypeHi == 0x12)) // F1232 / F1xx
-		{
-		BYTE BCSCTL1, DCOCTL; 		// Basic Clock Module Registers
-		switch (speed)		    	// for F148, F149, F169
-			{ 												//Rsel DCO
-			case 0:  BR = CBR_9600;  BCSCTL1 = 0x85; DCOCTL = 0x80; break;// 5	4
-			case 1:  BR = CBR_19200; BCSCTL1 = 0x86; DCOCTL = 0xE0; break;// 6	7
-			case 2:  BR = CBR_38400; BCSCTL1 = 0x87; DCOCTL = 0xE0; break;// 7	7
-			default: BR = CBR_9600;  BCSCTL1 = 0x85; DCOCTL = 0x80; speed = 0;
-			}
-		_addr = (BCSCTL1 << 8) + DCOCTL;// D2, D1: values for CPU frequency
-		}
-	else if (devTypeHi == 0xF4)
-		{
-		BYTE SCFI0, SCFI1;			// FLL+ Registers
-		switch (speed)			    // for F448, F449
-			{ 												//NDCO FN_x
-			case 0:  BR = CBR_9600;  SCFI1 = 0x98; SCFI0= 0x00; break;// 19	0
-			case 1:  BR = CBR_19200; SCFI1 = 0xB0; SCFI0= 0x00; break;// 22	0
-			case 2:  BR = CBR_38400; SCFI1 = 0xC8; SCFI0= 0x00; break;// 25	0
-			default: BR = CBR_9600;  SCFI1 = 0x98; SCFI0= 0x00; speed = 0;
-			}
-		_addr = (SCFI1 << 8) + SCFI0; // D2, D1: values for CPU frequency
-		}
-	else if (devTypeHi == 0xF2 || devTypeHi == 0x25)
-		{
-		BYTE BCSCTL1, DCOCTL; 		// Basic Clock Module Registers
-		switch (speed)			    // for F2xx
-			{ 												//Rsel DCO
-			case 0:  BR = CBR_9600;  BCSCTL1 = 0x88; DCOCTL = 0x80; break;// 5	4
-			case 1:  BR = CBR_19200; BCSCTL1 = 0x8B; DCOCTL = 0x80; break;// 6	7
-			case 2:  BR = CBR_38400; BCSCTL1 = 0x8C; DCOCTL = 0x80; break;// 7	7
-			default: BR = CBR_9600;  BCSCTL1 = 0x88; DCOCTL = 0x80; speed = 0;
-			}
-		_addr = (BCSCTL1 << 8) + DCOCTL;// D2, D1: values for CPU frequency
-		}
-	_len	= speed;				// D3: index for baudrate (speed)
+    if (frameFile != NULL)
+    {
+        if (opt.filename != NULL)
+            return(ffCompile(opt.filename, opt.passwdFile, opt.maxData,
+                             opt.toDo.MSP430X, frameFile));
+        printf("ERROR: No file to compile!\n");
+        return(1);
+    }
 
-	if (BR != comGetBaudrate()) 	// change only if not same speed
-		{
-		printf("Change Baudrate ");
-		error= bslTxRx(BSL_SPEED, 	// Command: Change Speed
-			_addr,		// Mandatory code
-			_len, 		// Mandatory code
-			NULL, blkin);
+    if (benchFile != NULL)
+        return(bnRun(&opt, benchFile, benchThreshold, benchLatency));
 
-		if (error == ERR_NONE)
-			{
-			printf("from %d ", comGetBaudrate());
-			comChangeBaudrate(BR);
-			delay(10);
-			printf("to %d Baud (Mode: %d)\n", comGetBaudrate(),speed);
-			}
-		else
-			{
-			printf("command not accepted. Baudrate remains at %d Baud\n", comGetBaudrate());
-			}
-		}
-	}
+    if ((opt.faults != NULL) &&
+        ((faultRuns > 1) || (faultFactors > 0) || (faultLatency >= 0)))
+        return(faultSweep());
 
+    if ((gangPorts > 1) && (replayFile == NULL))
+    {
+        error= gangRun(&opt);
+        if (opt.toDo.Wait) WaitForKey();
+        return(error);
+    }
 
 
+/*-------------------------------------------------------
+* Communication with Bootstrap Loader ...
+*-------------------------------------------------------
+*/
 
- Time_PRG_starts = GetTickCount();
- //printf("Start time measurement for pure Prog/Verify cycle...\n");
 
- if (!toDo.OnePass)
-	{
-	if (toDo.EraseCheck)
+	/* Open COMx port (Change COM-port name to your needs!): */
+	if (replayFile != NULL)
 		{
-		/* Parse file in TXT-Format and check the erasure of required flash cells. */
-		printf("Erase Check by file \"%s\"...\n", filename);
-		if ((error= programTIText(filename, ACTION_ERASE_CHECK)) != ERR_NONE)
+		if ((replay= rpOpen(replayFile, replayScale, &error)) == NULL)
 			{
-			return(signOff(error, FALSE));
+			printf("ERROR: Can't read recording \"%s\"!\n", replayFile);
+			return(1);
 			}
+		error= bslOpen(&session, &rpTransport, replay, &opt);
 		}
-
-	if (toDo.FastCheck)
+	else
+		error= bslOpenCom(&session, comPortName, &opt);
+	if (error != 0)
 		{
-		/* Parse file in TXT-Format and check the erasure of required flash cells. */
-		printf("Fast E-Check by file \"%s\"...\n", filename);
-		if ((error= programTIText(filename, ACTION_ERASE_CHECK_FAST)) != ERR_NONE)
+		printf("ERROR: Opening COM-Port failed!\n");
+		if (opt.toDo.Wait)
 			{
-			return(signOff(error, FALSE));
+			WaitForKey(); /* FRGR */
 			}
+		return(0);
 		}
 
-	if (toDo.Program)
-		{
-		/* Parse file in TXT-Format and program data into flash memory. */
-		printf("Program \"%s\"...\n", filename);
-		if ((error= programTIText(filename, ACTION_PROGRAM)) != ERR_NONE)
-			{
-			if (newBSLFile == NULL)
-				return(signOff(ERR_VERIFY_FAILED, FALSE));
-			else
-				{
-				// read out error address+3 from RAM (error address buffer)
-				if ((loadedModel == LARGE_RAM_model) || (loadedModel == SMALL_RAM_model))
-					{
-					if (toDo.MSP430X)
-						if (bslTxRx(BSL_MEMOFFSET, 0, 0, NULL, blkin) !=0) signOff(error, TRUE);
-					if ((error= bslTxRx(BSL_RXBLK, bslerrbuf, 2, NULL, blkin)) == ERR_NONE)
-						{
-						_err = (blkin[1] << 8) + blkin[0];
-						printf("Verification Error at 0x%04X\n", _err-3);
-						}
-					else
-						return(signOff(error, FALSE));
-					}
-				else
-					return(signOff(ERR_VERIFY_FAILED, FALSE));
-				}
-			}
-		else
-			{
-			printf("%i bytes programmed.\n", byteCtr);
-			}
-		}
+	error= bslRun(&session);
 
-	if (toDo.Verify)
+	if (replay != NULL) rpPrint(replay);
+
+	if (opt.traceFile != NULL)
 		{
-		if ((toDo.Program) && ((bslVer >= 0x0140) || (newBSLFile != NULL)))
-			{
-			printf("Verify... already done during programming.\n");
-			}
+		if (wtFile(&session) != NULL)
+			printf("Session recorded in %s (list it with -l%s, replay it with -y%s).\n",
+				opt.traceFile, opt.traceFile, opt.traceFile);
 		else
-			{
-			/* Verify programmed data: */
-			printf("Verify\"%s\"...\n", filename);
-			if ((error= programTIText(filename, ACTION_VERIFY)) != ERR_NONE)
-				{
-				return(signOff(error, FALSE));
-				}
-			}
-		}
-	}
-	else
-	{
-	unsigned action= 0;
-	if (toDo.EraseCheck)
-		{
-		action |= ACTION_ERASE_CHECK;	printf("EraseCheck ");
-		}
-	if (toDo.FastCheck)
-		{
-		action |= ACTION_ERASE_CHECK_FAST; printf("EraseCheckFast ");
+			printf("ERROR: Can't write \"%s\"!\n", opt.traceFile);
 		}
-	if (toDo.Program)
+	else if (error != ERR_NONE)
 		{
-		action |= ACTION_PROGRAM;		printf("Program ");
-		}
-	if (toDo.Verify)
-		{
-		action |= ACTION_VERIFY; 		printf("Verify ");
-		}
-
-	if (action != 0)
-		{
-		printf("\"%s\" ...\n", filename);
-		error= programTIText(filename, action);
-		if (error != ERR_NONE)
-			{
-			return(signOff(error, FALSE));
-			}
+		if (wtWrite(&session, WT_DEFAULT_FILE))
+			printf("Wire trace written to %s (list it with -l%s).\n", WT_DEFAULT_FILE, WT_DEFAULT_FILE);
 		else
-			{
-			printf("%i bytes programmed.\n", byteCtr);
-			}
+			printf("ERROR: Can't write \"%s\"!\n", WT_DEFAULT_FILE);
 		}
-	}
 
-	if (toDo.RestoreInfoA)
+	if (opt.metrics)
 		{
-
-		unsigned long startaddr = 0x10C0;
-		WORD len = 0x40;
-
-		printf("Restore InfoA Segment...\n");
-		/* Restore actual InfoA segment Content. */
-		if (toDo.MSP430X) if (bslTxRx(BSL_MEMOFFSET, 0, 0, NULL, blkin) !=0)  return (signOff(error, TRUE));
-
-		while ((len > 0) && (infoA[0x40-len] == 0xff))
-			{
-			len --;
-			startaddr++;
-			}
-
-        if (len > 0)
+		mxPrint(&session);
+		sessions[0]= &session;
+		if ((opt.metricsFile != NULL) &&
+			!mxWrite(sessions, 1, opt.metricsFile))
 			{
-			memcpy(blkout, &infoA[startaddr - 0x10C0], len);
-			if (error= programBlk(startaddr, len, ACTION_PROGRAM))
-				{
-					return(signOff(error, FALSE));
-				}
+			printf("ERROR: Can't write \"%s\"!\n", opt.metricsFile);
 			}
 		}
 
-	if (toDo.Dump2file)
-	{
-		BYTE* DataPtr = NULL;
-		BYTE* BytesPtr = NULL;
-		long byteCount = readLen;
-		long addrCount = readStart;
-		BytesPtr = DataPtr = (BYTE*) malloc(sizeof(BYTE) * readLen);
-		printf("Read memory to file: %s Start: 0x%-4X Length 0x%-4X\n", readfilename, readStart, readLen);
-
-		if (toDo.MSP430X) {
-			if (error = bslTxRx(BSL_MEMOFFSET, 0, (WORD)(addrCount>>16), NULL, blkin) !=ERR_NONE) return(signOff(error, FALSE));
-			addrCount = addrCount & 0xFFFF;
-		}
-        while (byteCount > 0)
+	if (opt.toDo.Wait)
 		{
-			if (byteCount > maxData)
-			{	/* Read data. */
-				printf("  Read memory Start: 0x%-4X Length %d\n", (readStart & 0xFFFF0000)+addrCount, maxData);
-				if ((error= bslTxRx(BSL_RXBLK,	/* Command: Read/Receive Block 	*/
-					(WORD)addrCount,			/* Start address					*/
-					(WORD)maxData,	   			/* No. of bytes to read			*/
-					NULL, BytesPtr)) != ERR_NONE) return(signOff(error, FALSE));
-			}
-			else
-			{
-				/* Read data. */
-				printf("  Read memory Start: 0x%-4X Length %d\n", (readStart & 0xFFFF0000)+addrCount, byteCount);
-				if ((error= bslTxRx(BSL_RXBLK,	/* Command: Read/Receive Block 	*/
-					(WORD)addrCount,			/* Start address					*/
-					(WORD)byteCount,			/* No. of bytes to read			*/
-					NULL, BytesPtr)) != ERR_NONE) return(signOff(error, FALSE));
-			}
-			byteCount -= maxData;
-			addrCount += maxData;
-			BytesPtr  += maxData;
-		}
-
-		StartTITextOutput(readfilename);
-		WriteTITextBytes((unsigned long) readStart, (WORD) (readLen/2), DataPtr);
-		FinishTITextOutput();
-
-		if (DataPtr != NULL) free (DataPtr);
-        if (toDo.MSP430X)
-			if (error = bslTxRx(BSL_MEMOFFSET, 0, (WORD)(0),NULL, blkin) !=0)  return (error);
-
-	}
-
-	if (toDo.EraseSegment)
-	{
-		long addrCount = readStart;
-		printf("Erase Segment: 0x%-4X\n", readStart);
-
-		if (toDo.MSP430X) {
-			if (error = bslTxRx(BSL_MEMOFFSET, 0, (WORD)(addrCount>>16), NULL, blkin) !=ERR_NONE) return(signOff(error, FALSE));
-			addrCount = addrCount & 0xFFFF;
+		WaitForKey();
 		}
 
-		if (error = bslTxRx(BSL_ERASE, addrCount, 0xA502, NULL, blkin) !=ERR_NONE) return(signOff(error, FALSE));
-        if (toDo.MSP430X)
-			if (error = bslTxRx(BSL_MEMOFFSET, 0, (WORD)(0),NULL, blkin) !=0)  return (error);
-	}
-
-	if (toDo.UserCalled)
-	{
-		toDo.UserCalled = 0;
-		//bslReset(0); /* Reset MSP430 and start user program. */
-		printf("No Device reset - BSL called from user program ---------------------\n");
-		//delay(100);
-		goto Repeat;
-	}
-
-	Time_BSL_stops = GetTickCount();
-
-    return(signOff(ERR_NONE, FALSE));
+	bslClose(&session);	/* Release serial communication port.	*/
+						/* After having released the serial port,
+						 * the target is no longer supplied via this port!
+						 */
+	if (error == ERR_NONE)
+		return(0);
+	else
+		return(1);
 }
 
 /* EOF */
@@ -0,0 +1,303 @@
+/****************************************************************
+*
+* Project: MSP430 Bootstrap Loader Demonstration Program
+*
+* File:    DAEMON.C
+*
+* Job server (see DAEMON.H).
+*
+* A job is sent as lines: the client's current directory, the
+* arguments, and an empty line.  The server sends the output of
+* the job back as it comes, then a 0 and the errorlevel in digits,
+* and disconnects.  The pipe has one instance: while a job runs,
+* the next client waits in WaitNamedPipe().  Clients on other
+* computers are rejected (PIPE_REJECT_REMOTE_CLIENTS).
+*
+****************************************************************/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <windows.h>
+
+#include "daemon.h"
+#include "wiretrace.h"
+
+/* Max. arguments of a job: */
+#define DM_MAX_ARGS  64
+
+/* (Windows Vista on; not in the LCC-win32 headers) */
+#ifndef PIPE_REJECT_REMOTE_CLIENTS
+#define PIPE_REJECT_REMOTE_CLIENTS 0x00000008
+#endif
+
+typedef struct
+{
+  char name[64];
+  BSL_SESSION s;
+  BOOL open;
+  DWORD used;             /* tick of the last job */
+} DM_PORT;
+
+static DM_PORT dmPort[DM_PORTS];
+
+/* Pipe of the job running: */
+static HANDLE dmPipe= INVALID_HANDLE_VALUE;
+
+/*-------------------------------------------------------------*/
+static void dmWrite(const char *data, DWORD count)
+{
+  DWORD written;
+
+  if (dmPipe != INVALID_HANDLE_VALUE) WriteFile(dmPipe, data, count, &written, NULL);
+}
+
+/*-------------------------------------------------------------*/
+void dmPrintf(const char *format, ...)
+{
+  char text[512];
+  va_list args;
+
+  va_start(args, format);
+  _vsnprintf(text, sizeof(text) - 1, format, args);
+  va_end(args);
+  text[sizeof(text) - 1]= 0;
+  dmWrite(text, strlen(text));
+}
+
+/*-------------------------------------------------------------*/
+static void dmPrint(BSL_SESSION *s, const char *text)
+{
+  dmWrite(text, strlen(text));
+}
+
+/*-------------------------------------------------------------*/
+static DM_PORT *dmFind(const char *portName)
+/* The entry of the port: the one open, else a free one, else the
+ * one used longest ago (closed for it).
+ */
+{
+  DM_PORT *p, *oldest= NULL;
+
+  for (p= dmPort; p < &dmPort[DM_PORTS]; p++)
+  {
+    if (p->open && (stricmp(p->name, portName) == 0)) return(p);
+  }
+  for (p= dmPort; (p < &dmPort[DM_PORTS]) && p->open; p++)
+  {
+    if ((oldest == NULL) || ((int)(p->used - oldest->used) < 0)) oldest= p;
+  }
+  if (p == &dmPort[DM_PORTS])
+  {
+    p= oldest;
+    bslClose(&p->s);
+    p->open= FALSE;
+  }
+  strncpy(p->name, portName, sizeof(p->name) - 1);
+  p->name[sizeof(p->name) - 1]= 0;
+  return(p);
+}
+
+/*-------------------------------------------------------------*/
+int dmRun(const char *portName, const BSL_OPTIONS *opt)
+{
+  DM_PORT *p= dmFind(portName);
+  BOOL warm= p->open && p->s.warm;
+  int error= ERR_NONE, run;
+
+  for (run= 0; run < 2; run++)
+  {
+    if (p->open) error= bslNextRun(&p->s, opt);
+    if (!p->open || (error != ERR_NONE))
+    { /* (first job on the port, or it can't be set) */
+      if (p->open) bslClose(&p->s);
+      p->open= FALSE;
+      if ((error= bslOpenCom(&p->s, portName, opt)) != ERR_NONE)
+      {
+        dmPrintf("ERROR: Opening COM-Port failed!\n");
+        return(error);
+      }
+      p->open= TRUE;
+    }
+    p->s.print= dmPrint;
+    p->s.progress= NULL;
+    if (warm) dmPrintf("Device in the BSL since the last job: no entry sequence, no password.\n");
+
+    error= bslRun(&p->s);
+    p->used= GetTickCount();
+
+    /* Not in the BSL any more (reset, power)? */
+    if (!warm || ((error != ERR_BSL_SYNC) && ((error < ERR_COM) || (error > ERR_DEADLINE))))
+    {
+      break;
+    }
+    dmPrintf("No reply: again with the entry sequence.\n");
+    warm= FALSE;
+  }
+
+  if ((error != ERR_NONE) && wtWrite(&p->s, WT_DEFAULT_FILE))
+  {
+    dmPrintf("Wire trace written to %s (list it with -l%s).\n", WT_DEFAULT_FILE, WT_DEFAULT_FILE);
+  }
+  return(error);
+}
+
+/*-------------------------------------------------------------*/
+static int dmSplit(char *text, char **dir, char *argv[])
+/* Splits a job into its lines; argv[] ends with NULL, as that of
+ * main().
+ * Returns the number of arguments (with argv[0]), 0 if the job
+ * is not complete.
+ */
+{
+  char *end;
+  int argc= 1;
+
+  argv[0]= "BSLDEMO";
+  *dir= text;
+  if ((end= strchr(text, '\n')) == NULL) return(0);
+  *end= 0;
+  for (text= end + 1; *text != '\n'; text= end + 1)
+  {
+    if (((end= strchr(text, '\n')) == NULL) || (argc == DM_MAX_ARGS - 1)) return(0);
+    *end= 0;
+    argv[argc++]= text;
+  }
+  argv[argc]= NULL;
+  return(argc);
+}
+
+/*-------------------------------------------------------------*/
+int dmServe(const char *pipeName, DM_JOB job)
+{
+  char text[DM_MAX_JOB + 1], home[MAX_PATH], *dir, *argv[DM_MAX_ARGS];
+  DWORD got, n, start;
+  HANDLE pipe;
+  int argc, code, i, jobs= 0;
+
+  /* Local clients only: a job writes files (-r) where it is told. */
+  pipe= CreateNamedPipe(pipeName, PIPE_ACCESS_DUPLEX,
+                        PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT |
+                        PIPE_REJECT_REMOTE_CLIENTS,
+                        1, DM_MAX_JOB, DM_MAX_JOB, 0, NULL);
+  if (pipe == INVALID_HANDLE_VALUE)
+  {
+    printf("ERROR: Can't create pipe \"%s\"!\n", pipeName);
+    return(1);
+  }
+  GetCurrentDirectory(sizeof(home), home);
+  printf("Waiting for jobs on %s (Ctrl+C ends).\n", pipeName);
+
+  while (TRUE)
+  {
+    if (!ConnectNamedPipe(pipe, NULL) && (GetLastError() != ERROR_PIPE_CONNECTED))
+    {
+      Sleep(100);
+      continue;
+    }
+
+    /* The job, up to the empty line: */
+    for (got= 0; (got < 2) || (memcmp(&text[got - 2], "\n\n", 2) != 0); got+= n)
+    {
+      if ((got == DM_MAX_JOB) ||
+          !ReadFile(pipe, &text[got], DM_MAX_JOB - got, &n, NULL) || (n == 0))
+      {
+        break;
+      }
+    }
+    text[got]= 0;
+
+    if ((argc= dmSplit(text, &dir, argv)) > 0)
+    {
+      printf("Job %d:", ++jobs);
+      for (i= 1; i < argc; i++) printf(" %s", argv[i]);
+      printf("\n");
+      start= GetTickCount();
+      dmPipe= pipe;
+      if (SetCurrentDirectory(dir)) code= job(argc, argv);
+      else
+      {
+        dmPrintf("ERROR: Can't change to \"%s\"!\n", dir);
+        code= 1;
+      }
+      dmPipe= INVALID_HANDLE_VALUE;
+      SetCurrentDirectory(home);
+      printf("  errorlevel %d, %.2f sec\n", code, (GetTickCount() - start) / 1000.0);
+      fflush(stdout);
+
+      text[0]= 0;
+      sprintf(&text[1], "%d", code);
+      WriteFile(pipe, text, 1 + strlen(&text[1]), &n, NULL);
+      FlushFileBuffers(pipe);
+    }
+    DisconnectNamedPipe(pipe);
+  }
+}
+
+/*-------------------------------------------------------------*/
+int dmSubmit(const char *pipeName, int argc, char *argv[])
+{
+  char text[DM_MAX_JOB + 1], code[16];
+  HANDLE pipe;
+  DWORD len, n, i;
+  int arg, digits= 0;
+  BOOL end= FALSE;
+
+  while ((pipe= CreateFile(pipeName, GENERIC_READ | GENERIC_WRITE, 0, NULL,
+                           OPEN_EXISTING, 0, NULL)) == INVALID_HANDLE_VALUE)
+  { /* (busy: another job runs) */
+    if ((GetLastError() != ERROR_PIPE_BUSY) ||
+        !WaitNamedPipe(pipeName, NMPWAIT_WAIT_FOREVER))
+    {
+      printf("ERROR: No BSLDEMO server on %s!\n", pipeName);
+      return(1);
+    }
+  }
+
+  GetCurrentDirectory(DM_MAX_JOB - 2, text);
+  len= strlen(text);
+  text[len++]= '\n';
+  for (arg= 1; arg < argc; arg++)
+  {
+    if ((argv[arg][0] == '-') && ((argv[arg][1] == 'o') || (argv[arg][1] == 'O')))
+    {
+      continue;
+    }
+    if (len + strlen(argv[arg]) + 2 > DM_MAX_JOB)
+    {
+      printf("ERROR: Command line too long!\n");
+      CloseHandle(pipe);
+      return(1);
+    }
+    strcpy(&text[len], argv[arg]);
+    len+= strlen(argv[arg]);
+    text[len++]= '\n';
+  }
+  text[len++]= '\n';
+  WriteFile(pipe, text, len, &n, NULL);
+
+  /* Output up to the 0, then the errorlevel: */
+  while (ReadFile(pipe, text, DM_MAX_JOB, &n, NULL) && (n > 0))
+  {
+    for (i= 0; i < n; i++)
+    {
+      if (end)
+      {
+        if (digits < (int)sizeof(code) - 1) code[digits++]= text[i];
+      }
+      else if (text[i] == 0) end= TRUE;
+      else putchar(text[i]);
+    }
+  }
+  CloseHandle(pipe);
+  code[digits]= 0;
+  if (!end)
+  {
+    printf("\nERROR: The server ended the job!\n");
+    return(1);
+  }
+  return(atoi(code));
+}
+
+/* EOF */
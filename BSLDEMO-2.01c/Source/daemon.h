@@ -0,0 +1,86 @@
+/****************************************************************
+*
+* Project: MSP430 Bootstrap Loader Demonstration Program
+*
+* File:    DAEMON.H
+*
+* Job server (-q): BSLDEMO keeps running, owns the serial ports,
+* and takes jobs - BSLDEMO command lines - on a named pipe, one
+* after the other, from BSLDEMO -o (dmSubmit()).  The output of a
+* job goes back through the pipe, and the client ends with the
+* job's errorlevel:
+*
+*   BSLDEMO-2.01C.exe -q                        (server)
+*   BSLDEMO-2.01C.exe -o -c3 +epv firmware.txt  (job)
+*
+* The session of each port stays open between the jobs, so a job
+* costs neither a process start nor the opening of the port.  A
+* job which leaves the device in the ROM BSL (no reset: +... with
+* no r, no loader, no baudrate change) lets the next job on that
+* port skip the entry sequence (half a second) and the password,
+* as +u does; if the device does not answer then, the job is run
+* again with the entry sequence.
+*
+* -q{pipe} and -o{pipe} give another pipe: -qLAB is \\.\pipe\LAB.
+*
+* A job runs in the client's current directory.  The options which
+* run something else than the program flow on one port, or which
+* keep state in the session (-l, -k, -u, -g, -y, -n, -t, -d, -w,
+* +w, several ports), can't be used in a job.
+*
+****************************************************************/
+
+#ifndef Daemon__H
+#define Daemon__H
+
+#include "session.h"
+
+/* Pipe used if none is given: */
+#define DM_DEFAULT_PIPE  "\\\\.\\pipe\\BSLDEMO"
+
+/* Ports with a session kept open: */
+#define DM_PORTS         16
+
+/* Max. size of a job (current directory and arguments): */
+#define DM_MAX_JOB       4096
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Runs a job: parses its command line and calls dmRun().  Returns
+ * the errorlevel of the job. */
+typedef int (*DM_JOB)(int argc, char *argv[]);
+
+/*-------------------------------------------------------------*/
+int dmServe(const char *pipeName, DM_JOB job);
+/* Takes jobs on the pipe until the process is stopped.
+ * Returns 1 if the pipe can't be created.
+ */
+
+/*-------------------------------------------------------------*/
+int dmSubmit(const char *pipeName, int argc, char *argv[]);
+/* Sends the command line (without the argument -o...) to the
+ * server, waiting while it runs another job, and shows the output.
+ * Returns the errorlevel of the job, 1 if there is no server.
+ */
+
+/*-------------------------------------------------------------*/
+int dmRun(const char *portName, const BSL_OPTIONS *opt);
+/* Runs the program flow of a job on the session of the port
+ * (opened if there is none yet), with its output to the client.
+ * Returns the error of bslRun().
+ */
+
+/*-------------------------------------------------------------*/
+void dmPrintf(const char *format, ...);
+/* printf() to the client of the job running.
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/* EOF */
@@ -0,0 +1,583 @@
+/****************************************************************
+*
+* Project: MSP430 Bootstrap Loader Demonstration Program
+*
+* File:    FASTLOAD.C
+*
+* Host side of the RAM loader FastLoader.txt (source:
+* FastLoader.m43).
+*
+* The loader runs the DCO at up to 16 MHz and receives frames of
+* up to FL_MAX_DATA bytes with 8N1 framing at the baudrate set by
+* BSLDEMO.  It writes the data to flash while the frame is still
+* being received, and reads it back against the checksum before
+* it replies.  So there is one reply per frame, and no separate
+* verify pass:
+*
+*   0x80, CMD, ADDRL, ADDRH, LENL, LENH, HCKL, HCKH,
+*   [data, DCKL, DCKH]
+*
+*   HCK: inverted XOR of the three header words
+*   DCK: inverted XOR of the data words (Transmit Block only)
+*
+* Reply: DATA_ACK, DATA_NAK (checksum error) or CMD_FAILED.
+*
+* The data of Transmit Block is compressed into tokens (words):
+*
+*   0x0000      no operation
+*   n           n literal words follow
+*   0x8000+n    copy n words from the flash address that follows
+*   0x8000      end of data
+*
+* and LEN carries VCK instead, the inverted XOR of the words to be
+* written to flash.  Copies are taken from flash written earlier
+* in this session, or earlier in the same frame.  The loader has
+* room for 15 literal words, and starts a copy as soon as its
+* source address is received.  So flMakeStream() keeps track of
+* when each word can be written, and puts in no-operation tokens
+* where the flash would fall behind.
+*
+* The tables used for the compression (about 200K) are allocated
+* by flStart() for each session, and freed by flDone().
+*
+****************************************************************/
+
+#include <windows.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "session.h"
+#include "metrics.h"
+
+/* Shorter copies don't save anything: */
+#define FL_MIN_COPY    4
+/* Positions tried when looking for a copy: */
+#define FL_MAX_CHAIN   256
+/* Literal words the loader can hold: */
+#define FL_RING        15
+#define FL_HASH_SIZE   4096
+/* Max. words in a token stream: */
+#define FL_MAX_STREAM  (FL_MAX_DATA / 2 + 2)
+
+/* What the loader does with the token stream, as far as the host
+ * can tell (times in ns from the start of the stream):
+ */
+typedef struct
+{
+  DWORD time;            /* stream received up to here */
+  DWORD wrtEnd;          /* flash written up to here */
+  DWORD lastWrt;         /* start of the last word write */
+  DWORD ring[FL_RING];   /* write starts of literal words held */
+  WORD  ringFirst;
+  WORD  ringCount;
+} FL_PACE;
+
+struct FL_STATE
+{
+  /* Flash contents written in this session, per word address/2: */
+  WORD image[0x8000];
+  BYTE valid[0x1000];
+
+  /* Positions of three-word sequences in image, by hash: */
+  WORD head[FL_HASH_SIZE];
+  WORD prev[0x8000];
+
+  /* Time to send a byte, time to write a word (ns): */
+  DWORD byteTime;
+  DWORD wordTime;
+
+  FL_PACE pace;
+  WORD token[FL_MAX_STREAM];
+  WORD tokens;
+};
+
+#define FL_VALID(f, i)  ((f)->valid[(i) >> 3] & (1 << ((i) & 7)))
+
+/*-------------------------------------------------------------*/
+WORD flChecksum(BYTE data[], WORD length)
+/* Same as calcChecksum(), but for frames longer than 255 words.
+ */
+{
+  WORD checksum= 0;
+  WORD i;
+
+  for (i= 0; i < length; i+= 2)
+  {
+    checksum^= data[i] | (data[i+1] << 8);
+  }
+  return(checksum ^ 0xffff);
+}
+
+/*-------------------------------------------------------------*/
+static WORD flHash(FL_STATE *f, WORD i)
+/* Hash of the three words in image[] from index i on.
+ */
+{
+  return((WORD)((f->image[i] ^ (f->image[i+1] << 4) ^ (f->image[i+2] << 8)
+                ^ (f->image[i+2] >> 4)) & (FL_HASH_SIZE - 1)));
+}
+
+/*-------------------------------------------------------------*/
+static void flLearn(FL_STATE *f, WORD i, WORD value)
+/* Enters a word (written or to be written) into image[] at
+ * index i, and the sequences it completes into the hash chains.
+ */
+{
+  WORD k, h;
+
+  if (FL_VALID(f, i) && (f->image[i] == value))
+  {
+    return;
+  }
+  f->image[i]= value;
+  f->valid[i >> 3]|= (BYTE)(1 << (i & 7));
+
+  for (k= (i > 2) ? i - 2 : 1; (k <= i) && (k < 0x7ffe); k++)
+  {
+    if (FL_VALID(f, k) && FL_VALID(f, k+1) && FL_VALID(f, k+2))
+    {
+      h= flHash(f, k);
+      if (f->head[h] != k)
+      {
+        f->prev[k]= f->head[h];
+        f->head[h]= k;
+      }
+    }
+  }
+}
+
+/*-------------------------------------------------------------*/
+static void flForget(FL_STATE *f, WORD first, WORD count)
+/* Removes words not written after all from image[].
+ */
+{
+  for (; count > 0; first++, count--)
+  {
+    f->valid[first >> 3]&= (BYTE)~(1 << (first & 7));
+  }
+}
+
+/*-------------------------------------------------------------*/
+static WORD flFindCopy(FL_STATE *f, WORD data[], WORD first, WORD pos, WORD count,
+                       WORD *source)
+/* Longest run of words in image[] equal to data[pos] on, that
+ * starts below first+pos.  data[] is to be written from index
+ * first on; count is the number of words in data[].
+ * Returns the length of the run (0: none), *source its index.
+ */
+{
+  WORD k, j, v, n, best= 0;
+  int chain;
+
+  if (pos + 3 > count)
+  {
+    return(0);
+  }
+  /* (data[pos] to data[pos+2] are in image[] already) */
+  k= f->head[flHash(f, (WORD)(first + pos))];
+  for (chain= FL_MAX_CHAIN; (k != 0) && (chain > 0); k= f->prev[k], chain--)
+  {
+    if (k >= first + pos)
+    {
+      continue;
+    }
+    for (n= 0; pos + n < count; n++)
+    {
+      j= k + n;
+      if ((j >= first) && (j < first + count))
+      {
+        v= data[j - first];    /* written by the time it is read */
+      }
+      else if (FL_VALID(f, j))
+      {
+        v= f->image[j];
+      }
+      else
+      {
+        break;
+      }
+      if (v != data[pos + n])
+      {
+        break;
+      }
+    }
+    if (n > best)
+    {
+      best= n;
+      *source= k;
+    }
+  }
+  return(best);
+}
+
+/*-------------------------------------------------------------*/
+static BOOL flPut(FL_STATE *f, WORD token)
+/* Appends a word to the token stream.
+ */
+{
+  if (f->tokens >= FL_MAX_STREAM)
+  {
+    return(FALSE);
+  }
+  f->token[f->tokens++]= token;
+  f->pace.time+= 2 * f->byteTime;
+  return(TRUE);
+}
+
+/*-------------------------------------------------------------*/
+static WORD flRingUsed(FL_PACE *p)
+/* Literal words the loader still holds at p->time.
+ */
+{
+  while ((p->ringCount > 0) && (p->ring[p->ringFirst] <= p->time))
+  {
+    p->ringFirst= (p->ringFirst + 1) % FL_RING;
+    p->ringCount--;
+  }
+  return(p->ringCount);
+}
+
+/*-------------------------------------------------------------*/
+static void flSchedule(FL_STATE *f, FL_PACE *p)
+/* Schedules the write of a literal word received at p->time.
+ */
+{
+  DWORD start;
+
+  start= (p->time > p->wrtEnd) ? p->time : p->wrtEnd;
+  p->ring[(p->ringFirst + p->ringCount) % FL_RING]= start;
+  p->ringCount++;
+  p->wrtEnd= start + f->wordTime;
+  p->lastWrt= start;
+}
+
+/*-------------------------------------------------------------*/
+static BOOL flPutLiterals(FL_STATE *f, WORD data[], WORD count)
+/* Appends data[] as literal words, in runs the loader can hold.
+ */
+{
+  FL_PACE trial;
+  WORD n;
+
+  while (count > 0)
+  {
+    /* Words the loader can take after a run token sent now: */
+    trial= f->pace;
+    trial.time+= 2 * f->byteTime;
+    for (n= 0; n < count; n++)
+    {
+      trial.time+= 2 * f->byteTime;
+      if (flRingUsed(&trial) >= FL_RING)
+      {
+        break;
+      }
+      flSchedule(f, &trial);
+    }
+
+    if (!flPut(f, n))    /* (n == 0: no operation) */
+    {
+      return(FALSE);
+    }
+    for (; n > 0; n--, count--)
+    {
+      if (!flPut(f, *data++))
+      {
+        return(FALSE);
+      }
+      flRingUsed(&f->pace);
+      flSchedule(f, &f->pace);
+    }
+  }
+  return(TRUE);
+}
+
+/*-------------------------------------------------------------*/
+static BOOL flPutCopy(FL_STATE *f, WORD count, WORD source)
+/* Appends a copy.  The loader starts it as soon as the source
+ * address is received, so all words before it must be under way
+ * by then.
+ */
+{
+  DWORD start;
+
+  while (f->pace.time + 4 * f->byteTime < f->pace.lastWrt)
+  {
+    if (!flPut(f, 0))
+    {
+      return(FALSE);
+    }
+  }
+  if (!flPut(f, (WORD)(0x8000 | count)) || !flPut(f, (WORD)(source << 1)))
+  {
+    return(FALSE);
+  }
+  start= (f->pace.time > f->pace.wrtEnd) ? f->pace.time : f->pace.wrtEnd;
+  f->pace.lastWrt= start + (count - 1) * f->wordTime;
+  f->pace.wrtEnd= start + count * f->wordTime;
+  f->pace.ringCount= 0;
+  return(TRUE);
+}
+
+/*-------------------------------------------------------------*/
+static BOOL flMakeStream(FL_STATE *f, WORD data[], WORD first, WORD count, BOOL compress)
+/* Builds the token stream in token[] for count words to be
+ * written from word index first on (address/2).  With compress
+ * == FALSE, all words are sent as literal words.
+ * Return == FALSE: stream too long
+ */
+{
+  WORD pos, lit, known, n, source= 0;
+
+  memset(&f->pace, 0, sizeof(f->pace));
+  f->tokens= 0;
+
+  for (pos= 0, lit= 0, known= 0; pos < count; pos+= n)
+  {
+    /* The search needs data[pos] to data[pos+2] in image[]: */
+    for (; (known < pos + 3) && (known < count); known++)
+    {
+      flLearn(f, (WORD)(first + known), data[known]);
+    }
+    n= compress ? flFindCopy(f, data, first, pos, count, &source) : 0;
+    if (n >= FL_MIN_COPY)
+    {
+      if (!flPutLiterals(f, &data[lit], (WORD)(pos - lit)) ||
+          !flPutCopy(f, n, source))
+      {
+        return(FALSE);
+      }
+      lit= pos + n;
+    }
+    else
+    {
+      n= 1;
+    }
+  }
+  if (!flPutLiterals(f, &data[lit], (WORD)(count - lit)))
+  {
+    return(FALSE);
+  }
+  return(flPut(f, 0x8000));
+}
+
+/*-------------------------------------------------------------*/
+static DWORD flFinish(FL_STATE *f)
+/* Time the loader needs for the stream in token[] (ns).
+ */
+{
+  return((f->pace.time > f->pace.wrtEnd) ? f->pace.time : f->pace.wrtEnd);
+}
+
+/*-------------------------------------------------------------*/
+int flStart(BSL_SESSION *s, WORD startaddr, DWORD baud, DWORD ftgMin)
+/* Starts the loader at startaddr (the parameter block must have
+ * been written with the ROM BSL), switches the serial port to
+ * baud/8N1 and synchronizes with the loader.  ftgMin is the
+ * lowest frequency the flash timing generator may run at.
+ * Return == 0: OK, s->flActive set
+ * Return != 0: Error!
+ */
+{
+  int savedProlong= s->prolongFactor;
+  FL_STATE *f;
+
+  if ((s->fl == NULL) &&
+      ((s->fl= (FL_STATE*)malloc(sizeof(FL_STATE))) == NULL))
+  {
+    return(s->lastError= ERR_CMD_FAILED);
+  }
+  f= s->fl;
+
+  /* Nothing is received at 9600 Baud once the loader runs,
+   * so don't wait long for a reply:
+   */
+  s->prolongFactor= 1;
+  bslTxRx(s, BSL_LOADPC, startaddr, 0, NULL, NULL);
+  s->prolongFactor= savedProlong;
+
+  s->baudrate= baud;
+  if (comSetLines(s, s->lines & ~LINE_PARITY) != ERR_NONE)
+  {
+    return(s->lastError= ERR_SET_COMM_STATE);
+  }
+  comDelay(s, 10);
+
+  /* The loader measures the bit time from the sync character: */
+  if (bslSync(s) != ERR_NONE)
+  {
+    return(s->lastError= ERR_BSL_SYNC);
+  }
+  s->flActive= TRUE;
+
+  /* A word write takes 30 cycles of the flash timing generator,
+   * and the loader sees the end of it within 3 bit times:
+   */
+  f->byteTime= (1000000000L / baud) * 10;
+  f->wordTime= (1000000000L / ftgMin) * 30 + (1000000000L / baud) * 3;
+  memset(f->valid, 0, sizeof(f->valid));
+  memset(f->head, 0, sizeof(f->head));
+  s->flTxBytes= 0;
+
+  return(s->lastError= ERR_NONE);
+} /* flStart */
+
+/*-------------------------------------------------------------*/
+void flDone(BSL_SESSION *s)
+/* Frees the tables of the loader.
+ */
+{
+  if (s->fl != NULL)
+  {
+    free(s->fl);
+    s->fl= NULL;
+  }
+  s->flActive= FALSE;
+} /* flDone */
+
+/*-------------------------------------------------------------*/
+int flTxRx(BSL_SESSION *s, BYTE cmd, unsigned long addr, WORD len,
+           BYTE blkout[], BYTE blkin[])
+/* Same as bslTxRx(), but for the fast loader.  Only Transmit
+ * Block (compressed on the way) and Erase Check are executed,
+ * Transmit Password is accepted without action, all other
+ * commands fail.
+ * Return == 0: OK
+ * Return != 0: Error!
+ */
+{
+  BYTE txFrame[2 * FL_MAX_STREAM + 10];
+  WORD data[FL_MAX_DATA / 2];
+  BYTE ch;
+  WORD checksum, lenField= len;
+  WORD length= 8;
+  WORD i;
+  DWORD txTime, finish;
+  FL_STATE *f= s->fl;
+
+  switch (cmd)
+  {
+    case BSL_TXPWORD:
+      /* No protected functions: flash was erased by the ROM BSL */
+      return(s->lastError= ERR_NONE);
+
+    case BSL_TXBLK:
+      /* (addr and len already aligned by bslTxRx) */
+      if ((len > FL_MAX_DATA) ||
+          ((addr < FL_RAM_END) && (addr + len > FL_RAM_START)))
+      {
+        return(s->lastError= ERR_CMD_FAILED);
+      }
+      for (i= 0; i < len / 2; i++)
+      {
+        data[i]= blkout[2*i] | (blkout[2*i+1] << 8);
+      }
+      /* Compress, unless it takes longer than sending it as is: */
+      flMakeStream(f, data, (WORD)(addr >> 1), (WORD)(len / 2), FALSE);
+      finish= flFinish(f);
+      if (!flMakeStream(f, data, (WORD)(addr >> 1), (WORD)(len / 2), TRUE) ||
+          (flFinish(f) > finish))
+      {
+        if (!flMakeStream(f, data, (WORD)(addr >> 1), (WORD)(len / 2), FALSE))
+        {
+          return(s->lastError= ERR_CMD_FAILED);
+        }
+      }
+      lenField= flChecksum(blkout, len);   /* VCK */
+      length+= 2 * f->tokens + 2;
+      break;
+
+    case BSL_ECHECK:
+      if ((addr % 2) != 0)
+      {
+        addr--;
+        len++;
+      }
+      if ((len % 2) != 0)
+      {
+        len++;
+      }
+      lenField= len;
+      break;
+
+    default: /* Needs the ROM BSL */
+      return(s->lastError= ERR_CMD_FAILED);
+  }
+
+  txFrame[0]= DATA_FRAME;
+  txFrame[1]= cmd;
+  txFrame[2]= (BYTE)( addr       & 0x00ff);
+  txFrame[3]= (BYTE)((addr >> 8) & 0x00ff);
+  txFrame[4]= (BYTE)( lenField       & 0x00ff);
+  txFrame[5]= (BYTE)((lenField >> 8) & 0x00ff);
+  checksum= flChecksum(txFrame, 6);
+  txFrame[6]= (BYTE)(checksum);
+  txFrame[7]= (BYTE)(checksum >> 8);
+
+  if (cmd == BSL_TXBLK)
+  {
+    for (i= 0; i < f->tokens; i++)
+    {
+      txFrame[2*i+8]= (BYTE)(f->token[i]);
+      txFrame[2*i+9]= (BYTE)(f->token[i] >> 8);
+    }
+    checksum= flChecksum(&txFrame[8], (WORD)(2 * f->tokens));
+    txFrame[length-2]= (BYTE)(checksum);
+    txFrame[length-1]= (BYTE)(checksum >> 8);
+  }
+
+  s->flErrAddr= (WORD)addr;
+
+  s->transport->purge(s->port);
+  mxPhase(s, MX_TX);
+  s->transport->write(s->port, txFrame, length);
+  mxPhase(s, MX_WAIT);
+
+  /* The frame may still be in the transmit queue, and the loader
+   * may still be writing flash:
+   */
+  txTime= (length * 10000L) / s->baudrate + 1;
+  if (cmd == BSL_TXBLK)
+  {
+    txTime+= flFinish(f) / 1000000L;
+  }
+
+  if (comWaitForData(s, 1, s->timeout + txTime) < 1)
+  {
+    ch= 0;
+    s->lastError= ERR_RX_HDR_TIMEOUT;
+  }
+  else
+  {
+    s->transport->read(s->port, &ch, 1);
+    switch (ch)
+    {
+      case DATA_ACK:
+        s->lastError= ERR_NONE;
+        break;
+      case DATA_NAK:
+        s->lastError= ERR_RX_NAK;
+        break;
+      case CMD_FAILED:
+        s->lastError= ERR_CMD_FAILED;
+        break;
+      default:
+        s->lastError= ERR_COM;
+    }
+  }
+
+  if (cmd == BSL_TXBLK)
+  {
+    if (s->lastError == ERR_NONE)
+    {
+      s->flTxBytes+= length;
+    }
+    else
+    {
+      /* Not a source for copies: */
+      flForget(f, (WORD)(addr >> 1), (WORD)(len / 2));
+    }
+  }
+  return(s->lastError);
+} /* flTxRx */
+
+/* EOF */
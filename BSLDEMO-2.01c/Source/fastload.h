@@ -0,0 +1,72 @@
+/****************************************************************
+*
+* Project: MSP430 Bootstrap Loader Demonstration Program
+*
+* File:    FASTLOAD.H
+*
+* Host side of the RAM loader FastLoader.txt (source:
+* FastLoader.m43), which is loaded and started with the -b
+* option in place of the ROM BSL.  Once the loader runs,
+* bslTxRx() passes all commands to flTxRx().  The state of the
+* loader is kept in the session (SESSION.H).
+*
+****************************************************************/
+
+#ifndef FastLoad__H
+#define FastLoad__H
+
+#include "ssp.h"
+
+/* Loaded model reported by FastLoader.txt at startaddr+2: */
+#define FAST_RAM_model   2
+
+/* Max. data bytes within one fast loader frame: */
+#define FL_MAX_DATA   2048
+
+/* RAM used by the loader (frames must not overwrite it): */
+#define FL_RAM_START  0x0200
+#define FL_RAM_END    0x0400
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-------------------------------------------------------------*/
+WORD flChecksum(BYTE data[], WORD length);
+/* Checksum of the loader's frames (HCK, DCK, VCK): the inverted
+ * XOR of the words.
+ */
+
+/*-------------------------------------------------------------*/
+int flStart(BSL_SESSION *s, WORD startaddr, DWORD baud, DWORD ftgMin);
+/* Starts the loader at startaddr (the parameter block must have
+ * been written with the ROM BSL), switches the serial port to
+ * baud/8N1 and synchronizes with the loader.  ftgMin is the
+ * lowest frequency the flash timing generator may run at.
+ * Return == 0: OK, s->flActive set
+ * Return != 0: Error!
+ */
+
+/*-------------------------------------------------------------*/
+void flDone(BSL_SESSION *s);
+/* Frees the tables of the loader (allocated by flStart()).
+ */
+
+/*-------------------------------------------------------------*/
+int flTxRx(BSL_SESSION *s, BYTE cmd, unsigned long addr, WORD len,
+           BYTE blkout[], BYTE blkin[]);
+/* Same as bslTxRx(), but for the fast loader.  Only Transmit
+ * Block (compressed on the way) and Erase Check are executed,
+ * Transmit Password is accepted without action, all other
+ * commands fail.
+ * Return == 0: OK
+ * Return != 0: Error!
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/* EOF */
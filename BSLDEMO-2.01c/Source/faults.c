@@ -0,0 +1,379 @@
+/****************************************************************
+*
+* Project: MSP430 Bootstrap Loader Demonstration Program
+*
+* File:    FAULTS.C
+*
+* Fault injection (see FAULTS.H).
+*
+* Bytes written are spoilt on their way to the port.  Bytes
+* received are taken from the port as soon as the session looks
+* for them, spoilt, and put into queue[] with the tick at which
+* they may be read (due[]); the ticks never decrease, so a byte
+* held back holds back all after it, as on the line.
+*
+****************************************************************/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <windows.h>
+
+#include "faults.h"
+
+/* Bytes taken from the port (written) at a time: */
+#define FI_CHUNK   256
+
+/* Delay (ms) of FI_DELAY if not given: */
+#define FI_DEFAULT_DELAY 100
+
+/* Tick a later than tick b (DWORD ticks wrap): */
+#define FI_LATER(a, b) ((int)((a) - (b)) > 0)
+
+struct BSL_FAULTS
+{
+  /* Transport spoilt: */
+  const BSL_TRANSPORT *transport;
+  void *port;
+
+  FI_SPEC spec;
+  DWORD rand;             /* state of the generator */
+  DWORD pos;              /* bytes on the line so far */
+  DWORD count[FI_KINDS];  /* faults injected */
+  DWORD lineErrors;       /* FI_PARITY */
+  DWORD hold;             /* tick before which nothing is read */
+  DWORD first, used;      /* bytes in the queue */
+  BYTE queue[FI_QUEUE];
+  DWORD due[FI_QUEUE];
+};
+
+/*-------------------------------------------------------------*/
+static DWORD fiRandom(BSL_FAULTS *f)
+/* xorshift32. */
+{
+  f->rand^= f->rand << 13;
+  f->rand^= f->rand >> 17;
+  f->rand^= f->rand << 5;
+  return(f->rand);
+}
+
+/*-------------------------------------------------------------*/
+static BOOL fiHit(BSL_FAULTS *f, int kind)
+/* Whether the current byte gets a fault of this kind. */
+{
+  if (f->spec.rate[kind] <= 0) return(FALSE);
+  if (f->pos < f->spec.from) return(FALSE);
+  if ((f->spec.to != 0) && (f->pos > f->spec.to)) return(FALSE);
+  if ((fiRandom(f) >> 8) >= f->spec.rate[kind] * 16777216.0) return(FALSE);
+  f->count[kind]++;
+  return(TRUE);
+}
+
+/*-------------------------------------------------------------*/
+static BYTE fiFlip(BSL_FAULTS *f, BYTE b)
+/* Inverts one bit. */
+{
+  return((BYTE)(b ^ (1 << (fiRandom(f) & 7))));
+}
+
+/*-------------------------------------------------------------*/
+static void fiQueue(BSL_FAULTS *f, BYTE b, DWORD now)
+{
+  DWORD at;
+
+  if (f->used >= FI_QUEUE) return;  /* (lost, as by an overrun) */
+  at= (f->first + f->used++) % FI_QUEUE;
+  f->queue[at]= b;
+  f->due[at]= FI_LATER(f->hold, now) ? f->hold : now;
+}
+
+/*-------------------------------------------------------------*/
+static void fiFill(BSL_FAULTS *f)
+/* Takes the bytes received from the port into the queue. */
+{
+  BYTE data[FI_CHUNK];
+  DWORD n, i, now;
+  BYTE b;
+
+  while ((n= FI_QUEUE - f->used) > 0)
+  {
+    if (n > sizeof(data)) n= sizeof(data);
+    n= f->transport->waitForData(f->port, n, 0);
+    if (n > sizeof(data)) n= sizeof(data);
+    if ((n == 0) || ((n= f->transport->read(f->port, data, n)) == 0)) break;
+    now= f->transport->ticks(f->port);
+    for (i= 0; i < n; i++)
+    {
+      f->pos++;
+      if (fiHit(f, FI_DROP)) continue;
+      b= data[i];
+      if (fiHit(f, FI_CORRUPT)) b= fiFlip(f, b);
+      if (fiHit(f, FI_PARITY))
+      {
+        b= fiFlip(f, b);
+        f->lineErrors++;
+      }
+      if ((b == DATA_ACK) && fiHit(f, FI_NAK)) b= DATA_NAK;
+      if (fiHit(f, FI_DELAY)) f->hold= now + f->spec.delay;
+      fiQueue(f, b, now);
+      if (fiHit(f, FI_DUP)) fiQueue(f, b, now);
+    }
+  }
+}
+
+/*-------------------------------------------------------------*/
+static DWORD fiReady(BSL_FAULTS *f, DWORD now, DWORD *next)
+/* Bytes in the queue which are due; *next: tick of the next one
+ * (if any is held back).
+ */
+{
+  DWORD n;
+
+  for (n= 0; n < f->used; n++)
+  {
+    if (FI_LATER(f->due[(f->first + n) % FI_QUEUE], now))
+    {
+      *next= f->due[(f->first + n) % FI_QUEUE];
+      break;
+    }
+  }
+  return(n);
+}
+
+/***************************************************************
+ * Transport which spoils the traffic (port: BSL_FAULTS):
+ */
+
+/*-------------------------------------------------------------*/
+static int fiSetLine(void *port, DWORD baudrate, int lines)
+{
+  BSL_FAULTS *f= (BSL_FAULTS*)port;
+
+  return(f->transport->setLine(f->port, baudrate, lines));
+}
+
+/*-------------------------------------------------------------*/
+static DWORD fiWrite(void *port, const BYTE data[], DWORD count)
+{
+  BSL_FAULTS *f= (BSL_FAULTS*)port;
+  BYTE line[2 * FI_CHUNK];
+  DWORD i, n= 0;
+  BYTE b;
+
+  for (i= 0; i < count; i++)
+  {
+    f->pos++;
+    if (fiHit(f, FI_DROP)) continue;
+    b= data[i];
+    if (fiHit(f, FI_CORRUPT)) b= fiFlip(f, b);
+    line[n++]= b;
+    if (fiHit(f, FI_DUP)) line[n++]= b;
+    if (n >= sizeof(line) - 1)
+    {
+      f->transport->write(f->port, line, n);
+      n= 0;
+    }
+  }
+  if (n > 0) f->transport->write(f->port, line, n);
+  return(count);          /* (the host has sent them all) */
+}
+
+/*-------------------------------------------------------------*/
+static DWORD fiWaitForData(void *port, DWORD count, DWORD timeout)
+{
+  BSL_FAULTS *f= (BSL_FAULTS*)port;
+  DWORD start= f->transport->ticks(f->port);
+  DWORD now, next, n;
+  long left;
+
+  for (;;)
+  {
+    fiFill(f);
+    now= f->transport->ticks(f->port);
+    next= now + timeout;
+    if ((n= fiReady(f, now, &next)) >= count) break;
+    left= (long)timeout - (long)(now - start);
+    if (left <= 0) break;
+    if (FI_LATER(now + left, next)) left= (long)(next - now);
+    if (f->used >= FI_QUEUE)
+      f->transport->delay(f->port, (DWORD)left);
+    else
+      f->transport->waitForData(f->port, 1, (DWORD)left);
+  }
+  return(n);
+}
+
+/*-------------------------------------------------------------*/
+static DWORD fiRead(void *port, BYTE data[], DWORD count)
+{
+  BSL_FAULTS *f= (BSL_FAULTS*)port;
+  DWORD next, n, i;
+
+  fiFill(f);
+  n= fiReady(f, f->transport->ticks(f->port), &next);
+  if (count > n) count= n;
+  for (i= 0; i < count; i++)
+  {
+    data[i]= f->queue[f->first];
+    f->first= (f->first + 1) % FI_QUEUE;
+    f->used--;
+  }
+  return(count);
+}
+
+/*-------------------------------------------------------------*/
+static void fiPurge(void *port)
+{
+  BSL_FAULTS *f= (BSL_FAULTS*)port;
+
+  f->first= f->used= 0;
+  f->hold= f->transport->ticks(f->port);
+  f->transport->purge(f->port);
+}
+
+/*-------------------------------------------------------------*/
+static int fiClose(void *port)
+{
+  BSL_FAULTS *f= (BSL_FAULTS*)port;
+
+  return(f->transport->close(f->port));
+}
+
+/*-------------------------------------------------------------*/
+static DWORD fiTicks(void *port)
+{
+  BSL_FAULTS *f= (BSL_FAULTS*)port;
+
+  return(f->transport->ticks(f->port));
+}
+
+/*-------------------------------------------------------------*/
+static void fiDelay(void *port, DWORD time)
+{
+  BSL_FAULTS *f= (BSL_FAULTS*)port;
+
+  f->transport->delay(f->port, time);
+}
+
+/*-------------------------------------------------------------*/
+static DWORD fiLineErrors(void *port)
+{
+  BSL_FAULTS *f= (BSL_FAULTS*)port;
+  DWORD n= f->lineErrors;
+
+  if (f->transport->lineErrors != NULL) n+= f->transport->lineErrors(f->port);
+  return(n);
+}
+
+static const BSL_TRANSPORT fiTransport=
+{
+  fiSetLine, fiWrite, fiWaitForData, fiRead,
+  fiPurge, fiClose, fiTicks, fiDelay, NULL, fiLineErrors
+};
+
+/***************************************************************
+ * Fault injection:
+ */
+
+/*-------------------------------------------------------------*/
+BOOL fiParse(char *text, FI_SPEC *spec, int *runs, double factor[],
+             int *factors, double *latency)
+{
+  static const char kinds[FI_KINDS + 1]= "dcuwpn";
+  char *end;
+  char *kind;
+  char c;
+
+  memset(spec, 0, sizeof(FI_SPEC));
+  spec->delay= FI_DEFAULT_DELAY;
+  *runs= 1;
+  *factors= 0;
+  *latency= -1;
+  while (*text != '\0')
+  {
+    c= *text++;
+    if ((kind= strchr(kinds, c)) != NULL)
+    {
+      spec->rate[kind - kinds]= strtod(text, &end);
+    }
+    else switch (c)
+    {
+      case 'l': spec->delay= strtoul(text, &end, 0); break;
+      case 'f': spec->from= strtoul(text, &end, 0); break;
+      case 't': spec->to= strtoul(text, &end, 0); break;
+      case 's': spec->seed= strtoul(text, &end, 0); break;
+      case 'r': *runs= (int)strtol(text, &end, 0); break;
+      case 'k': *latency= strtod(text, &end); break;
+      case 'x':
+        end= text;
+        do
+        {
+          if (*factors >= FI_MAX_FACTORS) return(FALSE);
+          text= (*end == '/') ? end + 1 : end;
+          factor[(*factors)++]= strtod(text, &end);
+        } while ((end != text) && (*end == '/'));
+        break;
+      default:
+        return(FALSE);
+    }
+    if ((end == text) || ((*end != ',') && (*end != '\0'))) return(FALSE);
+    text= (*end == ',') ? end + 1 : end;
+  }
+  return(*runs > 0);
+}
+
+/*-------------------------------------------------------------*/
+int fiStart(BSL_SESSION *s)
+{
+  BSL_FAULTS *f;
+
+  if ((s->transport == NULL) || (s->opt.faults == NULL) || (s->faults != NULL))
+  {
+    return(ERR_COM);
+  }
+  if ((f= (BSL_FAULTS*)calloc(1, sizeof(BSL_FAULTS))) == NULL)
+  {
+    return(ERR_COM);
+  }
+  f->spec= *s->opt.faults;
+  f->rand= f->spec.seed * 2654435761UL + 0x9E3779B9UL;
+  if (f->rand == 0) f->rand= 1;
+  f->transport= s->transport;
+  f->port= s->port;
+  f->hold= f->transport->ticks(f->port);
+  s->transport= &fiTransport;
+  s->port= f;
+  s->faults= f;
+  return(ERR_NONE);
+}
+
+/*-------------------------------------------------------------*/
+void fiDone(BSL_SESSION *s)
+{
+  BSL_FAULTS *f= s->faults;
+
+  if (f == NULL) return;
+  if (s->transport == &fiTransport)
+  {
+    s->transport= f->transport;
+    if (s->port != NULL) s->port= f->port; /* (NULL: closed) */
+  }
+  free(f);
+  s->faults= NULL;
+}
+
+/*-------------------------------------------------------------*/
+DWORD fiCount(BSL_SESSION *s, DWORD count[FI_KINDS])
+{
+  DWORD n= 0;
+  int kind;
+
+  for (kind= 0; kind < FI_KINDS; kind++)
+  {
+    if (count != NULL) count[kind]= (s->faults != NULL) ? s->faults->count[kind] : 0;
+    if (s->faults != NULL) n+= s->faults->count[kind];
+  }
+  return(n);
+}
+
+/* EOF */
@@ -0,0 +1,101 @@
+/****************************************************************
+*
+* Project: MSP430 Bootstrap Loader Demonstration Program
+*
+* File:    FAULTS.H
+*
+* Fault injection (-n): a transport put in front of the port by
+* bslOpen() which spoils the bytes on the line at the rates given,
+* to time the recovery paths of SSP.C (NAK, resent frames, sync
+* retries) and of the program flow as a bad cable would make them
+* run.  The wire trace keeps the bytes as the host wrote and read
+* them, so a session with faults recorded with -d replays with the
+* same faults, without -n.
+*
+*   FI_DROP     byte lost (sent or received)
+*   FI_CORRUPT  one bit of the byte inverted (sent or received)
+*   FI_DUP      byte doubled (sent or received)
+*   FI_DELAY    byte received, and all after it, held back
+*   FI_PARITY   byte received with one bit inverted and counted as
+*               a receive error, as the UART reports a parity error
+*   FI_NAK      DATA_ACK received turned into DATA_NAK (rate per
+*               DATA_ACK)
+*
+* The rates are per byte, drawn from a generator of its own with
+* the seed given, so a run can be repeated exactly.  Bytes are
+* counted in both directions; faults only hit bytes from..to.
+* Received bytes are only read by the session while this transport
+* is in place, so its queue is the receive queue; rxEvent is not
+* passed on (sessions with faults are polled).
+*
+****************************************************************/
+
+#ifndef Faults__H
+#define Faults__H
+
+#include "session.h"
+
+/* Kinds of faults: */
+#define FI_DROP     0
+#define FI_CORRUPT  1
+#define FI_DUP      2
+#define FI_DELAY    3
+#define FI_PARITY   4
+#define FI_NAK      5
+#define FI_KINDS    6
+
+/* Bytes received and not read yet: */
+#define FI_QUEUE    4096
+
+/* Sweep of -n (runs at several multiples of the rates): */
+#define FI_MAX_FACTORS 16
+
+/* What to inject (BSL_OPTIONS.faults): */
+struct FI_SPEC
+{
+  double rate[FI_KINDS];  /* per byte, 0: never */
+  DWORD from, to;         /* bytes hit (to == 0: up to the end) */
+  DWORD delay;            /* ms of FI_DELAY */
+  DWORD seed;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-------------------------------------------------------------*/
+BOOL fiParse(char *text, FI_SPEC *spec, int *runs, double factor[],
+             int *factors, double *latency);
+/* Reads the text of -n: a list of {letter}{value} separated by
+ * commas.  d, c, u, w, p, n: rate of FI_DROP, FI_CORRUPT, FI_DUP,
+ * FI_DELAY, FI_PARITY, FI_NAK; l: delay (ms); f, t: from, to;
+ * s: seed; r: runs; x: factors of the rates, separated by '/';
+ * k: latency (ms) of the simulated device (SIMDEV.H) to run on
+ * (*latency < 0: not given).
+ * Return == FALSE: text not understood
+ */
+
+/*-------------------------------------------------------------*/
+int fiStart(BSL_SESSION *s);
+/* Starts the fault injection of s->opt.faults (done by bslOpen()).
+ * Return == 0: OK
+ */
+
+/*-------------------------------------------------------------*/
+void fiDone(BSL_SESSION *s);
+/* Removes the transport of fiStart().
+ */
+
+/*-------------------------------------------------------------*/
+DWORD fiCount(BSL_SESSION *s, DWORD count[FI_KINDS]);
+/* Copies the faults injected of each kind into count (if not
+ * NULL) and returns their sum.
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/* EOF */
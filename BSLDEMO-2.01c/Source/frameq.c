@@ -0,0 +1,232 @@
+/****************************************************************
+*
+* Project: MSP430 Bootstrap Loader Demonstration Program
+*
+* File:    FRAMEQ.C
+*
+* Frame queue of programTIText() (see FRAMEQ.H).
+*
+* head counts the blocks put into the ring (written by the parsing
+* thread only), tail the blocks given back (written by the session
+* only).  A slot is filled before head is advanced past it, and is
+* used before tail is; InterlockedExchange() orders these writes.
+* The events (auto-reset) only wake up a side waiting for a slot
+* or a block, and a wakeup is never lost: the index is always
+* written before the event is set.
+*
+* With a frame file, slot 0 is the only one used, for the record
+* fqGet() has come to.
+*
+****************************************************************/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <windows.h>
+
+#include "bslcomm.h"
+#include "frameq.h"
+#include "frames.h"
+
+struct FRAME_QUEUE
+{
+  FQ_BLOCK slot[FQ_SLOTS];
+  volatile LONG head;         /* blocks put    (parsing thread) */
+  volatile LONG tail;         /* blocks used   (session)        */
+  volatile LONG done;         /* end of file reached            */
+  volatile LONG stop;         /* fqStop() called                */
+  HANDLE filled, freed;
+  HANDLE thread;
+  FILE *infile;
+  int maxData;
+  BYTE cmd;                   /* frames built for, 0: none      */
+  FRAME_FILE *file;           /* frame file, or NULL            */
+  const FF_RECORD *rec;       /* record of slot 0 (frame file)  */
+};
+
+/*-------------------------------------------------------------*/
+static FQ_BLOCK *fqSlot(FRAME_QUEUE *q)
+/* Waits for a free slot (parsing thread).
+ * Return == NULL: stopped
+ */
+{
+  while ((q->head - q->tail) >= FQ_SLOTS)
+  {
+    if (q->stop) return(NULL);
+    WaitForSingleObject(q->freed, INFINITE);
+  }
+  if (q->stop) return(NULL);
+  return(&q->slot[q->head % FQ_SLOTS]);
+}
+
+/*-------------------------------------------------------------*/
+static FQ_BLOCK *fqPut(FRAME_QUEUE *q, FQ_BLOCK *b,
+                       unsigned long addr, WORD len)
+/* Completes the block in slot b, passes it to the session and
+ * returns the next slot (NULL: stopped).
+ */
+{
+  BYTE data[MAX_FRAME_SIZE];
+
+  b->addr= addr;
+  b->len= len;
+  b->data= b->buf;
+  b->txFrame= NULL;
+  if ((q->cmd != 0) && (len + 12 <= MAX_FRAME_SIZE))
+  { /* (bslFrame() pads its data in place) */
+    memcpy(data, b->buf, len);
+    bslFrame(q->cmd, addr, len, data, b->frame);
+    b->txFrame= b->frame;
+  }
+  InterlockedExchange(&q->head, q->head + 1);
+  SetEvent(q->filled);
+  return(fqSlot(q));
+}
+
+/*-------------------------------------------------------------*/
+int fqParseLine(const char *line, int linelen, BYTE data[])
+{
+  unsigned int value;
+  int linepos, len= 0;
+
+  for (linepos= 0; linepos < linelen-3; linepos+= 3, len++)
+  {
+    sscanf(&line[linepos], "%3x", &value);
+    data[len]= (BYTE)value;
+  }
+  return(len);
+}
+
+/*-------------------------------------------------------------*/
+static DWORD WINAPI fqParse(LPVOID param)
+/* Parsing thread: splits the file as programTIText() did. */
+{
+  FRAME_QUEUE *q= (FRAME_QUEUE*)param;
+  FQ_BLOCK *b= fqSlot(q);
+  unsigned long currentAddr= 0;
+  WORD len= 0;
+  int linelen;
+  char strdata[128];
+
+  while (b != NULL)
+  {
+    /* Read one line: */
+    if ((fgets(strdata, 127, q->infile) == 0) || (strdata[0] == 'q'))
+    { /* End Of File or q => last block */
+      if (len > 0) fqPut(q, b, currentAddr, len);
+      break;
+    }
+    linelen= strlen(strdata);
+
+    if (strdata[0] == '@')
+    { /* new address => block ends */
+      if (len > 0) b= fqPut(q, b, currentAddr, len);
+      len= 0;
+      sscanf(&strdata[1], "%lx\n", &currentAddr);
+      continue;
+    }
+
+    len+= fqParseLine(strdata, linelen, &b->buf[len]);
+
+    if (len > q->maxData-16)
+    { /* frame is getting full */
+      b= fqPut(q, b, currentAddr, len);
+      currentAddr+= len;
+      len= 0;
+    }
+  }
+
+  InterlockedExchange(&q->done, TRUE);
+  SetEvent(q->filled);
+  return(0);
+}
+
+/*-------------------------------------------------------------*/
+FRAME_QUEUE *fqStart(char *filename, int maxData, BYTE cmd, int *error)
+{
+  FRAME_QUEUE *q= (FRAME_QUEUE*)calloc(1, sizeof(FRAME_QUEUE));
+
+  *error= ERR_FILE_OPEN;
+  if (q == NULL) return(NULL);
+  q->maxData= maxData;
+  q->cmd= cmd;
+  q->thread= INVALID_HANDLE_VALUE;
+
+  /* Compiled already? */
+  if ((q->file= ffOpen(filename, error)) != NULL) return(q);
+  if ((*error != ERR_NONE) || ((q->infile= fopen(filename, "rb")) == NULL))
+  {
+    if (*error == ERR_NONE) *error= ERR_FILE_OPEN;
+    free(q);
+    return(NULL);
+  }
+  q->filled= CreateEvent(NULL, FALSE, FALSE, NULL);
+  q->freed= CreateEvent(NULL, FALSE, FALSE, NULL);
+  q->thread= CreateThread(NULL, 0, fqParse, q, 0, NULL);
+  if (q->thread == NULL)
+  {
+    q->thread= INVALID_HANDLE_VALUE;
+    fqStop(q);
+    *error= ERR_FILE_OPEN;
+    return(NULL);
+  }
+  return(q);
+}
+
+/*-------------------------------------------------------------*/
+FQ_BLOCK *fqGet(FRAME_QUEUE *q)
+{
+  FQ_BLOCK *b= &q->slot[0];
+  LONG done;
+
+  if (q->file != NULL)
+  {
+    if ((q->rec= ffNext(q->file, q->rec, q->cmd)) == NULL) return(NULL);
+    b->addr= q->rec->addr;
+    b->len= q->rec->len;
+    b->data= FF_DATA(q->rec);
+    b->txFrame= (FF_FRAME(q->rec)[1] == q->cmd) ? FF_FRAME(q->rec) : NULL;
+    return(b);
+  }
+
+  for (;;)
+  {
+    done= q->done; /* (read before head: head is final once set) */
+    if (q->tail != q->head) break;
+    if (done) return(NULL);
+    WaitForSingleObject(q->filled, INFINITE);
+  }
+  return(&q->slot[q->tail % FQ_SLOTS]);
+}
+
+/*-------------------------------------------------------------*/
+void fqRelease(FRAME_QUEUE *q)
+{
+  if (q->file != NULL) return;
+  InterlockedExchange(&q->tail, q->tail + 1);
+  SetEvent(q->freed);
+}
+
+/*-------------------------------------------------------------*/
+void fqStop(FRAME_QUEUE *q)
+{
+  if (q->file != NULL)
+  {
+    ffClose(q->file);
+    free(q);
+    return;
+  }
+  InterlockedExchange(&q->stop, TRUE);
+  SetEvent(q->freed);
+  if (q->thread != INVALID_HANDLE_VALUE)
+  {
+    WaitForSingleObject(q->thread, INFINITE);
+    CloseHandle(q->thread);
+  }
+  CloseHandle(q->filled);
+  CloseHandle(q->freed);
+  fclose(q->infile);
+  free(q);
+}
+
+/* EOF */
@@ -0,0 +1,96 @@
+/****************************************************************
+*
+* Project: MSP430 Bootstrap Loader Demonstration Program
+*
+* File:    FRAMEQ.H
+*
+* Frame queue of programTIText() (SESSION.C): a thread of its
+* own parses the TI TXT file into blocks, and builds the Transmit
+* Block frame of each block for the ROM BSL ahead (alignment,
+* padding, checksum), while the session sends the blocks before.
+* The blocks are passed in a ring of FQ_SLOTS slots, with one
+* producer and one consumer, which needs no lock: each index is
+* written by one side only.  A side sleeps on an event only while
+* the ring is full or empty.
+*
+* A frame file (FRAMES.H) needs no thread: fqGet() returns its
+* blocks with data and frame pointing into the file's view.
+*
+*   q= fqStart("firmware.txt", 240, BSL_TXBLK, &error);
+*   while ((b= fqGet(q)) != NULL)
+*   {
+*     ... bslTxRxFrame(s, b->txFrame, NULL) ...
+*     fqRelease(q);
+*   }
+*   fqStop(q);
+*
+****************************************************************/
+
+#ifndef FrameQ__H
+#define FrameQ__H
+
+#include "fastload.h"
+
+/* Slots of the ring (power of 2): */
+#define FQ_SLOTS 8
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+  unsigned long addr;
+  WORD len;
+  BYTE *data;                     /* buf, or in the frame file */
+  BYTE *txFrame;                  /* frame, or in the frame file;
+                                     NULL: not built */
+  BYTE buf[FL_MAX_DATA];
+  BYTE frame[MAX_FRAME_SIZE];
+} FQ_BLOCK;
+
+typedef struct FRAME_QUEUE FRAME_QUEUE;
+
+/*-------------------------------------------------------------*/
+FRAME_QUEUE *fqStart(char *filename, int maxData, BYTE cmd, int *error);
+/* Opens the file and starts parsing it into blocks of up to
+ * maxData bytes, split as programTIText() always did.  With cmd
+ * (BSL_TXBLK or BSL_TXPWORD), the frame of that command is built
+ * for each block which fits into one frame.  A frame file gives
+ * its blocks as compiled, with its frames of cmd (see ffNext()).
+ * Return == NULL: *error == ERR_FILE_OPEN: file can't be opened
+ *                 (or no memory)
+ *                 *error == ERR_FRAME_FILE: broken frame file
+ */
+
+/*-------------------------------------------------------------*/
+FQ_BLOCK *fqGet(FRAME_QUEUE *q);
+/* Waits for the next block.
+ * Return == NULL: end of file
+ */
+
+/*-------------------------------------------------------------*/
+void fqRelease(FRAME_QUEUE *q);
+/* Gives the block returned by fqGet() back to the ring.
+ */
+
+/*-------------------------------------------------------------*/
+void fqStop(FRAME_QUEUE *q);
+/* Stops the parsing (also before the end of the file), closes
+ * the file and frees the queue.
+ */
+
+/*-------------------------------------------------------------*/
+int fqParseLine(const char *line, int linelen, BYTE data[]);
+/* Converts a data line of a TI TXT file ("XX XX ...\r\n", linelen
+ * characters with the line end) into data[].
+ * Returns the number of bytes.
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/* EOF */
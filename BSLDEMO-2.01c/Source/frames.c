@@ -0,0 +1,233 @@
+/****************************************************************
+*
+* Project: MSP430 Bootstrap Loader Demonstration Program
+*
+* File:    FRAMES.C
+*
+* Frame files (see FRAMES.H).  ffOpen() checks the header and the
+* bounds of each record once, so the frames can be used from the
+* view without any further check.  The checksums are not looked
+* at: a frame spoilt in the file is refused (NAK) by the BSL.
+*
+****************************************************************/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <windows.h>
+
+#include "frames.h"
+#include "frameq.h"
+
+struct FRAME_FILE
+{
+  HANDLE file;
+  HANDLE mapping;
+  const BYTE *view;
+  DWORD size;
+};
+
+/*-------------------------------------------------------------*/
+static DWORD ffAfter(FRAME_FILE *f, const FF_RECORD *r)
+/* Offset of the record after r. */
+{
+  return((DWORD)((const BYTE*)r - f->view) + sizeof(FF_RECORD) + ((r->txLen + 3) & ~3));
+}
+
+/*-------------------------------------------------------------*/
+static BOOL ffCheck(FRAME_FILE *f, DWORD offset)
+/* Checks that the record at offset and its frame are complete. */
+{
+  const FF_RECORD *r= (const FF_RECORD*)&f->view[offset];
+  const BYTE *frame;
+
+  if (offset + sizeof(FF_RECORD) > f->size) return(FALSE);
+  frame= FF_FRAME(r);
+  return((r->txLen >= 10) && (r->txLen <= MAX_FRAME_SIZE) &&
+         (offset + sizeof(FF_RECORD) + r->txLen <= f->size) &&
+         (frame[2] == frame[3]) && (r->txLen == frame[2] + 6) &&
+         (8 + (r->addr & 1) + r->len <= (DWORD)frame[2] + 4));
+}
+
+/*-------------------------------------------------------------*/
+FRAME_FILE *ffOpen(const char *filename, int *error)
+{
+  FRAME_FILE *f;
+  FF_HEADER h;
+  DWORD got, offset;
+  HANDLE file= CreateFile(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+                          OPEN_EXISTING, 0, NULL);
+
+  *error= ERR_FILE_OPEN;
+  if (file == INVALID_HANDLE_VALUE) return(NULL);
+
+  *error= ERR_NONE;
+  if (!ReadFile(file, &h, sizeof(h), &got, NULL) || (got < sizeof(h)) ||
+      (memcmp(h.magic, FF_MAGIC, sizeof(h.magic)) != 0))
+  { /* (TI TXT) */
+    CloseHandle(file);
+    return(NULL);
+  }
+
+  *error= ERR_FRAME_FILE;
+  if ((f= (FRAME_FILE*)calloc(1, sizeof(FRAME_FILE))) == NULL)
+  {
+    CloseHandle(file);
+    return(NULL);
+  }
+  f->file= file;
+  f->size= GetFileSize(file, NULL);
+  f->mapping= CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (f->mapping != NULL)
+  {
+    f->view= (const BYTE*)MapViewOfFile(f->mapping, FILE_MAP_READ, 0, 0, 0);
+  }
+  if ((f->view == NULL) || (h.size != f->size))
+  {
+    ffClose(f);
+    return(NULL);
+  }
+
+  for (offset= sizeof(FF_HEADER); offset < f->size;
+       offset= ffAfter(f, (const FF_RECORD*)&f->view[offset]))
+  {
+    if (!ffCheck(f, offset))
+    {
+      ffClose(f);
+      return(NULL);
+    }
+  }
+
+  *error= ERR_NONE;
+  return(f);
+}
+
+/*-------------------------------------------------------------*/
+const FF_HEADER *ffHeader(FRAME_FILE *f)
+{
+  return((const FF_HEADER*)f->view);
+}
+
+/*-------------------------------------------------------------*/
+const FF_RECORD *ffNext(FRAME_FILE *f, const FF_RECORD *r, BYTE cmd)
+{
+  DWORD offset= (r == NULL) ? sizeof(FF_HEADER) : ffAfter(f, r);
+
+  if ((cmd == 0) || ((cmd == BSL_TXPWORD) && !(ffHeader(f)->flags & FF_PASSWORD)))
+  {
+    cmd= BSL_TXBLK;
+  }
+  for (; offset < f->size; offset= ffAfter(f, r))
+  {
+    r= (const FF_RECORD*)&f->view[offset];
+    if (FF_FRAME(r)[1] == cmd) return(r);
+  }
+  return(NULL);
+}
+
+/*-------------------------------------------------------------*/
+void ffClose(FRAME_FILE *f)
+{
+  if (f->view != NULL) UnmapViewOfFile((LPVOID)f->view);
+  if (f->mapping != NULL) CloseHandle(f->mapping);
+  CloseHandle(f->file);
+  free(f);
+}
+
+/*-------------------------------------------------------------*/
+static BOOL ffPut(FILE *out, char *filename, int maxData, BYTE cmd,
+                  BOOL msp430x, FF_HEADER *h)
+/* Appends the frames of the blocks of the TI TXT file. */
+{
+  static const BYTE pad[4]= { 0, 0, 0, 0 };
+  FRAME_QUEUE *q;
+  FQ_BLOCK *b;
+  FF_RECORD r;
+  int error;
+  BOOL ok= TRUE;
+
+  if ((q= fqStart(filename, maxData, cmd, &error)) == NULL)
+  {
+    printf("ERROR: Unable to open input file \"%s\"!\n", filename);
+    return(FALSE);
+  }
+  while (ok && ((b= fqGet(q)) != NULL))
+  {
+    if ((b->addr + b->len > 0x10000L) && !msp430x)
+    {
+      printf("ERROR: Addresses above 0xFFFF need -x!\n");
+      ok= FALSE;
+    }
+    else if (b->txFrame == NULL)
+    {
+      printf("ERROR: Block at 0x%lX too long for one frame!\n", b->addr);
+      ok= FALSE;
+    }
+    else
+    {
+      r.addr= b->addr;
+      r.len= b->len;
+      r.txLen= (WORD)(b->txFrame[2] + 6);
+      fwrite(&r, sizeof(r), 1, out);
+      fwrite(b->txFrame, 1, r.txLen, out);
+      fwrite(pad, 1, (4 - (r.txLen % 4)) % 4, out);
+      if (b->addr + b->len > 0x10000L) h->flags|= FF_MSP430X;
+      if (cmd == BSL_TXBLK)
+      {
+        h->blocks++;
+        h->bytes+= b->len;
+      }
+    }
+    fqRelease(q);
+  }
+  fqStop(q);
+  return(ok);
+}
+
+/*-------------------------------------------------------------*/
+int ffCompile(char *filename, char *passwdFile, int maxData,
+              BOOL msp430x, char *frameFile)
+{
+  FF_HEADER h;
+  FILE *out;
+  BOOL ok;
+
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, FF_MAGIC, sizeof(h.magic));
+  h.maxData= (WORD)maxData;
+
+  if ((out= fopen(frameFile, "wb")) == NULL)
+  {
+    printf("ERROR: Unable to write output file \"%s\"!\n", frameFile);
+    return(1);
+  }
+  fwrite(&h, sizeof(h), 1, out);
+  ok= ffPut(out, filename, maxData, BSL_TXBLK, msp430x, &h);
+  if (ok && (passwdFile != NULL))
+  {
+    ok= ffPut(out, passwdFile, maxData, BSL_TXPWORD, msp430x, &h);
+    h.flags|= FF_PASSWORD;
+  }
+  h.size= (DWORD)ftell(out);
+  rewind(out);
+  fwrite(&h, sizeof(h), 1, out);
+  if (ferror(out))
+  {
+    printf("ERROR: Unable to write output file \"%s\"!\n", frameFile);
+    ok= FALSE;
+  }
+  fclose(out);
+  if (!ok)
+  {
+    remove(frameFile);
+    return(1);
+  }
+
+  printf("%s: %lu blocks, %lu bytes%s, %lu bytes of frames.\n", frameFile,
+         (unsigned long)h.blocks, (unsigned long)h.bytes,
+         (h.flags & FF_PASSWORD) ? " and the password" : "",
+         (unsigned long)h.size);
+  return(0);
+}
+
+/* EOF */
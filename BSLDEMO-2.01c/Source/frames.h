@@ -0,0 +1,116 @@
+/****************************************************************
+*
+* Project: MSP430 Bootstrap Loader Demonstration Program
+*
+* File:    FRAMES.H
+*
+* Frame files: a TI TXT file compiled (-g) into the frames the ROM
+* BSL is sent for it, ready to go, for the profile given: the
+* blocks split for -f, aligned, padded and with their checksum,
+* blocks above 0xFFFF with -x, and the password of -p as frames of
+* their own.  The session maps the file and sends the frames from
+* it as they are, with nothing parsed or built:
+*
+*   BSLDEMO-2.01C.exe -gfirmware.frm -pold.txt firmware.txt
+*   BSLDEMO-2.01C.exe -c3 -pfirmware.frm +epvr firmware.frm
+*
+* A frame file is given where a TI TXT file is (program, verify,
+* erase check, -p, gang); FRAMEQ.C tells them apart by the first
+* bytes.  Verify and erase check take the data from the frames,
+* and so does the fast loader, which has frames of its own.
+*
+* File (little endian, records on 4 byte boundaries):
+*
+*   FF_HEADER
+*   FF_RECORD, frame (txLen bytes, padded to 4)
+*   ...
+*
+* The frames of the image are Transmit Block frames (BSL_TXBLK),
+* those of the password Transmit Password frames (BSL_TXPWORD).
+*
+****************************************************************/
+
+#ifndef Frames__H
+#define Frames__H
+
+#include "session.h"
+
+/* First bytes of a frame file (version 1): */
+#define FF_MAGIC     "BSLFRM1\x1A"
+
+/* FF_HEADER.flags: */
+#define FF_MSP430X   0x0001     /* blocks above 0xFFFF (needs -x) */
+#define FF_PASSWORD  0x0002     /* holds a password */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+  char  magic[8];
+  DWORD size;                   /* of the file */
+  WORD  maxData;                /* -f it was compiled with */
+  WORD  flags;
+  DWORD blocks;                 /* of the image */
+  DWORD bytes;                  /* of the image */
+} FF_HEADER;
+
+typedef struct
+{
+  DWORD addr;                   /* of the block */
+  WORD  len;                    /* of the block */
+  WORD  txLen;                  /* of the frame following */
+} FF_RECORD;
+
+/* Frame and data of a record (the frame starts at an even
+ * address, a byte before the block if its address is odd):
+ */
+#define FF_FRAME(r)  ((BYTE*)((r) + 1))
+#define FF_DATA(r)   (FF_FRAME(r) + 8 + ((r)->addr & 1))
+
+typedef struct FRAME_FILE FRAME_FILE;
+
+/*-------------------------------------------------------------*/
+FRAME_FILE *ffOpen(const char *filename, int *error);
+/* Maps the frame file into memory and checks its records.
+ * Return == NULL: *error == ERR_NONE: not a frame file
+ *                 *error == ERR_FILE_OPEN: can't be opened
+ *                 *error == ERR_FRAME_FILE: broken
+ */
+
+/*-------------------------------------------------------------*/
+const FF_HEADER *ffHeader(FRAME_FILE *f);
+/* The header of the file.
+ */
+
+/*-------------------------------------------------------------*/
+const FF_RECORD *ffNext(FRAME_FILE *f, const FF_RECORD *r, BYTE cmd);
+/* The record after r (NULL: the first one) with a frame of the
+ * command cmd: BSL_TXBLK (or 0) the image, BSL_TXPWORD the
+ * password, or the image if the file holds no password (as a TI
+ * TXT file given with -p).
+ * Return == NULL: no more
+ */
+
+/*-------------------------------------------------------------*/
+void ffClose(FRAME_FILE *f);
+/* Unmaps and closes the file.
+ */
+
+/*-------------------------------------------------------------*/
+int ffCompile(char *filename, char *passwdFile, int maxData,
+              BOOL msp430x, char *frameFile);
+/* Compiles the TI TXT file (and the password file, if not NULL)
+ * into the frame file, with blocks of up to maxData bytes.
+ * Return == 0: OK
+ * Return == 1: error (shown)
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/* EOF */
@@ -0,0 +1,715 @@
+/****************************************************************
+*
+* Project: MSP430 Bootstrap Loader Demonstration Program
+*
+* File:    GANG.C
+*
+* Gang programming: with -c given for more than one COM port, the
+* file is programmed into the devices on all of them at once.
+*
+* Each port gets a session of its own (SESSION.H).  The program
+* flow of the ROM BSL (entry sequence, mass erase, password, chip
+* ID, baudrate, erase check, program, verify, reset) runs as a
+* chain of asynchronous commands (BSLASYNC.H), and one thread
+* waits for the replies of all ports, so each device goes at its
+* own speed.  The file is parsed once (by FRAMEQ.C, as for one
+* port), into blocks which all ports share.
+*
+* The program flow which needs the blocking functions (-b, -e, -x,
+* +a, +u, and devices with BSL 1.10 or older, which need the
+* workaround patch) runs on one thread per port instead, with
+* bslRun().  Devices found to need the patch are run that way after
+* the others have completed.
+*
+* The messages of the sessions are shown line by line with the
+* name of the port.  A device which fails does not stop the others.
+* A table with the result for each port is shown at the end.
+*
+****************************************************************/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <windows.h>
+
+#include "gang.h"
+#include "bslasync.h"
+#include "frameq.h"
+#include "metrics.h"
+#include "wiretrace.h"
+
+/* Deadline of one command (ms), far above its protocol timeouts: */
+#define GANG_DEADLINE 10000
+
+typedef struct
+{
+  unsigned long addr;
+  WORD len;
+  DWORD offset;           /* of the data in GANG_IMAGE.data */
+} GANG_BLOCK;
+
+typedef struct
+{
+  GANG_BLOCK *blk;
+  int count;
+  BYTE *data;
+  DWORD size;
+} GANG_IMAGE;
+
+/* Steps of the program flow on the loop: */
+enum { GS_RESET, GS_MERASE, GS_PASSWD, GS_READID, GS_SPEED, GS_PASS,
+       GS_RUN, GS_DONE, GS_FAILED };
+
+/* Commands whose result is checked by gangNext(): */
+enum { OP_NONE, OP_READID, OP_SPEED, OP_ECHECK, OP_FASTCHECK, OP_VERIFY };
+
+typedef struct
+{
+  char   name[20];
+  BSL_SESSION s;
+  BOOL   opened;
+  BOOL   fullFlow;        /* run with bslRun() on a thread */
+  int    error;           /* result of bslOpenCom() / the flow */
+  char   traceName[300];  /* wire trace file of the port */
+  char   line[256];       /* output not terminated by '\n' yet */
+  int    lineLen;
+
+  /* Program flow on the loop: */
+  int    step;
+  int    op;
+  int    count;           /* mass erase cycles, blocks sent */
+  int    pass;
+  unsigned action;        /* actions of this pass */
+  unsigned todo;          /* actions left for this block */
+  BOOL   verify;          /* verify by reading back */
+  DWORD  BR;
+  DWORD  bytes;           /* bytes programmed */
+  BYTE   blkin[MAX_DATA_BYTES + 2];
+} GANG_PORT;
+
+char gangPortName[GANG_MAX_PORTS][20];
+int gangPorts= 0;
+
+static GANG_PORT gangPort[GANG_MAX_PORTS];
+static CRITICAL_SECTION gangLock;
+static GANG_IMAGE gangImg, gangPwd;
+
+/*-------------------------------------------------------------*/
+static void gangPrint(BSL_SESSION *s, const char *text)
+/* Output of a session: complete lines are shown with the port
+ * name in front of them.
+ */
+{
+  GANG_PORT *p= (GANG_PORT*)s->user;
+
+  for (; *text != 0; text++)
+  {
+    if ((*text != '\n') && (p->lineLen < (int)sizeof(p->line) - 1))
+    {
+      p->line[p->lineLen++]= *text;
+    }
+    else if (*text == '\n')
+    {
+      p->line[p->lineLen]= 0;
+      EnterCriticalSection(&gangLock);
+      printf("%-6s %s\n", &p->name[4], p->line);
+      LeaveCriticalSection(&gangLock);
+      p->lineLen= 0;
+    }
+  }
+} /* gangPrint */
+
+/*-------------------------------------------------------------*/
+static void gangProgress(BSL_SESSION *s, int bytes)
+/* No bargraph: it can't be shown for several ports at once. */
+{
+} /* gangProgress */
+
+/*-------------------------------------------------------------*/
+static BOOL gangAddBlock(GANG_IMAGE *img, unsigned long addr,
+                         BYTE *data, WORD len)
+{
+  GANG_BLOCK *blk;
+  BYTE *store;
+
+  if ((img->count % 256) == 0)
+  {
+    blk= (GANG_BLOCK*)realloc(img->blk, (img->count + 256) * sizeof(GANG_BLOCK));
+    if (blk == NULL) return(FALSE);
+    img->blk= blk;
+  }
+  store= (BYTE*)realloc(img->data, img->size + len);
+  if (store == NULL) return(FALSE);
+  img->data= store;
+
+  img->blk[img->count].addr= addr;
+  img->blk[img->count].len= len;
+  img->blk[img->count].offset= img->size;
+  memcpy(&img->data[img->size], data, len);
+  img->size+= len;
+  img->count++;
+  return(TRUE);
+}
+
+/*-------------------------------------------------------------*/
+static int gangLoad(char *filename, const BSL_OPTIONS *opt, BYTE cmd,
+                    GANG_IMAGE *img)
+/* Reads the blocks of a TI TXT file (or of the frames of cmd of a
+ * frame file) through FRAMEQ.C, split as programTIText() gets them;
+ * as there, blocks above 0xFFFF need -x (ERR_READ_RANGE).
+ */
+{
+  FRAME_QUEUE *q;
+  FQ_BLOCK *b;
+  int error= ERR_NONE;
+
+  memset(img, 0, sizeof(GANG_IMAGE));
+  if ((q= fqStart(filename, opt->maxData, cmd, &error)) == NULL)
+  {
+    if (error == ERR_FRAME_FILE)
+      printf("ERROR: Frame file \"%s\" is broken!\n", filename);
+    else
+      printf("ERROR: Unable to open input file \"%s\"!\n", filename);
+    return(error);
+  }
+  while ((error == ERR_NONE) && ((b= fqGet(q)) != NULL))
+  {
+    if ((b->addr + b->len > 0x10000L) && !opt->toDo.MSP430X)
+    { /* (would be written below 64K) */
+      printf("ERROR: Addresses above 0xFFFF can only be used with -x!\n");
+      error= ERR_READ_RANGE;
+    }
+    else if (!gangAddBlock(img, b->addr, b->data, b->len))
+    {
+      printf("ERROR: Not enough memory for \"%s\"!\n", filename);
+      error= ERR_FILE_OPEN;
+    }
+    fqRelease(q);
+  }
+  fqStop(q);
+  return(error);
+}
+
+/*-------------------------------------------------------------*/
+static void gangFree(GANG_IMAGE *img)
+{
+  if (img->blk != NULL) free(img->blk);
+  if (img->data != NULL) free(img->data);
+  memset(img, 0, sizeof(GANG_IMAGE));
+}
+
+/*-------------------------------------------------------------*/
+static char *gangErrorText(int error)
+{
+  switch (error)
+  {
+    case ERR_OPEN_COMM:
+    case ERR_SET_COMM_STATE:      return("Opening COM-Port failed");
+    case ERR_BSL_SYNC:            return("Synchronization failed");
+    case ERR_RX_HDR_TIMEOUT:      return("No reply");
+    case ERR_DEADLINE:            return("Command did not complete in time");
+    case ERR_VERIFY_FAILED:       return("Verification failed");
+    case ERR_ERASE_CHECK_FAILED:  return("Erase check failed");
+    case ERR_FILE_OPEN:           return("Unable to open input file");
+    case ERR_RX_NAK:              return("NAK received");
+    case ERR_CMD_FAILED:          return("Command failed");
+    default:                      return("Communication Error");
+  }
+} /* gangErrorText */
+
+/*-------------------------------------------------------------*/
+static BOOL gangCompare(GANG_PORT *p, GANG_BLOCK *b, BYTE *data)
+/* Compares the block read with data (NULL: erased). */
+{
+  BYTE *rx= &p->blkin[b->addr % 2];
+  WORD n;
+
+  for (n= 0; n < b->len; n++)
+  {
+    if (rx[n] != ((data != NULL) ? data[n] : 0xff)) return(FALSE);
+  }
+  return(TRUE);
+}
+
+/*-------------------------------------------------------------*/
+static unsigned gangPassAction(GANG_PORT *p)
+/* Actions of the next pass through the file (0: none left). */
+{
+  const BSL_TODO *toDo= &p->s.opt.toDo;
+  BSL_SESSION *s= &p->s;
+  char *filename= s->opt.filename;
+  unsigned action= 0;
+
+  if (toDo->OnePass)
+  {
+    if (p->pass++ > 0) return(0);
+    if (toDo->EraseCheck) action|= ACTION_ERASE_CHECK;
+    if (toDo->FastCheck)  action|= ACTION_ERASE_CHECK_FAST;
+    if (toDo->Program)    action|= ACTION_PROGRAM;
+    if (toDo->Verify)     action|= ACTION_VERIFY;
+    if (action != 0) bslPrintf(s, "One pass \"%s\"...\n", filename);
+    return(action);
+  }
+  while (action == 0)
+  {
+    switch (p->pass++)
+    {
+      case 0:
+        if (!toDo->EraseCheck) break;
+        bslPrintf(s, "Erase Check by file \"%s\"...\n", filename);
+        action= ACTION_ERASE_CHECK;
+        break;
+      case 1:
+        if (!toDo->FastCheck) break;
+        bslPrintf(s, "Fast E-Check by file \"%s\"...\n", filename);
+        action= ACTION_ERASE_CHECK_FAST;
+        break;
+      case 2:
+        if (!toDo->Program) break;
+        bslPrintf(s, "Program \"%s\"...\n", filename);
+        action= ACTION_PROGRAM;
+        break;
+      case 3:
+        if (!toDo->Verify) break;
+        if (!p->verify)
+        {
+          bslPrintf(s, "Verify... already done during programming.\n");
+          break;
+        }
+        bslPrintf(s, "Verify \"%s\"...\n", filename);
+        action= ACTION_VERIFY;
+        break;
+      default:
+        return(0);
+    }
+  }
+  return(action);
+}
+
+/*-------------------------------------------------------------*/
+static void gangNext(BSL_SESSION *s, int error, void *context);
+
+static void gangStart(GANG_PORT *p, int op, int error)
+/* Called with the result of starting a command.  An error ends the
+ * flow of the port; as signOff() does, the device is reset then
+ * with +r (unless the reset is what failed), and the error kept.
+ */
+{
+  BOOL reset= p->s.opt.toDo.Reset && (p->step != GS_DONE) &&
+              (p->step != GS_FAILED);
+
+  p->op= op;
+  if (error != ERR_NONE)
+  {
+    p->error= error;
+    bslPrintf(&p->s, "ERROR: %s!\n", gangErrorText(error));
+    p->step= GS_FAILED;
+    if (reset) bslAsyncReset(&p->s, FALSE, gangNext, p);
+  }
+}
+
+#define GANG_TXRX(op, cmd, addr, len, out, in) \
+  gangStart(p, op, bslAsyncTxRx(s, cmd, addr, len, out, in, \
+                                GANG_DEADLINE, gangNext, p))
+
+/*-------------------------------------------------------------*/
+static void gangNext(BSL_SESSION *s, int error, void *context)
+/* Program flow of one port on the loop: called when a command
+ * has completed, starts the next one.
+ */
+{
+  GANG_PORT *p= (GANG_PORT*)context;
+  const BSL_OPTIONS *opt= &s->opt;
+  GANG_BLOCK *b= NULL;
+  WORD code;
+
+  if (p->step == GS_FAILED) return;   /* (reset after the error done) */
+  if (p->count > 0) b= &gangImg.blk[p->count - 1];
+
+  /* Result of the command: */
+  switch (p->op)
+  {
+    case OP_READID:
+      if (error != ERR_NONE) break;
+      s->devTypeHi= p->blkin[0x00];
+      s->devTypeLo= p->blkin[0x01];
+      s->devProcHi= p->blkin[0x02];
+      s->devProcLo= p->blkin[0x03];
+      s->bslVerHi= p->blkin[0x0A];
+      s->bslVerLo= p->blkin[0x0B];
+      s->bslVer= (s->bslVerHi << 8) | s->bslVerLo;
+      bslPrintf(s, "BSL version: %X.%02X", s->bslVerHi, s->bslVerLo);
+      bslPrintf(s, " - Family member: %02X%02X", s->devTypeHi, s->devTypeLo);
+      bslPrintf(s, " - Process: %02X%02X\n", s->devProcHi, s->devProcLo);
+      if (s->bslVer <= 0x0110)
+      {
+        bslPrintf(s, "Needs the workaround patch: programmed after the others.\n");
+        p->fullFlow= TRUE;
+        return;
+      }
+      p->verify= !opt->toDo.Program || (s->bslVer < 0x0140);
+      break;
+
+    case OP_SPEED:
+      if (error != ERR_NONE)
+      {
+        bslPrintf(s, "Change Baudrate command not accepted. Baudrate remains at %d Baud\n",
+                  comGetBaudrate(s));
+        error= ERR_NONE;
+        break;
+      }
+      bslPrintf(s, "Change Baudrate from %d ", comGetBaudrate(s));
+      comChangeBaudrate(s, p->BR);
+      bslPrintf(s, "to %d Baud (Mode: %d)\n", comGetBaudrate(s), opt->speed);
+      gangStart(p, OP_NONE, bslAsyncDelay(s, 10, gangNext, p));
+      return;
+
+    case OP_ECHECK:
+      if ((error == ERR_NONE) && !gangCompare(p, b, NULL))
+        error= ERR_ERASE_CHECK_FAILED;
+      break;
+
+    case OP_FASTCHECK:
+      /* (as verifyBlk(): any error means not erased) */
+      if (error != ERR_NONE) error= ERR_ERASE_CHECK_FAILED;
+      break;
+
+    case OP_VERIFY:
+      if ((error == ERR_NONE) && !gangCompare(p, b, &gangImg.data[b->offset]))
+        error= ERR_VERIFY_FAILED;
+      break;
+  }
+  if (error != ERR_NONE)
+  {
+    gangStart(p, OP_NONE, error);
+    return;
+  }
+
+  /* Next command: */
+  for (;;)
+  {
+    switch (p->step)
+    {
+      case GS_RESET:
+        p->step= GS_MERASE;
+        gangStart(p, OP_NONE, bslAsyncReset(s, opt->toDo.BSLStart, gangNext, p));
+        return;
+
+      case GS_MERASE:
+        if (!opt->toDo.MassErase || (p->count >= opt->meraseCycles))
+        {
+          p->step= GS_PASSWD;
+          p->count= 0;
+          break;
+        }
+        if (p->count++ == 0) bslPrintf(s, "Mass Erase...\n");
+        GANG_TXRX(OP_NONE, BSL_MERAS, 0xff00, 0xa506, NULL, NULL);
+        return;
+
+      case GS_PASSWD:
+        if (opt->toDo.MassErase || (opt->passwdFile == NULL))
+        {
+          memset(p->blkin, 0xff, 0x20);
+          bslPrintf(s, "Transmit standard password...\n");
+          p->step= GS_READID;
+          GANG_TXRX(OP_NONE, BSL_TXPWORD, 0xffe0, 0x0020, p->blkin, NULL);
+          return;
+        }
+        if (p->count == 0) bslPrintf(s, "Transmit PSW file \"%s\"...\n", opt->passwdFile);
+        if (p->count < gangPwd.count)
+        {
+          b= &gangPwd.blk[p->count++];
+          GANG_TXRX(OP_NONE, BSL_TXPWORD, b->addr, b->len, &gangPwd.data[b->offset], NULL);
+          return;
+        }
+        p->step= GS_READID;
+        break;
+
+      case GS_READID:
+        p->step= GS_SPEED;
+        GANG_TXRX(OP_READID, BSL_RXBLK, 0x0ff0, 14, NULL, p->blkin);
+        return;
+
+      case GS_SPEED:
+        p->step= GS_PASS;
+        p->count= 0;
+        p->pass= 0;
+        p->todo= 0;
+        p->action= gangPassAction(p);
+        if (opt->toDo.SpeedUp &&
+            speedSetting(s->devTypeHi, &s->opt.speed, &p->BR, &code) &&
+            (p->BR != comGetBaudrate(s)))
+        {
+          GANG_TXRX(OP_SPEED, BSL_SPEED, code, opt->speed, NULL, NULL);
+          return;
+        }
+        break;
+
+      case GS_PASS:
+        if (p->action == 0)
+        {
+          p->step= GS_RUN;
+          break;
+        }
+        if (p->todo == 0)
+        {
+          if (p->count >= gangImg.count)
+          {
+            p->count= 0;
+            p->action= gangPassAction(p);
+            break;
+          }
+          p->todo= p->action;
+          b= &gangImg.blk[p->count++];
+        }
+        if ((p->todo & ACTION_ERASE_CHECK) != 0)
+        {
+          p->todo&= ~ACTION_ERASE_CHECK;
+          GANG_TXRX(OP_ECHECK, BSL_RXBLK, b->addr, b->len, NULL, p->blkin);
+          return;
+        }
+        if ((p->todo & ACTION_ERASE_CHECK_FAST) != 0)
+        {
+          p->todo&= ~ACTION_ERASE_CHECK_FAST;
+          GANG_TXRX(OP_FASTCHECK, BSL_ECHECK, b->addr, b->len, NULL, NULL);
+          return;
+        }
+        if ((p->todo & ACTION_PROGRAM) != 0)
+        {
+          p->todo&= ~ACTION_PROGRAM;
+          p->bytes+= b->len;
+          GANG_TXRX(OP_NONE, BSL_TXBLK, b->addr, b->len, &gangImg.data[b->offset], NULL);
+          return;
+        }
+        if (((p->todo & ACTION_VERIFY) != 0) && p->verify)
+        {
+          p->todo&= ~ACTION_VERIFY;
+          GANG_TXRX(OP_VERIFY, BSL_RXBLK, b->addr, b->len, NULL, p->blkin);
+          return;
+        }
+        p->todo= 0;
+        break;
+
+      case GS_RUN:
+        p->step= GS_DONE;
+        if (opt->toDo.Reset)
+        {
+          gangStart(p, OP_NONE, bslAsyncReset(s, FALSE, gangNext, p));
+          return;
+        }
+        break;
+
+      default:
+        if (opt->toDo.Program) bslPrintf(s, "Programming completed.\n");
+        else if (opt->toDo.Verify) bslPrintf(s, "Verification successful.\n");
+        p->error= ERR_NONE;
+        return;
+    }
+  }
+} /* gangNext */
+
+/*-------------------------------------------------------------*/
+static DWORD WINAPI gangThread(LPVOID param)
+{
+  GANG_PORT *p= (GANG_PORT*)param;
+
+  p->error= bslRun(&p->s);
+  if (p->lineLen > 0) gangPrint(&p->s, "\n");
+  p->bytes= p->s.byteCtr;
+  return(0);
+} /* gangThread */
+
+/*-------------------------------------------------------------*/
+static void gangRunThreads(void)
+/* Runs bslRun() on one thread per port marked fullFlow. */
+{
+  HANDLE thread[GANG_MAX_PORTS];
+  int i, threads= 0;
+
+  for (i= 0; i < gangPorts; i++)
+  {
+    if (!gangPort[i].fullFlow) continue;
+    thread[threads]= CreateThread(NULL, 0, gangThread, &gangPort[i], 0, NULL);
+    if (thread[threads] != NULL)
+      threads++;
+    else
+      gangPort[i].error= ERR_COM;
+  }
+  if (threads > 0)
+  {
+    WaitForMultipleObjects(threads, thread, TRUE, INFINITE);
+  }
+  for (i= 0; i < threads; i++)
+  {
+    CloseHandle(thread[i]);
+  }
+} /* gangRunThreads */
+
+/*-------------------------------------------------------------*/
+static char *gangTraceName(GANG_PORT *p, char *filename)
+/* Sets the name of the port's wire trace file: filename with the
+ * name of the port in front of the file's ("COM5-BSLDEMO.WTR").
+ */
+{
+  char *name= p->traceName;
+  char *c= &p->name[4];   /* (after "\\.\") */
+  char *base= filename;
+  int n;
+
+  for (n= 0; filename[n] != 0; n++)
+  {
+    if ((filename[n] == '\\') || (filename[n] == '/') || (filename[n] == ':'))
+      base= &filename[n+1];
+  }
+  n= (int)(base - filename);
+  if (n > 256) n= 256;
+  memcpy(name, filename, n);
+  for (; (*c != 0) && (n < 276); c++)
+  {
+    if (isalnum((BYTE)*c)) name[n++]= *c;
+  }
+  sprintf(&name[n], "-%.20s", base);
+  return(name);
+}
+
+/*-------------------------------------------------------------*/
+int gangRun(const BSL_OPTIONS *opt)
+/* Runs the program flow of BSLDEMO on all ports given with -c.
+ * Returns 0 if all devices completed it.
+ */
+{
+  BSL_LOOP loop;
+  BSL_OPTIONS portOpt;
+  BOOL fullFlow;
+  DWORD startTime;
+  int i, ok= 0;
+
+  if (opt->toDo.Dump2file)
+  {
+    printf("ERROR: Option -r can't be used with several ports!\n");
+    return(1);
+  }
+
+  /* Options handled by bslRun() only: */
+  fullFlow= (opt->newBSLFile != NULL) || opt->toDo.EraseSegment ||
+            opt->toDo.MSP430X || opt->toDo.RestoreInfoA ||
+            opt->toDo.UserCalled;
+
+  memset(&gangImg, 0, sizeof(gangImg));
+  memset(&gangPwd, 0, sizeof(gangPwd));
+  if (!fullFlow &&
+      (((opt->passwdFile != NULL) && (gangLoad(opt->passwdFile, opt, BSL_TXPWORD, &gangPwd) != ERR_NONE)) ||
+       ((opt->filename != NULL) && (gangLoad(opt->filename, opt, BSL_TXBLK, &gangImg) != ERR_NONE))))
+  {
+    gangFree(&gangPwd);
+    return(1);
+  }
+
+  InitializeCriticalSection(&gangLock);
+  bslLoopInit(&loop);
+  startTime= GetTickCount();
+
+  /* Ports are opened in the order given, then all run at once: */
+  for (i= 0; i < gangPorts; i++)
+  {
+    GANG_PORT *p= &gangPort[i];
+
+    memset(p, 0, sizeof(GANG_PORT));
+    strcpy(p->name, gangPortName[i]);
+    portOpt= *opt;
+    if (opt->traceFile != NULL) portOpt.traceFile= gangTraceName(p, opt->traceFile);
+    if ((p->error= bslOpenCom(&p->s, p->name, &portOpt)) != ERR_NONE)
+    {
+      continue;
+    }
+    p->opened= TRUE;
+    p->error= ERR_COM;
+    p->s.print= gangPrint;
+    p->s.progress= gangProgress;
+    p->s.user= p;
+    if (fullFlow || (bslLoopAdd(&loop, &p->s) != ERR_NONE))
+    {
+      p->fullFlow= TRUE;
+      continue;
+    }
+    p->step= GS_RESET;
+    gangNext(&p->s, ERR_NONE, p);
+  }
+
+  bslLoopRun(&loop);
+  gangRunThreads();
+
+  printf("Port     BSL   Device  Result\n");
+  for (i= 0; i < gangPorts; i++)
+  {
+    GANG_PORT *p= &gangPort[i];
+
+    printf("%-8s ", &p->name[4]);
+    if (p->s.bslVer != 0)
+      printf("%X.%02X  %02X%02X    ", p->s.bslVer >> 8, p->s.bslVer & 0xff,
+             p->s.devTypeHi, p->s.devTypeLo);
+    else
+      printf("-     -       ");
+    if (p->error == ERR_NONE)
+    {
+      ok++;
+      printf("OK, %lu bytes programmed\n", p->bytes);
+    }
+    else
+      printf("ERROR: %s\n", gangErrorText(p->error));
+  }
+  printf("%d of %d devices completed.", ok, gangPorts);
+  printf(" Over all: %.1f sec\n", (float)(GetTickCount()-startTime)/1000.0);
+
+  if (opt->metrics)
+  {
+    BSL_SESSION *s[GANG_MAX_PORTS];
+    int n= 0;
+
+    for (i= 0; i < gangPorts; i++)
+    {
+      if (!gangPort[i].opened) continue;
+      mxPrint(&gangPort[i].s);
+      s[n++]= &gangPort[i].s;
+    }
+    if ((opt->metricsFile != NULL) && !mxWrite(s, n, opt->metricsFile))
+    {
+      printf("ERROR: Can't write \"%s\"!\n", opt->metricsFile);
+    }
+  }
+
+  /* Recordings (-d), wire traces of the ports which failed: */
+  for (i= 0; i < gangPorts; i++)
+  {
+    GANG_PORT *p= &gangPort[i];
+
+    if (!p->opened) continue;
+    if (opt->traceFile != NULL)
+    {
+      if (wtFile(&p->s) != NULL)
+        printf("Session of %s recorded in %s.\n", &p->name[4], p->traceName);
+      else
+        printf("ERROR: Can't write \"%s\"!\n", p->traceName);
+    }
+    else if (p->error != ERR_NONE)
+    {
+      if (wtWrite(&p->s, gangTraceName(p, WT_DEFAULT_FILE)))
+        printf("Wire trace of %s written to %s.\n", &p->name[4], p->traceName);
+      else
+        printf("ERROR: Can't write \"%s\"!\n", p->traceName);
+    }
+  }
+
+  for (i= 0; i < gangPorts; i++)
+  {
+    if (gangPort[i].opened) bslClose(&gangPort[i].s);
+  }
+  DeleteCriticalSection(&gangLock);
+  gangFree(&gangImg);
+  gangFree(&gangPwd);
+
+  return((ok == gangPorts) ? 0 : 1);
+} /* gangRun */
+
+/* EOF */
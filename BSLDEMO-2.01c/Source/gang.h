@@ -0,0 +1,43 @@
+/****************************************************************
+*
+* Project: MSP430 Bootstrap Loader Demonstration Program
+*
+* File:    GANG.H
+*
+* Gang programming: with -c given for more than one COM port, the
+* file is programmed into the devices on all of them at once (see
+* GANG.C).  The ports are put into gangPortName[] as -c is parsed.
+*
+****************************************************************/
+
+#ifndef Gang__H
+#define Gang__H
+
+#include "session.h"
+
+/* Max. ports of one run: */
+#define GANG_MAX_PORTS 16
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern char gangPortName[GANG_MAX_PORTS][20];
+extern int gangPorts;
+
+/*-------------------------------------------------------------*/
+int gangRun(const BSL_OPTIONS *opt);
+/* Runs the program flow of BSLDEMO on the gangPorts ports of
+ * gangPortName[] with the options given (toDo.Wait is left to
+ * the caller).
+ * Return == 0: all devices completed it
+ * Return == 1: a device failed, or the file can't be read
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/* EOF */
@@ -0,0 +1,578 @@
+/****************************************************************
+*
+* Project: MSP430 Bootstrap Loader Demonstration Program
+*
+* File:    METRICS.C
+*
+* Measurements of a session (see METRICS.H).
+*
+* All times are kept in counts of QueryPerformanceCounter(), and
+* only converted when shown.  The command running is kept in
+* cur (its phase starts in at[], 0: phase not entered); mxEnd()
+* adds it to the statistics of its type, and to the trace while
+* there is room.
+*
+****************************************************************/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <windows.h>
+
+#include "metrics.h"
+
+/* Commands of the fast loader are counted under cmd + MX_LOADER: */
+#define MX_LOADER  0x40
+#define MX_KEYS    0x80
+
+/* Trace grows by: */
+#define MX_CHUNK   1024
+
+typedef struct
+{
+  DWORD count;
+  DWORD errors;           /* commands failed (all reasons)   */
+  DWORD naks;
+  DWORD timeouts;         /* no reply header, deadline       */
+  DWORD retries;          /* synchronization characters again */
+  DWORD lineErrors;       /* parity, framing, overrun        */
+  DWORD txWire, rxWire;   /* bytes on the wire               */
+  DWORD payload;          /* data bytes carried              */
+  LONGLONG phase[MX_PHASES];
+  LONGLONG total, max;
+  DWORD hist[MX_BUCKETS];
+} MX_STAT;
+
+typedef struct
+{
+  LONGLONG at[MX_PHASES + 1];   /* phase starts, end */
+  unsigned long addr;
+  WORD len;
+  BYTE key;
+  BYTE error;
+} MX_EVENT;
+
+struct BSL_METRICS
+{
+  /* Transport measured: */
+  const BSL_TRANSPORT *transport;
+  void *port;
+  DWORD txWire, rxWire;   /* all bytes of the session */
+  DWORD lineErrors;
+
+  LONGLONG freq;
+  LONGLONG origin;        /* mxStart() */
+  LONGLONG stop;          /* last mxEnd() */
+
+  /* Command running: */
+  BOOL active;
+  int phase;
+  MX_EVENT cur;
+  DWORD txStart, rxStart;
+
+  MX_STAT stat[MX_KEYS];
+
+  MX_EVENT *event;
+  DWORD events, size, dropped;
+};
+
+static const char *phaseName[MX_PHASES]= { "host", "sync", "tx", "wait", "rx" };
+
+/*-------------------------------------------------------------*/
+static LONGLONG mxNow(void)
+{
+  LARGE_INTEGER t;
+
+  QueryPerformanceCounter(&t);
+  return(t.QuadPart);
+}
+
+/*-------------------------------------------------------------*/
+static double mxMs(BSL_METRICS *m, LONGLONG t)
+{
+  return((double)t * 1000.0 / (double)m->freq);
+}
+
+/*-------------------------------------------------------------*/
+static void mxKeyText(int key, char *text)
+{
+  const char *name= bslCmdName((BYTE)(key & (MX_LOADER - 1)));
+
+  if (name != NULL)
+    sprintf(text, "%s%s", (key & MX_LOADER) ? "FL " : "", name);
+  else
+    sprintf(text, "%s0x%02X", (key & MX_LOADER) ? "FL " : "CMD ", key & (MX_LOADER - 1));
+}
+
+/***************************************************************
+ * Transport which counts the bytes (port: BSL_METRICS):
+ */
+
+/*-------------------------------------------------------------*/
+static int mxSetLine(void *port, DWORD baudrate, int lines)
+{
+  BSL_METRICS *m= (BSL_METRICS*)port;
+
+  return(m->transport->setLine(m->port, baudrate, lines));
+}
+
+/*-------------------------------------------------------------*/
+static DWORD mxWriteBytes(void *port, const BYTE data[], DWORD count)
+{
+  BSL_METRICS *m= (BSL_METRICS*)port;
+  DWORD n= m->transport->write(m->port, data, count);
+
+  m->txWire+= n;
+  return(n);
+}
+
+/*-------------------------------------------------------------*/
+static DWORD mxWaitForData(void *port, DWORD count, DWORD timeout)
+{
+  BSL_METRICS *m= (BSL_METRICS*)port;
+
+  return(m->transport->waitForData(m->port, count, timeout));
+}
+
+/*-------------------------------------------------------------*/
+static DWORD mxRead(void *port, BYTE data[], DWORD count)
+{
+  BSL_METRICS *m= (BSL_METRICS*)port;
+  DWORD n= m->transport->read(m->port, data, count);
+
+  m->rxWire+= n;
+  return(n);
+}
+
+/*-------------------------------------------------------------*/
+static void mxPurge(void *port)
+{
+  BSL_METRICS *m= (BSL_METRICS*)port;
+
+  m->transport->purge(m->port);
+}
+
+/*-------------------------------------------------------------*/
+static int mxClose(void *port)
+{
+  BSL_METRICS *m= (BSL_METRICS*)port;
+
+  return(m->transport->close(m->port));
+}
+
+/*-------------------------------------------------------------*/
+static DWORD mxTicks(void *port)
+{
+  BSL_METRICS *m= (BSL_METRICS*)port;
+
+  return(m->transport->ticks(m->port));
+}
+
+/*-------------------------------------------------------------*/
+static void mxDelay(void *port, DWORD time)
+{
+  BSL_METRICS *m= (BSL_METRICS*)port;
+
+  m->transport->delay(m->port, time);
+}
+
+/*-------------------------------------------------------------*/
+static HANDLE mxRxEvent(void *port)
+{
+  BSL_METRICS *m= (BSL_METRICS*)port;
+
+  if (m->transport->rxEvent == NULL) return(NULL);
+  return(m->transport->rxEvent(m->port));
+}
+
+/*-------------------------------------------------------------*/
+static DWORD mxLineErrors(void *port)
+{
+  BSL_METRICS *m= (BSL_METRICS*)port;
+
+  if (m->transport->lineErrors == NULL) return(0);
+  return(m->transport->lineErrors(m->port));
+}
+
+static const BSL_TRANSPORT mxTransport=
+{
+  mxSetLine, mxWriteBytes, mxWaitForData, mxRead,
+  mxPurge, mxClose, mxTicks, mxDelay, mxRxEvent, mxLineErrors
+};
+
+/***************************************************************
+ * Measurement:
+ */
+
+/*-------------------------------------------------------------*/
+int mxStart(BSL_SESSION *s)
+{
+  BSL_METRICS *m;
+  LARGE_INTEGER freq;
+
+  if ((s->transport == NULL) || (s->metrics != NULL)) return(ERR_COM);
+  if (!QueryPerformanceFrequency(&freq) || (freq.QuadPart == 0))
+  {
+    return(ERR_COM);
+  }
+  if ((m= (BSL_METRICS*)calloc(1, sizeof(BSL_METRICS))) == NULL)
+  {
+    return(ERR_COM);
+  }
+  m->freq= freq.QuadPart;
+  m->origin= m->stop= mxNow();
+  m->transport= s->transport;
+  m->port= s->port;
+  if (m->transport->lineErrors != NULL)
+  {
+    m->transport->lineErrors(m->port); /* (errors before: not ours) */
+  }
+  s->transport= &mxTransport;
+  s->port= m;
+  s->metrics= m;
+  return(ERR_NONE);
+}
+
+/*-------------------------------------------------------------*/
+void mxDone(BSL_SESSION *s)
+{
+  BSL_METRICS *m= s->metrics;
+
+  if (m == NULL) return;
+  if (s->transport == &mxTransport)
+  {
+    s->transport= m->transport;
+    if (s->port != NULL) s->port= m->port; /* (NULL: closed) */
+  }
+  free(m->event);
+  free(m);
+  s->metrics= NULL;
+}
+
+/*-------------------------------------------------------------*/
+void mxCommand(BSL_SESSION *s, BYTE cmd, unsigned long addr, WORD len)
+{
+  BSL_METRICS *m= s->metrics;
+
+  if (m == NULL) return;
+  memset(&m->cur, 0, sizeof(MX_EVENT));
+  m->cur.key= (BYTE)((cmd & (MX_LOADER - 1)) | (s->flActive ? MX_LOADER : 0));
+  m->cur.addr= addr;
+  m->cur.len= len;
+  m->cur.at[MX_HOST]= mxNow();
+  m->phase= MX_HOST;
+  m->active= TRUE;
+  m->txStart= m->txWire;
+  m->rxStart= m->rxWire;
+  m->lineErrors+= mxLineErrors(m);
+}
+
+/*-------------------------------------------------------------*/
+void mxPhase(BSL_SESSION *s, int phase)
+{
+  BSL_METRICS *m= s->metrics;
+  LONGLONG now;
+
+  if ((m == NULL) || !m->active || (m->phase == phase)) return;
+  now= mxNow();
+  m->stat[m->cur.key].phase[m->phase]+= now - m->cur.at[m->phase];
+  m->cur.at[phase]= now;
+  m->phase= phase;
+}
+
+/*-------------------------------------------------------------*/
+void mxRetry(BSL_SESSION *s)
+{
+  BSL_METRICS *m= s->metrics;
+
+  if ((m == NULL) || !m->active) return;
+  m->stat[m->cur.key].retries++;
+}
+
+/*-------------------------------------------------------------*/
+int mxEnd(BSL_SESSION *s, int error)
+{
+  BSL_METRICS *m= s->metrics;
+  MX_STAT *st;
+  MX_EVENT *e;
+  LONGLONG now, t;
+  int cmd, b;
+  DWORD n;
+
+  if ((m == NULL) || !m->active) return(error);
+  now= mxNow();
+  m->active= FALSE;
+  m->stop= now;
+  m->cur.at[MX_PHASES]= now;
+  m->cur.error= (BYTE)error;
+
+  st= &m->stat[m->cur.key];
+  st->phase[m->phase]+= now - m->cur.at[m->phase];
+  st->count++;
+  t= now - m->cur.at[MX_HOST];
+  st->total+= t;
+  if (t > st->max) st->max= t;
+  for (b= 0; (b < MX_BUCKETS - 1) && (mxMs(m, t) >= 0.25 * (1 << b)); b++)
+    ;
+  st->hist[b]++;
+
+  if (error != ERR_NONE) st->errors++;
+  if (error == ERR_RX_NAK) st->naks++;
+  if ((error == ERR_RX_HDR_TIMEOUT) || (error == ERR_DEADLINE)) st->timeouts++;
+  n= mxLineErrors(m);
+  st->lineErrors+= n;
+  m->lineErrors+= n;
+  st->txWire+= m->txWire - m->txStart;
+  st->rxWire+= m->rxWire - m->rxStart;
+
+  cmd= m->cur.key & (MX_LOADER - 1);
+  if ((cmd == BSL_TXBLK) || (cmd == BSL_TXPWORD))
+    st->payload+= m->cur.len;
+  else if ((cmd == BSL_RXBLK) && (error == ERR_NONE))
+    st->payload+= s->rxFrame[2];
+
+  /* Trace: */
+  if (m->events == m->size)
+  {
+    e= NULL;
+    if (m->size < MX_MAX_EVENTS)
+    {
+      e= (MX_EVENT*)realloc(m->event, (m->size + MX_CHUNK) * sizeof(MX_EVENT));
+    }
+    if (e == NULL)
+    {
+      m->dropped++;
+      return(error);
+    }
+    m->event= e;
+    m->size+= MX_CHUNK;
+  }
+  m->event[m->events++]= m->cur;
+  return(error);
+}
+
+/***************************************************************
+ * Output:
+ */
+
+/*-------------------------------------------------------------*/
+static void mxTotals(BSL_METRICS *m, MX_STAT *sum)
+/* Sums up the statistics of all command types. */
+{
+  int k, p, b;
+
+  memset(sum, 0, sizeof(MX_STAT));
+  for (k= 0; k < MX_KEYS; k++)
+  {
+    MX_STAT *st= &m->stat[k];
+
+    sum->count+= st->count;
+    sum->errors+= st->errors;
+    sum->naks+= st->naks;
+    sum->timeouts+= st->timeouts;
+    sum->retries+= st->retries;
+    sum->payload+= st->payload;
+    sum->total+= st->total;
+    if (st->max > sum->max) sum->max= st->max;
+    for (p= 0; p < MX_PHASES; p++) sum->phase[p]+= st->phase[p];
+    for (b= 0; b < MX_BUCKETS; b++) sum->hist[b]+= st->hist[b];
+  }
+  /* (bytes and receive errors outside of the commands as well) */
+  sum->txWire= m->txWire;
+  sum->rxWire= m->rxWire;
+  sum->lineErrors= m->lineErrors;
+}
+
+/*-------------------------------------------------------------*/
+void mxPrint(BSL_SESSION *s)
+{
+  BSL_METRICS *m= s->metrics;
+  MX_STAT sum;
+  char name[16];
+  int k, p, b;
+
+  if (m == NULL) return;
+
+  bslPrintf(s, "Time (ms)    Count    Host    Sync      Tx    Wait      Rx     Avg     Max\n");
+  for (k= 0; k < MX_KEYS; k++)
+  {
+    MX_STAT *st= &m->stat[k];
+
+    if (st->count == 0) continue;
+    mxKeyText(k, name);
+    bslPrintf(s, "%-12s%6lu", name, (unsigned long)st->count);
+    for (p= 0; p < MX_PHASES; p++)
+    {
+      bslPrintf(s, " %7.1f", mxMs(m, st->phase[p]));
+    }
+    bslPrintf(s, " %7.2f %7.1f\n", mxMs(m, st->total) / st->count, mxMs(m, st->max));
+  }
+
+  bslPrintf(s, "Command       Tx(B)   Rx(B) Data(B)  Eff%% Retry  NAK  T/O  Line  Err\n");
+  for (k= 0; k < MX_KEYS; k++)
+  {
+    MX_STAT *st= &m->stat[k];
+
+    if (st->count == 0) continue;
+    mxKeyText(k, name);
+    bslPrintf(s, "%-12s%7lu %7lu %7lu %5.0f %5lu %4lu %4lu %5lu %4lu\n", name,
+              (unsigned long)st->txWire, (unsigned long)st->rxWire,
+              (unsigned long)st->payload,
+              (st->txWire + st->rxWire > 0) ?
+                100.0 * st->payload / (st->txWire + st->rxWire) : 0.0,
+              (unsigned long)st->retries, (unsigned long)st->naks,
+              (unsigned long)st->timeouts, (unsigned long)st->lineErrors,
+              (unsigned long)st->errors);
+  }
+
+  bslPrintf(s, "Latency (ms) <.25  <.5   <1   <2   <4   <8  <16  <32  <64 <128 <256 more\n");
+  for (k= 0; k < MX_KEYS; k++)
+  {
+    MX_STAT *st= &m->stat[k];
+
+    if (st->count == 0) continue;
+    mxKeyText(k, name);
+    bslPrintf(s, "%-12s", name);
+    for (b= 0; b < MX_BUCKETS; b++)
+    {
+      bslPrintf(s, "%5lu", (unsigned long)st->hist[b]);
+    }
+    bslPrintf(s, "\n");
+  }
+
+  mxTotals(m, &sum);
+  bslPrintf(s, "%lu commands took %.1f of %.1f ms, %lu of %lu bytes on the wire\n"
+               "were data, %lu errors, %lu line errors.\n",
+            (unsigned long)sum.count, mxMs(m, sum.total),
+            mxMs(m, m->stop - m->origin), (unsigned long)sum.payload,
+            (unsigned long)(sum.txWire + sum.rxWire),
+            (unsigned long)sum.errors, (unsigned long)sum.lineErrors);
+}
+
+/*-------------------------------------------------------------*/
+static void mxWriteStat(FILE *f, BSL_METRICS *m, MX_STAT *st)
+/* Members of a statistics object (JSON). */
+{
+  int p, b;
+
+  fprintf(f, "\"count\": %lu, \"errors\": %lu, \"naks\": %lu, "
+             "\"timeouts\": %lu, \"retries\": %lu, \"lineErrors\": %lu,\n",
+          (unsigned long)st->count, (unsigned long)st->errors,
+          (unsigned long)st->naks, (unsigned long)st->timeouts,
+          (unsigned long)st->retries, (unsigned long)st->lineErrors);
+  fprintf(f, "      \"txWire\": %lu, \"rxWire\": %lu, \"payload\": %lu,\n",
+          (unsigned long)st->txWire, (unsigned long)st->rxWire,
+          (unsigned long)st->payload);
+  fprintf(f, "      \"us\": {");
+  for (p= 0; p < MX_PHASES; p++)
+  {
+    fprintf(f, "\"%s\": %.1f, ", phaseName[p], mxMs(m, st->phase[p]) * 1000.0);
+  }
+  fprintf(f, "\"total\": %.1f, \"max\": %.1f},\n",
+          mxMs(m, st->total) * 1000.0, mxMs(m, st->max) * 1000.0);
+  fprintf(f, "      \"histogram\": [");
+  for (b= 0; b < MX_BUCKETS; b++)
+  {
+    fprintf(f, "%s%lu", (b > 0) ? ", " : "", (unsigned long)st->hist[b]);
+  }
+  fprintf(f, "]");
+}
+
+/*-------------------------------------------------------------*/
+BOOL mxWrite(BSL_SESSION *s[], int count, char *filename)
+{
+  FILE *f;
+  LONGLONG origin= 0;
+  BOOL first= TRUE;
+  MX_STAT sum;
+  char name[16];
+  int i, k, p, q, b;
+  DWORD e;
+
+  if ((f= fopen(filename, "w")) == NULL) return(FALSE);
+
+  /* One time line for all sessions: */
+  for (i= 0; i < count; i++)
+  {
+    if ((s[i]->metrics != NULL) &&
+        ((origin == 0) || (s[i]->metrics->origin < origin)))
+    {
+      origin= s[i]->metrics->origin;
+    }
+  }
+
+  fprintf(f, "{\n\"summary\": {\n  \"histogramMs\": [");
+  for (b= 0; b < MX_BUCKETS - 1; b++)
+  {
+    fprintf(f, "%s%g", (b > 0) ? ", " : "", 0.25 * (1 << b));
+  }
+  fprintf(f, "],\n  \"sessions\": [");
+  for (i= 0; i < count; i++)
+  {
+    BSL_METRICS *m= s[i]->metrics;
+
+    if (m == NULL) continue;
+    mxTotals(m, &sum);
+    fprintf(f, "%s\n  {\"tid\": %d, \"ms\": %.3f, \"dropped\": %lu,\n    \"total\": {",
+            first ? "" : ",", i + 1, mxMs(m, m->stop - m->origin),
+            (unsigned long)m->dropped);
+    first= FALSE;
+    mxWriteStat(f, m, &sum);
+    fprintf(f, "},\n    \"commands\": [");
+    for (k= 0, b= 0; k < MX_KEYS; k++)
+    {
+      if (m->stat[k].count == 0) continue;
+      mxKeyText(k, name);
+      fprintf(f, "%s\n    {\"name\": \"%s\", \"cmd\": %d, \"loader\": %s,\n      ",
+              (b++ > 0) ? "," : "", name, k & (MX_LOADER - 1),
+              (k & MX_LOADER) ? "true" : "false");
+      mxWriteStat(f, m, &m->stat[k]);
+      fprintf(f, "}");
+    }
+    fprintf(f, "]}");
+  }
+  fprintf(f, "]\n},\n\"displayTimeUnit\": \"ms\",\n\"traceEvents\": [");
+
+  /* Complete events ("X"): a command, and its phases below it: */
+  first= TRUE;
+  for (i= 0; i < count; i++)
+  {
+    BSL_METRICS *m= s[i]->metrics;
+
+    if (m == NULL) continue;
+    for (e= 0; e < m->events; e++)
+    {
+      MX_EVENT *ev= &m->event[e];
+
+      mxKeyText(ev->key, name);
+      fprintf(f, "%s\n{\"name\": \"%s\", \"cat\": \"command\", \"ph\": \"X\", "
+                 "\"pid\": 1, \"tid\": %d, \"ts\": %.1f, \"dur\": %.1f, "
+                 "\"args\": {\"addr\": \"0x%lX\", \"len\": %u, \"error\": %d}}",
+              first ? "" : ",", name, i + 1,
+              mxMs(m, ev->at[MX_HOST] - origin) * 1000.0,
+              mxMs(m, ev->at[MX_PHASES] - ev->at[MX_HOST]) * 1000.0,
+              ev->addr, ev->len, ev->error);
+      first= FALSE;
+      for (p= 0; p < MX_PHASES; p++)
+      { /* (a phase ends where the next one entered starts) */
+        if (ev->at[p] == 0) continue;
+        for (q= p + 1; ev->at[q] == 0; q++)
+          ;
+        fprintf(f, ",\n{\"name\": \"%s\", \"cat\": \"phase\", \"ph\": \"X\", "
+                   "\"pid\": 1, \"tid\": %d, \"ts\": %.1f, \"dur\": %.1f}",
+                phaseName[p], i + 1, mxMs(m, ev->at[p] - origin) * 1000.0,
+                mxMs(m, ev->at[q] - ev->at[p]) * 1000.0);
+      }
+    }
+  }
+  fprintf(f, "\n]\n}\n");
+
+  if (ferror(f) != 0)
+  {
+    fclose(f);
+    return(FALSE);
+  }
+  return(fclose(f) == 0);
+}
+
+/* EOF */
@@ -0,0 +1,106 @@
+/****************************************************************
+*
+* Project: MSP430 Bootstrap Loader Demonstration Program
+*
+* File:    METRICS.H
+*
+* Measurements of a session (-t): the time of each command, split
+* into its phases, taken with QueryPerformanceCounter(), the bytes
+* on the wire against the data they carried, and the retries, NAKs,
+* timeouts and receive errors (parity, framing, overrun), all per
+* command type.  The ROM BSL and the fast loader are counted apart.
+*
+*   MX_HOST   command called until the first byte goes out (frame
+*             built, compressed by the fast loader)
+*   MX_SYNC   0x80 sent until DATA_ACK (with the retries)
+*   MX_TX     frame written
+*   MX_WAIT   until the reply header (the device executes)
+*   MX_RX     rest of a data frame
+*
+* mxStart() puts a transport of its own in front of the session's,
+* which counts the bytes.  The commands mark their phases with the
+* functions below, which return at once while no measurement runs,
+* so they cost nothing without -t.
+*
+* mxPrint() shows tables of the times, bytes and errors, and a
+* histogram of the command latencies.  mxWrite() writes the same
+* as JSON, with a trace of all commands and their phases which
+* chrome://tracing (or Perfetto) shows as a timeline, one row per
+* session.
+*
+****************************************************************/
+
+#ifndef Metrics__H
+#define Metrics__H
+
+#include "session.h"
+
+/* Phases of a command: */
+#define MX_HOST    0
+#define MX_SYNC    1
+#define MX_TX      2
+#define MX_WAIT    3
+#define MX_RX      4
+#define MX_PHASES  5
+
+/* Latency histogram: < 0.25 ms, < 0.5 ms, ... < 256 ms, more: */
+#define MX_BUCKETS 12
+
+/* Commands kept for the trace (the statistics are complete): */
+#define MX_MAX_EVENTS 16384
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-------------------------------------------------------------*/
+int mxStart(BSL_SESSION *s);
+/* Starts the measurement of the session (bslOpen() with -t).
+ * Return == 0: OK
+ */
+
+/*-------------------------------------------------------------*/
+void mxDone(BSL_SESSION *s);
+/* Removes the transport of mxStart() and frees the measurement.
+ */
+
+/*-------------------------------------------------------------*/
+void mxCommand(BSL_SESSION *s, BYTE cmd, unsigned long addr, WORD len);
+/* A command starts (in phase MX_HOST).
+ */
+
+/*-------------------------------------------------------------*/
+void mxPhase(BSL_SESSION *s, int phase);
+/* The command goes to the given phase (ignored between commands).
+ */
+
+/*-------------------------------------------------------------*/
+void mxRetry(BSL_SESSION *s);
+/* The synchronization character is sent again.
+ */
+
+/*-------------------------------------------------------------*/
+int mxEnd(BSL_SESSION *s, int error);
+/* The command has completed with the given error, which is
+ * returned.
+ */
+
+/*-------------------------------------------------------------*/
+void mxPrint(BSL_SESSION *s);
+/* Shows the summary of the session on its output.
+ */
+
+/*-------------------------------------------------------------*/
+BOOL mxWrite(BSL_SESSION *s[], int count, char *filename);
+/* Writes the summary and the trace of the sessions given into a
+ * JSON file.
+ * Return == FALSE: Error!
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/* EOF */
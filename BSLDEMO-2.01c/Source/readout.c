@@ -0,0 +1,167 @@
+/****************************************************************
+*
+* Project: MSP430 Bootstrap Loader Demonstration Program
+*
+* File:    READOUT.C
+*
+* Output file of the memory readout (see READOUT.H).  All state
+* of a file is kept in its RD_FILE (the TI TXT functions of
+* TI_TXT_FILES.C keep theirs in globals, and take words only).
+*
+****************************************************************/
+
+#include <string.h>
+#include <stdio.h>
+#include <windows.h>
+
+#include "readout.h"
+
+/*-------------------------------------------------------------*/
+int rdFormat(char *filename)
+{
+  char *ext= strrchr(filename, '.');
+
+  if ((ext == NULL) || (strpbrk(ext, "\\/") != NULL)) return(RD_TITXT);
+  if (stricmp(ext, ".bin") == 0) return(RD_BIN);
+  if ((stricmp(ext, ".hex") == 0) || (stricmp(ext, ".ihex") == 0)) return(RD_IHEX);
+  return(RD_TITXT);
+}
+
+/*-------------------------------------------------------------*/
+static void rdHexRecord(RD_FILE *r, BYTE type, WORD addr, BYTE data[], int len)
+/* Writes one Intel HEX record. */
+{
+  BYTE sum= (BYTE)(len + (addr >> 8) + addr + type);
+  int i;
+
+  fprintf(r->f, ":%02X%04X%02X", len, addr, type);
+  for (i= 0; i < len; i++)
+  {
+    fprintf(r->f, "%02X", data[i]);
+    sum+= data[i];
+  }
+  fprintf(r->f, "%02X\n", (BYTE)(0x100 - sum));
+}
+
+/*-------------------------------------------------------------*/
+static void rdHexFlush(RD_FILE *r)
+/* Writes the data record collected (with a record 04 before it
+ * if the upper 16 bits of the address have changed).
+ */
+{
+  BYTE upper[2];
+
+  if (r->recLen == 0) return;
+  if ((r->recAddr >> 16) != r->upper)
+  {
+    r->upper= r->recAddr >> 16;
+    upper[0]= (BYTE)(r->upper >> 8);
+    upper[1]= (BYTE)(r->upper);
+    rdHexRecord(r, 0x04, 0, upper, 2);
+  }
+  rdHexRecord(r, 0x00, (WORD)r->recAddr, r->rec, r->recLen);
+  r->recLen= 0;
+}
+
+/*-------------------------------------------------------------*/
+BOOL rdOpen(RD_FILE *r, char *filename)
+{
+  memset(r, 0, sizeof(RD_FILE));
+  r->format= rdFormat(filename);
+  r->f= fopen(filename, (r->format == RD_BIN) ? "wb" : "w");
+  return(r->f != NULL);
+}
+
+/*-------------------------------------------------------------*/
+BOOL rdWrite(RD_FILE *r, unsigned long addr, BYTE data[], WORD len)
+{
+  unsigned long end= addr + len;
+  WORD i;
+
+  switch (r->format)
+  {
+    case RD_BIN:
+      /* (gaps are filled with 0xFF) */
+      while (r->started && (r->next < addr))
+      {
+        fputc(0xFF, r->f);
+        r->next++;
+      }
+      fwrite(data, 1, len, r->f);
+      break;
+
+    case RD_IHEX:
+      for (i= 0; i < len; i++, addr++)
+      {
+        if ((r->recLen > 0) &&
+            ((addr != r->recAddr + r->recLen) || (r->recLen == 16) ||
+             ((addr & 0xFFFF) == 0)))
+        {
+          rdHexFlush(r);
+        }
+        if (r->recLen == 0) r->recAddr= addr;
+        r->rec[r->recLen++]= data[i];
+      }
+      break;
+
+    default: /* RD_TITXT */
+      if (!r->started || (addr != r->next))
+      {
+        if (r->column > 0) fprintf(r->f, "\n");
+        fprintf(r->f, "@%04lX\n", addr);
+        r->column= 0;
+      }
+      for (i= 0; i < len; i++)
+      {
+        fprintf(r->f, "%02X", data[i]);
+        if (++r->column == 16)
+        {
+          fprintf(r->f, "\n");
+          r->column= 0;
+        }
+        else
+          fprintf(r->f, " ");
+      }
+  }
+  r->started= TRUE;
+  r->next= end;
+  return(ferror(r->f) == 0);
+}
+
+/*-------------------------------------------------------------*/
+BOOL rdSkip(RD_FILE *r, unsigned long addr, unsigned long len)
+{
+  if (r->format == RD_BIN)
+  {
+    r->started= TRUE;
+    r->next= addr + len;
+    for (; len > 0; len--) fputc(0xFF, r->f);
+  }
+  return(ferror(r->f) == 0);
+}
+
+/*-------------------------------------------------------------*/
+BOOL rdClose(RD_FILE *r)
+{
+  BOOL ok;
+
+  if (r->f == NULL) return(FALSE);
+  switch (r->format)
+  {
+    case RD_IHEX:
+      rdHexFlush(r);
+      rdHexRecord(r, 0x01, 0, NULL, 0);
+      break;
+
+    case RD_TITXT:
+      if (r->column > 0) fprintf(r->f, "\n");
+      fprintf(r->f, "q\n");
+      break;
+  }
+  ok= (ferror(r->f) == 0);
+  if (fclose(r->f) != 0) ok= FALSE;
+  r->f= NULL;
+  return(ok);
+}
+
+/* EOF */
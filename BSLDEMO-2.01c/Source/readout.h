@@ -0,0 +1,81 @@
+/****************************************************************
+*
+* Project: MSP430 Bootstrap Loader Demonstration Program
+*
+* File:    READOUT.H
+*
+* Output file of the memory readout (-r): the data is written
+* frame by frame as it is read, so the memory needed does not
+* grow with the length read.  The format is chosen by the
+* extension of the file name:
+*
+*   .bin          binary (the bytes read, nothing else)
+*   .hex, .ihex   Intel HEX (records 04 for addresses > 0xFFFF)
+*   other         TI TXT (as written by TI_TXT_FILES.C)
+*
+****************************************************************/
+
+#ifndef ReadOut__H
+#define ReadOut__H
+
+#include <stdio.h>
+
+/* Formats: */
+#define RD_TITXT  0
+#define RD_IHEX   1
+#define RD_BIN    2
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+  FILE *f;
+  int format;
+  unsigned long next;         /* address after the last byte */
+  BOOL started;
+  int column;                 /* TI TXT: bytes in the line */
+  unsigned long upper;        /* Intel HEX: last record 04 */
+  unsigned long recAddr;      /* Intel HEX: record collected */
+  BYTE rec[16];
+  int recLen;
+} RD_FILE;
+
+/*-------------------------------------------------------------*/
+int rdFormat(char *filename);
+/* Format of the file name (RD_TITXT, RD_IHEX or RD_BIN).
+ */
+
+/*-------------------------------------------------------------*/
+BOOL rdOpen(RD_FILE *r, char *filename);
+/* Creates the output file.
+ * Return == FALSE: Error!
+ */
+
+/*-------------------------------------------------------------*/
+BOOL rdWrite(RD_FILE *r, unsigned long addr, BYTE data[], WORD len);
+/* Writes len bytes read from addr (any length, any address).
+ * Return == FALSE: Error!
+ */
+
+/*-------------------------------------------------------------*/
+BOOL rdSkip(RD_FILE *r, unsigned long addr, unsigned long len);
+/* Range not read (erased): filled with 0xFF in a binary file,
+ * left out of the other formats.
+ * Return == FALSE: Error!
+ */
+
+/*-------------------------------------------------------------*/
+BOOL rdClose(RD_FILE *r);
+/* Ends and closes the output file.
+ * Return == FALSE: Error!
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/* EOF */
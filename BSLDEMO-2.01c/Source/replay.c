@@ -0,0 +1,307 @@
+/****************************************************************
+*
+* Project: MSP430 Bootstrap Loader Demonstration Program
+*
+* File:    REPLAY.C
+*
+* Replay of a recorded session (see REPLAY.H).
+*
+* The records stay in the buffer of the file; pos is the next one
+* not used up, off the bytes of it which are.  The received bytes
+* up to the next sent record are the receive queue; each record of
+* it is due at anchor + scale * (its time - anchorTime), anchor
+* being the start of the host's last write and anchorTime the time
+* of the record sent it was compared with.
+*
+****************************************************************/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <windows.h>
+
+#include "replay.h"
+#include "wiretrace.h"
+
+typedef struct
+{
+  BYTE *buf;              /* records of the file */
+  long size;
+  long pos;               /* next record */
+  DWORD off;              /* bytes of it used */
+  double scale;
+  LONGLONG freq, start;
+  LONGLONG anchor;        /* counter at the last write */
+  DWORD anchorTime;       /* record time (us) it stands for */
+  DWORD recorded;         /* us from the first record to the last */
+
+  /* Results: */
+  DWORD txSame, txOther;  /* bytes written as recorded / not */
+  DWORD rxRead, rxLeft;   /* bytes received read / passed over */
+  DWORD rxAll;
+  long firstOther;        /* record of the first difference */
+} RP_PORT;
+
+#define RP_KIND(p, at) ((p)->buf[at])
+#define RP_LEN(p, at)  ((p)->buf[(at) + 1])
+#define RP_DATA(p, at) (&(p)->buf[(at) + WT_HEADER])
+
+/*-------------------------------------------------------------*/
+static DWORD rpTime(RP_PORT *p, long at)
+{
+  BYTE *d= &p->buf[at + 2];
+
+  return(d[0] | (d[1] << 8) | ((DWORD)d[2] << 16) | ((DWORD)d[3] << 24));
+}
+
+/*-------------------------------------------------------------*/
+static LONGLONG rpNow(void)
+{
+  LARGE_INTEGER now;
+
+  QueryPerformanceCounter(&now);
+  return(now.QuadPart);
+}
+
+/*-------------------------------------------------------------*/
+static long rpNext(RP_PORT *p, long at)
+{
+  return(at + WT_HEADER + RP_LEN(p, at));
+}
+
+/*-------------------------------------------------------------*/
+static LONGLONG rpDue(RP_PORT *p, long at)
+/* Counter at which the record is read. */
+{
+  double us= (double)(long)(rpTime(p, at) - p->anchorTime);
+
+  if (us < 0) us= 0;
+  return(p->anchor + (LONGLONG)(us * p->scale * p->freq / 1000000.0));
+}
+
+/*-------------------------------------------------------------*/
+static DWORD rpReady(RP_PORT *p, LONGLONG *next)
+/* Bytes received which are due; *next: counter when more are
+ * (0: none before the next write).
+ */
+{
+  LONGLONG now= rpNow();
+  DWORD n= 0, off= p->off;
+  long at;
+
+  *next= 0;
+  for (at= p->pos; (at < p->size) && (RP_KIND(p, at) != WT_TX); at= rpNext(p, at))
+  {
+    if (RP_KIND(p, at) != WT_RX) continue;
+    if (rpDue(p, at) > now)
+    {
+      *next= rpDue(p, at);
+      break;
+    }
+    n+= RP_LEN(p, at) - off;
+    off= 0;
+  }
+  return(n);
+}
+
+/***************************************************************
+ * Transport (port: RP_PORT):
+ */
+
+/*-------------------------------------------------------------*/
+static int rpSetLine(void *port, DWORD baudrate, int lines)
+{
+  return(ERR_NONE);
+}
+
+/*-------------------------------------------------------------*/
+static DWORD rpWrite(void *port, const BYTE data[], DWORD count)
+{
+  RP_PORT *p= (RP_PORT*)port;
+  DWORD i= 0;
+  BOOL first= TRUE;
+
+  /* What the recorded host read before, this one has not: */
+  while ((p->pos < p->size) && (RP_KIND(p, p->pos) != WT_TX))
+  {
+    if (RP_KIND(p, p->pos) == WT_RX) p->rxLeft+= RP_LEN(p, p->pos) - p->off;
+    p->pos= rpNext(p, p->pos);
+    p->off= 0;
+  }
+
+  p->anchor= rpNow();
+  while (i < count)
+  {
+    if ((p->pos >= p->size) || (RP_KIND(p, p->pos) != WT_TX)) break;
+    if (first)
+    {
+      p->anchorTime= rpTime(p, p->pos);
+      first= FALSE;
+    }
+    for (; (i < count) && (p->off < RP_LEN(p, p->pos)); i++, p->off++)
+    {
+      if (data[i] == RP_DATA(p, p->pos)[p->off])
+      {
+        p->txSame++;
+        continue;
+      }
+      if (p->txOther++ == 0) p->firstOther= p->pos;
+    }
+    if (p->off == RP_LEN(p, p->pos))
+    { /* (a long write goes on in the next record) */
+      p->pos= rpNext(p, p->pos);
+      p->off= 0;
+    }
+  }
+  if ((i < count) && (p->txOther == 0)) p->firstOther= p->pos;
+  p->txOther+= count - i;   /* (more than recorded) */
+  return(count);
+}
+
+/*-------------------------------------------------------------*/
+static DWORD rpWaitForData(void *port, DWORD count, DWORD timeout)
+{
+  RP_PORT *p= (RP_PORT*)port;
+  LONGLONG end= rpNow() + (LONGLONG)timeout * p->freq / 1000;
+  LONGLONG next;
+  DWORD n;
+
+  while (((n= rpReady(p, &next)) < count) && (timeout > 0))
+  {
+    if ((next == 0) || (next > end)) next= end;
+    if (next <= rpNow()) break;
+    Sleep((DWORD)((next - rpNow()) * 1000 / p->freq));
+  }
+  return(n);
+}
+
+/*-------------------------------------------------------------*/
+static DWORD rpRead(void *port, BYTE data[], DWORD count)
+{
+  RP_PORT *p= (RP_PORT*)port;
+  LONGLONG next;
+  DWORD n= rpReady(p, &next), i= 0, k;
+
+  if (count > n) count= n;
+  while (i < count)
+  {
+    if (RP_KIND(p, p->pos) == WT_RX)
+    {
+      k= RP_LEN(p, p->pos) - p->off;
+      if (k > count - i) k= count - i;
+      memcpy(&data[i], &RP_DATA(p, p->pos)[p->off], k);
+      i+= k;
+      p->off+= k;
+      p->rxRead+= k;
+      if (p->off < RP_LEN(p, p->pos)) break;
+    }
+    p->pos= rpNext(p, p->pos);
+    p->off= 0;
+  }
+  return(i);
+}
+
+/*-------------------------------------------------------------*/
+static void rpPurge(void *port)
+{
+  RP_PORT *p= (RP_PORT*)port;
+  LONGLONG next;
+  DWORD n= rpReady(p, &next);
+  BYTE rest[256];
+
+  /* (bytes due are dropped, as by the serial port) */
+  while (n > 0)
+  {
+    n-= rpRead(p, rest, (n > sizeof(rest)) ? sizeof(rest) : n);
+  }
+}
+
+/*-------------------------------------------------------------*/
+static int rpClose(void *port)
+{
+  RP_PORT *p= (RP_PORT*)port;
+
+  free(p->buf);
+  free(p);
+  return(ERR_NONE);
+}
+
+/*-------------------------------------------------------------*/
+static DWORD rpTicks(void *port)
+{
+  return(GetTickCount());
+}
+
+/*-------------------------------------------------------------*/
+static void rpDelay(void *port, DWORD time)
+{
+  RP_PORT *p= (RP_PORT*)port;
+
+  delay((DWORD)(time * p->scale));
+}
+
+const BSL_TRANSPORT rpTransport=
+{
+  rpSetLine, rpWrite, rpWaitForData, rpRead,
+  rpPurge, rpClose, rpTicks, rpDelay, NULL, NULL
+};
+
+/***************************************************************
+ * Replay:
+ */
+
+/*-------------------------------------------------------------*/
+void *rpOpen(char *filename, double scale, int *error)
+{
+  RP_PORT *p;
+  LARGE_INTEGER freq;
+  long at, last= 0;
+
+  *error= ERR_FILE_OPEN;
+  if (!QueryPerformanceFrequency(&freq) || (freq.QuadPart == 0)) return(NULL);
+  if ((p= (RP_PORT*)calloc(1, sizeof(RP_PORT))) == NULL) return(NULL);
+  if ((p->buf= wtLoad(filename, &p->size)) == NULL)
+  {
+    free(p);
+    return(NULL);
+  }
+  /* (a record cut off at the end is not used) */
+  for (at= 0; (at + WT_HEADER <= p->size) && (rpNext(p, at) <= p->size); at= rpNext(p, at))
+  {
+    if (RP_KIND(p, at) == WT_RX) p->rxAll+= RP_LEN(p, at);
+    last= at;
+  }
+  p->size= at;
+  if (p->size > 0)
+  {
+    p->anchorTime= rpTime(p, 0);
+    p->recorded= rpTime(p, last) - p->anchorTime;
+  }
+  p->scale= (scale < 0) ? 0 : scale;
+  p->freq= freq.QuadPart;
+  p->start= p->anchor= rpNow();
+  p->firstOther= -1;
+  *error= ERR_NONE;
+  return(p);
+}
+
+/*-------------------------------------------------------------*/
+void rpPrint(void *port)
+{
+  RP_PORT *p= (RP_PORT*)port;
+
+  printf("Replay: %lu bytes sent as recorded, %lu not",
+         (unsigned long)p->txSame, (unsigned long)p->txOther);
+  if (p->firstOther >= p->size)
+    printf(" (first after the end)");
+  else if (p->firstOther >= 0)
+    printf(" (first at %.3f ms)", (double)(rpTime(p, p->firstOther) - rpTime(p, 0)) / 1000.0);
+  printf(".\n");
+  printf("        %lu of %lu bytes received read, %lu passed over.\n",
+         (unsigned long)p->rxRead, (unsigned long)p->rxAll, (unsigned long)p->rxLeft);
+  printf("        %.3f s (recorded %.3f s, scale %g).\n",
+         (double)(rpNow() - p->start) / p->freq, (double)p->recorded / 1000000.0,
+         p->scale);
+}
+
+/* EOF */
@@ -0,0 +1,60 @@
+/****************************************************************
+*
+* Project: MSP430 Bootstrap Loader Demonstration Program
+*
+* File:    REPLAY.H
+*
+* Replay of a session recorded with -d (WIRETRACE.H): a transport
+* which plays the part of the device, so a change of the host side
+* can be measured against a library of real sessions without the
+* hardware, and with the timing of the line and the device which
+* was recorded (adapter latency, slow replies, retries).
+*
+* The bytes written by the host are compared with those recorded
+* as sent.  The bytes recorded as received become readable at the
+* time they were read in the recording, counted from the write
+* before them: the host gets each reply as late after its request
+* as the recorded host did, so any time it saves shows in the run
+* time.  All these times, and the delays of the host, are multiplied
+* by the scale given (0: as fast as possible).  Line settings and
+* purges are passed over.
+*
+*   port= rpOpen("load.wtr", 1.0, &error);
+*   bslOpen(&s, &rpTransport, port, &opt);
+*   bslRun(&s);
+*   rpPrint(port);
+*   bslClose(&s);              (frees the port)
+*
+****************************************************************/
+
+#ifndef Replay__H
+#define Replay__H
+
+#include "session.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Transport for the ports opened by rpOpen(): */
+extern const BSL_TRANSPORT rpTransport;
+
+/*-------------------------------------------------------------*/
+void *rpOpen(char *filename, double scale, int *error);
+/* Loads a recording for rpTransport.
+ * Returns NULL (and ERR_FILE_OPEN in *error) if it can't be read.
+ */
+
+/*-------------------------------------------------------------*/
+void rpPrint(void *port);
+/* Shows how far the host has followed the recording, and the time
+ * of the replay against the time recorded.
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/* EOF */
@@ -0,0 +1,1389 @@
+/****************************************************************
+*
+* Project: MSP430 Bootstrap Loader Demonstration Program
+*
+* File:    SESSION.C
+*
+* The program flow of BSLDEMO (moved here from BSLDEMO.C), run on
+* a BSL_SESSION: entry sequence, mass erase, password, patch or
+* loader, erase check, program, verify, read and reset.  All
+* state is kept in the session, and all messages go through
+* bslPrintf(), so BSLDEMO.C and GANG.C (and any other program)
+* can run it on as many ports as they like.
+*
+****************************************************************/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <windows.h>
+
+#include "session.h"
+#include "bslasync.h"
+#include "frameq.h"
+#include "readout.h"
+#include "metrics.h"
+#include "wiretrace.h"
+#include "faults.h"
+
+/*---------------------------------------------------------------
+* Session:
+*---------------------------------------------------------------
+*/
+
+void bslDefaultOptions(BSL_OPTIONS *opt)
+	{
+	memset(opt, 0, sizeof(BSL_OPTIONS));
+
+	/* Default: all actions turned on: */
+	opt->toDo.MassErase = 1;
+	opt->toDo.EraseCheck= 1;
+	opt->toDo.Program = 1;
+	opt->toDo.Verify= 1;
+	opt->toDo.Reset   = 1;
+	opt->toDo.BSLStart= 1;
+
+#ifdef WORKAROUND
+	opt->patchFile= "PATCH.TXT";
+#ifdef NEW_BSL
+	/* Loader started in place of the patch, if found (not with -a): */
+	opt->fastPatchFile= "FastLoader.txt";
+#endif /* NEW_BSL */
+#endif /* WORKAROUND */
+
+	/* Max. bytes sent within one frame if parsing a TI TXT file.
+	* ( >= 16 and == n*16 and <= MAX_DATA_BYTES!)
+	* (FL_MAX_DATA-16 while the fast loader is active)
+	*/
+	opt->maxData= 240;
+
+#ifdef ADD_MERASE_CYCLES
+	opt->meraseCycles= ADD_MERASE_CYCLES;
+#else
+	opt->meraseCycles= 1;
+#endif /* ADD_MERASE_CYCLES */
+	} /* bslDefaultOptions */
+
+int bslOpen(BSL_SESSION *s, const BSL_TRANSPORT *transport, void *port,
+            const BSL_OPTIONS *opt)
+	{
+	memset(s, 0, sizeof(BSL_SESSION));
+	s->opt= *opt;
+	s->maxData= opt->maxData;
+
+#ifdef WORKAROUND
+	/* Show memory access warning, if working with bootstrap
+	* loader version(s) requiring the workaround patch.
+	* Turn warning on by default until we can determine the
+	* actual version of the bootstrap loader.
+	*/
+	s->memAccessWarning= 1;
+#endif /* WORKAROUND */
+
+	if (comInit(s, transport, port, DEFAULT_TIMEOUT, 4) != ERR_NONE)
+		{
+		s->transport= NULL; /* (port closed by comInit()) */
+		}
+	else
+		{
+		if (opt->faults != NULL) fiStart(s); /* (the trace sees them) */
+		wtStart(s);	/* always on: written if an error occurs */
+		if (opt->metrics) mxStart(s);
+		}
+	return(comGetLastError(s));
+	} /* bslOpen */
+
+int bslOpenCom(BSL_SESSION *s, LPCSTR comPortName, const BSL_OPTIONS *opt)
+	{
+	int error= ERR_NONE;
+	void *port= winComOpen(comPortName, &error);
+
+	if (port == NULL)
+		{
+		memset(s, 0, sizeof(BSL_SESSION));
+		return(error);
+		}
+	return(bslOpen(s, &winComTransport, port, opt));
+	} /* bslOpenCom */
+
+int bslNextRun(BSL_SESSION *s, const BSL_OPTIONS *opt)
+	{
+	s->opt= *opt;
+	s->maxData= opt->maxData;
+	s->patchRequired= FALSE;
+	s->patchLoaded= FALSE;
+	s->fastPatch= FALSE;
+	s->byteCtr= 0;
+	s->errData= NULL;
+	s->Time_BSL_starts= s->Time_PRG_starts= s->Time_BSL_stops= 0;
+	s->memAccessWarning= 1;
+
+	if (!s->warm)
+		{
+		flDone(s);
+		return(comInit(s, s->transport, s->port, DEFAULT_TIMEOUT, 4));
+		}
+	return(ERR_NONE);
+	} /* bslNextRun */
+
+void bslClose(BSL_SESSION *s)
+	{
+	flDone(s);
+	bslAsyncDone(s);
+	mxDone(s);
+	wtDone(s);
+	fiDone(s);
+	if (s->transport != NULL)
+		{
+		comDone(s);	/* Release serial communication port.	*/
+					/* After having released the serial port,
+					 * the target is no longer supplied via this port!
+					 */
+		s->transport= NULL;
+		}
+	} /* bslClose */
+
+void bslPrintf(BSL_SESSION *s, const char *format, ...)
+	{
+	char text[512];
+	va_list args;
+
+	va_start(args, format);
+	_vsnprintf(text, sizeof(text) - 1, format, args);
+	va_end(args);
+	text[sizeof(text) - 1]= 0;
+
+	if (s->print != NULL)
+		s->print(s, text);
+	else
+		printf("%s", text);
+	} /* bslPrintf */
+
+/*---------------------------------------------------------------
+* Program Flow:
+*---------------------------------------------------------------
+*/
+
+static int preparePatch(BSL_SESSION *s)
+	{
+	int error= ERR_NONE;
+
+#ifdef WORKAROUND
+	if (s->patchLoaded)
+		{
+		/* Load PC with 0x0220.
+		* This will invoke the patched bootstrap loader subroutines.
+		*/
+		error= bslTxRx(s, BSL_LOADPC,	/* Command: Load PC 	*/
+			0x0220, 	/* Address to load into PC */
+			0,			/* No additional data! 	*/
+			NULL, s->blkin);
+		if (error != ERR_NONE) return(error);
+		s->memAccessWarning= 0; /* Error is removed within workaround code */
+		}
+#endif /* WORKAROUND */
+
+	return(error);
+	}
+
+static void postPatch(BSL_SESSION *s)
+	{
+#ifdef WORKAROUND
+	if (s->patchLoaded)
+		{
+		s->memAccessWarning= 1; /* Turn warning back on. */
+		}
+#endif /* WORKAROUND */
+	}
+
+static int verifyBlk(BSL_SESSION *s, unsigned long addr, WORD len, unsigned action)
+	{
+	int i= 0;
+	int error= ERR_NONE;
+
+	if (s->flActive)
+		{
+		/* The fast loader can't read memory. It verifies each block
+		* while programming, and checks erasure itself:
+		*/
+		if ((action & ACTION_ERASE_CHECK) != 0)
+			action= ACTION_ERASE_CHECK_FAST;
+		action&= ~ACTION_VERIFY;
+		}
+
+	if ((action & (ACTION_VERIFY | ACTION_ERASE_CHECK)) != 0)
+		{
+		error= preparePatch(s);
+		if (error != ERR_NONE) return(error);
+
+        if (s->opt.toDo.MSP430X) {
+			if (error = bslTxRx(s, BSL_MEMOFFSET, 0, (WORD)(addr>>16),	NULL, s->blkin) !=0)  return (error);
+			addr = addr & 0xFFFF;
+		}
+
+		error= bslTxRx(s, BSL_RXBLK, addr, len, NULL, s->blkin);
+
+		postPatch(s);
+
+		if (error != ERR_NONE)
+			{
+			return(error); /* Cancel, if read error */
+			}
+		else
+			{
+			for (i= 0; i < len; i++)
+				{
+				if ((action & ACTION_VERIFY) != 0)
+					{
+					/* Compare data in s->blkout and s->blkin: */
+					if (s->blkin[i] != s->blkout[i])
+						{
+						bslPrintf(s, "Verification failed at %x (%x, %x)\n", addr+i, s->blkin[i], s->blkout[i]);
+						return(ERR_VERIFY_FAILED); /* Verify failed! */
+						}
+					continue;
+					}
+				if ((action & ACTION_ERASE_CHECK) != 0)
+					{
+					/* Compare data in s->blkin with erase pattern: */
+					if (s->blkin[i] != 0xff)
+						{
+						bslPrintf(s, "Erase Check failed at %x (%x)\n", addr+i, s->blkin[i]);
+						return(ERR_ERASE_CHECK_FAILED); /* Erase Check failed! */
+						}
+					continue;
+					} /* if ACTION_ERASE_CHECK */
+				} /* for (i) */
+			} /* else */
+        if (s->opt.toDo.MSP430X)
+			if (error = bslTxRx(s, BSL_MEMOFFSET, 0, (WORD)(0),NULL, s->blkin) !=0)  return (error);
+		} /* if ACTION_VERIFY | ACTION_ERASE_CHECK */
+
+
+	else if ((action & ACTION_ERASE_CHECK_FAST) != 0) /* FRGR 02/01 */
+		{
+		error= preparePatch(s);
+		if (error != ERR_NONE) return(error);
+
+		error= bslTxRx(s, BSL_ECHECK, addr, len, NULL, s->blkin);
+
+		postPatch(s);
+
+		if (error != ERR_NONE)
+			{
+			return(ERR_ERASE_CHECK_FAILED); /* Erase Check failed! */
+			}
+		} /* if ACTION_ERASE_CHECK_FAST */
+
+
+	return(error);
+	}
+
+static int programBlk(BSL_SESSION *s, unsigned long addr, WORD len, unsigned action,
+	BYTE *txFrame)
+/* txFrame: Transmit Block (Password) frame built ahead by FRAMEQ.C
+ * or compiled into a frame file, or NULL */
+	{
+	int i= 0;
+	int error= ERR_NONE;
+
+	if ((action & ACTION_PASSWD) != 0)
+		{
+		if (txFrame != NULL) return(bslTxRxFrame(s, txFrame, s->blkin));
+		return(bslTxRx(s, BSL_TXPWORD, /* Command: Transmit Password*/
+			addr,		/* Address of interupt vectors */
+			len,		/* Number of bytes 			*/
+			s->blkout, s->blkin));
+		} /* if ACTION_PASSWD */
+
+	/* Check, if specified range is erased: */
+	if (action & ACTION_ERASE_CHECK)
+		error= verifyBlk(s, addr, len, action & ACTION_ERASE_CHECK);
+	else if (action & ACTION_ERASE_CHECK_FAST)
+		error= verifyBlk(s, addr, len, action & ACTION_ERASE_CHECK_FAST);
+	if (error != ERR_NONE)
+		{
+		return(error);
+		}
+
+	if ((action & ACTION_PROGRAM) != 0)
+		{
+		error= preparePatch(s);
+		if (error != ERR_NONE) return(error);
+
+		/* Set Offset: */
+		if (s->opt.toDo.MSP430X) error= bslTxRx(s, BSL_MEMOFFSET, 0, (WORD)(addr>>16), s->blkout, s->blkin);
+		if (error != ERR_NONE) return(error);
+
+		/* Program block: */
+		if (txFrame != NULL)
+			error= bslTxRxFrame(s, txFrame, s->blkin);
+		else
+			error= bslTxRx(s, BSL_TXBLK, addr, len, s->blkout, s->blkin);
+
+		postPatch(s);
+
+		if (error != ERR_NONE)
+			{
+			return(error); /* Cancel, if error (ACTION_VERIFY is skipped!) */
+			}
+        if (s->opt.toDo.MSP430X)
+			if (error = bslTxRx(s, BSL_MEMOFFSET, 0, (WORD)(0),NULL, s->blkin) !=0)  return (error);
+
+		} /* if ACTION_PROGRAM */
+
+	/* Verify block: */
+	error= verifyBlk(s, addr, len, action & ACTION_VERIFY);
+	if (error != ERR_NONE)
+		{
+		return(error);
+		}
+
+	return(error);
+	} /* programBlk */
+
+static unsigned int readStartAddrTIText(BSL_SESSION *s, char *filename) /* FRGR */
+	{
+	unsigned int startAddr=0; /* (scanned with %x) */
+	char strdata[128];
+	FILE* infile;
+
+	if ((infile = fopen(filename, "rb")) == 0)
+		{
+		s->errData= filename;
+		return(ERR_FILE_OPEN);
+		}
+
+	/* TXT-File is parsed for first @Addr occurence: */
+	while (TRUE)
+		{
+		/* Read one line: */
+		if (fgets(strdata, 127, infile) == 0)   /* if End Of File                */
+			{
+			break;
+			}
+		if (strdata[0] == '@')				    /* if @ => start address         */
+			{
+			sscanf(&strdata[1], "%x\n", &startAddr);
+			break;
+			}
+		}
+	fclose(infile);
+	return(startAddr);
+	} /* readStartAddrTIText */
+
+static int programTIText(BSL_SESSION *s, char *filename, unsigned action)
+	{
+	int error= ERR_NONE;
+	int i, KBytes, KBytesbefore= -1;
+	FRAME_QUEUE *q;
+	FQ_BLOCK *b;
+	BYTE cmd= 0;
+
+	s->byteCtr= 0;
+
+	/* TXT-File is parsed (and the frames for the ROM BSL are built)
+	 * by a thread of its own, while the blocks before are sent; a
+	 * frame file has them ready:
+	 */
+	if ((action & ACTION_PASSWD) != 0)
+		cmd= BSL_TXPWORD;
+	else if (((action & ACTION_PROGRAM) != 0) && !s->flActive)
+		cmd= BSL_TXBLK;
+	q= fqStart(filename, s->maxData, cmd, &error);
+	if (q == NULL)
+		{
+		s->errData= filename;
+		return(error);
+		}
+
+	while ((b= fqGet(q)) != NULL) /* FRGR */
+		{
+		if ((b->addr + b->len > 0x10000L) && !s->opt.toDo.MSP430X)
+			{
+			error= ERR_READ_RANGE;	/* (would be written below 64K) */
+			break;
+			}
+		memcpy(s->blkout, b->data, b->len);
+		error= programBlk(s, b->addr, b->len, action, b->txFrame);
+		s->byteCtr+= b->len; /* Byte Counter */
+		fqRelease(q);
+
+		if (error != ERR_NONE)
+			{
+			break;	/* FRGR */
+			}
+
+		/* bargraph: indicates succession, actualize only when changed. FRGR */
+		KBytes = (s->byteCtr+512)/1024;
+		if (KBytesbefore != KBytes)
+			{
+			KBytesbefore = KBytes;
+			if (s->progress != NULL)
+				s->progress(s, s->byteCtr);
+			else
+				{
+				bslPrintf(s, "\r%02d KByte ", KBytes);
+				bslPrintf(s, "\xDE");
+				for (i=0;i<KBytes;i+=1) bslPrintf(s, "\xB2");
+				bslPrintf(s, "\xDD");
+				}
+			}
+		}
+	/* clear bargraph, go to left margin */
+	if (s->progress == NULL) bslPrintf(s, "\r \r");
+
+	fqStop(q);
+
+	return(error);
+	} /* programTIText */
+
+static int txPasswd(BSL_SESSION *s, char* passwdFile)
+	{
+	int i;
+
+	if (passwdFile == NULL)
+		{
+		/* Send "standard" password to get access to protected functions. */
+		bslPrintf(s, "Transmit standard password...\n");
+		/* Fill s->blkout with 0xff
+		* (Flash is completely erased, the contents of all Flash cells is 0xff)
+		*/
+		for (i= 0; i < 0x20; i++)
+			{
+			s->blkout[i]= 0xff;
+			}
+		return(bslTxRx(s, BSL_TXPWORD, /* Command: Transmit Password  */
+			0xffe0, 	            /* Address of interupt vectors */
+			0x0020, 	            /* Number of bytes             */
+			s->blkout, s->blkin));
+		}
+	else
+		{
+		/* Send TI TXT file holding interrupt vector data as password: */
+		bslPrintf(s, "Transmit PSW file \"%s\"...\n", passwdFile);
+		return(programTIText(s, passwdFile, ACTION_PASSWD));
+		}
+	} /* txPasswd */
+
+#ifdef NEW_BSL
+static BOOL fastLoaderAllowed(BSL_SESSION *s)
+	{
+	/* The fast loader can only program and check erasure: */
+	return(!(s->opt.toDo.MSP430X || s->opt.toDo.Dump2file || s->opt.toDo.EraseSegment ||
+		(s->opt.toDo.Verify && !s->opt.toDo.Program)));
+	}
+
+static int startFastLoader(BSL_SESSION *s, WORD loaderaddr, WORD startaddr)
+	{
+	/* Writes the parameter block of FastLoader.txt (loaded at loaderaddr)
+	* for the connected family and starts it. If the loader can't be
+	* used with this device or these options, it is not started, and
+	* s->flActive stays FALSE (the ROM BSL is used instead).
+	*/
+	WORD param[4];
+	DWORD BR= 0;
+	BYTE BCSCTL1= 0, DCOCTL= 0, FN= 0;
+	DWORD FTG= 0;		/* lowest flash timing generator clock */
+	int error;
+
+	if (!fastLoaderAllowed(s))
+		{
+		bslPrintf(s, "Fast loader not used with these options.\n");
+		return(ERR_NONE);
+		}
+
+	if ((s->devTypeHi == 0xF1) || (s->devTypeHi == 0x12)) // F1232 / F1xx
+		{
+		/* No calibration data: same DCO setting as -s2 (38400 Baud) */
+		BR = CBR_38400;  BCSCTL1 = 0x87; DCOCTL = 0xE0; FN = 15;
+		FTG = 257000;		/* (min. of the range allowed) */
+		param[2] = 0x0028;	/* P2IN: RXD on P2.2 */
+		param[3] = 0x0004;
+		}
+	else if (s->devTypeHi == 0xF2 || s->devTypeHi == 0x25)
+		{
+		/* Read DCO calibration data from INFOA: */
+		if ((error= bslTxRx(s, BSL_RXBLK, 0x10F8, 8, NULL, s->blkin)) != ERR_NONE)
+			{
+			return(error);
+			}
+		/* 12MHz needs less Vcc than 16MHz, at the same baudrate: */
+		if ((s->blkin[3] != 0xFF) && (s->blkin[2] != 0xFF))		// CALBC1_12MHZ
+			{
+			BR = CBR_115200; BCSCTL1 = s->blkin[3]; DCOCTL = s->blkin[2]; FN = 29;
+			}
+		else if ((s->blkin[1] != 0xFF) && (s->blkin[0] != 0xFF))	// CALBC1_16MHZ
+			{
+			BR = CBR_115200; BCSCTL1 = s->blkin[1]; DCOCTL = s->blkin[0]; FN = 39;
+			}
+		else if ((s->blkin[5] != 0xFF) && (s->blkin[4] != 0xFF))	// CALBC1_8MHZ
+			{
+			BR = CBR_57600;  BCSCTL1 = s->blkin[5]; DCOCTL = s->blkin[4]; FN = 19;
+			}
+		/* 400KHz, less the tolerance of the calibrated DCO: */
+		FTG = 350000;
+		if (s->devTypeHi == 0x25)
+			{
+			param[2] = 0x0020;	/* P1IN: RXD on P1.5 */
+			param[3] = 0x0020;
+			}
+		else
+			{
+			param[2] = 0x0028;	/* P2IN: RXD on P2.2 */
+			param[3] = 0x0004;
+			}
+		}
+
+	if (FN == 0)
+		{
+		bslPrintf(s, "No DCO setting for the fast loader on this device.\n");
+		return(ERR_NONE);
+		}
+
+	if ((s->opt.passwdFile != NULL) && s->opt.toDo.MassErase)
+		{
+		/* The fast loader can't erase, so erase now with the ROM BSL: */
+		bslPrintf(s, "Mass Erase...\n");
+		if ((error= bslTxRx(s, BSL_MERAS, /* Command: Mass Erase 			*/
+			0xff00,	/* Any address within flash memory. */
+			0xa506,	/* Required setting for mass erase! */
+			NULL, s->blkin)) != ERR_NONE)
+			{
+			return(error);
+			}
+		s->opt.passwdFile= NULL; /* No password file required! */
+		if ((error= txPasswd(s, s->opt.passwdFile)) != ERR_NONE)
+			{
+			return(error);
+			}
+		}
+
+	param[0] = (BCSCTL1 << 8) + DCOCTL;
+	param[1] = 0xA540 + FN;			/* FCTL2: FWKEY, MCLK / (FN+1) */
+	memcpy(s->blkout, param, 8);
+	if ((error= bslTxRx(s, BSL_TXBLK, loaderaddr + 4, 8, s->blkout, s->blkin)) != ERR_NONE)
+		{
+		return(error);
+		}
+
+	bslPrintf(s, "Start fast loader at 0x%04X (%d Baud)...\n", startaddr, BR);
+	if ((error= flStart(s, startaddr, BR, FTG)) != ERR_NONE)
+		{
+		return(error);
+		}
+	s->maxData= FL_MAX_DATA - 16;
+
+	return(ERR_NONE);
+	} /* startFastLoader */
+#endif /* NEW_BSL */
+
+
+/* Readout (-r): */
+typedef struct
+	{
+	RD_FILE out;
+	int KBytesbefore;
+	unsigned long bytesRead;
+	} READ_STATE;
+
+/* Max. bytes of one Receive Block frame: */
+#define READ_FRAME	(MAX_DATA_BYTES & ~1)
+
+static void readProgress(BSL_SESSION *s, READ_STATE *r, unsigned long len)
+	{
+	int KBytes;
+
+	s->byteCtr+= len;
+	KBytes = (s->byteCtr+512)/1024;
+	if (r->KBytesbefore != KBytes)
+		{
+		r->KBytesbefore = KBytes;
+		if (s->progress != NULL)
+			s->progress(s, s->byteCtr);
+		else
+			bslPrintf(s, "\r%d KByte (%d%%)", KBytes,
+				(int)(100.0 * s->byteCtr / s->opt.readLen));
+		}
+	} /* readProgress */
+
+static int readRange(BSL_SESSION *s, READ_STATE *r, unsigned long addr, unsigned long len)
+/* Reads addr..addr+len-1 (within one 64 KB page) with Receive Block
+* frames of the max. size, and writes each one to the file.
+*/
+	{
+	unsigned long end= addr + len;
+	WORD skip;
+	int error;
+
+	while (addr < end)
+		{
+		/* An odd address is read from the byte before (bslAlign()): */
+		skip= (WORD)(addr & 1);
+		len= READ_FRAME - skip;
+		if (len > end - addr) len= end - addr;
+
+		if ((error= bslTxRx(s, BSL_RXBLK,	/* Command: Read/Receive Block */
+			addr & 0xFFFF,					/* Start address				*/
+			(WORD)len,						/* No. of bytes to read		*/
+			NULL, s->blkin)) != ERR_NONE)
+			return(error);
+
+		if (!rdWrite(&r->out, addr, &s->blkin[skip], (WORD)len))
+			return(ERR_FILE_WRITE);
+		addr+= len;
+		r->bytesRead+= len;
+		readProgress(s, r, len);
+		}
+	return(ERR_NONE);
+	} /* readRange */
+
+static int readSparse(BSL_SESSION *s, READ_STATE *r, unsigned long addr, unsigned long len)
+/* Sparse readout (-z): a range found erased by one Erase Check
+* command is skipped, other ranges are halved until they fit into
+* one frame, which is read.
+*/
+	{
+	unsigned long first, mid;
+	int error;
+
+	if (len <= 0x8000) /* (length of Erase Check: one word) */
+		{
+		/* Check whole words, the odd bytes at the ends included: */
+		first= addr & ~1;
+		error= bslTxRx(s, BSL_ECHECK, first & 0xFFFF,
+			(WORD)(((addr + len + 1) & ~1) - first), NULL, s->blkin);
+		if (error == ERR_NONE)
+			{
+			readProgress(s, r, len); /* erased */
+			return(rdSkip(&r->out, addr, len) ? ERR_NONE : ERR_FILE_WRITE);
+			}
+		if ((error != ERR_CMD_FAILED) && (error != ERR_RX_NAK))
+			return(error);
+		if (len <= READ_FRAME - (addr & 1))
+			return(readRange(s, r, addr, len));
+		}
+
+	mid= (addr + len/2) & ~1;
+	if ((error= readSparse(s, r, addr, mid - addr)) != ERR_NONE)
+		return(error);
+	return(readSparse(s, r, mid, addr + len - mid));
+	} /* readSparse */
+
+static int readMemory(BSL_SESSION *s)
+/* -r: reads the memory and writes each frame to the output file as
+* it arrives (READOUT.C), so the memory used does not grow with the
+* length.  With -x the memory offset is set for each 64 KB page (no
+* frame crosses the end of a page).
+*/
+	{
+	unsigned long addr= (unsigned long)s->opt.readStart;
+	unsigned long end= addr + (unsigned long)s->opt.readLen;
+	unsigned long len;
+	int error= ERR_NONE;
+	READ_STATE r;
+
+	bslPrintf(s, "Read memory to file: %s Start: 0x%-4lX Length 0x%-4lX%s\n",
+		s->opt.readfilename, (unsigned long)s->opt.readStart, (unsigned long)s->opt.readLen,
+		s->opt.toDo.SparseRead ? " (erased ranges skipped)" : "");
+
+	if (!s->opt.toDo.MSP430X && (end > 0x10000))
+		{
+		return(ERR_READ_RANGE);
+		}
+	if (!rdOpen(&r.out, s->opt.readfilename))
+		{
+		s->errData= s->opt.readfilename;
+		return(ERR_FILE_WRITE);
+		}
+	r.KBytesbefore= -1;
+	r.bytesRead= 0;
+
+	s->byteCtr= 0;
+	while (addr < end)
+		{
+		if (s->opt.toDo.MSP430X)
+			{
+			if ((error= bslTxRx(s, BSL_MEMOFFSET, 0, (WORD)(addr >> 16), NULL, s->blkin)) != ERR_NONE)
+				break;
+			}
+
+		/* Up to the end of the range or of the page: */
+		len= end - addr;
+		if (len > 0x10000 - (addr & 0xFFFF)) len= 0x10000 - (addr & 0xFFFF);
+
+		if (s->opt.toDo.SparseRead)
+			error= readSparse(s, &r, addr, len);
+		else
+			error= readRange(s, &r, addr, len);
+		if (error != ERR_NONE)
+			break;
+		addr+= len;
+		}
+	if (s->progress == NULL) bslPrintf(s, "\r                    \r");
+
+	if (!rdClose(&r.out) && (error == ERR_NONE))
+		{
+		error= ERR_FILE_WRITE;
+		}
+	if (error == ERR_FILE_WRITE)
+		{
+		s->errData= s->opt.readfilename;
+		}
+	if ((error == ERR_NONE) && s->opt.toDo.MSP430X)
+		{
+		error= bslTxRx(s, BSL_MEMOFFSET, 0, (WORD)(0), NULL, s->blkin);
+		}
+	if (error == ERR_NONE)
+		{
+		bslPrintf(s, "%lu bytes read", r.bytesRead);
+		if (s->opt.toDo.SparseRead)
+			bslPrintf(s, ", %lu bytes erased", (unsigned long)s->opt.readLen - r.bytesRead);
+		bslPrintf(s, ".\n");
+		}
+	return(error);
+	} /* readMemory */
+
+static int signOff(BSL_SESSION *s, int error, BOOL passwd)
+	{
+	if (s->opt.toDo.MSP430X) bslTxRx(s, BSL_MEMOFFSET, 0, (WORD)(0), s->blkout, s->blkin);
+
+	if (s->opt.toDo.Reset)
+		{
+		bslReset(s, 0); /* Reset MSP430 and start user program. */
+		}
+
+	/* Still in the ROM BSL (not in a loader), as after the entry sequence: */
+	s->warm= (error == ERR_NONE) && !s->opt.toDo.Reset && !s->flActive &&
+		(s->opt.newBSLFile == NULL) && (s->baudrate == CBR_9600);
+
+	switch (error)
+		{
+		case ERR_NONE:
+			if (s->opt.toDo.Program) bslPrintf(s, "Programming completed.");
+				else if (s->opt.toDo.Verify)bslPrintf(s, "Verification successful.");
+			bslPrintf(s, "Prog/Verify: %.1f sec",(float)(s->Time_BSL_stops-s->Time_PRG_starts)/1000.0);
+			bslPrintf(s, " - Over all: %.1f sec\n",(float)(s->Time_BSL_stops-s->Time_BSL_starts)/1000.0);
+			break;
+		case ERR_BSL_SYNC:
+			bslPrintf(s, "ERROR: Synchronization failed!\n");
+			bslPrintf(s, "Device with boot loader connected?\n");
+			break;
+		case ERR_VERIFY_FAILED:
+			bslPrintf(s, "ERROR: Verification failed!\n");
+			break;
+		case ERR_ERASE_CHECK_FAILED:
+			bslPrintf(s, "ERROR: Erase check failed!\n");
+			break;
+		case ERR_FILE_OPEN:
+			bslPrintf(s, "ERROR: Unable to open input file \"%s\"!\n", (char*)s->errData);
+			break;
+		case ERR_FILE_WRITE:
+			bslPrintf(s, "ERROR: Unable to write output file \"%s\"!\n", (char*)s->errData);
+			break;
+		case ERR_FRAME_FILE:
+			bslPrintf(s, "ERROR: Frame file \"%s\" is broken!\n", (char*)s->errData);
+			break;
+		case ERR_READ_RANGE:
+			bslPrintf(s, "ERROR: Addresses above 0xFFFF can only be used with -x!\n");
+			break;
+		default:
+			if ((passwd) && (error == ERR_RX_NAK))
+				/* If last command == transmit password && Error: */
+				bslPrintf(s, "ERROR: Password not accepted!\n");
+			else
+				bslPrintf(s, "ERROR: Communication Error!\n");
+		} /* switch */
+
+	return(error);
+	} /* signOff */
+
+
+/*-------------------------------------------------------------*/
+int bslRun(BSL_SESSION *s)
+	{
+	const WORD SMALL_RAM_model = 0;
+	const WORD LARGE_RAM_model = 1;
+	const WORD ROM_model = 0x4567;
+	WORD loadedModel = ROM_model;
+	unsigned char infoA[0x40];
+	WORD _addr, _len, _err;
+	int error= ERR_NONE;
+	BOOL warm= s->warm;
+
+	s->warm= FALSE;
+	if (s->opt.toDo.UserCalled)
+	{ }
+	else if (warm)
+	{
+		s->Time_BSL_starts = comTicks(s);	/* (in the BSL already) */
+	}
+    else
+	{
+
+		bslReset(s, s->opt.toDo.BSLStart); /* Invoke the boot loader. */
+		//comDelay(s, 2000);
+		s->Time_BSL_starts = comTicks(s);
+	}
+
+
+	Repeat:
+
+#ifdef NEW_BSL
+
+
+
+if ((s->opt.newBSLFile == NULL) || (s->opt.passwdFile == NULL))
+	{
+	/* If a password file is specified the "new" bootstrap loader can be loaded
+	* (if also specified) before the mass erase is performed. Then the mass
+	* erase can be done using the "new" BSL. Otherwise the mass erase is done
+	* now!
+	*/
+#endif /* NEW_BSL */
+
+
+	if (s->opt.toDo.RestoreInfoA && s->opt.toDo.MassErase)
+		{
+
+		/* Read actual InfoA segment Content. */
+		bslPrintf(s, "Read InfoA Segment...\n");
+		/* Transmit password to get access to protected BSL functions. */
+		if ((error= txPasswd(s, s->opt.passwdFile)) != ERR_NONE)
+			{
+			return(signOff(s, error, TRUE)); /* Password was transmitted! */
+			}
+		if (s->opt.toDo.MSP430X) if (bslTxRx(s, BSL_MEMOFFSET, 0, 0, NULL, s->blkin) !=0)  return (signOff(s, error, TRUE));
+		if ((error= bslTxRx(s, BSL_RXBLK, /* Command: Read/Receive Block 	*/
+			0x010C0,	/* Start address					*/
+			0x40,		/* No. of bytes to read			*/
+			NULL, infoA)) != ERR_NONE)
+			{
+				return(signOff(s, error, FALSE));
+			}
+		}
+	else
+		{
+		s->opt.toDo.RestoreInfoA = 0;
+		}
+
+
+	if (s->opt.toDo.MassErase)
+		{
+		int i;
+		/* Erase the flash memory completely (with mass erase command): */
+		bslPrintf(s, "Mass Erase...\n");
+		for (i= 0; i < s->opt.meraseCycles; i++)
+			{
+			if (i == 1)
+				{
+				bslPrintf(s, "Additional mass erase cycles...\n");
+				}
+			if ((error= bslTxRx(s, BSL_MERAS, /* Command: Mass Erase 			*/
+				0xff00,	/* Any address within flash memory. */
+				0xa506,	/* Required setting for mass erase! */
+				NULL, s->blkin)) != ERR_NONE)
+				{
+				return(signOff(s, error, FALSE));
+				}
+			}
+		s->opt.passwdFile= NULL; /* No password file required! */
+		}
+
+#ifdef NEW_BSL
+	} /* if ((s->opt.newBSLFile == NULL) || (s->opt.passwdFile == NULL)) */
+#endif /* NEW_BSL */
+
+/* Transmit password to get access to protected BSL functions. */
+	if (!(s->opt.toDo.UserCalled) && !warm)
+		if ((error= txPasswd(s, s->opt.passwdFile)) != ERR_NONE)
+			{
+			return(signOff(s, error, TRUE)); /* Password was transmitted! */
+			}
+
+/* Read actual bootstrap loader version (FRGR: complete Chip ID). */
+    if (s->opt.toDo.MSP430X) if (bslTxRx(s, BSL_MEMOFFSET, 0, 0, NULL, s->blkin) !=0)  return (signOff(s, error, TRUE));
+	if ((error= bslTxRx(s, BSL_RXBLK, /* Command: Read/Receive Block 	*/
+		0x0ff0,	/* Start address					*/
+		14,		/* No. of bytes to read			*/
+		NULL, s->blkin)) == ERR_NONE)
+	{
+	memcpy(&s->devTypeHi,&s->blkin[0x00], 1);
+	memcpy(&s->devTypeLo,&s->blkin[0x01], 1);
+	memcpy(&s->devProcHi,&s->blkin[0x02], 1);
+	memcpy(&s->devProcLo,&s->blkin[0x03], 1);
+	memcpy(&s->bslVerHi, &s->blkin[0x0A], 1);
+	memcpy(&s->bslVerLo, &s->blkin[0x0B], 1);
+
+	bslPrintf(s, "BSL version: %X.%02X",	s->bslVerHi,s->bslVerLo);
+	bslPrintf(s, " - Family member: %02X%02X", s->devTypeHi, s->devTypeLo);
+	bslPrintf(s, " - Process: %02X%02X\n",	s->devProcHi, s->devProcLo);
+
+	s->bslVer= (s->bslVerHi << 8) | s->bslVerLo;
+
+	if (s->bslVer < 0x0150) s->bslerrbuf = 0x021E; else s->bslerrbuf = 0x0200;
+
+	if (s->bslVer <= 0x0110)
+		{
+
+#ifdef WORKAROUND
+#ifdef NEW_BSL
+		if ((s->opt.newBSLFile == NULL) && (s->opt.fastPatchFile != NULL) && fastLoaderAllowed(s))
+			{
+			/* The patch only covers the one command after each Load PC.
+			* The fast loader, once started, handles all following frames:
+			*/
+			FILE *fp= fopen(s->opt.fastPatchFile, "r");
+			if (fp != NULL)
+				{
+				fclose(fp);
+				bslPrintf(s, "Patch for flash programming replaced by \"%s\".\n", s->opt.fastPatchFile);
+				s->opt.newBSLFile= s->opt.fastPatchFile;
+				s->fastPatch= TRUE;
+				}
+			}
+		if (s->opt.newBSLFile == NULL)
+			{
+#endif /* NEW_BSL */
+			bslPrintf(s, "Patch for flash programming required!\n");
+			s->patchRequired= TRUE;
+#ifdef NEW_BSL
+			}
+#endif /* NEW_BSL */
+#endif /* WORKAROUND */
+
+		s->memAccessWarning= 1;
+		}
+	else
+		{
+		s->memAccessWarning= 0; /* Fixed in newer versions of BSL. */
+		}
+	}
+
+
+	if (s->patchRequired || ((s->opt.newBSLFile != NULL) && (s->bslVer <= 0x0110)))
+	{
+	/* Execute function within bootstrap loader
+	* to prepare stack pointer for the following patch.
+	* This function will lock the protected functions again.
+	*/
+	bslPrintf(s, "Load PC with 0x0C22...\n");
+	if ((error= bslTxRx(s, BSL_LOADPC, /* Command: Load PC		*/
+		0x0C22,	/* Address to load into PC */
+		0,		/* No additional data!	*/
+		NULL, s->blkin)) != ERR_NONE)
+		{
+		return(signOff(s, error, FALSE));
+		}
+
+	/* Re-send password to re-gain access to protected functions. */
+	if ((error= txPasswd(s, s->opt.passwdFile)) != ERR_NONE)
+		{
+		return(signOff(s, error, TRUE)); /* Password was transmitted! */
+		}
+	}
+
+#ifdef NEW_BSL
+	if (s->opt.newBSLFile != NULL)
+	{
+	WORD startaddr; /* used twice: vector or start address */
+	WORD loaderaddr;
+	startaddr = readStartAddrTIText(s, s->opt.newBSLFile);
+	if (startaddr == 0)
+		{
+		startaddr = 0x0300;
+		}
+	loaderaddr = startaddr;
+
+	bslPrintf(s, "Load");
+	if (s->bslVer >= 0x0140) bslPrintf(s, "/Verify");
+	bslPrintf(s, " new BSL \"%s\" into RAM at 0x%04X...\n", s->opt.newBSLFile, startaddr);
+	if ((error= programTIText(s, s->opt.newBSLFile, /* File to program */
+		ACTION_PROGRAM)) != ERR_NONE)
+		{
+		return(signOff(s, error, FALSE));
+		}
+	if (s->bslVer < 0x0140)
+		{
+		bslPrintf(s, "Verify new BSL \"%s\"...\n", s->opt.newBSLFile);
+		if ((error= programTIText(s, s->opt.newBSLFile, /* File to verify */
+			ACTION_VERIFY)) != ERR_NONE)
+			{
+#ifdef WORKAROUND
+			if (!s->fastPatch || (error != ERR_VERIFY_FAILED))
+#endif /* WORKAROUND */
+			return(signOff(s, error, FALSE));
+			}
+		}
+
+	if (error != ERR_NONE)
+		{
+		/* Fast loader in place of the patch, but not enough RAM: */
+		bslPrintf(s, "Fast loader not started.\n");
+		error= ERR_NONE;
+		}
+	/* Read startvector/loaded model of NEW bootstrap loader: */
+	else if ((error= bslTxRx(s, BSL_RXBLK, startaddr, 4, NULL, s->blkin)) == ERR_NONE)
+		{
+		memcpy(&startaddr, &s->blkin[0], 2);
+		memcpy(&loadedModel, &s->blkin[2], 2);
+		if (loadedModel == FAST_RAM_model)
+			{
+			error= startFastLoader(s, loaderaddr, startaddr);
+			if ((error == ERR_NONE) && !s->flActive)
+				{
+				/* Loader not started: continue with the ROM BSL */
+				loadedModel= ROM_model;
+				}
+			}
+		else
+			{
+			if (loadedModel != SMALL_RAM_model)
+				{
+				loadedModel= LARGE_RAM_model;
+				s->bslerrbuf = 0x0200;
+				bslPrintf(s, "Start new BSL (LARGE model > 1K Bytes) at 0x%04X...\n", startaddr);
+				}
+			else
+				bslPrintf(s, "Start new BSL (SMALL model < 512 Bytes) at 0x%04X...\n", startaddr);
+
+			error= bslTxRx(s, BSL_LOADPC, /* Command: Load PC		*/
+				startaddr,/* Address to load into PC */
+				0,		/* No additional data!	*/
+				NULL, s->blkin);
+			}
+		}
+	if (error != ERR_NONE)
+		{
+		return(signOff(s, error, FALSE));
+		}
+
+	if (loadedModel != ROM_model)
+		{
+		/* BSL-Bugs should be fixed within "new" BSL: */
+		s->memAccessWarning= 0;
+		s->patchRequired= FALSE;
+		s->patchLoaded= FALSE;
+		}
+#ifdef WORKAROUND
+	else if (s->fastPatch)
+		{
+		/* Fast loader not started: back to the patch */
+		bslPrintf(s, "Patch for flash programming required!\n");
+		s->opt.newBSLFile= NULL;
+		s->patchRequired= TRUE;
+		}
+#endif /* WORKAROUND */
+
+	if (loadedModel == LARGE_RAM_model)
+		{
+		/* Re-send password to re-gain access to protected functions. */
+		if ((error= txPasswd(s, s->opt.passwdFile)) != ERR_NONE)
+			{
+			return(signOff(s, error, TRUE)); /* Password was transmitted! */
+			}
+		}
+	}
+#endif/* NEW_BSL */
+
+#ifdef WORKAROUND
+	if (s->patchRequired)
+	{
+	bslPrintf(s, "Load and verify patch \"%s\"...\n", s->opt.patchFile);
+	/* Programming and verification is done in one pass.
+	* The patch file is only read and parsed once.
+	*/
+	if ((error= programTIText(s, s->opt.patchFile, /* File to program */
+		ACTION_PROGRAM | ACTION_VERIFY)) != ERR_NONE)
+		{
+		return(signOff(s, error, FALSE));
+		}
+	s->patchLoaded= TRUE;
+	}
+#endif /* WORKAROUND */
+
+#ifdef NEW_BSL
+	if ((s->opt.newBSLFile != NULL) && (s->opt.passwdFile != NULL) && s->opt.toDo.MassErase)
+	{
+	/* Erase the flash memory completely (with mass erase command): */
+	bslPrintf(s, "Mass Erase...\n");
+	if ((error= bslTxRx(s, BSL_MERAS, /* Command: Mass Erase 			*/
+		0xff00,	/* Any address within flash memory. */
+		0xa506,	/* Required setting for mass erase! */
+		NULL, s->blkin)) != ERR_NONE)
+		{
+		return(signOff(s, error, FALSE));
+		}
+	s->opt.passwdFile= NULL; /* No password file required! */
+	}
+#endif /* NEW_BSL*/
+
+
+/* FRGR */
+	if (s->opt.toDo.SpeedUp && !s->flActive) // 0:9600, 1:19200, 2:38400 (3:56000 not applicable)
+	{
+	DWORD BR;
+	if (!speedSetting(s->devTypeHi, &s->opt.speed, &BR, &_addr))
+		BR = comGetBaudrate(s);	// unknown device: no change
+	_len	= s->opt.speed;				// D3: index for baudrate (s->opt.speed)
+
+	if (BR != comGetBaudrate(s)) 	// change only if not same s->opt.speed
+		{
+		bslPrintf(s, "Change Baudrate ");
+		error= bslTxRx(s, BSL_SPEED, 	// Command: Change Speed
+			_addr,		// Mandatory code
+			_len, 		// Mandatory code
+			NULL, s->blkin);
+
+		if (error == ERR_NONE)
+			{
+			bslPrintf(s, "from %d ", comGetBaudrate(s));
+			comChangeBaudrate(s, BR);
+			comDelay(s, 10);
+			bslPrintf(s, "to %d Baud (Mode: %d)\n", comGetBaudrate(s),s->opt.speed);
+			}
+		else
+			{
+			bslPrintf(s, "command not accepted. Baudrate remains at %d Baud\n", comGetBaudrate(s));
+			}
+		}
+	}
+
+
+
+
+ s->Time_PRG_starts = comTicks(s);
+ //bslPrintf(s, "Start time measurement for pure Prog/Verify cycle...\n");
+
+ if (!s->opt.toDo.OnePass)
+	{
+	if (s->opt.toDo.EraseCheck)
+		{
+		/* Parse file in TXT-Format and check the erasure of required flash cells. */
+		bslPrintf(s, "Erase Check by file \"%s\"...\n", s->opt.filename);
+		if ((error= programTIText(s, s->opt.filename, ACTION_ERASE_CHECK)) != ERR_NONE)
+			{
+			return(signOff(s, error, FALSE));
+			}
+		}
+
+	if (s->opt.toDo.FastCheck)
+		{
+		/* Parse file in TXT-Format and check the erasure of required flash cells. */
+		bslPrintf(s, "Fast E-Check by file \"%s\"...\n", s->opt.filename);
+		if ((error= programTIText(s, s->opt.filename, ACTION_ERASE_CHECK_FAST)) != ERR_NONE)
+			{
+			return(signOff(s, error, FALSE));
+			}
+		}
+
+	if (s->opt.toDo.Program)
+		{
+		/* Parse file in TXT-Format and program data into flash memory. */
+		bslPrintf(s, "Program \"%s\"...\n", s->opt.filename);
+		if ((error= programTIText(s, s->opt.filename, ACTION_PROGRAM)) != ERR_NONE)
+			{
+			if ((error == ERR_FILE_OPEN) || (error == ERR_FRAME_FILE) ||
+				(error == ERR_READ_RANGE))	/* (the file, not the device) */
+				return(signOff(s, error, FALSE));
+			if (s->opt.newBSLFile == NULL)
+				return(signOff(s, ERR_VERIFY_FAILED, FALSE));
+			else
+				{
+				// read out error address+3 from RAM (error address buffer)
+				if ((loadedModel == LARGE_RAM_model) || (loadedModel == SMALL_RAM_model))
+					{
+					if (s->opt.toDo.MSP430X)
+						if (bslTxRx(s, BSL_MEMOFFSET, 0, 0, NULL, s->blkin) !=0) signOff(s, error, TRUE);
+					if ((error= bslTxRx(s, BSL_RXBLK, s->bslerrbuf, 2, NULL, s->blkin)) == ERR_NONE)
+						{
+						_err = (s->blkin[1] << 8) + s->blkin[0];
+						bslPrintf(s, "Verification Error at 0x%04X\n", _err-3);
+						}
+					else
+						return(signOff(s, error, FALSE));
+					}
+				else
+					{
+					if ((loadedModel == FAST_RAM_model) && (error == ERR_CMD_FAILED))
+						bslPrintf(s, "Verification Error in block at 0x%04X\n", s->flErrAddr);
+					return(signOff(s, ERR_VERIFY_FAILED, FALSE));
+					}
+				}
+			}
+		else
+			{
+			bslPrintf(s, "%i bytes programmed.\n", s->byteCtr);
+			if (s->flActive)
+				bslPrintf(s, "%lu bytes sent.\n", s->flTxBytes);
+			}
+		}
+
+	if (s->opt.toDo.Verify)
+		{
+		if ((s->opt.toDo.Program) && ((s->bslVer >= 0x0140) || (loadedModel != ROM_model)))
+			{
+			bslPrintf(s, "Verify... already done during programming.\n");
+			}
+		else
+			{
+			/* Verify programmed data: */
+			bslPrintf(s, "Verify\"%s\"...\n", s->opt.filename);
+			if ((error= programTIText(s, s->opt.filename, ACTION_VERIFY)) != ERR_NONE)
+				{
+				return(signOff(s, error, FALSE));
+				}
+			}
+		}
+	}
+	else
+	{
+	unsigned action= 0;
+	if (s->opt.toDo.EraseCheck)
+		{
+		action |= ACTION_ERASE_CHECK;	bslPrintf(s, "EraseCheck ");
+		}
+	if (s->opt.toDo.FastCheck)
+		{
+		action |= ACTION_ERASE_CHECK_FAST; bslPrintf(s, "EraseCheckFast ");
+		}
+	if (s->opt.toDo.Program)
+		{
+		action |= ACTION_PROGRAM;		bslPrintf(s, "Program ");
+		}
+	if (s->opt.toDo.Verify)
+		{
+		action |= ACTION_VERIFY; 		bslPrintf(s, "Verify ");
+		}
+
+	if (action != 0)
+		{
+		bslPrintf(s, "\"%s\" ...\n", s->opt.filename);
+		error= programTIText(s, s->opt.filename, action);
+		if (error != ERR_NONE)
+			{
+			return(signOff(s, error, FALSE));
+			}
+		else
+			{
+			bslPrintf(s, "%i bytes programmed.\n", s->byteCtr);
+			if (s->flActive)
+				bslPrintf(s, "%lu bytes sent.\n", s->flTxBytes);
+			}
+		}
+	}
+
+	if (s->opt.toDo.RestoreInfoA)
+		{
+
+		unsigned long startaddr = 0x10C0;
+		WORD len = 0x40;
+
+		bslPrintf(s, "Restore InfoA Segment...\n");
+		/* Restore actual InfoA segment Content. */
+		if (s->opt.toDo.MSP430X) if (bslTxRx(s, BSL_MEMOFFSET, 0, 0, NULL, s->blkin) !=0)  return (signOff(s, error, TRUE));
+
+		while ((len > 0) && (infoA[0x40-len] == 0xff))
+			{
+			len --;
+			startaddr++;
+			}
+
+        if (len > 0)
+			{
+			memcpy(s->blkout, &infoA[startaddr - 0x10C0], len);
+			if (error= programBlk(s, startaddr, len, ACTION_PROGRAM, NULL))
+				{
+					return(signOff(s, error, FALSE));
+				}
+			}
+		}
+
+	if (s->opt.toDo.Dump2file)
+		{
+		if ((error= readMemory(s)) != ERR_NONE)
+			{
+			return(signOff(s, error, FALSE));
+			}
+		}
+
+	if (s->opt.toDo.EraseSegment)
+	{
+		long addrCount = s->opt.readStart;
+		bslPrintf(s, "Erase Segment: 0x%-4X\n", s->opt.readStart);
+
+		if (s->opt.toDo.MSP430X) {
+			if (error = bslTxRx(s, BSL_MEMOFFSET, 0, (WORD)(addrCount>>16), NULL, s->blkin) !=ERR_NONE) return(signOff(s, error, FALSE));
+			addrCount = addrCount & 0xFFFF;
+		}
+
+		if (error = bslTxRx(s, BSL_ERASE, addrCount, 0xA502, NULL, s->blkin) !=ERR_NONE) return(signOff(s, error, FALSE));
+        if (s->opt.toDo.MSP430X)
+			if (error = bslTxRx(s, BSL_MEMOFFSET, 0, (WORD)(0),NULL, s->blkin) !=0)  return (error);
+	}
+
+	if (s->opt.toDo.UserCalled)
+	{
+		s->opt.toDo.UserCalled = 0;
+		//bslReset(s, 0); /* Reset MSP430 and start user program. */
+		bslPrintf(s, "No Device reset - BSL called from user program ---------------------\n");
+		//comDelay(s, 100);
+		goto Repeat;
+	}
+
+	s->Time_BSL_stops = comTicks(s);
+
+    return(signOff(s, ERR_NONE, FALSE));
+	} /* bslRun */
+
+
+/*-------------------------------------------------------------*/
+BOOL speedSetting(BYTE devType, BYTE *spd, DWORD *BR, WORD *code)
+/* Baudrate and code for the Change Baudrate command of the given
+ * device family (FRGR).  *spd is set to 0 if not supported.
+ * Returns FALSE for unknown families.
+ */
+	{
+	if ((devType == 0xF1) || (devType == 0x12)) // F1232 / F1xx
+		{
+		BYTE BCSCTL1, DCOCTL; 		// Basic Clock Module Registers
+		switch (*spd)		    	// for F148, F149, F169
+			{ 												//Rsel DCO
+			case 0:  *BR = CBR_9600;  BCSCTL1 = 0x85; DCOCTL = 0x80; break;// 5	4
+			case 1:  *BR = CBR_19200; BCSCTL1 = 0x86; DCOCTL = 0xE0; break;// 6	7
+			case 2:  *BR = CBR_38400; BCSCTL1 = 0x87; DCOCTL = 0xE0; break;// 7	7
+			default: *BR = CBR_9600;  BCSCTL1 = 0x85; DCOCTL = 0x80; *spd = 0;
+			}
+		*code = (BCSCTL1 << 8) + DCOCTL;// D2, D1: values for CPU frequency
+		}
+	else if (devType == 0xF4)
+		{
+		BYTE SCFI0, SCFI1;			// FLL+ Registers
+		switch (*spd)			    // for F448, F449
+			{ 												//NDCO FN_x
+			case 0:  *BR = CBR_9600;  SCFI1 = 0x98; SCFI0= 0x00; break;// 19	0
+			case 1:  *BR = CBR_19200; SCFI1 = 0xB0; SCFI0= 0x00; break;// 22	0
+			case 2:  *BR = CBR_38400; SCFI1 = 0xC8; SCFI0= 0x00; break;// 25	0
+			default: *BR = CBR_9600;  SCFI1 = 0x98; SCFI0= 0x00; *spd = 0;
+			}
+		*code = (SCFI1 << 8) + SCFI0; // D2, D1: values for CPU frequency
+		}
+	else if (devType == 0xF2 || devType == 0x25)
+		{
+		BYTE BCSCTL1, DCOCTL; 		// Basic Clock Module Registers
+		switch (*spd)			    // for F2xx
+			{ 												//Rsel DCO
+			case 0:  *BR = CBR_9600;  BCSCTL1 = 0x88; DCOCTL = 0x80; break;// 5	4
+			case 1:  *BR = CBR_19200; BCSCTL1 = 0x8B; DCOCTL = 0x80; break;// 6	7
+			case 2:  *BR = CBR_38400; BCSCTL1 = 0x8C; DCOCTL = 0x80; break;// 7	7
+			default: *BR = CBR_9600;  BCSCTL1 = 0x88; DCOCTL = 0x80; *spd = 0;
+			}
+		*code = (BCSCTL1 << 8) + DCOCTL;// D2, D1: values for CPU frequency
+		}
+	else
+		return(FALSE);
+	return(TRUE);
+	} /* speedSetting */
+
+/* EOF */
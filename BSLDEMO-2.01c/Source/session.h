@@ -0,0 +1,266 @@
+/****************************************************************
+*
+* Project: MSP430 Bootstrap Loader Demonstration Program
+*
+* File:    SESSION.H
+*
+* A session holds everything about one connection to a device:
+* the transport, the protocol state, the buffers, the state of
+* the fast loader, the device information and the program flow
+* options.  Nothing is kept in global variables, so a process can
+* run any number of sessions, on any number of threads (one
+* thread per session at a time).
+*
+* A session is used like this:
+*
+*   BSL_SESSION s;
+*   BSL_OPTIONS opt;
+*
+*   bslDefaultOptions(&opt);
+*   opt.filename= "firmware.txt";
+*   if (bslOpenCom(&s, "\\\\.\\COM5", &opt) == ERR_NONE)
+*   {
+*     error= bslRun(&s);     (complete BSLDEMO program flow)
+*     bslClose(&s);
+*   }
+*
+* bslOpen() takes any BSL_TRANSPORT in place of a serial port.
+* The single commands (bslTxRx() etc.) can be used between
+* bslOpen() and bslClose() as well.
+*
+****************************************************************/
+
+#ifndef Session__H
+#define Session__H
+
+#include "bslcomm.h"
+#include "fastload.h"
+
+/* This definition includes code to load a new BSL into RAM:
+* NOTE: Can only be used with devices with sufficient RAM!
+* The program flow is changed slightly compared to a version
+* without "NEW_BSL" defined.
+*/
+#define NEW_BSL
+
+/* The "WORKAROUND" definition includes code for a workaround
+* required by the first version(s) of the bootstrap loader.
+*/
+#define WORKAROUND
+
+/* Error: verification failed:		*/
+#define ERR_VERIFY_FAILED		98
+/* Error: erase check failed:		*/
+#define ERR_ERASE_CHECK_FAILED	97
+/* Error: unable to open input file: */
+#define ERR_FILE_OPEN			96
+/* Error: unable to write output file: */
+#define ERR_FILE_WRITE			95
+/* Error: -r or a block above 0xFFFF without -x: */
+#define ERR_READ_RANGE			94
+/* Error: frame file broken: */
+#define ERR_FRAME_FILE			93
+
+/* Mask: program data:	*/
+#define ACTION_PROGRAM			0x01
+/* Mask: verify data:	*/
+#define ACTION_VERIFY			0x02
+/* Mask: erase check:	*/
+#define ACTION_ERASE_CHECK		0x04
+/* Mask: transmit password:  */
+/* Note: Should not be used in conjunction with any other action! */
+#define ACTION_PASSWD			0x08
+/* Mask: erase check fast:	*/
+#define ACTION_ERASE_CHECK_FAST	0x10
+
+/* Additional mass erase cylces required for (some) F149 devices.
+* If ADD_MERASE_CYCLES is not defined only one mass erase
+* cycle is executed.
+* Remove #define for fixed F149 or F11xx devices.
+*/
+#define ADD_MERASE_CYCLES		20
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct toDoList
+	{
+	unsigned MassErase : 1;
+	unsigned EraseCheck: 1;
+	unsigned FastCheck : 1;
+	unsigned Program : 1;
+	unsigned Verify: 1;
+	unsigned Reset	: 1;
+	unsigned Wait	: 1;    /* Wait for <Enter> at end of program */
+	                        /* (0: no; 1: yes):                   */
+	unsigned OnePass : 1;   /* Do EraseCheck, Program and Verify  */
+	                        /* in one pass (TI TXT file is read   */
+	                        /* only once)                         */
+	unsigned SpeedUp : 1;   /* Change Baudrate                    */
+	unsigned UserCalled: 1; /* Second run without entry sequence  */
+	unsigned BSLStart: 1;   /* Start BSL                          */
+	unsigned Dump2file:1;   /* Dump Memory to file                */
+	unsigned EraseSegment:1;/* Erase Segment                      */
+	unsigned MSP430X:1;     /* Enable MSP430X Ext.Memory support  */
+	unsigned RestoreInfoA:1;/* Save InfoA before mass erase       */
+	unsigned SparseRead:1;  /* Dump: skip erased ranges (ECHECK)  */
+	} BSL_TODO;
+
+/* What bslRun() does (set from the command line by BSLDEMO): */
+typedef struct
+	{
+	BSL_TODO toDo;
+	char *filename;			/* TI TXT file to program/verify		*/
+	char *passwdFile;		/* TI TXT file with the password		*/
+	char *patchFile;		/* Workaround patch					*/
+	char *fastPatchFile;	/* Loader used in place of the patch	*/
+	char *newBSLFile;		/* Loader to load into RAM (-b)		*/
+	int maxData;			/* Max. bytes within one frame			*/
+	BYTE speed;				/* -s: 0:9600, 1:19200, 2:38400		*/
+	int meraseCycles;
+	long readStart;			/* -r, -e								*/
+	long readLen;
+	char *readfilename;
+	BOOL invertDTR;			/* -i									*/
+	BOOL invertRTS;			/* -j									*/
+	BOOL metrics;			/* -t: measure the commands			*/
+	char *metricsFile;		/* -t{file}: JSON summary and trace	*/
+	char *traceFile;		/* -d{file}: wire trace written always	*/
+	const struct FI_SPEC *faults; /* -n: faults injected (FAULTS.H)	*/
+	} BSL_OPTIONS;
+
+/* Data of the fast loader (FASTLOAD.C), allocated by flStart(): */
+typedef struct FL_STATE FL_STATE;
+/* State of asynchronous commands (BSLASYNC.C): */
+typedef struct BSL_ASYNC BSL_ASYNC;
+/* Measurements (METRICS.C), allocated by mxStart(): */
+typedef struct BSL_METRICS BSL_METRICS;
+/* Wire trace (WIRETRACE.C), allocated by wtStart(): */
+typedef struct BSL_WIRETRACE BSL_WIRETRACE;
+/* Fault injection (FAULTS.C), allocated by fiStart(): */
+typedef struct FI_SPEC FI_SPEC;
+typedef struct BSL_FAULTS BSL_FAULTS;
+
+struct BSL_SESSION
+	{
+	/* Transport and protocol state (SSP.C): */
+	const BSL_TRANSPORT *transport;
+	void *port;
+	DWORD baudrate;
+	int lines;				/* LINE_xxx								*/
+	DWORD timeout;			/* ms until a timeout occurs			*/
+	int prolongFactor;		/* timeout factor after a command		*/
+	int lastError;
+	BYTE seqNo, reqNo;
+	BYTE rxFrame[MAX_FRAME_SIZE];
+
+	/* BSLCOMM.C: */
+	int memAccessWarning;	/* warn of access below 0x1000			*/
+
+	/* Fast loader (FASTLOAD.C): */
+	BOOL flActive;			/* loader handles all commands			*/
+	WORD flErrAddr;			/* block the loader did not accept		*/
+	DWORD flTxBytes;		/* bytes sent in Transmit Block frames	*/
+	FL_STATE *fl;
+
+	/* Asynchronous commands (BSLASYNC.C): */
+	BSL_ASYNC *async;
+
+	/* Measurements (METRICS.C, NULL: off): */
+	BSL_METRICS *metrics;
+
+	/* Wire trace (WIRETRACE.C): */
+	BSL_WIRETRACE *trace;
+
+	/* Fault injection (FAULTS.C, NULL: off): */
+	BSL_FAULTS *faults;
+
+	/* Program flow (SESSION.C): */
+	BSL_OPTIONS opt;		/* (changed while running)				*/
+	int maxData;
+	BYTE blkin [MAX_DATA_BYTES]; /* Receive buffer	*/
+	BYTE blkout[FL_MAX_DATA];    /* Transmit buffer */
+	BOOL patchRequired;
+	BOOL patchLoaded;
+	BOOL fastPatch;
+	WORD loadedModel;
+	WORD bslerrbuf;
+	int byteCtr;
+	char *errData;			/* file which could not be opened		*/
+	BYTE infoA[0x40];
+	DWORD Time_BSL_starts, Time_PRG_starts, Time_BSL_stops;
+	BOOL warm;				/* device left in the ROM BSL by the	*/
+							/* last run: unlocked, 9600 Baud		*/
+
+	/* Device (read by bslRun()): */
+	WORD bslVer;
+	BYTE bslVerHi, bslVerLo, devTypeHi, devTypeLo, devProcHi, devProcLo;
+
+	/* Output; NULL: printf() and the bargraph on the console: */
+	void (*print)(BSL_SESSION *s, const char *text);
+	void (*progress)(BSL_SESSION *s, int bytes);
+	void *user;				/* free for the caller					*/
+	};
+
+/*-------------------------------------------------------------*/
+void bslDefaultOptions(BSL_OPTIONS *opt);
+/* Sets the options to the defaults of BSLDEMO.
+ */
+
+/*-------------------------------------------------------------*/
+int bslOpen(BSL_SESSION *s, const BSL_TRANSPORT *transport, void *port,
+            const BSL_OPTIONS *opt);
+/* Initialises the session for a port opened already.
+ * Return == 0: OK
+ */
+
+/*-------------------------------------------------------------*/
+int bslOpenCom(BSL_SESSION *s, LPCSTR comPortName, const BSL_OPTIONS *opt);
+/* Opens a serial port and initialises the session for it.
+ * Return == 0: OK
+ */
+
+/*-------------------------------------------------------------*/
+int bslRun(BSL_SESSION *s);
+/* Runs the program flow of BSLDEMO with the session's options:
+ * entry sequence, mass erase, password, loaders, erase check,
+ * program, verify, read, reset.  Messages go to s->print.
+ * Return == 0: OK
+ * Return != 0: Error!
+ */
+
+/*-------------------------------------------------------------*/
+int bslNextRun(BSL_SESSION *s, const BSL_OPTIONS *opt);
+/* Sets the options of another bslRun() on a session kept open
+ * (DAEMON.C).  If the run before left the device in the ROM BSL
+ * (s->warm), the next run skips the entry sequence and the
+ * password, as with +u; otherwise the port is set as by bslOpen()
+ * and the next run starts with the entry sequence.
+ * Return == 0: OK
+ */
+
+/*-------------------------------------------------------------*/
+void bslClose(BSL_SESSION *s);
+/* Releases the port and all memory of the session.
+ */
+
+/*-------------------------------------------------------------*/
+void bslPrintf(BSL_SESSION *s, const char *format, ...);
+/* printf() to the session's output.
+ */
+
+/*-------------------------------------------------------------*/
+BOOL speedSetting(BYTE devType, BYTE *spd, DWORD *BR, WORD *code);
+/* Baudrate and code for the Change Baudrate command of the given
+ * device family (FRGR).  *spd is set to 0 if not supported.
+ * Returns FALSE for unknown families.
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/* EOF */
@@ -0,0 +1,380 @@
+/****************************************************************
+*
+* Project: MSP430 Bootstrap Loader Demonstration Program
+*
+* File:    SIMDEV.C
+*
+* Simulated device (see SIMDEV.H).
+*
+* Each byte written reaches the device when the line has carried
+* it (txFree); the device answers a sync byte, and a frame after
+* it, at once.  Its reply goes into rx[], each byte with the time
+* it has come in (due[]), after the latency, the time of the
+* command and the reply before (rxFree).  The host reads a byte
+* once the clock (now) has passed its time.
+*
+****************************************************************/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <windows.h>
+
+#include "simdev.h"
+
+/* Bytes of replies not read yet: */
+#define SD_QUEUE   1024
+
+/* Device information at 0x0FF0 (family, BSL version at 0x0FFA): */
+static const BYTE sdChipId[14]=
+  { 0xF2, 0x6F, 0x00, 0x00, 0, 0, 0, 0, 0, 0, 0x02, 0x12, 0, 0 };
+
+typedef struct
+{
+  BYTE *mem;              /* SD_MEMORY bytes */
+  DWORD latency;          /* us */
+  DWORD baudrate;
+  double byteTime;        /* us per byte */
+  double now;             /* clock (us) */
+  double txFree, rxFree;  /* lines busy until */
+  BOOL synced, unlocked;
+  unsigned long offset;   /* MEMOFFSET */
+  BYTE frame[MAX_FRAME_SIZE + 8];
+  int got;                /* bytes of it received */
+  BYTE rx[SD_QUEUE];
+  double due[SD_QUEUE];
+  int first, used;
+  DWORD wire;
+} SD_PORT;
+
+/*-------------------------------------------------------------*/
+static void sdSetBaud(SD_PORT *p, DWORD baudrate)
+{
+  p->baudrate= (baudrate > 0) ? baudrate : 9600;
+  p->byteTime= 11 * 1000000.0 / p->baudrate;
+}
+
+/*-------------------------------------------------------------*/
+static void sdReply(SD_PORT *p, const BYTE data[], int n, double at)
+/* Sends n bytes, the first one starting at 'at'. */
+{
+  int i;
+
+  if (at < p->rxFree) at= p->rxFree;
+  for (i= 0; (i < n) && (p->used < SD_QUEUE); i++)
+  {
+    at+= p->byteTime;
+    p->rx[(p->first + p->used) % SD_QUEUE]= data[i];
+    p->due[(p->first + p->used++) % SD_QUEUE]= at;
+    p->wire++;
+  }
+  p->rxFree= at;
+}
+
+/*-------------------------------------------------------------*/
+static void sdAnswer(SD_PORT *p, BYTE reply, double at)
+{
+  sdReply(p, &reply, 1, at);
+}
+
+/*-------------------------------------------------------------*/
+static BOOL sdIsFlash(unsigned long a)
+{
+  return((a >= SD_FLASH) || ((a >= 0x1000) && (a < 0x1100)));
+}
+
+/*-------------------------------------------------------------*/
+static void sdCommand(SD_PORT *p, double at)
+/* Runs the frame received; at: time of its last byte. */
+{
+  BYTE *d= &p->frame[4];
+  BYTE cmd= p->frame[1];
+  int n= p->frame[2] - 4;
+  unsigned long addr= p->offset + (d[0] | (d[1] << 8));
+  WORD len= d[2] | (d[3] << 8);
+  BYTE reply[MAX_FRAME_SIZE];
+  double work= 0;
+  unsigned long a, size;
+  WORD check;
+  BOOL ok= TRUE;
+  int i;
+
+  at+= p->latency;
+  if ((cmd != BSL_TXPWORD) && (cmd != BSL_MERAS) && !p->unlocked)
+  {
+    sdAnswer(p, DATA_NAK, at);
+    return;
+  }
+  switch (cmd)
+  {
+    case BSL_TXPWORD:
+      p->unlocked= (n >= 32) && (memcmp(&d[4], &p->mem[0xFFE0], 32) == 0);
+      ok= p->unlocked;
+      break;
+    case BSL_MERAS:
+      memset(&p->mem[0x1000], 0xFF, 0x100);
+      memset(&p->mem[SD_FLASH], 0xFF, SD_MEMORY - SD_FLASH);
+      p->unlocked= TRUE;
+      work= SD_MERASE_US;
+      break;
+    case BSL_TXBLK:
+      for (i= 0; i < n; i++)
+      {
+        a= (addr + i) % SD_MEMORY;
+        if (sdIsFlash(a))
+        {
+          p->mem[a]&= d[4 + i];
+          work+= SD_WRITE_US;
+        }
+        else if ((a >= 0x0200) && (a < 0x0C00))
+          p->mem[a]= d[4 + i];
+        if (p->mem[a] != d[4 + i]) ok= FALSE;
+      }
+      break;
+    case BSL_RXBLK:
+      if (len > MAX_DATA_BYTES) len= MAX_DATA_BYTES;
+      reply[0]= DATA_FRAME;
+      reply[1]= 0;
+      reply[2]= reply[3]= (BYTE)len;
+      for (i= 0; i < len; i++)
+      {
+        a= (addr + i) % SD_MEMORY;
+        reply[4 + i]= ((a >= 0x0FF0) && (a < 0x0FFE)) ? sdChipId[a - 0x0FF0] : p->mem[a];
+      }
+      for (check= 0, i= 0; i < len + 4; i+= 2) check^= reply[i] | (reply[i + 1] << 8);
+      check= ~check;
+      reply[len + 4]= (BYTE)check;
+      reply[len + 5]= (BYTE)(check >> 8);
+      sdReply(p, reply, len + 6, at + len * SD_READ_US);
+      return;
+    case BSL_ERASE:
+      size= ((addr >= 0x1000) && (addr < 0x1100)) ? 0x40 : 0x200;
+      a= addr & ~(size - 1);
+      if (sdIsFlash(a)) memset(&p->mem[a], 0xFF, size);
+      work= SD_ERASE_US;
+      break;
+    case BSL_ECHECK:
+      for (i= 0; i < len; i++)
+      {
+        if (p->mem[(addr + i) % SD_MEMORY] != 0xFF) ok= FALSE;
+      }
+      work= len * SD_READ_US;
+      break;
+    case BSL_LOADPC:
+    case BSL_SPEED:       /* (the host sets the line) */
+      break;
+    case BSL_MEMOFFSET:
+      p->offset= (unsigned long)len << 16;
+      break;
+    default:
+      ok= FALSE;
+  }
+  sdAnswer(p, ok ? DATA_ACK : DATA_NAK, at + work);
+}
+
+/*-------------------------------------------------------------*/
+static void sdByte(SD_PORT *p, BYTE b, double at)
+/* The device receives a byte at time 'at'. */
+{
+  WORD check;
+  int i, length;
+
+  if (!p->synced)
+  {
+    if (b == DATA_FRAME)
+    {
+      p->synced= TRUE;
+      p->got= 0;
+      sdAnswer(p, DATA_ACK, at + p->latency);
+    }
+    return;
+  }
+  if ((p->got == 1) && (b == DATA_FRAME))
+  { /* (sync again) */
+    sdAnswer(p, DATA_ACK, at + p->latency);
+    return;
+  }
+  p->frame[p->got++]= b;
+  if (p->got < 4) return;
+  length= 4 + p->frame[2] + 2;
+  if ((p->frame[0] != DATA_FRAME) || (p->frame[2] != p->frame[3]) || (p->frame[2] < 4))
+  {
+    p->synced= FALSE;
+    sdAnswer(p, DATA_NAK, at + p->latency);
+    return;
+  }
+  if (p->got < length) return;
+  p->synced= FALSE;
+  for (check= 0, i= 0; i < length - 2; i+= 2)
+  {
+    check^= p->frame[i] | (p->frame[i + 1] << 8);
+  }
+  if ((WORD)~check != (p->frame[length - 2] | (p->frame[length - 1] << 8)))
+  {
+    sdAnswer(p, DATA_NAK, at + p->latency);
+    return;
+  }
+  sdCommand(p, at);
+}
+
+/*-------------------------------------------------------------*/
+static int sdReady(SD_PORT *p)
+/* Bytes which have come in. */
+{
+  int n;
+
+  for (n= 0; (n < p->used) && (p->due[(p->first + n) % SD_QUEUE] <= p->now); n++);
+  return(n);
+}
+
+/***************************************************************
+ * Transport (port: SD_PORT):
+ */
+
+/*-------------------------------------------------------------*/
+static int sdSetLine(void *port, DWORD baudrate, int lines)
+{
+  sdSetBaud((SD_PORT*)port, baudrate);
+  return(ERR_NONE);
+}
+
+/*-------------------------------------------------------------*/
+static DWORD sdWrite(void *port, const BYTE data[], DWORD count)
+{
+  SD_PORT *p= (SD_PORT*)port;
+  DWORD i;
+
+  for (i= 0; i < count; i++)
+  {
+    if (p->txFree < p->now) p->txFree= p->now;
+    p->txFree+= p->byteTime;
+    p->wire++;
+    sdByte(p, data[i], p->txFree);
+  }
+  return(count);
+}
+
+/*-------------------------------------------------------------*/
+static DWORD sdWaitForData(void *port, DWORD count, DWORD timeout)
+{
+  SD_PORT *p= (SD_PORT*)port;
+  double end= p->now + timeout * 1000.0;
+
+  if (sdReady(p) >= (int)count) return(sdReady(p));
+  if ((p->used >= (int)count) && (p->due[(p->first + count - 1) % SD_QUEUE] <= end))
+    p->now= p->due[(p->first + count - 1) % SD_QUEUE];
+  else
+    p->now= end;
+  return(sdReady(p));
+}
+
+/*-------------------------------------------------------------*/
+static DWORD sdRead(void *port, BYTE data[], DWORD count)
+{
+  SD_PORT *p= (SD_PORT*)port;
+  DWORD i, n= sdReady(p);
+
+  if (count > n) count= n;
+  for (i= 0; i < count; i++)
+  {
+    data[i]= p->rx[p->first];
+    p->first= (p->first + 1) % SD_QUEUE;
+    p->used--;
+  }
+  return(count);
+}
+
+/*-------------------------------------------------------------*/
+static void sdPurge(void *port)
+{
+  SD_PORT *p= (SD_PORT*)port;
+  BYTE rest[SD_QUEUE];
+
+  sdRead(p, rest, sizeof(rest));
+}
+
+/*-------------------------------------------------------------*/
+static int sdClose(void *port)
+{
+  SD_PORT *p= (SD_PORT*)port;
+
+  /* (reset: the memory stays) */
+  p->synced= p->unlocked= FALSE;
+  p->offset= 0;
+  p->got= p->first= p->used= 0;
+  sdSetBaud(p, 9600);
+  return(ERR_NONE);
+}
+
+/*-------------------------------------------------------------*/
+static DWORD sdTicks(void *port)
+{
+  return((DWORD)(((SD_PORT*)port)->now / 1000));
+}
+
+/*-------------------------------------------------------------*/
+static void sdDelay(void *port, DWORD time)
+{
+  ((SD_PORT*)port)->now+= time * 1000.0;
+}
+
+const BSL_TRANSPORT sdTransport=
+{
+  sdSetLine, sdWrite, sdWaitForData, sdRead,
+  sdPurge, sdClose, sdTicks, sdDelay, NULL, NULL
+};
+
+/***************************************************************
+ * Device:
+ */
+
+/*-------------------------------------------------------------*/
+void *sdOpen(DWORD latency, int *error)
+{
+  SD_PORT *p;
+
+  *error= ERR_COM;
+  if ((p= (SD_PORT*)calloc(1, sizeof(SD_PORT))) == NULL) return(NULL);
+  if ((p->mem= (BYTE*)malloc(SD_MEMORY)) == NULL)
+  {
+    free(p);
+    return(NULL);
+  }
+  memset(p->mem, 0, SD_MEMORY);
+  memset(&p->mem[0x1000], 0xFF, 0x100);
+  memset(&p->mem[SD_FLASH], 0xFF, SD_MEMORY - SD_FLASH);
+  p->latency= latency;
+  sdSetBaud(p, 9600);
+  *error= ERR_NONE;
+  return(p);
+}
+
+/*-------------------------------------------------------------*/
+void sdFree(void *port)
+{
+  SD_PORT *p= (SD_PORT*)port;
+
+  free(p->mem);
+  free(p);
+}
+
+/*-------------------------------------------------------------*/
+DWORD sdWire(void *port)
+{
+  return(((SD_PORT*)port)->wire);
+}
+
+/*-------------------------------------------------------------*/
+long sdCompare(void *port, unsigned long addr, const BYTE data[], long len)
+{
+  SD_PORT *p= (SD_PORT*)port;
+  long i;
+
+  for (i= 0; i < len; i++)
+  {
+    if (p->mem[(addr + i) % SD_MEMORY] != data[i]) return(i);
+  }
+  return(-1);
+}
+
+/* EOF */
@@ -0,0 +1,79 @@
+/****************************************************************
+*
+* Project: MSP430 Bootstrap Loader Demonstration Program
+*
+* File:    SIMDEV.H
+*
+* Simulated device for the benchmark (BENCH.C): a transport which
+* plays an MSP430 with the ROM BSL (2.12, family F26F, 1 MB of
+* flash from 0x1100 on, MSP430X address offsets), so the whole
+* program flow runs without a port.
+*
+* It runs on a clock of its own: the bytes take the time of 11
+* bits at the baudrate set (8E1) on the line in each direction,
+* each reply comes the latency given after the last byte of the
+* request plus the time the device takes (SD_xxx below), and the
+* waits of the host (delay(), waitForData()) move the clock on
+* instead of waiting.  The times of a session so depend on the
+* protocol only, not on the PC, and a session of minutes runs in
+* well under a second.  ticks() tells the time of this clock.
+*
+* The Load PC of code in RAM is acknowledged but nothing runs
+* (the fast loader and new BSLs can't be used), and the lines are
+* not looked at: the device is reset when the port is closed, and
+* keeps its memory until sdFree().
+*
+****************************************************************/
+
+#ifndef SimDev__H
+#define SimDev__H
+
+#include "session.h"
+
+/* Times of the device (us): */
+#define SD_WRITE_US    75   /* per byte written to flash      */
+#define SD_READ_US      2   /* per byte read (Erase Check, Rx) */
+#define SD_ERASE_US 12000   /* segment erase                  */
+#define SD_MERASE_US 23000  /* mass erase                     */
+
+/* Memory of the device: */
+#define SD_MEMORY   0x100000L
+#define SD_FLASH    0x1100L
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Transport for the ports opened by sdOpen(): */
+extern const BSL_TRANSPORT sdTransport;
+
+/*-------------------------------------------------------------*/
+void *sdOpen(DWORD latency, int *error);
+/* Creates a device with erased flash whose replies come latency
+ * us after the request.
+ * Returns NULL (and ERR_COM in *error) if out of memory.
+ */
+
+/*-------------------------------------------------------------*/
+void sdFree(void *port);
+/* Frees the device (closing the port does not).
+ */
+
+/*-------------------------------------------------------------*/
+DWORD sdWire(void *port);
+/* Returns the bytes sent and received on the line so far.
+ */
+
+/*-------------------------------------------------------------*/
+long sdCompare(void *port, unsigned long addr, const BYTE data[], long len);
+/* Compares the memory of the device with data.
+ * Returns the offset of the first difference, -1 if none.
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/* EOF */
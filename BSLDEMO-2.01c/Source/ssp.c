@@ -23,12 +23,16 @@
 *----------------------------------------------------------------
 * 08/01 FRGR Implemented function comChangeBaudrate()
 * 06/04 UPSF Added return no error at comChangeBaudrate()
+* GH: state kept per session (SESSION.H), serial port behind
+*     BSL_TRANSPORT, so the port can be replaced
 ****************************************************************/
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <windows.h>
-#include "ssp.h"
+#include "session.h"
+#include "metrics.h"
 
 /* Global Constants: */
 
@@ -38,25 +42,7 @@
 #define MAX_FRAME_COUNT   16
 #define MAX_ERR_COUNT      5
 
-/* Global Variables: */
 const unsigned short protocolMode= MODE_BSL;
-HANDLE       hComPort;    /* COM-Port Handle             */
-DCB          comDCB;      /* COM-Port Control-Settings   */
-COMSTAT      comState;    /* COM-Port Status-Information */
-COMMTIMEOUTS orgTimeouts; /* Original COM-Port Time-out  */
-
-/* Time in milliseconds until a timeout occurs: */
-DWORD timeout      = DEFAULT_TIMEOUT;
-/* Factor by which the timeout after sending a frame is prolonged: */
-int prolongFactor= DEFAULT_PROLONG;
-
-/* Variable to save the latest error (used by comGetLastError): */
-int lastError;
-
-BYTE seqNo, reqNo, txPtr, rxPtr;
-BYTE rxFrame[MAX_FRAME_SIZE];
-
-DWORD nakDelay; /* Delay before DATA_NAK will be send */
 
 /***************************************************************/
 DWORD calcTimeout(DWORD startTime) /* exported! */
@@ -98,40 +84,372 @@ WORD calcChecksum(BYTE data[], WORD length)
   return(checksum ^ 0xffff); /* inverting */
 }
 
+/***************************************************************
+ * Windows serial port (winComTransport):
+ *
+ * The port is opened for overlapped I/O, but reads and writes
+ * wait for their completion, so they work as in nonoverlapped
+ * mode.  Waiting for data is done by ReadFile() with a total
+ * timeout, into a small buffer of the port, so the thread sleeps
+ * until the data is there.  winComRxEvent() arms WaitCommEvent()
+ * for EV_RXCHAR, so one thread can wait for the data of many
+ * ports at once (BSLASYNC.C).
+ */
+
+typedef struct
+{
+  HANDLE       handle;      /* COM-Port Handle             */
+  DCB          dcb;         /* COM-Port Control-Settings   */
+  COMMTIMEOUTS orgTimeouts; /* Original COM-Port Time-out  */
+  DWORD        rxTimeout;   /* Read timeout set (ms)       */
+  BYTE         rxBuf[MAX_FRAME_SIZE];
+  DWORD        rxFirst, rxCount;
+  OVERLAPPED   ovIo;        /* ReadFile(), WriteFile()     */
+  OVERLAPPED   ovWait;      /* WaitCommEvent()             */
+  DWORD        evMask;
+  BOOL         waitPending;
+  DWORD        lineErrors;  /* since winComLineErrors()    */
+} WIN_COM;
+
+/*-------------------------------------------------------------*/
+static void winComErrors(WIN_COM *p, DWORD errors)
+/* Counts the receive errors reported by ClearCommError().
+ */
+{
+  if (errors & CE_RXPARITY) p->lineErrors++;
+  if (errors & CE_FRAME)    p->lineErrors++;
+  if (errors & (CE_OVERRUN | CE_RXOVER)) p->lineErrors++;
+}
+
 /*-------------------------------------------------------------*/
-int comWaitForData(int count, DWORD timeout) /* exported! */
-/* Waits until a given number (count) of bytes was received or a
- * given time (timeout) has passed.
+static DWORD winComComplete(WIN_COM *p, BOOL ok)
+/* Waits for the read or write started with p->ovIo and returns
+ * the number of bytes transferred.
+ */
+{
+  DWORD n= 0;
+
+  if (!ok && (GetLastError() != ERROR_IO_PENDING))
+  {
+    return(0);
+  }
+  GetOverlappedResult(p->handle, &p->ovIo, &n, TRUE);
+  return(n);
+}
+
+/*-------------------------------------------------------------*/
+static void winComTimeout(WIN_COM *p, DWORD timeout)
+/* Sets the time ReadFile() waits (0: returns at once).
+ */
+{
+  COMMTIMEOUTS timeouts;
+
+  if (p->rxTimeout == timeout) return;
+  memset(&timeouts, 0, sizeof(timeouts));
+  if (timeout == 0)
+    timeouts.ReadIntervalTimeout= MAXDWORD;
+  else
+    timeouts.ReadTotalTimeoutConstant= timeout;
+  SetCommTimeouts(p->handle, &timeouts);
+  p->rxTimeout= timeout;
+}
+
+/*-------------------------------------------------------------*/
+void *winComOpen(LPCSTR lpszDevice, int *error)
+/* Opens the serial port given in 'lpszDevice' for
+ * winComTransport.
  */
 {
+  WIN_COM *p;
+
+  p= (WIN_COM*)calloc(1, sizeof(WIN_COM));
+  if (p == NULL)
+  {
+    *error= ERR_OPEN_COMM;
+    return(NULL);
+  }
+
+  p->handle= CreateFile(lpszDevice, GENERIC_READ | GENERIC_WRITE,
+                        0, 0, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, 0);
+  p->ovIo.hEvent= CreateEvent(NULL, TRUE, FALSE, NULL);
+  p->ovWait.hEvent= CreateEvent(NULL, TRUE, FALSE, NULL);
+  if ((p->handle == INVALID_HANDLE_VALUE) ||
+      (p->ovIo.hEvent == NULL) || (p->ovWait.hEvent == NULL) ||
+      !SetCommMask(p->handle, EV_RXCHAR) ||
+      (SetupComm(p->handle, QUEUE_SIZE, QUEUE_SIZE) == 0) ||
+      !GetCommTimeouts(p->handle, &p->orgTimeouts) ||
+      !GetCommState(p->handle, &p->dcb))
+  {
+    if (p->handle != INVALID_HANDLE_VALUE) CloseHandle(p->handle);
+    if (p->ovIo.hEvent != NULL) CloseHandle(p->ovIo.hEvent);
+    if (p->ovWait.hEvent != NULL) CloseHandle(p->ovWait.hEvent);
+    free(p);
+    *error= ERR_OPEN_COMM;
+    return(NULL);
+  }
+  p->rxTimeout= MAXDWORD;
+  winComTimeout(p, 0);
+
+  p->dcb.ByteSize    = 8;
+  p->dcb.StopBits    = ONESTOPBIT;
+  p->dcb.fBinary     = TRUE; /* Enable Binary Transmission */
+  p->dcb.ErrorChar   = (char)0xff;
+  /* Char. w/ Parity-Err are replaced with 0xff
+   *(if fErrorChar is set to TRUE)
+   */
+
+/* Change by GH */
+
+/*
+  comDCB.fRtsControl = RTS_CONTROL_ENABLE; --- For power supply
+  comDCB.fDtrControl = DTR_CONTROL_ENABLE; --- For power supply
+*/
+
+  p->dcb.fOutxCtsFlow= FALSE;        p->dcb.fOutxDsrFlow= FALSE;
+  p->dcb.fOutX       = FALSE;        p->dcb.fInX        = FALSE;
+  p->dcb.fNull       = FALSE;
+
+  p->dcb.fErrorChar  = FALSE;
+
+  *error= ERR_NONE;
+  return(p);
+} /* winComOpen */
+
+/*-------------------------------------------------------------*/
+static int winComSetLine(void *port, DWORD baudrate, int lines)
+{
+  WIN_COM *p= (WIN_COM*)port;
+
+  p->dcb.BaudRate   = baudrate;
+  p->dcb.Parity     = (lines & LINE_PARITY) ? EVENPARITY : NOPARITY;
+  p->dcb.fParity    = (lines & LINE_PARITY) ? TRUE : FALSE;
+  p->dcb.fDtrControl= (lines & LINE_DTR) ? DTR_CONTROL_ENABLE : DTR_CONTROL_DISABLE;
+  p->dcb.fRtsControl= (lines & LINE_RTS) ? RTS_CONTROL_ENABLE : RTS_CONTROL_DISABLE;
+  if (!SetCommState(p->handle, &p->dcb))
+  {
+    return(ERR_SET_COMM_STATE);
+  }
+  return(ERR_NONE);
+}
+
+/*-------------------------------------------------------------*/
+static DWORD winComWrite(void *port, const BYTE data[], DWORD count)
+{
+  WIN_COM *p= (WIN_COM*)port;
+  DWORD dwWrite= 0;
+
+  dwWrite= winComComplete(p, WriteFile(p->handle, data, count, &dwWrite, &p->ovIo));
+  return(dwWrite);
+}
+
+/*-------------------------------------------------------------*/
+static DWORD winComWaitForData(void *port, DWORD count, DWORD timeout)
+{
+  WIN_COM *p= (WIN_COM*)port;
+  DWORD dwRead, startTime= GetTickCount();
+  long left;
+
+  if (count > sizeof(p->rxBuf)) count= sizeof(p->rxBuf);
+  if (p->rxFirst + count > sizeof(p->rxBuf))
+  {
+    memmove(p->rxBuf, &p->rxBuf[p->rxFirst], p->rxCount);
+    p->rxFirst= 0;
+  }
+  while (p->rxCount < count)
+  {
+    left= (long)timeout - (long)calcTimeout(startTime);
+    winComTimeout(p, (left > 0) ? left : 0);
+    dwRead= winComComplete(p, ReadFile(p->handle, &p->rxBuf[p->rxFirst + p->rxCount],
+                                       count - p->rxCount, &dwRead, &p->ovIo));
+    p->rxCount+= dwRead;
+    if (left <= 0) break;
+  }
+  return(p->rxCount);
+}
+
+/*-------------------------------------------------------------*/
+static DWORD winComRead(void *port, BYTE data[], DWORD count)
+{
+  WIN_COM *p= (WIN_COM*)port;
+  DWORD n= 0;
+
+  while (n < count)
+  {
+    if (p->rxCount == 0)
+    {
+      winComWaitForData(port, count - n, 0);
+      if (p->rxCount == 0) break;
+    }
+    data[n++]= p->rxBuf[p->rxFirst++];
+    p->rxCount--;
+  }
+  if (p->rxCount == 0) p->rxFirst= 0;
+  return(n);
+}
+
+/*-------------------------------------------------------------*/
+static void winComPurge(void *port)
+{
+  WIN_COM *p= (WIN_COM*)port;
+
+  PurgeComm(p->handle, PURGE_RXCLEAR | PURGE_RXABORT);
+  p->rxFirst= 0;
+  p->rxCount= 0;
+}
+
+/*-------------------------------------------------------------*/
+static int winComClose(void *port)
+{
+  WIN_COM *p= (WIN_COM*)port;
+  COMSTAT comState;
   DWORD errors;
-  int rxCount= 0;
   DWORD startTime= GetTickCount();
+  int error= ERR_NONE;
+
+  /* Wait until data is transmitted, but not too long... (Timeout-Time) */
   do
   {
-    ClearCommError(hComPort, &errors, &comState);
-  } while (((rxCount= comState.cbInQue) < count) &&
-           (calcTimeout(startTime) <= timeout));
+    ClearCommError(p->handle, &errors, &comState);
+  } while ((comState.cbOutQue > 0) &&
+           (calcTimeout(startTime) < DEFAULT_TIMEOUT));
+
+  /* Clear buffers: */
+  PurgeComm(p->handle, PURGE_TXCLEAR | PURGE_TXABORT);
+  PurgeComm(p->handle, PURGE_RXCLEAR | PURGE_RXABORT);
+  /* Complete a pending WaitCommEvent(): */
+  SetCommMask(p->handle, 0);
+  if (p->waitPending)
+  {
+    GetOverlappedResult(p->handle, &p->ovWait, &errors, TRUE);
+  }
+  /* Restore original timeout values: */
+  SetCommTimeouts(p->handle, &p->orgTimeouts);
+  /* Close COM-Port: */
+  if (!CloseHandle(p->handle))
+    error= ERR_CLOSE_COMM;
+  CloseHandle(p->ovIo.hEvent);
+  CloseHandle(p->ovWait.hEvent);
+  free(p);
+  return(error);
+}
+
+/*-------------------------------------------------------------*/
+static DWORD winComTicks(void *port)
+{
+  return(GetTickCount());
+}
+
+/*-------------------------------------------------------------*/
+static void winComDelay(void *port, DWORD time)
+{
+  delay(time);
+}
+
+/*-------------------------------------------------------------*/
+static HANDLE winComRxEvent(void *port)
+{
+  WIN_COM *p= (WIN_COM*)port;
+  COMSTAT comState;
+  DWORD errors, n;
+
+  if (p->waitPending)
+  {
+    if (!GetOverlappedResult(p->handle, &p->ovWait, &n, FALSE))
+    {
+      return(p->ovWait.hEvent); /* still waiting */
+    }
+    p->waitPending= FALSE;
+  }
+  ResetEvent(p->ovWait.hEvent);
+  if (!WaitCommEvent(p->handle, &p->evMask, &p->ovWait) &&
+      (GetLastError() == ERROR_IO_PENDING))
+  {
+    p->waitPending= TRUE;
+  }
+  /* Data received before the wait was armed: */
+  ClearCommError(p->handle, &errors, &comState);
+  winComErrors(p, errors);
+  if ((comState.cbInQue > 0) || (p->rxCount > 0))
+  {
+    SetEvent(p->ovWait.hEvent);
+  }
+  return(p->ovWait.hEvent);
+}
+
+/*-------------------------------------------------------------*/
+static DWORD winComLineErrors(void *port)
+{
+  WIN_COM *p= (WIN_COM*)port;
+  COMSTAT comState;
+  DWORD errors;
 
-  return(rxCount);
+  ClearCommError(p->handle, &errors, &comState);
+  winComErrors(p, errors);
+  errors= p->lineErrors;
+  p->lineErrors= 0;
+  return(errors);
 }
 
+const BSL_TRANSPORT winComTransport=
+{
+  winComSetLine, winComWrite, winComWaitForData, winComRead,
+  winComPurge, winComClose, winComTicks, winComDelay, winComRxEvent,
+  winComLineErrors
+};
+
+/***************************************************************
+ * Protocol (per session):
+ */
+
 /*-------------------------------------------------------------*/
-int comRxHeader(BYTE *rxHeader, BYTE *rxNum,
+DWORD comTicks(BSL_SESSION *s) /* exported! */
+/* Time of the session's clock (in milliseconds).
+ */
+{
+  return(s->transport->ticks(s->port));
+}
+
+/*-------------------------------------------------------------*/
+void comDelay(BSL_SESSION *s, DWORD time) /* exported! */
+/* Delays the session by a given time in ms.
+ */
+{
+  s->transport->delay(s->port, time);
+}
+
+/*-------------------------------------------------------------*/
+int comWaitForData(BSL_SESSION *s, int count, DWORD timeout) /* exported! */
+/* Waits until a given number (count) of bytes was received or a
+ * given time (timeout) has passed.
+ */
+{
+  return((int)s->transport->waitForData(s->port, (DWORD)count, timeout));
+}
+
+/*-------------------------------------------------------------*/
+int comSetLines(BSL_SESSION *s, int lines) /* exported! */
+/* Sets the line states (LINE_xxx) at the current baudrate.
+ */
+{
+  s->lines= lines;
+  return(s->transport->setLine(s->port, s->baudrate, lines));
+}
+
+/*-------------------------------------------------------------*/
+int comRxHeader(BSL_SESSION *s, BYTE *rxHeader, BYTE *rxNum,
                 DWORD timeout)
 {
   BYTE Hdr;
-  DWORD dwRead;
 
-  if (comWaitForData(1, timeout) >= 1)
+  if (comWaitForData(s, 1, timeout) >= 1)
   {
-    ReadFile(hComPort, &Hdr, 1, &dwRead, NULL);
+    s->transport->read(s->port, &Hdr, 1);
     *rxHeader= Hdr & 0xf0;
     *rxNum   = Hdr & 0x0f;
 
     if (protocolMode == MODE_BSL)
-    { reqNo= 0;
-      seqNo= 0;
+    { s->reqNo= 0;
+      s->seqNo= 0;
       *rxNum= 0;
     }
 
@@ -141,159 +459,89 @@ int comRxHeader(BYTE *rxHeader, BYTE *rxNum,
   {
     *rxHeader= 0;
     *rxNum= 0;
-    return(lastError= ERR_RX_HDR_TIMEOUT);
+    return(s->lastError= ERR_RX_HDR_TIMEOUT);
   }
 }
 
 /*-------------------------------------------------------------*/
-void comTxHeader(const BYTE txHeader)
+void comTxHeader(BSL_SESSION *s, const BYTE txHeader)
 {
-  DWORD dwWrite;
   BYTE Hdr= txHeader;
 
-  WriteFile(hComPort, &Hdr, 1, &dwWrite, NULL);
+  s->transport->write(s->port, &Hdr, 1);
 }
 
 /***************************************************************/
-int comGetLastError()
+int comGetLastError(BSL_SESSION *s)
 /* Returns the error code generated by the last function call to
  * a SERCOMM-Function.  If this function returned without errors,
  * comGetLastError will return zero (errNoError) as well.
  */
-{ return(lastError); }
+{ return(s->lastError); }
 
 /***************************************************************/
-int comInit(LPCSTR lpszDevice, DWORD aTimeout, int aProlongFactor)
-/* Tries to open the serial port given in 'lpszDevice' and
- * initialises the port and global variables.
+int comInit(BSL_SESSION *s,
+            const BSL_TRANSPORT *transport, void *port,
+            DWORD aTimeout, int aProlongFactor)
+/* Initialises the session's protocol state for the port given
+ * (which is opened already), and sets 9600 Baud, even parity.
  * The timeout and the number of allowed errors is multiplied by
  * 'aProlongFactor' after transmission of a command to give
  * plenty of time to the micro controller to finish the command.
  * Returns zero if the function is successful.
  */
 {
-  COMMTIMEOUTS timeouts;
-  DWORD dwCommEvents;
-
-  /* Init. global variables: */
-
-  seqNo= 0;
-  reqNo= 0;
-  rxPtr= 0;
-  txPtr= 0;
-
-  timeout= aTimeout;
-  prolongFactor= aProlongFactor;
-
-  hComPort= CreateFile(lpszDevice, GENERIC_READ | GENERIC_WRITE,
-                       0, 0, OPEN_EXISTING, 0, 0);
-  /* In this application the serial port is used in
-   * nonoverlapped mode!
-   */
-  if (hComPort == INVALID_HANDLE_VALUE)
-  {
-    hComPort= 0;
-    return (lastError= ERR_OPEN_COMM); /* Error! */
-  }
-  if (SetupComm(hComPort, QUEUE_SIZE, QUEUE_SIZE) == 0)
-  {
-    CloseHandle(hComPort);
-   hComPort= 0;
-    return (lastError= ERR_OPEN_COMM); /* Error! */
-  }
-
-  /* Save original timeout values: */
-  GetCommTimeouts(hComPort, &orgTimeouts);
-  /* Set Windows timeout values (disable build-in timeouts): */
-  timeouts.ReadIntervalTimeout= 0;
-  timeouts.ReadTotalTimeoutMultiplier= 0;
-  timeouts.ReadTotalTimeoutConstant= 0;
-  timeouts.WriteTotalTimeoutMultiplier= 0;
-  timeouts.WriteTotalTimeoutConstant= 0;
-  if (!SetCommTimeouts(hComPort, &timeouts))
-  {
-    CloseHandle(hComPort);
-   hComPort= 0;
-    return (lastError= ERR_OPEN_COMM); /* Error! */
-  }
-
-  dwCommEvents= EV_RXCHAR | EV_TXEMPTY | EV_RXFLAG | EV_ERR;
-  SetCommMask(hComPort, dwCommEvents);
-
-
-  /* Get state and modify it: */
-  if (!GetCommState(hComPort, &comDCB))
-  {
-    CloseHandle(hComPort);
-   hComPort= 0;
-    return (lastError= ERR_OPEN_COMM); /* Error! */
-  }
-
-  comDCB.BaudRate    = CBR_9600; /* Startup-Baudrate: 9,6kBaud */
-  comDCB.ByteSize    = 8;
-  nakDelay= (DWORD)((11*MAX_FRAME_SIZE)/9.6);
+  /* Init. session variables: */
 
-  comDCB.Parity      = EVENPARITY;
-  comDCB.StopBits    = ONESTOPBIT;
-  comDCB.fBinary     = TRUE; /* Enable Binary Transmission */
-  comDCB.fParity     = TRUE; /* Enable Parity Check        */
-  comDCB.ErrorChar   = (char)0xff;
-  /* Char. w/ Parity-Err are replaced with 0xff
-   *(if fErrorChar is set to TRUE)
-   */
-
-/* Change by GH */
-
-/*
-  comDCB.fRtsControl = RTS_CONTROL_ENABLE; --- For power supply
-  comDCB.fDtrControl = DTR_CONTROL_ENABLE; --- For power supply
-*/
+  s->transport= transport;
+  s->port= port;
+  s->seqNo= 0;
+  s->reqNo= 0;
 
-  comDCB.fOutxCtsFlow= FALSE;        comDCB.fOutxDsrFlow= FALSE;
-  comDCB.fOutX       = FALSE;        comDCB.fInX        = FALSE;
-  comDCB.fNull       = FALSE;
+  s->timeout= aTimeout;
+  s->prolongFactor= aProlongFactor;
 
-  comDCB.fErrorChar  = FALSE;
+  s->baudrate= CBR_9600; /* Startup-Baudrate: 9,6kBaud */
+  s->lines= LINE_PARITY;
 
   /* Assign new state: */
-  if (!SetCommState(hComPort, &comDCB))
+  if (transport->setLine(port, s->baudrate, s->lines) != ERR_NONE)
   {
-    CloseHandle(hComPort);
-   hComPort= 0;
-    return(lastError= ERR_SET_COMM_STATE); /* Error! */
+    transport->close(port);
+    s->port= NULL;
+    return(s->lastError= ERR_SET_COMM_STATE); /* Error! */
   }
 
   /* Clear buffers: */
-  PurgeComm(hComPort, PURGE_TXCLEAR | PURGE_TXABORT);
-  PurgeComm(hComPort, PURGE_RXCLEAR | PURGE_RXABORT);
+  transport->purge(port);
 
-  return(lastError= 0);
+  return(s->lastError= 0);
 } /* comInit */
 
 /***************************************************************/
-DWORD comGetBaudrate()
+DWORD comGetBaudrate(BSL_SESSION *s)
 /* Returns Baudrate of the used serial port
  */
 {
-   return(comDCB.BaudRate);
+   return(s->baudrate);
 }
 
-int comChangeBaudrate(DWORD Baud)
+int comChangeBaudrate(BSL_SESSION *s, DWORD Baud)
 /* Changes Baudrate of the used serial port
  */
 {
-   comDCB.BaudRate = Baud;
-   if (!SetCommState(hComPort, &comDCB))
+   s->baudrate = Baud;
+   if (s->transport->setLine(s->port, s->baudrate, s->lines) != ERR_NONE)
    {
-      CloseHandle(hComPort);
-      hComPort= 0;
-      return(lastError= ERR_SET_COMM_STATE); /* Error! */
+      s->transport->close(s->port);
+      s->port= NULL;
+      return(s->lastError= ERR_SET_COMM_STATE); /* Error! */
    }
     return(ERR_NONE);
 }
 
 /***************************************************************/
-int comDone()
+int comDone(BSL_SESSION *s)
 /* Closes the used serial port.
  * This function must be called at the end of a program,
  * otherwise the serial port might not be released and can not be
@@ -301,59 +549,43 @@ int comDone()
  * Returns zero if the function is successful.
  */
 {
-  DWORD errors;
-  DWORD startTime= GetTickCount();
-  /* Wait until data is transmitted, but not too long... (Timeout-Time) */
-  do
-  {
-    ClearCommError(hComPort, &errors, &comState);
-  } while ((comState.cbOutQue > 0) &&
-           (calcTimeout(startTime) < timeout));
+  int error= ERR_NONE;
 
-  /* Clear buffers: */
-  PurgeComm(hComPort, PURGE_TXCLEAR | PURGE_TXABORT);
-  PurgeComm(hComPort, PURGE_RXCLEAR | PURGE_RXABORT);
-  /* Restore original timeout values: */
-  SetCommTimeouts(hComPort, &orgTimeouts);
-  /* Close COM-Port: */
-  if (!CloseHandle(hComPort))
-    return(lastError= ERR_CLOSE_COMM); /* Error! */
-  else
-    return(lastError= ERR_NONE);
+  if (s->port != NULL)
+  {
+    error= s->transport->close(s->port);
+    s->port= NULL;
+  }
+  return(s->lastError= error);
 } /* comDone */
 
 
 /***************************************************************/
 
 /*-------------------------------------------------------------*/
-int comRxFrame(BYTE *rxHeader, BYTE *rxNum)
+int comRxFrame(BSL_SESSION *s, BYTE *rxHeader, BYTE *rxNum)
 {
-  DWORD dwRead;
-  WORD checksum;
   BYTE* rxLength;
   WORD rxLengthCRC;
+  BYTE* rxFrame= s->rxFrame;
 
   rxFrame[0]= DATA_FRAME | *rxNum;
 
-  if (comWaitForData(3, timeout) >= 3)
+  if (comWaitForData(s, 3, s->timeout) >= 3)
   {
-    ReadFile(hComPort, &rxFrame[1], 3, &dwRead, NULL);
+    s->transport->read(s->port, &rxFrame[1], 3);
 
     if ((rxFrame[1] == 0) && (rxFrame[2] == rxFrame[3]))
     {
       rxLength= &rxFrame[2];      /* Pointer to rxFrame[2]   */
       rxLengthCRC= *rxLength + 2; /* Add CRC-Bytes to length */
 
-      if (comWaitForData(rxLengthCRC, timeout) >= rxLengthCRC)
+      if (comWaitForData(s, rxLengthCRC, s->timeout) >= rxLengthCRC)
       {
-        ReadFile(hComPort, &rxFrame[4], rxLengthCRC, &dwRead, NULL);
+        s->transport->read(s->port, &rxFrame[4], rxLengthCRC);
 
         /* Check received frame: */
-        checksum= calcChecksum(rxFrame, (WORD)(*rxLength+4));
-                  /* rxLength+4: Length with header but w/o CRC */
-
-        if ((rxFrame[*rxLength+4] == (BYTE)checksum) &&
-            (rxFrame[*rxLength+5] == (BYTE)(checksum >> 8)))
+        if (comCheckFrame(rxFrame))
         {
           return(ERR_NONE);
           /* Frame received correctly (=> send next frame) */
@@ -366,28 +598,16 @@ int comRxFrame(BYTE *rxHeader, BYTE *rxNum)
 }  /* comRxFrame */
 
 /*-------------------------------------------------------------*/
-int comTxRx(BYTE cmd, BYTE dataOut[], BYTE length)
-/* Sends the command cmd with the data given in dataOut to the
- * microcontroller and expects either an acknowledge or a frame
- * with result from the microcontroller.  The results are stored
- * in dataIn (if not a NULL pointer is passed).
- * In this routine all the necessary protocol stuff is handled.
- * Returns zero if the function was successful.
+int comFrame(BYTE seqNo, BYTE cmd, BYTE dataOut[], BYTE length,
+             BYTE txFrame[]) /* exported! */
+/* Builds the frame of the command cmd with the data given in
+ * dataOut (padded to an even length) into txFrame.  No session
+ * state is used, so frames can be built ahead by another thread.
+ * Returns the length of the frame.
  */
 {
-  DWORD dwWrite;
-  DWORD errors;
-  BYTE txFrame[MAX_FRAME_SIZE];
   WORD checksum= 0;
-  int k= 0;
-  int errCtr= 0;
-  int resendCtr= 0;
-  BYTE rxHeader= 0;
-  BYTE rxNum= 0;
-  int resentFrame= 0;
-  int pollCtr= 0;
 
-  /* Transmitting part ----------------------------------------*/
   /* Prepare data for transmit */
   if ((length % 2) != 0)
   { /* Fill with one byte to have even number of bytes to send */
@@ -402,48 +622,122 @@ int comTxRx(BYTE cmd, BYTE dataOut[], BYTE length)
   txFrame[2]= length;
   txFrame[3]= length;
 
-  reqNo= (seqNo + 1) % MAX_FRAME_COUNT;
-
   memcpy(&txFrame[4], dataOut, length);
 
   checksum= calcChecksum(txFrame, (WORD)(length+4));
   txFrame[length+4]= (BYTE)(checksum);
   txFrame[length+5]= (BYTE)(checksum >> 8);
 
+  return(length + 6);
+} /* comFrame */
+
+/*-------------------------------------------------------------*/
+static void comWarnAccess(BSL_SESSION *s, BYTE txFrame[])
+/* Warns if the BSL (checksum bug) may write to RAM below
+ * BSL_CRITICAL_ADDR while receiving the frame.
+ */
+{
+  WORD checksum= txFrame[txFrame[2]+4] | (txFrame[txFrame[2]+5] << 8);
+  WORD accessAddr= (0x0212 + (checksum^0xffff)) & 0xfffe;
+                   /* 0x0212: Address of wCHKSUM */
+
+  if (s->memAccessWarning && (accessAddr < BSL_CRITICAL_ADDR))
   {
-    WORD accessAddr= (0x0212 + (checksum^0xffff)) & 0xfffe;
-                     /* 0x0212: Address of wCHKSUM */
-    if (BSLMemAccessWarning && (accessAddr < BSL_CRITICAL_ADDR))
-    {
-      printf("WARNING: This command might change data "
-             "at address %x or %x!\n",
-             accessAddr, accessAddr + 1);
-    }
+    bslPrintf(s, "WARNING: This command might change data "
+                 "at address %x or %x!\n",
+              accessAddr, accessAddr + 1);
   }
+} /* comWarnAccess */
+
+/*-------------------------------------------------------------*/
+int comBuildFrame(BSL_SESSION *s, BYTE cmd, BYTE dataOut[], BYTE length,
+                  BYTE txFrame[]) /* exported! */
+/* Same as comFrame(), with the sequence number of the session.
+ */
+{
+  int txLen= comFrame(s->seqNo, cmd, dataOut, length, txFrame);
+
+  s->reqNo= (s->seqNo + 1) % MAX_FRAME_COUNT;
+  comWarnAccess(s, txFrame);
+  return(txLen);
+} /* comBuildFrame */
+
+/*-------------------------------------------------------------*/
+BOOL comCheckFrame(BYTE rxFrame[]) /* exported! */
+/* Checks the lengths and the checksum of a frame received.
+ */
+{
+  WORD checksum;
+  BYTE rxLength= rxFrame[2];
+
+  if ((rxFrame[1] != 0) || (rxFrame[2] != rxFrame[3]))
+  {
+    return(FALSE);
+  }
+  checksum= calcChecksum(rxFrame, (WORD)(rxLength+4));
+            /* rxLength+4: Length with header but w/o CRC */
+  return((rxFrame[rxLength+4] == (BYTE)checksum) &&
+         (rxFrame[rxLength+5] == (BYTE)(checksum >> 8)));
+} /* comCheckFrame */
+
+/*-------------------------------------------------------------*/
+int comTxRx(BSL_SESSION *s, BYTE cmd, BYTE dataOut[], BYTE length)
+/* Sends the command cmd with the data given in dataOut to the
+ * microcontroller and expects either an acknowledge or a frame
+ * with result from the microcontroller.  The results are stored
+ * in s->rxFrame.
+ * Returns zero if the function was successful.
+ */
+{
+  BYTE txFrame[MAX_FRAME_SIZE];
+
+  comFrame(s->seqNo, cmd, dataOut, length, txFrame);
+  return(comTxRxFrame(s, txFrame));
+} /* comTxRx */
+
+/*-------------------------------------------------------------*/
+int comTxRxFrame(BSL_SESSION *s, BYTE txFrame[])
+/* Same as comTxRx(), with a frame built by comFrame() (with
+ * s->seqNo, which is always 0 with the BSL).
+ * In this routine all the necessary protocol stuff is handled.
+ */
+{
+  BYTE length= txFrame[2];
+  int k= 0;
+  int errCtr= 0;
+  int resendCtr= 0;
+  BYTE rxHeader= 0;
+  BYTE rxNum= 0;
+  int resentFrame= 0;
+  int pollCtr= 0;
+
+  /* Transmitting part ----------------------------------------*/
+  s->reqNo= (s->seqNo + 1) % MAX_FRAME_COUNT;
+  comWarnAccess(s, txFrame);
 
   /* Transmit data: */
   k= 0;
 
   /* Clear receiving queue: */
-  PurgeComm(hComPort, PURGE_RXCLEAR | PURGE_RXABORT);
+  s->transport->purge(s->port);
+  mxPhase(s, MX_TX);
   do
   {
-    WriteFile(hComPort, &txFrame[k++], 1, &dwWrite, NULL);
-
-    ClearCommError(hComPort, &errors, &comState);
-  } while ((k < length + 6) && (comState.cbInQue == 0));
+    s->transport->write(s->port, &txFrame[k++], 1);
+  } while ((k < length + 6) && (comWaitForData(s, 1, 0) == 0));
   /* Check after each transmitted character,
    * if microcontroller did send a character (probably a NAK!).
    */
+  mxPhase(s, MX_WAIT);
 
   /* Receiving part -------------------------------------------*/
-  rxFrame[2]= 0;
-  rxFrame[3]= 0; /* Set lengths of received data to 0! */
+  s->rxFrame[2]= 0;
+  s->rxFrame[3]= 0; /* Set lengths of received data to 0! */
 
   do
   {
-    lastError= 0; /* Clear last error */
-    if (comRxHeader(&rxHeader, &rxNum, timeout*prolongFactor) == 0)
+    s->lastError= 0; /* Clear last error */
+    if (comRxHeader(s, &rxHeader, &rxNum, s->timeout*s->prolongFactor) == 0)
         /* prolong timeout to allow execution of sent command */
     { /* => Header received */
       do
@@ -451,26 +745,27 @@ int comTxRx(BYTE cmd, BYTE dataOut[], BYTE length)
         resentFrame= 0;
         switch (rxHeader)
         { case DATA_ACK:
-          if (rxNum == reqNo)
-            { seqNo= reqNo;
-              return(lastError= ERR_NONE);
+          if (rxNum == s->reqNo)
+            { s->seqNo= s->reqNo;
+              return(s->lastError= ERR_NONE);
               /* Acknowledge received correctly => next frame */
             }
           break; /* case DATA_ACK */
 
           case DATA_NAK:
-            return(lastError= ERR_RX_NAK);
+            return(s->lastError= ERR_RX_NAK);
         break; /* case DATA_NAK */
 
           case DATA_FRAME:
-            if (rxNum == reqNo)
-              if (comRxFrame(&rxHeader, &rxNum) == 0)
-                return(lastError= ERR_NONE);
+            mxPhase(s, MX_RX);
+            if (rxNum == s->reqNo)
+              if (comRxFrame(s, &rxHeader, &rxNum) == 0)
+                return(s->lastError= ERR_NONE);
           break; /* case DATA_FRAME */
 
           case CMD_FAILED:
             /* Frame ok, but command failed. */
-            return(lastError= ERR_CMD_FAILED);
+            return(s->lastError= ERR_CMD_FAILED);
           break; /* case CMD_FAILED */
 
           default:
@@ -486,16 +781,16 @@ int comTxRx(BYTE cmd, BYTE dataOut[], BYTE length)
     } /* else (comRxHeader) */
   } while (errCtr < MAX_ERR_COUNT);
 
-  if (lastError == ERR_CMD_NOT_COMPLETED)
+  if (s->lastError == ERR_CMD_NOT_COMPLETED)
   { /* Accept QUERY_RESPONSE as real ACK and correct Seq.-No.: */
-    seqNo= reqNo;
+    s->seqNo= s->reqNo;
   }
 
-  if (lastError == ERR_NONE)
-    return(lastError= ERR_COM);
+  if (s->lastError == ERR_NONE)
+    return(s->lastError= ERR_COM);
   else
-    return(lastError);
-} /* comTxRx */
+    return(s->lastError);
+} /* comTxRxFrame */
 
 
 /* EOF */
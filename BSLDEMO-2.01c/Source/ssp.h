@@ -22,6 +22,7 @@
 * is acknowledged.
 *----------------------------------------------------------------
 * 08/01 FRGR Implemented function comChangeBaudrate()
+* GH: state kept per session, serial port behind BSL_TRANSPORT
 ****************************************************************/
 
 #ifndef SSP__H
@@ -57,6 +58,8 @@
 #define ERR_CMD_FAILED         9
 /* CloseComm failed:           */
 #define ERR_CLOSE_COMM        10
+/* Command not completed before its deadline (BSLASYNC.C): */
+#define ERR_DEADLINE          11
 
 /* Header Definitions: */
 #define CMD_FAILED       0x70
@@ -76,10 +79,52 @@
 #define MAX_DATA_BYTES 250
 #define MAX_DATA_WORDS 125
 
+/* Line states set by BSL_TRANSPORT.setLine(): */
+#define LINE_PARITY      0x01 /* even parity (otherwise none) */
+#define LINE_DTR         0x02 /* DTR on                       */
+#define LINE_RTS         0x04 /* RTS on                       */
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* All state of a connection to a device (see SESSION.H): */
+typedef struct BSL_SESSION BSL_SESSION;
+
+/* Serial port (or anything that acts like one) used by a session.
+ * Each function gets the port pointer passed to comInit().
+ */
+typedef struct BSL_TRANSPORT
+{
+  /* Sets baudrate and the line states (LINE_xxx): */
+  int   (*setLine)(void *port, DWORD baudrate, int lines);
+  /* Transmits count bytes, returns the number sent: */
+  DWORD (*write)(void *port, const BYTE data[], DWORD count);
+  /* Waits until count bytes were received or timeout (ms) has
+   * passed, returns the number of bytes received (timeout 0:
+   * don't wait):
+   */
+  DWORD (*waitForData)(void *port, DWORD count, DWORD timeout);
+  /* Reads up to count bytes already received, returns the number: */
+  DWORD (*read)(void *port, BYTE data[], DWORD count);
+  /* Discards all bytes received: */
+  void  (*purge)(void *port);
+  /* Waits until all data is sent and closes the port: */
+  int   (*close)(void *port);
+  /* Clock of the port (ms), and a delay by it: */
+  DWORD (*ticks)(void *port);
+  void  (*delay)(void *port, DWORD time);
+  /* Event which is set when data has been received, to wait for
+   * several ports at once (NULL: not supported, the port is
+   * polled):
+   */
+  HANDLE (*rxEvent)(void *port);
+  /* Receive errors (parity, framing, overrun) found since the last
+   * call (NULL: not known):
+   */
+  DWORD (*lineErrors)(void *port);
+} BSL_TRANSPORT;
+
 /*---------------------------------------------------------------
  * Support Subroutines:
  *---------------------------------------------------------------
@@ -91,39 +136,67 @@ extern DWORD calcTimeout(DWORD startTime);
  * windows time (in milliseconds).
  */
 /*-------------------------------------------------------------*/
+extern WORD calcChecksum(BYTE data[], WORD length);
+/* Calculates the checksum of a frame (length bytes of data).
+ */
+/*-------------------------------------------------------------*/
 extern void delay(DWORD time);
 /* Delays the execution by a given time in ms.
  */
-/*-------------------------------------------------------------*/
-extern int comWaitForData(int count, DWORD timeout);
-/* Waits until a given number (count) of bytes was received or a
- * given time (timeout) has passed.
+
+/*---------------------------------------------------------------
+ * Windows Serial Port:
+ *---------------------------------------------------------------
  */
 
-extern void comTxHeader(const BYTE txHeader);
+/* Transport for the ports opened by winComOpen(): */
+extern const BSL_TRANSPORT winComTransport;
+
+/*-------------------------------------------------------------*/
+extern void *winComOpen(LPCSTR lpszDevice, int *error);
+/* Opens the serial port given in 'lpszDevice' (e.g.
+ * "\\\\.\\COM5") for winComTransport.
+ * Returns NULL (and the reason in *error) if it fails.
+ */
 
 /*---------------------------------------------------------------
  * Communication Subroutines:
  *---------------------------------------------------------------
  */
 
-extern int comGetLastError();
+/*-------------------------------------------------------------*/
+extern DWORD comTicks(BSL_SESSION *s);
+/* Time of the session's clock (in milliseconds).
+ */
+/*-------------------------------------------------------------*/
+extern void comDelay(BSL_SESSION *s, DWORD time);
+/* Delays the session by a given time in ms.
+ */
+/*-------------------------------------------------------------*/
+extern int comWaitForData(BSL_SESSION *s, int count, DWORD timeout);
+/* Waits until a given number (count) of bytes was received or a
+ * given time (timeout) has passed.
+ */
+/*-------------------------------------------------------------*/
+extern int comSetLines(BSL_SESSION *s, int lines);
+/* Sets the line states (LINE_xxx) at the current baudrate.
+ */
+
+extern void comTxHeader(BSL_SESSION *s, const BYTE txHeader);
+
+/*-------------------------------------------------------------*/
+extern int comGetLastError(BSL_SESSION *s);
 /* Returns the error code generated by the last function call to 
  * a SERCOMM-Function.  If this function returned without errors, 
  * comGetLastError will return zero (errNoError) as well.
  */
 
 /*-------------------------------------------------------------*/
-#ifdef __cplusplus
-extern int comInit(LPCSTR lpszDevice    = "COM1", 
-                   DWORD  aTimeout      = DEFAULT_TIMEOUT, 
-                   int    aProlongFactor= DEFAULT_PROLONG);
-#else
-extern int comInit(LPCSTR lpszDevice,
+extern int comInit(BSL_SESSION *s,
+                   const BSL_TRANSPORT *transport, void *port,
                    DWORD aTimeout, int aProlongFactor);
-#endif
-/* Tries to open the serial port given in 'lpszDevice' and
- * initialises the port and global variables.
+/* Initialises the session's protocol state for the port given
+ * (which is opened already), and sets 9600 Baud, even parity.
  * The timeout and the number of allowed errors is multiplied by
  * 'aProlongFactor' after transmission of a command to give
  * plenty of time to the micro controller to finish the command.
@@ -131,13 +204,13 @@ extern int comInit(LPCSTR lpszDevice,
  */
 
 /*-------------------------------------------------------------*/
-extern DWORD comGetBaudrate();
+extern DWORD comGetBaudrate(BSL_SESSION *s);
 /* Returns Baudrate of the used serial port
  */
-extern int comChangeBaudrate(DWORD Baud);
+extern int comChangeBaudrate(BSL_SESSION *s, DWORD Baud);
 /* Changes Baudrate of the used serial port
  */
-extern int comDone();
+extern int comDone(BSL_SESSION *s);
 /* Closes the used serial port. 
  * This function must be called at the end of a program,
  * otherwise the serial port might not be released and can not be
@@ -145,11 +218,36 @@ extern int comDone();
  * Returns zero if the function is successful.
  */
 
+/*-------------------------------------------------------------*/
+extern int comFrame(BYTE seqNo, BYTE cmd, BYTE dataOut[], BYTE length,
+                    BYTE txFrame[]);
+/* Builds the frame of the command cmd with the data given in
+ * dataOut (padded to an even length) into txFrame.  No session
+ * state is used, so frames can be built ahead by another thread.
+ * Returns the length of the frame.
+ */
+extern int comBuildFrame(BSL_SESSION *s, BYTE cmd, BYTE dataOut[],
+                         BYTE length, BYTE txFrame[]);
+/* Same as comFrame(), with the sequence number of the session.
+ */
+/*-------------------------------------------------------------*/
+extern BOOL comCheckFrame(BYTE rxFrame[]);
+/* Checks the lengths and the checksum of a frame received.
+ */
+
+/*-------------------------------------------------------------*/
+extern int comTxRx(BSL_SESSION *s, BYTE cmd, BYTE dataOut[], BYTE length);
+/* Sends the command cmd with the data given in dataOut to the
+ * microcontroller and expects either an acknowledge or a frame
+ * with result from the microcontroller (in s->rxFrame).
+ * Returns zero if the function was successful.
+ */
+extern int comTxRxFrame(BSL_SESSION *s, BYTE txFrame[]);
+/* Same as comTxRx(), with a frame built by comFrame().
+ */
 
 #ifdef __cplusplus
 }
 #endif
 
 #endif
-
-/* EOF */
\ No newline at end of file
@@ -0,0 +1,537 @@
+/****************************************************************
+*
+* Project: MSP430 Bootstrap Loader Demonstration Program
+*
+* File:    WIRETRACE.C
+*
+* Wire trace of a session (see WIRETRACE.H).
+*
+* The records lie in ring[] from first on, used bytes in all.  A
+* new record which does not fit drops the oldest ones.  Bytes are
+* added to the newest record (last) while it has the same
+* direction, room, and its last byte is less than WT_JOIN ms old.
+* With -d, each record is also written to the file when the next
+* one starts (and the last one by wtDone()).
+*
+****************************************************************/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <windows.h>
+
+#include "wiretrace.h"
+
+#define WT_MASK    (WT_SIZE - 1)
+
+/* First bytes of a file: */
+static const char wtMagic[4]= { 'W', 'T', 'R', '1' };
+
+struct BSL_WIRETRACE
+{
+  /* Transport traced: */
+  const BSL_TRANSPORT *transport;
+  void *port;
+
+  FILE *file;             /* -d: all records, NULL: none */
+  char *filename;
+  LONGLONG freq, origin;
+  DWORD first, used;
+  DWORD last;             /* newest record */
+  DWORD lastTime;         /* of its last byte (us) */
+  BYTE ring[WT_SIZE];
+};
+
+/*-------------------------------------------------------------*/
+static DWORD wtTime(BSL_WIRETRACE *t)
+/* us since wtStart(). */
+{
+  LARGE_INTEGER now;
+
+  QueryPerformanceCounter(&now);
+  return((DWORD)((now.QuadPart - t->origin) * 1000000 / t->freq));
+}
+
+/*-------------------------------------------------------------*/
+static void wtRoom(BSL_WIRETRACE *t, DWORD n)
+/* Drops the oldest records until n more bytes fit. */
+{
+  DWORD size;
+
+  while (t->used + n > WT_SIZE)
+  {
+    size= WT_HEADER + t->ring[(t->first + 1) & WT_MASK];
+    t->first= (t->first + size) & WT_MASK;
+    t->used-= size;
+  }
+}
+
+/*-------------------------------------------------------------*/
+static void wtPut(BSL_WIRETRACE *t, const BYTE data[], DWORD n)
+/* Appends n bytes (room made by wtRoom()); data may be NULL if n
+ * is 0.
+ */
+{
+  DWORD head= (t->first + t->used) & WT_MASK;
+  DWORD k= WT_SIZE - head;
+
+  if (n == 0) return;
+  if (k > n) k= n;
+  memcpy(&t->ring[head], data, k);
+  if (n > k) memcpy(t->ring, &data[k], n - k);
+  t->used+= n;
+}
+
+/*-------------------------------------------------------------*/
+static void wtFlush(BSL_WIRETRACE *t)
+/* Writes the newest record into the file. */
+{
+  DWORD size, k;
+
+  if ((t->file == NULL) || (t->used == 0)) return;
+  size= WT_HEADER + t->ring[(t->last + 1) & WT_MASK];
+  k= WT_SIZE - t->last;
+  if (k > size) k= size;
+  fwrite(&t->ring[t->last], 1, k, t->file);
+  fwrite(t->ring, 1, size - k, t->file);
+}
+
+/*-------------------------------------------------------------*/
+static void wtRecord(BSL_WIRETRACE *t, BYTE kind, const BYTE data[], DWORD n,
+                     DWORD now)
+/* Adds n bytes of the given kind, taken at now (us). */
+{
+  BYTE header[WT_HEADER];
+  BYTE *len;
+  DWORD k;
+
+  do
+  {
+    len= &t->ring[(t->last + 1) & WT_MASK];
+    if ((n > 0) && (t->used > 0) && (t->ring[t->last] == kind) &&
+        ((kind == WT_TX) || (kind == WT_RX)) && (*len < 255) &&
+        (now - t->lastTime <= WT_JOIN * 1000))
+    { /* same frame: */
+      k= 255 - *len;
+      if (k > n) k= n;
+      wtRoom(t, k);
+      wtPut(t, data, k);
+      *len+= (BYTE)k;
+    }
+    else
+    {
+      k= (n > 255) ? 255 : n;
+      wtFlush(t);
+      wtRoom(t, WT_HEADER + k);
+      t->last= (t->first + t->used) & WT_MASK;
+      header[0]= kind;
+      header[1]= (BYTE)k;
+      header[2]= (BYTE)(now);
+      header[3]= (BYTE)(now >> 8);
+      header[4]= (BYTE)(now >> 16);
+      header[5]= (BYTE)(now >> 24);
+      wtPut(t, header, WT_HEADER);
+      wtPut(t, data, k);
+    }
+    t->lastTime= now;
+    data+= k;
+    n-= k;
+  } while (n > 0);
+}
+
+/***************************************************************
+ * Transport which records the traffic (port: BSL_WIRETRACE):
+ */
+
+/*-------------------------------------------------------------*/
+static int wtSetLine(void *port, DWORD baudrate, int lines)
+{
+  BSL_WIRETRACE *t= (BSL_WIRETRACE*)port;
+  BYTE line[5];
+
+  line[0]= (BYTE)(baudrate);
+  line[1]= (BYTE)(baudrate >> 8);
+  line[2]= (BYTE)(baudrate >> 16);
+  line[3]= (BYTE)(baudrate >> 24);
+  line[4]= (BYTE)lines;
+  wtRecord(t, WT_LINE, line, sizeof(line), wtTime(t));
+  return(t->transport->setLine(t->port, baudrate, lines));
+}
+
+/*-------------------------------------------------------------*/
+static DWORD wtWriteBytes(void *port, const BYTE data[], DWORD count)
+{
+  BSL_WIRETRACE *t= (BSL_WIRETRACE*)port;
+  DWORD now= wtTime(t);   /* (the replay times the replies from here) */
+  DWORD n= t->transport->write(t->port, data, count);
+
+  if (n > 0) wtRecord(t, WT_TX, data, n, now);
+  return(n);
+}
+
+/*-------------------------------------------------------------*/
+static DWORD wtWaitForData(void *port, DWORD count, DWORD timeout)
+{
+  BSL_WIRETRACE *t= (BSL_WIRETRACE*)port;
+
+  return(t->transport->waitForData(t->port, count, timeout));
+}
+
+/*-------------------------------------------------------------*/
+static DWORD wtRead(void *port, BYTE data[], DWORD count)
+{
+  BSL_WIRETRACE *t= (BSL_WIRETRACE*)port;
+  DWORD n= t->transport->read(t->port, data, count);
+
+  if (n > 0) wtRecord(t, WT_RX, data, n, wtTime(t));
+  return(n);
+}
+
+/*-------------------------------------------------------------*/
+static void wtPurge(void *port)
+{
+  BSL_WIRETRACE *t= (BSL_WIRETRACE*)port;
+
+  wtRecord(t, WT_PURGE, NULL, 0, wtTime(t));
+  t->transport->purge(t->port);
+}
+
+/*-------------------------------------------------------------*/
+static int wtClose(void *port)
+{
+  BSL_WIRETRACE *t= (BSL_WIRETRACE*)port;
+
+  return(t->transport->close(t->port));
+}
+
+/*-------------------------------------------------------------*/
+static DWORD wtTicks(void *port)
+{
+  BSL_WIRETRACE *t= (BSL_WIRETRACE*)port;
+
+  return(t->transport->ticks(t->port));
+}
+
+/*-------------------------------------------------------------*/
+static void wtDelay(void *port, DWORD time)
+{
+  BSL_WIRETRACE *t= (BSL_WIRETRACE*)port;
+
+  t->transport->delay(t->port, time);
+}
+
+/*-------------------------------------------------------------*/
+static HANDLE wtRxEvent(void *port)
+{
+  BSL_WIRETRACE *t= (BSL_WIRETRACE*)port;
+
+  if (t->transport->rxEvent == NULL) return(NULL);
+  return(t->transport->rxEvent(t->port));
+}
+
+/*-------------------------------------------------------------*/
+static DWORD wtLineErrors(void *port)
+{
+  BSL_WIRETRACE *t= (BSL_WIRETRACE*)port;
+
+  if (t->transport->lineErrors == NULL) return(0);
+  return(t->transport->lineErrors(t->port));
+}
+
+static const BSL_TRANSPORT wtTransport=
+{
+  wtSetLine, wtWriteBytes, wtWaitForData, wtRead,
+  wtPurge, wtClose, wtTicks, wtDelay, wtRxEvent, wtLineErrors
+};
+
+/***************************************************************
+ * Trace:
+ */
+
+/*-------------------------------------------------------------*/
+int wtStart(BSL_SESSION *s)
+{
+  BSL_WIRETRACE *t;
+  LARGE_INTEGER freq, now;
+
+  if ((s->transport == NULL) || (s->trace != NULL)) return(ERR_COM);
+  if (!QueryPerformanceFrequency(&freq) || (freq.QuadPart == 0))
+  {
+    return(ERR_COM);
+  }
+  if ((t= (BSL_WIRETRACE*)calloc(1, sizeof(BSL_WIRETRACE))) == NULL)
+  {
+    return(ERR_COM);
+  }
+  if ((s->opt.traceFile != NULL) &&
+      ((t->file= fopen(s->opt.traceFile, "wb")) != NULL))
+  {
+    t->filename= s->opt.traceFile;
+    fwrite(wtMagic, 1, sizeof(wtMagic), t->file);
+  }
+  QueryPerformanceCounter(&now);
+  t->freq= freq.QuadPart;
+  t->origin= now.QuadPart;
+  t->transport= s->transport;
+  t->port= s->port;
+  s->transport= &wtTransport;
+  s->port= t;
+  s->trace= t;
+  return(((s->opt.traceFile != NULL) && (t->file == NULL)) ? ERR_FILE_WRITE : ERR_NONE);
+}
+
+/*-------------------------------------------------------------*/
+void wtDone(BSL_SESSION *s)
+{
+  BSL_WIRETRACE *t= s->trace;
+
+  if (t == NULL) return;
+  if (s->transport == &wtTransport)
+  {
+    s->transport= t->transport;
+    if (s->port != NULL) s->port= t->port; /* (NULL: closed) */
+  }
+  if (t->file != NULL)
+  {
+    wtFlush(t);
+    fclose(t->file);
+  }
+  free(t);
+  s->trace= NULL;
+}
+
+/*-------------------------------------------------------------*/
+BOOL wtWrite(BSL_SESSION *s, char *filename)
+{
+  BSL_WIRETRACE *t= s->trace;
+  FILE *f;
+  DWORD k;
+  BOOL ok;
+
+  if ((t == NULL) || ((f= fopen(filename, "wb")) == NULL)) return(FALSE);
+  k= WT_SIZE - t->first;
+  if (k > t->used) k= t->used;
+  fwrite(wtMagic, 1, sizeof(wtMagic), f);
+  fwrite(&t->ring[t->first], 1, k, f);
+  fwrite(t->ring, 1, t->used - k, f);
+  ok= (ferror(f) == 0);
+  if (fclose(f) != 0) ok= FALSE;
+  return(ok);
+}
+
+/*-------------------------------------------------------------*/
+char *wtFile(BSL_SESSION *s)
+{
+  if ((s->trace == NULL) || (s->trace->file == NULL)) return(NULL);
+  return(s->trace->filename);
+}
+
+/*-------------------------------------------------------------*/
+BYTE *wtLoad(char *filename, long *size)
+{
+  FILE *f;
+  BYTE *buf;
+  long n;
+
+  if ((f= fopen(filename, "rb")) == NULL) return(NULL);
+  fseek(f, 0, SEEK_END);
+  n= ftell(f);
+  fseek(f, 0, SEEK_SET);
+  buf= (n < (long)sizeof(wtMagic)) ? NULL : (BYTE*)malloc(n);
+  if ((buf != NULL) &&
+      ((fread(buf, 1, n, f) != (size_t)n) || (memcmp(buf, wtMagic, sizeof(wtMagic)) != 0)))
+  {
+    free(buf);
+    buf= NULL;
+  }
+  fclose(f);
+  if (buf == NULL) return(NULL);
+  *size= n - sizeof(wtMagic);
+  memmove(buf, &buf[sizeof(wtMagic)], *size);
+  return(buf);
+}
+
+/***************************************************************
+ * Decoder:
+ */
+
+/*-------------------------------------------------------------*/
+static void wtCmdText(char *text, const char *prefix, BYTE cmd)
+{
+  const char *name= bslCmdName(cmd);
+
+  if (name != NULL)
+    sprintf(text, "%s%s", prefix, name);
+  else
+    sprintf(text, "%scommand 0x%02X", prefix, cmd);
+}
+
+/*-------------------------------------------------------------*/
+static int wtTxText(BYTE d[], int n, BOOL parity, char *text)
+/* Describes bytes sent; returns the number described. */
+{
+  WORD check;
+  int len;
+
+  if (d[0] == 0x80 && n == 1)
+  {
+    strcpy(text, parity ? "sync" : "sync (loader measures the baudrate)");
+    return(1);
+  }
+  if (parity)
+  { /* ROM BSL frame: */
+    len= d[2] + 6;
+    if ((n < 6) || ((d[0] & 0xf0) != DATA_FRAME) || (d[2] != d[3]) || (n < len))
+    {
+      strcpy(text, "?");
+      return(0);
+    }
+    wtCmdText(text, "", d[1]);
+    if (d[2] >= 4)
+    {
+      sprintf(&text[strlen(text)], " addr 0x%04X len 0x%04X, %d data bytes",
+              d[4] | (d[5] << 8), d[6] | (d[7] << 8), d[2] - 4);
+    }
+    check= calcChecksum(d, (WORD)(d[2] + 4));
+    strcat(text, ((d[len-2] == (BYTE)check) && (d[len-1] == (BYTE)(check >> 8))) ?
+                 ", checksum ok" : ", CHECKSUM WRONG");
+    return(len);
+  }
+
+  /* Fast loader frame (FASTLOAD.C): */
+  if ((n < 8) || (d[0] != DATA_FRAME))
+  {
+    strcpy(text, "?");
+    return(0);
+  }
+  wtCmdText(text, "FL ", d[1]);
+  check= flChecksum(d, 6);
+  sprintf(&text[strlen(text)], " addr 0x%04X %s 0x%04X, header %s",
+          d[2] | (d[3] << 8), (d[1] == BSL_TXBLK) ? "VCK" : "len",
+          d[4] | (d[5] << 8),
+          ((d[6] | (d[7] << 8)) == check) ? "ok" : "CHECKSUM WRONG");
+  if ((d[1] != BSL_TXBLK) || (n < 10)) return(8);
+  /* (n: the whole frame, records joined by wtList()) */
+  check= flChecksum(&d[8], (WORD)(n - 10));
+  sprintf(&text[strlen(text)], ", %d stream bytes%s", n - 10,
+          ((d[n-2] | (d[n-1] << 8)) == check) ? ", data ok" : "");
+  return(n);
+}
+
+/*-------------------------------------------------------------*/
+static int wtRxText(BYTE d[], int n, char *text)
+/* Describes bytes received; returns the number described. */
+{
+  WORD check;
+  int len;
+
+  switch (d[0] & 0xf0)
+  {
+    case DATA_ACK:   strcpy(text, "DATA_ACK");   return(1);
+    case DATA_NAK:   strcpy(text, "DATA_NAK");   return(1);
+    case CMD_FAILED: strcpy(text, "CMD_FAILED"); return(1);
+    case DATA_FRAME:
+      if ((n < 4) || (d[1] != 0) || (d[2] != d[3]))
+      {
+        strcpy(text, "data frame, header wrong");
+        return(n);
+      }
+      len= d[2] + 6;
+      if (n < len)
+      {
+        sprintf(text, "data frame, %d of %d bytes", n, len);
+        return(n);
+      }
+      check= calcChecksum(d, (WORD)(d[2] + 4));
+      sprintf(text, "data frame, %d data bytes, %s", d[2],
+              ((d[len-2] == (BYTE)check) && (d[len-1] == (BYTE)(check >> 8))) ?
+              "checksum ok" : "CHECKSUM WRONG");
+      return(len);
+  }
+  strcpy(text, "?");
+  return(0);
+}
+
+/*-------------------------------------------------------------*/
+BOOL wtList(char *filename)
+{
+  BYTE *buf, *d, *frame;
+  long size, pos, next;
+  DWORD time, t0= 0;
+  BOOL parity= TRUE;      /* (the BSL starts with even parity) */
+  char text[160];
+  int n, m, k, i;
+
+  if ((buf= wtLoad(filename, &size)) == NULL) return(FALSE);
+  if ((frame= (BYTE*)malloc(size + 1)) == NULL)
+  {
+    free(buf);
+    return(FALSE);
+  }
+
+  printf("Wire trace \"%s\" (time in ms):\n", filename);
+  for (pos= 0; pos + WT_HEADER <= size; pos+= WT_HEADER + n)
+  {
+    d= &buf[pos + WT_HEADER];
+    n= buf[pos + 1];
+    if (pos + WT_HEADER + n > size) break;
+    time= buf[pos+2] | (buf[pos+3] << 8) | ((DWORD)buf[pos+4] << 16) |
+          ((DWORD)buf[pos+5] << 24);
+    if (pos == 0) t0= time;
+    printf("%11.3f ", (double)(time - t0) / 1000.0);
+
+    switch (buf[pos])
+    {
+      case WT_PURGE:
+        printf("purge\n");
+        continue;
+
+      case WT_LINE:
+        if (n < 5) break;
+        parity= (d[4] & LINE_PARITY) != 0;
+        printf("line  %lu Baud, %s, DTR %s, RTS %s\n",
+               (unsigned long)(d[0] | (d[1] << 8) | ((DWORD)d[2] << 16) | ((DWORD)d[3] << 24)),
+               parity ? "even parity" : "no parity",
+               (d[4] & LINE_DTR) ? "on" : "off", (d[4] & LINE_RTS) ? "on" : "off");
+        continue;
+
+      case WT_TX:
+      case WT_RX:
+        /* A full record is continued by the next of its kind: */
+        memcpy(frame, d, n);
+        m= n;
+        for (next= pos + WT_HEADER + n;
+             (n == 255) && (next + WT_HEADER <= size) && (buf[next] == buf[pos]) &&
+             (next + WT_HEADER + buf[next+1] <= size);
+             next= pos + WT_HEADER + n)
+        {
+          pos= next;
+          n= buf[pos + 1];
+          memcpy(&frame[m], &buf[pos + WT_HEADER], n);
+          m+= n;
+        }
+        for (i= 0; i < m; i+= k)
+        {
+          if (buf[pos] == WT_TX)
+            k= wtTxText(&frame[i], m - i, parity, text);
+          else
+            k= wtRxText(&frame[i], m - i, text);
+          if (k == 0) k= m - i;   /* (rest not decoded) */
+          printf("%s%s  %s\n", (i > 0) ? "            " : "",
+                 (buf[pos] == WT_TX) ? "tx  " : "  rx", text);
+        }
+        for (i= 0; i < m; i++)
+        {
+          printf("%s%02X", ((i % 16) == 0) ? "                  " : " ", frame[i]);
+          if (((i % 16) == 15) || (i == m - 1)) printf("\n");
+        }
+        continue;
+    }
+    printf("record '%c', %d bytes\n", buf[pos], n);
+  }
+  free(frame);
+  free(buf);
+  return(TRUE);
+}
+
+/* EOF */
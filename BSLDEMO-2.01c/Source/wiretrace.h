@@ -0,0 +1,106 @@
+/****************************************************************
+*
+* Project: MSP430 Bootstrap Loader Demonstration Program
+*
+* File:    WIRETRACE.H
+*
+* Wire trace of a session: every byte sent and received, the
+* purges of the receive queue and the line settings (baudrate,
+* parity, DTR, RTS) are kept with their time in a ring of
+* WT_SIZE bytes, which always holds the latest traffic.  The ring
+* is filled by a transport put in front of the session's by
+* bslOpen(), on the session's thread only, so it needs no lock,
+* and costs a copy of the bytes and a look at the clock.
+*
+* Records in the ring (and in the files):
+*
+*   kind, len, time (4 bytes, us since wtStart()), len bytes
+*
+*   WT_TX, WT_RX  bytes passed to write() (time: before the call) /
+*                 taken from the receive queue; bytes of the same
+*                 direction within WT_JOIN ms go into one record (up
+*                 to 255), so a record is a frame
+*   WT_PURGE      receive queue cleared (len 0)
+*   WT_LINE       baudrate (4 bytes), LINE_xxx (1 byte)
+*
+* With -d{file} (opt.traceFile) the records of the whole session go
+* into the file as well, a recording which REPLAY.C plays back.
+* Without it, the ring is written by wtWrite() on an error (the
+* latest 64 KB only).  wtList() decodes either offline (-l): each
+* record with its time, and the frames of the ROM BSL and of the
+* fast loader with their command, address, length and checksum.
+*
+****************************************************************/
+
+#ifndef WireTrace__H
+#define WireTrace__H
+
+#include "session.h"
+
+/* Size of the ring (power of 2): */
+#define WT_SIZE    0x10000
+
+/* Bytes before the data of a record: */
+#define WT_HEADER  6
+
+/* Record kinds: */
+#define WT_TX      'T'
+#define WT_RX      'R'
+#define WT_PURGE   'P'
+#define WT_LINE    'L'
+
+/* Bytes further apart (ms) start a new record: */
+#define WT_JOIN    5
+
+/* File name used if an error occurs and -d was not given: */
+#define WT_DEFAULT_FILE "BSLDEMO.WTR"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-------------------------------------------------------------*/
+int wtStart(BSL_SESSION *s);
+/* Starts the trace of the session (done by bslOpen()), and the
+ * recording into s->opt.traceFile if given.
+ * Return == 0: OK
+ * Return == ERR_FILE_WRITE: file not created (the ring runs)
+ */
+
+/*-------------------------------------------------------------*/
+void wtDone(BSL_SESSION *s);
+/* Removes the transport of wtStart(), completes the recording and
+ * frees the ring.
+ */
+
+/*-------------------------------------------------------------*/
+char *wtFile(BSL_SESSION *s);
+/* Returns the file the session is recorded into (NULL: none).
+ */
+
+/*-------------------------------------------------------------*/
+BOOL wtWrite(BSL_SESSION *s, char *filename);
+/* Writes the records in the ring (oldest first) into a file.
+ * Return == FALSE: Error!
+ */
+
+/*-------------------------------------------------------------*/
+BYTE *wtLoad(char *filename, long *size);
+/* Reads a file written by wtWrite() or recorded with -d.  Returns
+ * its records (*size bytes) in memory to be freed by the caller.
+ * Return == NULL: file can't be read
+ */
+
+/*-------------------------------------------------------------*/
+BOOL wtList(char *filename);
+/* Decodes a file written by wtWrite() to the console.
+ * Return == FALSE: file can't be read
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/* EOF */
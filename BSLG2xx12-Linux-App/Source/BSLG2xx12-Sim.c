@@ -0,0 +1,824 @@
+/*
+
+BSLG2xx12-Sim [-i|-s|-o|-f] [-mE000] [-b9600] [-e32] [-x] [-n] [-dfile] [-1]
+              [-kfile[,10]]
+BSLG2xx12-Sim -rfile [-t1.0]
+BSLG2xx12-Sim [-i|-s|-o|-f] [-mE000] -cfile[,sparse]
+
+This is a simulator of an MSP430G2xx12 with the custom BSL installed, for
+testing BSLG2xx12 without the hardware.  It creates a pseudo terminal, prints
+the name of its slave side ("Device: /dev/pts/N"), and then answers on it as
+the BSL code of Installer-G2xx12-INFO.m43 or Installer-G2xx12-Split.m43 does:
+
+ - Any byte but the command byte 0xBA is answered with the code from the
+   Response[] table of BSLG2xx12.c which identifies the BSL version and the
+   start of MAIN memory.
+
+ - On 0xBA the MAIN memory is mass erased, the reset vector at 0xFFFE is
+   pointed to the BSL (0x1000 for INFO, MAIN for Split), and for the Split
+   version the BSL code at the start of MAIN is restored.  Then the code of
+   the sync reply is sent once more to tell the host to go on.  Bytes arriving
+   while the erase is under way are lost, as on the real part.
+
+ - The following bytes are written to flash one by one, from MAIN (INFO) or
+   MAIN + 0x60 (Split, 0x50 for the old G2231 version) up to 0xFFFD, and the
+   XOR checksum of the bytes read back is formed.  The byte for 0xFFFE is the
+   checksum sent, and ACK 0xF8 or NACK 0xFE is the reply.  Then the BSL waits
+   for the next sync byte.
+
+With -f, the simulator answers as the BSL of Installer-G2xx12-Fast.m43 does,
+with the commands described there: baudrate switch 0xB1, erase 0xBA, record
+write 0xB2 with CRC-16, read 0xB3 and CRC 0xB4.  Fill bytes 0xFF between the
+commands are ignored.  The -b rate is then the rate before the switch, and the
+times of the segment erase and of the block write of each record are taken
+from the flash timing generator at 444 kHz, those of the CRCs from 70 cycles
+per byte at 8 MHz.  Bytes arriving while the BSL is busy erasing, writing or
+replying are lost.
+
+With -r, the simulator plays back the device side of a session recorded by
+BSLG2xx12 -w{file} in place of a BSL.  The bytes the host sends are compared
+with those it sent in the recording.  The bytes it received go out as long
+after the first byte of the host's write before them as they were read after
+it in the recording, times the -t scale, so the host sees the latency of the
+adapter and of the device which was recorded.  When the recording ends, or the
+host sends nothing for 2 seconds, the number of bytes sent as recorded and not,
+and the time of the replay against the time recorded are printed, and the
+simulator exits with 0 if the host has sent all bytes as recorded.
+
+Options:
+
+ -i        INFO version of the BSL (default)
+ -s        Split version
+ -o        old Split version for the G2231 (MAIN at F800 only)
+ -f        Fast version (MAIN at E000, F000 or F800)
+ -m{main}  start of MAIN memory in hex: E000 (default), F000, F800 or FC00
+ -b{baud}  bytes are taken at the rate of this baudrate (default 9600, 8N1)
+ -x        no baudrate timing - bytes are taken as fast as they arrive
+ -e{ms}    time of the mass erase in milliseconds (default 32)
+ -n        no ready signal after the erase, as with BSLs installed by earlier
+           versions of the installers
+ -d{file}  after each update, write MAIN memory to file (binary, up to 0xFFFF)
+ -1        exit after one update
+ -r{file}  replay of a recording made by BSLG2xx12 -w{file}
+ -t{scale} with -r: times of the recording multiplied by scale (default 1,
+           0: replies at once)
+ -c{file}  write a firmware file for this BSL and MAIN in Intel-HEX format and
+           exit: all of MAIN, or with ",sparse" 64 bytes of each 256, the rest
+           left erased
+ -k{file}  compare the rate of each update with the baseline file, and add it
+           there if the file has none for this BSL, MAIN and baudrate; with
+           ",{percent}" the rate may be this much lower (default 10)
+
+After each update, the simulator prints the number of bytes written, the
+number of bytes lost, the time from the command byte to the reply, and the
+reply.  The exit code after -1 is 0 for ACK, 1 otherwise.  For the Fast
+version, an update ends with the CRC command for the range up to the reset
+vector, and the number of records refused with NACK, the number of records
+written again over bytes written before, and the CRC sent are printed instead
+of the reply.  If MAIN was not erased before, the host has
+found the firmware in place, and only the CRC is printed.  After -1, the
+simulator exits with 0 when no byte has come for a second.
+
+With -k, the rate of each update - bytes written per second from the command
+byte to the reply - and the rate of the baseline are printed too, and an update
+more than the threshold slower than the baseline counts as failed, so after -1
+the exit code is 1.  A lower rate of the same firmware, BSL, MAIN and baudrate
+means a change of BSLG2xx12 has made it slower.  The files of -c are the
+firmware to use for that: the whole range, and with few bytes in many records.
+Each line of the baseline file is "{BSL} {MAIN} {baud} {bytes/sec}", with the
+rate the Fast BSL was switched to as baud.  For example:
+
+   ./BSLG2xx12-Sim -f -mE000 -cdense.hex
+   ./BSLG2xx12-Sim -f -mE000 -kbase.txt -1 &
+   ./BSLG2xx12 /dev/pts/N dense.hex -b115200
+
+This program was written in C for gcc:
+
+   gcc -O2 -o BSLG2xx12-Sim BSLG2xx12-Sim.c
+
+*/
+
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <time.h>
+#include <sys/select.h>
+#include <sys/ioctl.h>
+
+unsigned char cmdbyte = 0xBA;
+unsigned char ACK = 0xF8;
+unsigned char NACK = 0xFE;
+
+unsigned char Response[12] = {0xFF,0,0xC0,0x80,0xFC,0xF8,0xF0,0xE0,0xFE,0xAE,0xAF,0xA8};   /* Split/Info 1k-8k, Fast 2k-8k */
+long MainBeg[12] = {0xFC00,0xF800,0xF000,0xE000,0xFC00,0xF800,0xF000,0xE000,0xF800,0xE000,0xF000,0xF800};
+int BSLType[12] = {1,1,1,1,0,0,0,0,2,3,3,3};
+int BSL = 0;                /* 0 = INFO, 1 = Split, 2 = old 2231Split-0x50, 3 = Fast */
+
+/* Fast BSL: */
+long Bauds[5] = {9600,19200,38400,57600,115200};
+long FastBSLStart = 0xFC00;
+double tSegErase = 4819 / 444e3;  /* segment erase, 4819 cycles of the FTG */
+double tBlockWrite = 13 / 444e3;  /* block write, 13 cycles */
+double tBlockByte = 18 / 444e3;   /*  and 18 more per byte */
+double tCrcByte = 70 / 8e6;       /* CRC-16 of one byte at 8 MHz */
+
+long MainStart = 0xE000;
+long splitsize = 0x60;
+long baud = 9600;
+bool timing = true;
+long erasetime = 32;        /* ms */
+bool ready = true;
+char *dumpfile = NULL;
+bool once = false;
+char *replayname = NULL;
+double scale = 1.0;
+char *corpusname = NULL;
+bool sparse = false;
+char *basename = NULL;
+double threshold = 10;      /* % */
+bool slower = false;
+
+unsigned char flash[0x10000];
+unsigned char highcode[0x60];   /* Split: BSL code at the start of MAIN */
+
+/*======== Time in seconds since an arbitrary start. ========================*/
+
+double Now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*======== Wait until the given time. =======================================*/
+
+void WaitUntil(double t)
+{
+	double d = t - Now();
+
+	if (d > 0) usleep((useconds_t)(d * 1e6));
+}
+
+/*======== Display proper usage of program if error. ========================*/
+
+void Usage(char *programName)
+{
+	printf("\n%s usage:\n \n",programName);
+	printf("%s [-i|-s|-o|-f] [-mE000] [-b9600] [-e32] [-x] [-n] [-dfile] [-1] \n",programName);
+	printf("%s -rfile [-t1.0] \n",programName);
+	printf("%s [-i|-s|-o|-f] [-mE000] -cfile[,sparse] \n",programName);
+}
+
+/*======== Process command line arguments. ==================================*/
+
+int HandleOptions(int argc,char *argv[])
+{
+	int i;
+	char *comma;
+
+	for (i=1; i< argc;i++)
+	{
+		if (argv[i][0] != '-') return 1;
+		switch (argv[i][1])
+		{
+			case 'i': BSL = 0; break;
+			case 's': BSL = 1; break;
+			case 'o': BSL = 2; break;
+			case 'f': BSL = 3; break;
+			case 'm': MainStart = strtol(&argv[i][2], NULL, 16); break;
+			case 'b': baud = atol(&argv[i][2]); break;
+			case 'x': timing = false; break;
+			case 'e': erasetime = atol(&argv[i][2]); break;
+			case 'n': ready = false; break;
+			case 'd': dumpfile = &argv[i][2]; break;
+			case '1': once = true; break;
+			case 'r': replayname = &argv[i][2]; break;
+			case 't': scale = atof(&argv[i][2]); break;
+			case 'c':
+				corpusname = &argv[i][2];
+				comma = strchr(corpusname, ',');
+				if (comma != NULL)
+				{
+					*comma = 0;
+					if (strcmp(comma + 1, "sparse") != 0) return 1;
+					sparse = true;
+				}
+				break;
+			case 'k':
+				basename = &argv[i][2];
+				comma = strchr(basename, ',');
+				if (comma != NULL)
+				{
+					*comma = 0;
+					threshold = atof(comma + 1);
+				}
+				break;
+			default: return 1;
+		}
+	}
+	if (BSL == 2)
+	{
+		MainStart = 0xF800;
+		splitsize = 0x50;
+	}
+	if ((MainStart != 0xE000) && (MainStart != 0xF000) &&
+		(MainStart != 0xF800) && (MainStart != 0xFC00)) return 1;
+	if ((BSL == 3) && (MainStart == 0xFC00)) return 1;
+	if (baud <= 0) return 1;
+	if (scale < 0) return 1;
+	if ((corpusname != NULL) && (*corpusname == 0)) return 1;
+	if ((basename != NULL) && ((*basename == 0) || (threshold < 0))) return 1;
+	return 0;
+}
+
+/*======== Response byte of this BSL version and MAIN location. =============*/
+
+unsigned char SyncResponse(void)
+{
+	int i;
+
+	for (i=0; i<12; i++)
+	{
+		if ((BSLType[i] == BSL) && (MainBeg[i] == MainStart)) return Response[i];
+	}
+	return 0;
+}
+
+/*======== Write MAIN memory to the dump file. ==============================*/
+
+void DumpMain(void)
+{
+	FILE *fp;
+
+	if (dumpfile == NULL) return;
+	fp = fopen(dumpfile, "wb");
+	if (fp == NULL) return;
+	fwrite(&flash[MainStart], 1, 0x10000 - MainStart, fp);
+	fclose(fp);
+}
+
+/*======== Write a firmware file for the BSL and MAIN (-c). ===================*/
+
+/* The program starts at MAIN (INFO, Fast) or after the BSL code (Split) and
+   goes up to the reset vector, which points to its start.  The segment of the
+   Fast BSL is left free.  The data bytes vary with the address. */
+
+int WriteCorpus(void)
+{
+	FILE *fp;
+	long start, addr;
+	int i, n;
+	unsigned char data[16], sum;
+
+	fp = fopen(corpusname, "w");
+	if (fp == NULL)
+	{
+		printf("Error opening %s \n", corpusname);
+		return 2;
+	}
+	start = ((BSL == 1) || (BSL == 2)) ? MainStart + splitsize : MainStart;
+	for (addr = start; addr < 0x10000; addr += n)
+	{
+		n = 16 - (addr & 0x0F);
+		if (addr >= 0xFFFE) n = 2;
+		else if (addr + n > 0xFFFE) n = 0xFFFE - addr;
+		if ((BSL == 3) && (addr >= FastBSLStart) && (addr < FastBSLStart + 0x200)) continue;
+		if (sparse && ((addr & 0xC0) != 0) && (addr < 0xFFFE)) continue;
+
+		for (i=0; i<n; i++)
+		{
+			data[i] = (unsigned char)(((addr + i) * 7) ^ ((addr + i) >> 8));
+		}
+		if (addr == 0xFFFE)
+		{
+			data[0] = start & 0xFF;
+			data[1] = start >> 8;
+		}
+		sum = n + (addr >> 8) + (addr & 0xFF);
+		fprintf(fp, ":%02X%04lX00", n, addr);
+		for (i=0; i<n; i++)
+		{
+			fprintf(fp, "%02X", data[i]);
+			sum += data[i];
+		}
+		fprintf(fp, "%02X\n", (unsigned char)-sum);
+	}
+	fprintf(fp, ":00000001FF\n");
+	if (fclose(fp) != 0)
+	{
+		printf("Error writing %s \n", corpusname);
+		return 2;
+	}
+	printf("%s: %s firmware for %s BSL at %lX \n", corpusname,
+			sparse ? "sparse" : "dense",
+			(BSL == 0) ? "INFO" : (BSL == 3) ? "Fast" : "Split", start);
+	return 0;
+}
+
+/*======== Compare the rate of an update with the baseline (-k). =============*/
+
+/* The lines of the file are "{BSL} {MAIN} {baud} {bytes/sec}", with the rate
+   the Fast BSL was switched to.  A rate which has no line yet is added.  A
+   rate lower than that of the line by more than the threshold sets slower. */
+
+char *BSLName[4] = {"INFO", "Split", "Split-0x50", "Fast"};
+
+void CheckBaseline(long written, double seconds, long rate_baud)
+{
+	FILE *fp;
+	char line[100], name[16];
+	long mainbeg, rate, linebaud, linerate;
+	double change;
+
+	if ((basename == NULL) || (seconds <= 0)) return;
+	rate = (long)(written / seconds);
+
+	fp = fopen(basename, "r");
+	if (fp != NULL)
+	{
+		while (fgets(line, sizeof(line), fp) != NULL)
+		{
+			if ((sscanf(line, "%15s %lx %ld %ld", name, &mainbeg, &linebaud, &linerate) == 4) &&
+				(strcmp(name, BSLName[BSL]) == 0) && (mainbeg == MainStart) &&
+				(linebaud == rate_baud) && (linerate > 0))
+			{
+				fclose(fp);
+				change = (rate - linerate) * 100.0 / linerate;
+				if (change < -threshold) slower = true;
+				printf("Rate: %ld bytes/sec, baseline %ld, %+.1f%%%s \n", rate, linerate,
+						change, (change < -threshold) ? " - SLOWER" : "");
+				fflush(stdout);
+				return;
+			}
+		}
+		fclose(fp);
+	}
+
+	fp = fopen(basename, "a");
+	if ((fp == NULL) ||
+		(fprintf(fp, "%s %lX %ld %ld\n", BSLName[BSL], MainStart, rate_baud, rate) < 0) ||
+		(fclose(fp) != 0))
+	{
+		printf("Error writing %s \n", basename);
+		slower = true;
+		return;
+	}
+	printf("Rate: %ld bytes/sec, added to %s \n", rate, basename);
+	fflush(stdout);
+}
+
+/*======== CRC-16 (CCITT) as computed by the Fast BSL. =======================*/
+
+unsigned int Crc16(unsigned int crc, unsigned char* data, long length)
+{
+	int bit;
+
+	while (length-- > 0)
+	{
+		crc = crc ^ (*data++ << 8);
+		for (bit=0; bit<8; bit++)
+		{
+			if (crc & 0x8000) crc = (crc << 1) ^ 0x1021;
+			else crc = crc << 1;
+		}
+	}
+	return crc & 0xFFFF;
+}
+
+/*======== The Fast BSL: one command at a time, replies are UART bytes. =====*/
+
+int RunFast(int master)
+{
+	static unsigned char reply[0x10002];
+	unsigned char frame[70];
+	unsigned char rxData;
+	unsigned int crc = 0;
+	int got = 0;
+	int need = 0;
+	long replies;
+	long i;
+	long addr, length;
+	long written = 0, lost = 0, nacks = 0, again = 0;
+	bool erased = false, done = false;
+	long switched = baud;
+	double bytetime, tWire, tStart, tBusy, tCmd, tReply;
+	int queued = 0;
+	bool idle;
+	fd_set fds;
+	struct timeval tv;
+
+	bytetime = timing ? 10.0 / baud : 0;
+	tWire = 0;
+	tBusy = 0;
+	tCmd = 0;
+	tReply = 0;
+
+	while (true)
+	{
+		FD_ZERO(&fds);
+		FD_SET(master, &fds);
+		tv.tv_sec = (once && done) ? 1 : 0;		/* after -1, wait for the host */
+		tv.tv_usec = 0;								/*  to be done too */
+		idle = (select(master + 1, &fds, NULL, NULL, &tv) < 1);
+		if (once && done && idle) return slower ? 1 : 0;
+		if (read(master, &rxData, 1) != 1)
+		{
+			usleep(10000);
+			continue;
+		}
+
+		if (idle && (tWire < Now())) tWire = Now();	/* start bit after a gap */
+		if (queued > 0) queued--;					/* sent before the reply */
+		else if (tWire < tReply) tWire = tReply;	/*  or in answer to it */
+		tStart = tWire;								/* bytes already sent */
+		tWire = tWire + bytetime;					/*  follow at the baudrate */
+
+		if (timing && (tStart < tBusy))				/* erasing, writing, replying */
+		{
+			if (rxData != 0xFF) lost++;			/* fill bytes may go */
+			continue;
+		}
+		if ((got == 0) && (rxData == 0xFF)) continue;	/* fill byte */
+
+		frame[got++] = rxData;
+		if (got == 1)
+		{
+			switch (rxData)
+			{
+				case 0xB1: need = 2; break;			/* baudrate index */
+				case 0xB2: need = 4; break;			/* address and length */
+				case 0xB3:							/* start and end address */
+				case 0xB4: need = 5; break;
+				case 0xBA: need = 2; break;			/* confirmation */
+				default: need = 1; break;			/* sync */
+			}
+		}
+		if ((got == 4) && (frame[0] == 0xB2) && (frame[3] <= 64))
+		{
+			need = 6 + frame[3];					/* data and CRC */
+		}
+		if (got < need) continue;
+		got = 0;
+
+		tBusy = tWire;
+		reply[0] = ACK;
+		replies = 1;
+		switch (frame[0])
+		{
+			case 0xB1:
+				if (frame[1] > 4) reply[0] = NACK;
+				break;
+
+			case 0xBA:
+				if (frame[1] != SyncResponse())
+				{
+					reply[0] = NACK;
+					break;
+				}
+				for (addr = MainStart; addr < 0x10000; addr += 0x200)
+				{
+					if (addr == FastBSLStart) continue;
+					memset(&flash[addr], 0xFF, 0x200);
+					tBusy = tBusy + tSegErase;
+				}
+				flash[0xFFFE] = 0x00; flash[0xFFFF] = 0xFC;
+				written = 0;
+				lost = 0;
+				nacks = 0;
+				again = 0;
+				erased = true;
+				tCmd = tWire;
+				break;
+
+			case 0xB2:
+				if (frame[3] > 64)
+				{
+					reply[0] = NACK;
+					break;
+				}
+				tBusy = tBusy + (frame[3] + 5) * tCrcByte;
+				addr = frame[1] + (frame[2] << 8);
+				if ((Crc16(0xFFFF, &frame[1], 5 + frame[3]) != 0) ||
+					((addr & 0x3F) + frame[3] > 64) || (addr < MainStart) ||
+					((addr >= FastBSLStart) && (addr < FastBSLStart + 0x200)))
+				{
+					reply[0] = NACK;
+					break;
+				}
+				for (i=0; i<frame[3]; i++)
+				{
+					if (flash[addr+i] != 0xFF) break;
+				}
+				if (i < frame[3]) again++;				/* written before */
+				for (i=0; (i<frame[3]) && (addr+i < 0xFFFE); i++)
+				{
+					flash[addr+i] &= frame[4+i];
+				}
+				tBusy = tBusy + tBlockWrite + i * tBlockByte;
+				written = written + frame[3];
+				break;
+
+			case 0xB3:
+			case 0xB4:
+				addr = frame[1] + (frame[2] << 8);
+				length = ((frame[3] + (frame[4] << 8) - addr - 1) & 0xFFFF) + 1;
+				if (addr + length > 0x10000) length = 0x10000 - addr;	/* no wrap */
+				crc = Crc16(0xFFFF, &flash[addr], length);
+				tBusy = tBusy + length * tCrcByte;
+				replies = 0;
+				if (frame[0] == 0xB3)					/* the bytes first */
+				{
+					memcpy(reply, &flash[addr], length);
+					replies = length;
+				}
+				reply[replies++] = crc & 0xFF;
+				reply[replies++] = crc >> 8;
+				break;
+
+			default:
+				reply[0] = SyncResponse();
+		}
+		if (reply[0] == NACK) nacks++;
+
+		tBusy = tBusy + replies * bytetime;			/* reply goes out */
+		if (timing) WaitUntil(tBusy);
+		ioctl(master, FIONREAD, &queued);			/* sent before the reply */
+		tReply = Now();
+		write(master, reply, replies);
+
+		if ((frame[0] == 0xB1) && (reply[0] == ACK) && timing)
+		{
+			bytetime = 10.0 / Bauds[frame[1]];
+		}
+		if ((frame[0] == 0xB1) && (reply[0] == ACK))
+		{
+			switched = Bauds[frame[1]];
+		}
+
+		if ((frame[0] == 0xB4) && (frame[3] == 0xFE) && (frame[4] == 0xFF))
+		{
+			if (erased)
+			{
+				printf("Update: %ld bytes written, %ld lost, %ld NACK, %ld again, %.2f sec, CRC %04X \n",
+						written, lost, nacks, again, Now() - tCmd, crc);
+				CheckBaseline(written, Now() - tCmd, switched);
+				DumpMain();
+			}
+			else printf("No update, CRC %04X \n", crc);
+			fflush(stdout);
+			erased = false;
+			done = true;
+		}
+	}
+}
+
+/*======== Replay of a recording made by BSLG2xx12 -w. ======================*/
+
+/* Records as in the wire trace of BSLDEMO: kind, length, time in us (4 bytes,
+   low byte first), the bytes.  'T' bytes were sent by the host and are waited
+   for, 'R' bytes were received by it and are sent, 'L' (baudrate, DTR) means
+   nothing on a pseudo terminal. */
+
+int RunReplay(int master)
+{
+	static unsigned char rec[0x100000];
+	FILE *fp;
+	long size, pos;
+	int len = 0, i;
+	unsigned char rxData;
+	unsigned long t = 0, t0 = 0, tSent = 0;
+	double tStart, tHost;
+	long same = 0, other = 0, replied = 0;
+	fd_set fds;
+	struct timeval tv;
+
+	fp = fopen(replayname, "rb");
+	if (fp == NULL)
+	{
+		printf("Error opening %s \n", replayname);
+		return 2;
+	}
+	size = fread(rec, 1, sizeof(rec), fp);
+	fclose(fp);
+	if ((size < 4) || (memcmp(rec, "WTR1", 4) != 0))
+	{
+		printf("%s is not a recording \n", replayname);
+		return 2;
+	}
+
+	tStart = tHost = Now();
+	for (pos = 4; pos + 6 <= size; pos = pos + 6 + len)
+	{
+		len = rec[pos+1];
+		if (pos + 6 + len > size) break;				/* cut off */
+		t = rec[pos+2] | (rec[pos+3] << 8) | ((unsigned long)rec[pos+4] << 16) |
+			((unsigned long)rec[pos+5] << 24);
+		if (pos == 4) t0 = tSent = t;
+
+		if (rec[pos] == 'T')						/* host sends */
+		{
+			for (i=0; i<len; i++)
+			{
+				FD_ZERO(&fds);
+				FD_SET(master, &fds);
+				tv.tv_sec = 2;
+				tv.tv_usec = 0;
+				if ((select(master + 1, &fds, NULL, NULL, &tv) < 1) ||
+					(read(master, &rxData, 1) != 1)) goto Done;
+				if (i == 0)
+				{
+					tHost = Now();
+					tSent = t;
+				}
+				if (rxData == rec[pos+6+i]) same++;
+				else other++;
+			}
+		}
+		else if (rec[pos] == 'R')					/* host receives */
+		{
+			WaitUntil(tHost + scale * (long)(t - tSent) / 1e6);
+			write(master, &rec[pos+6], len);
+			replied = replied + len;
+		}
+	}
+	printf("End of the recording \n");
+
+Done:
+	printf("Replay: %ld bytes sent as recorded, %ld not, %ld replied, %.2f sec (recorded %.2f sec) \n",
+			same, other, replied, Now() - tStart, (t - t0) / 1e6);
+	fflush(stdout);
+	sleep(1);			/* closing the pty would drop an unread reply */
+	return (other == 0) ? 0 : 1;
+}
+
+/*============MAIN==========*/
+
+int main(int argc,char *argv[])
+{
+	int master, slave;
+	int i;
+	unsigned char rxData;
+	unsigned char reply;
+	double bytetime, tWire, tErased, tCmd;
+	long rPoint = 0;
+	unsigned char rCHKSUM = 0;
+	long written = 0, lost = 0;
+	bool writing = false;
+	struct termios tio;
+
+	if (HandleOptions(argc, argv) != 0)
+	{
+		Usage(argv[0]);
+		return 2;
+	}
+	if (corpusname != NULL) return WriteCorpus();
+
+	/* Device as installed: MAIN erased, BSL in INFO or at the start of MAIN */
+
+	memset(flash, 0xFF, sizeof(flash));
+	for (i=0; i<splitsize; i++) highcode[i] = (unsigned char)(0x30 + i);
+	if (BSL == 0)
+	{
+		flash[0xFFFE] = 0x00; flash[0xFFFF] = 0x10;		/* reset vector 0x1000 */
+	}
+	else if (BSL == 3)
+	{
+		for (i=0; i<0x200; i++) flash[FastBSLStart + i] = (unsigned char)i;
+		flash[0xFFFE] = 0x00; flash[0xFFFF] = 0xFC;		/* reset vector 0xFC00 */
+	}
+	else
+	{
+		memcpy(&flash[MainStart], highcode, splitsize);
+		flash[0xFFFE] = MainStart & 0xFF; flash[0xFFFF] = MainStart >> 8;
+	}
+
+	/* Pseudo terminal.  The slave side is kept open here too, so the
+	   master does not see a hangup each time the host closes it. */
+
+	master = posix_openpt(O_RDWR | O_NOCTTY);
+	if ((master < 0) || (grantpt(master) != 0) || (unlockpt(master) != 0))
+	{
+		printf("Error creating pseudo terminal \n");
+		return 2;
+	}
+	slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+	if (slave < 0)
+	{
+		printf("Error opening %s \n", ptsname(master));
+		return 2;
+	}
+	tcgetattr(slave, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(slave, TCSANOW, &tio);
+
+	printf("Device: %s\n", ptsname(master));
+	if (replayname != NULL)
+	{
+		printf("Replay of %s, scale %g \n", replayname, scale);
+		fflush(stdout);
+		return RunReplay(master);
+	}
+	printf("%s BSL, MAIN = %lX, reply to sync = %02X \n",
+			(BSL == 0) ? "INFO" : (BSL == 3) ? "Fast" : "Split", MainStart, SyncResponse());
+	fflush(stdout);
+
+	if (BSL == 3) return RunFast(master);
+
+	bytetime = timing ? 10.0 / baud : 0;
+	tWire = 0;
+	tErased = 0;
+	tCmd = 0;
+
+	while (true)
+	{
+		if (read(master, &rxData, 1) != 1)
+		{
+			usleep(10000);
+			continue;
+		}
+
+		/* The byte is complete one byte time after the previous one
+		   at the earliest: */
+		tWire = tWire + bytetime;
+		if (tWire < Now()) tWire = Now();
+		if (timing) WaitUntil(tWire);
+
+		if (!writing)								/* Wait4sync */
+		{
+			if (rxData != cmdbyte)
+			{
+				reply = SyncResponse();
+				write(master, &reply, 1);
+				continue;
+			}
+
+			/* EraseSeg: MAIN erased, reset vector to BSL.  Split restores
+			   its code at MAIN too - about 90 us per byte at 1 MHz: */
+			tCmd = tWire;
+			tErased = tWire + erasetime / 1000.0;
+			if (BSL != 0) tErased = tErased + splitsize * 90e-6;
+			memset(&flash[MainStart], 0xFF, 0x10000 - MainStart);
+			if (BSL == 0)
+			{
+				flash[0xFFFE] = 0x00; flash[0xFFFF] = 0x10;
+				rPoint = MainStart;
+			}
+			else
+			{
+				flash[0xFFFE] = MainStart & 0xFF; flash[0xFFFF] = MainStart >> 8;
+				memcpy(&flash[MainStart], highcode, splitsize);
+				rPoint = MainStart + splitsize;
+			}
+			rCHKSUM = 0;
+			written = 0;
+			lost = 0;
+			writing = true;
+			if (ready)
+			{
+				reply = SyncResponse();
+				WaitUntil(tErased);
+				write(master, &reply, 1);
+			}
+			continue;
+		}
+
+		if (tWire < tErased)						/* CPU held by the erase */
+		{
+			lost++;
+			continue;
+		}
+
+		if (rPoint != 0xFFFE)						/* CFW_Range */
+		{
+			flash[rPoint] &= rxData;				/* write byte to flash */
+			rCHKSUM ^= flash[rPoint++];				/* XOR of byte read back */
+			written++;
+			continue;
+		}
+
+		/* CFW_Done: byte for 0xFFFE is the checksum */
+		reply = (rxData == rCHKSUM) ? ACK : NACK;
+		if (timing) WaitUntil(tWire + bytetime);
+		write(master, &reply, 1);
+		writing = false;
+
+		printf("Update: %ld bytes written, %ld lost, %.2f sec, reply %02X \n",
+				written, lost, Now() - tCmd, reply);
+		fflush(stdout);
+		CheckBaseline(written, Now() - tCmd, baud);
+		DumpMain();
+		if (once)
+		{
+			sleep(1);			/* closing the pty would drop an unread reply */
+			return ((reply == ACK) && !slower) ? 0 : 1;
+		}
+	}
+}
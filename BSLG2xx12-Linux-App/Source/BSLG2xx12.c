@@ -0,0 +1,1207 @@
+/*
+
+BSLG2xx12 /dev/ttyUSB0            (Read BSL version and AppStart location)
+BSLG2xx12 /dev/ttyUSB0 filename   (Flash new firmware)
+BSLG2xx12 /dev/ttyUSB0 filename -b57600   (Flash at 57600 baud, Fast BSL only)
+BSLG2xx12 /dev/ttyUSB0 /dev/ttyUSB1 ... filename [-s]   (Flash several boards)
+BSLG2xx12 /dev/ttyUSB0 filename -wsession.wtr   (Record the session)
+
+This is the Linux (POSIX) version of the Windows console program BSLG2xx12.exe.
+It flashes firmware to MSP430G flash-memory Value Line microcontrollers in which
+the matching "custom" BSL firmware code has been installed.  The command line
+inputs are the serial device of the USB-to-UART adapter and the filename
+containing the new firmware to be flashed.  The sync protocol, the checks made
+on the firmware file, and the image sent to the BSL are the same as in the
+Windows version - see BSLG2xx12-Windows-App/Source/BSLG2xx12.c for the parts
+supported and a description of the INFO, Split and Fast versions of the BSL.
+The Fast BSL is switched to the rate of the -b option, 115200 by default.
+
+The serial device can also be the slave side of a pseudo terminal created by
+the device simulator BSLG2xx12-Sim (see BSLG2xx12-Sim.c), which behaves like a
+G2xx12 with the custom BSL installed.  Then the program can be tested without
+the hardware:
+
+   ./BSLG2xx12-Sim -i -mE000 &          (prints "Device: /dev/pts/N")
+   ./BSLG2xx12 /dev/pts/N firmware.hex
+
+The firmware file may be in Intel-HEX or TI-TXT format.
+
+With -w{file}, the bytes sent and received on the first device are recorded
+with their times, in the format of the wire trace of BSLDEMO (see
+BSLDEMO-2.01c/Source/wiretrace.h, BSLDEMO -l lists such a file).  BSLG2xx12-Sim
+-r{file} plays the part of the device in such a session back on its pseudo
+terminal, with the timing recorded, so a change of this program can be timed
+against real sessions without the hardware:
+
+   ./BSLG2xx12 /dev/ttyUSB0 firmware.hex -wsession.wtr
+   ./BSLG2xx12-Sim -rsession.wtr &      (prints "Device: /dev/pts/N")
+   ./BSLG2xx12 /dev/pts/N firmware.hex
+
+With -u and no device, the conversion of the firmware file into the image of
+MAIN is timed: the file is converted from memory again and again for a second,
+and the time per pass and per byte of the file is printed.  This is the part
+of the work which is done on the PC only:
+
+   ./BSLG2xx12 firmware.hex -u
+
+Up to 16 boards, each on its own serial device, are flashed at once.  The INFO
+and Split BSLs only reply to the sync, when MAIN is erased and at the end, so
+the firmware goes out to all boards in one stream, and takes no longer than for
+one board.  It is sent on each device, or with -s only on the first one, whose
+TX line then drives the RXD pins of all boards.  The replies are read from each
+device.  Boards which fail are reset and tried again one by one.  With -s, that
+goes out to all boards, and those already done are flashed once more, so they
+all need the same BSL.  The Fast BSL replies to each record, so with it the
+boards are flashed one after the other, and -s can not be used.
+
+The firmware data is sent as soon as the BSL reports that MAIN has been erased,
+or after two seconds for BSLs which do not (see the Windows version).
+
+This program pulses the DTR line low at the very beginning, which will reset the
+processor if DTR is connected to its /Reset pin.  (There is no DTR line on a
+pseudo terminal, so this step is skipped with the simulator.)
+
+This program was written in C for gcc:
+
+   gcc -O2 -o BSLG2xx12 BSLG2xx12.c
+
+*/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <sys/select.h>
+#include <sys/time.h>
+
+long MainStart = 0xE000;
+long splitsize = 0x60;
+long SplitStart = 0xE060;
+int firmwarelen = 8191;
+int comport = 0;
+int filearg = 0;
+int filelen = 0;
+unsigned char cmdbyte = 0xBA;
+unsigned char ACK = 0xF8;
+unsigned char NACK = 0xFE;
+
+unsigned char Response[12] = {0xFF,0,0xC0,0x80,0xFC,0xF8,0xF0,0xE0,0xFE,0xAE,0xAF,0xA8};   /* Split/Info 1k-8k, Fast 2k-8k */
+long MainBeg[12] = {0xFC00,0xF800,0xF000,0xE000,0xFC00,0xF800,0xF000,0xE000,0xF800,0xE000,0xF000,0xF800};
+int BSLType[12] = {1,1,1,1,0,0,0,0,2,3,3,3};
+int BSL = 4;                /* 0 = INFO, 1 = Split, 2 = old 2231Split-0x50, 3 = Fast, 4 = undefined */
+
+/* Fast BSL only: */
+unsigned char cmdbaud = 0xB1;
+unsigned char cmdwrite = 0xB2;
+unsigned char cmdread = 0xB3;
+unsigned char cmdcrc = 0xB4;
+unsigned char FILL = 0xFF;
+long Bauds[5] = {9600,19200,38400,57600,115200};
+speed_t Speeds[5] = {B9600,B19200,B38400,B57600,B115200};
+int baudindex = 4;          /* -b option, 115200 by default */
+long FastBSLStart = 0xFC00; /* BSL segment, no firmware there */
+int Version = -1;           /* reply to sync */
+
+/* Several boards: */
+#define MAXBOARDS 16
+#define RETRIES 2           /* tries one by one after the broadcast */
+int boardarg[MAXBOARDS];    /* argv index of the device of each board */
+int boards = 0;
+int hBoard[MAXBOARDS];
+char Prefix[MAXBOARDS][64]; /* device name for messages, if several boards */
+bool sharedtx = false;      /* -s option: TX line of the first device to all */
+bool otherbsl[MAXBOARDS];   /* not worth trying again */
+
+/* -w option, recording of the first device: */
+char *recordname = NULL;
+FILE *recordfile = NULL;
+unsigned long recordstart;  /* us */
+long recordbaud = 9600;
+
+/* -u option, time the conversion of the file: */
+bool timing = false;
+
+/*======== Time in microseconds. ============================================*/
+
+unsigned long Micros(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000000UL + tv.tv_usec;
+}
+
+/*======== Record bytes sent ('T') or received ('R'), or the line ('L'). ====*/
+
+/* Each record: kind, length, time in us since the start (4 bytes, low byte
+   first), the bytes.  'L' holds the baudrate (4 bytes) and 0x02 if DTR is on. */
+
+void Record(int handle, char kind, unsigned char* data, int length, unsigned long time)
+{
+	unsigned char header[6];
+	int n;
+
+	if ((recordfile == NULL) || (handle != hBoard[0])) return;
+	time = time - recordstart;
+	do
+	{
+		n = (length > 255) ? 255 : length;
+		header[0] = kind;
+		header[1] = n;
+		header[2] = time; header[3] = time >> 8; header[4] = time >> 16; header[5] = time >> 24;
+		fwrite(header, 1, 6, recordfile);
+		fwrite(data, 1, n, recordfile);
+		data = data + n;
+		length = length - n;
+	} while (length > 0);
+}
+
+/*======== Record the line state. ===========================================*/
+
+void RecordLine(int handle, bool dtr)
+{
+	unsigned char line[5];
+
+	line[0] = recordbaud; line[1] = recordbaud >> 8; line[2] = recordbaud >> 16; line[3] = recordbaud >> 24;
+	line[4] = dtr ? 0x02 : 0;
+	Record(handle, 'L', line, 5, Micros());
+}
+
+/*======== Wait a number of milliseconds. ====================================*/
+
+void msleep(unsigned int ms)
+{
+	usleep(ms * 1000);
+}
+
+/*======== Receive data from serial port, with timeout in milliseconds. =====*/
+
+bool ReadData(int handle, unsigned char* data, int length, int* dwRead, unsigned int timeout)
+{
+	struct timeval tv;
+	fd_set fds;
+	int n;
+
+	*dwRead = 0;
+	while (*dwRead < length)
+	{
+		FD_ZERO(&fds);
+		FD_SET(handle, &fds);
+		tv.tv_sec = timeout / 1000;
+		tv.tv_usec = (timeout % 1000) * 1000;
+		if (select(handle + 1, &fds, NULL, NULL, &tv) <= 0)
+			return false;								/* timeout or error */
+		n = read(handle, data + *dwRead, length - *dwRead);
+		if (n <= 0)
+			return false;
+		Record(handle, 'R', data + *dwRead, n, Micros());
+		*dwRead += n;
+	}
+	return true;
+}
+
+/*======= Transmit data through serial port, wait until all is sent. =======*/
+
+bool WriteData(int handle, unsigned char* data, int length, int* dwWritten)
+{
+	unsigned long start = Micros();
+	int n;
+
+	*dwWritten = 0;
+	while (*dwWritten < length)
+	{
+		n = write(handle, data + *dwWritten, length - *dwWritten);
+		if (n <= 0)
+			return false;
+		*dwWritten += n;
+	}
+	Record(handle, 'T', data, *dwWritten, start);
+	tcdrain(handle);
+	return true;
+}
+
+/*======== Set or clear the DTR line (no effect on a pseudo terminal). =====*/
+
+void SetDTR(int handle, bool on)
+{
+	int bits = TIOCM_DTR;
+
+	RecordLine(handle, on);
+	ioctl(handle, on ? TIOCMBIS : TIOCMBIC, &bits);
+}
+
+/*======== Display proper usage of program if /? or error. ===========*/
+
+void Usage(char *programName)
+{
+	printf("\n%s usage:\n \n",programName);
+	printf("Get BSL info:      %s /dev/ttyUSBn \n",programName);
+	printf("Flash firmware:    %s /dev/ttyUSBn filename \n",programName);
+	printf("Fast BSL rate:     -b9600, -b19200, -b38400, -b57600 or -b115200 (default) \n");
+	printf("Several boards:    %s /dev/ttyUSBn /dev/ttyUSBm ... filename \n",programName);
+	printf("                   -s  all boards on the TX line of the first device \n");
+	printf("Record session:    -wfile  bytes of the first device, for BSLG2xx12-Sim -r \n");
+	printf("Time conversion:   %s filename -u \n",programName);
+}
+
+/*======== Process command line arguments. ==========*/
+
+void HandleOptions(int argc,char *argv[])
+{
+	int i;
+
+	for (i=1; i< argc;i++)
+	{
+		if (argv[i][0] == '-')
+		{
+			if (argv[i][1] == 'b')
+			{
+				for (baudindex = 4; baudindex > 0; baudindex--)
+				{
+					if (atol(&argv[i][2]) == Bauds[baudindex]) break;
+				}
+			}
+			if (argv[i][1] == 's') sharedtx = true;
+			if (argv[i][1] == 'w') recordname = &argv[i][2];
+			if (argv[i][1] == 'u') timing = true;
+			continue;
+		}
+		else if (strncmp(argv[i], "/dev/", 5) == 0)
+		{
+			if (boards < MAXBOARDS) boardarg[boards++] = i;
+			comport = boardarg[0];
+		}
+
+		else if (strlen(argv[i]) > 3)
+		{
+			filearg = i;
+		}
+		else return;
+	}
+	return;
+}
+
+/*======== Change the baudrate of the serial port. =========================*/
+
+void SetBaud(int handle, int index)
+{
+	struct termios tio;
+
+	tcgetattr(handle, &tio);
+	cfsetispeed(&tio, Speeds[index]);
+	cfsetospeed(&tio, Speeds[index]);
+	tcsetattr(handle, TCSADRAIN, &tio);
+	recordbaud = Bauds[index];
+	RecordLine(handle, false);
+}
+
+/*======== Send a command to the Fast BSL, return its reply or -1. ==========*/
+
+int FastCommand(int handle, unsigned char* data, int length, unsigned int timeout, int index)
+{
+	unsigned char reply;
+	int n;
+
+	WriteData(handle, data, length, &n);
+
+	/* allow for the transfer time too, see the end of main() */
+	ReadData(handle, &reply, 1, &n, timeout + (length * 10000L) / Bauds[index]);
+	if (n == 0) return -1;
+	return reply;
+}
+
+/*======== CRC-16 (CCITT) as computed by the Fast BSL. =======================*/
+
+unsigned int Crc16(unsigned int crc, unsigned char* data, long length)
+{
+	int bit;
+
+	while (length-- > 0)
+	{
+		crc = crc ^ (*data++ << 8);
+		for (bit=0; bit<8; bit++)
+		{
+			if (crc & 0x8000) crc = (crc << 1) ^ 0x1021;
+			else crc = crc << 1;
+		}
+	}
+	return crc & 0xFFFF;
+}
+
+/*======== CRC of a range in the Fast BSL, and its bytes too if data. ======*/
+
+/* The range is from start up to but not including end.  Returns the CRC sent
+   by the BSL, or -1 if it did not reply in time. */
+
+long FastRange(int handle, long start, long end, unsigned char* data)
+{
+	unsigned char cmd[5];
+	unsigned char crc[2];
+	long length = 0;
+	int n;
+
+	cmd[0] = cmdcrc;
+	if (data != NULL)
+	{
+		cmd[0] = cmdread;
+		length = end - start;
+	}
+	cmd[1] = start & 0xFF;
+	cmd[2] = start >> 8;
+	cmd[3] = end & 0xFF;
+	cmd[4] = end >> 8;
+	WriteData(handle, cmd, 5, &n);
+
+	if (length > 0)
+	{
+		ReadData(handle, data, length, &n, 1000);
+		if (n < length) return -1;
+	}
+	ReadData(handle, crc, 2, &n, 1000 + (end - start) / 100);	/* 9 us per byte */
+	if (n < 2) return -1;
+	return crc[0] | (crc[1] << 8);
+}
+
+/*======== Compare MAIN of the Fast BSL with the image in buf. ==============*/
+
+/* MAIN is checked below and above the BSL segment, without the reset vector.
+   If report, the first byte which differs is found by reading MAIN back. */
+
+bool CheckFast(int handle, unsigned char* buf, bool report)
+{
+	unsigned char data[0x2000];
+	long start[2], end[2];
+	long crc, i;
+	int part;
+	bool same = true;
+
+	start[0] = MainStart;
+	end[0] = FastBSLStart;
+	start[1] = FastBSLStart + 0x200;
+	end[1] = 0xFFFE;
+	for (part=0; part<2; part++)
+	{
+		crc = Crc16(0xFFFF, &buf[start[part]-MainStart], end[part] - start[part]);
+		if (FastRange(handle, start[part], end[part], NULL) == crc) continue;
+		if (!report) return false;
+
+		crc = FastRange(handle, start[part], end[part], data);
+		if ((crc < 0) || (crc != Crc16(0xFFFF, data, end[part] - start[part])))
+		{
+			printf("MAIN %lX - %lX could not be read back \n", start[part], end[part] - 1);
+			same = false;
+			continue;
+		}
+		for (i=0; i < end[part] - start[part]; i++)
+		{
+			if (data[i] != buf[start[part]-MainStart + i])
+			{
+				printf("MAIN differs first at %lX \n", start[part] + i);
+				same = false;
+				break;
+			}
+		}
+	}
+	return same;
+}
+
+/*======== Get the Fast BSL back in step after a transfer error. ============*/
+
+/* Any record the BSL is still receiving is ended by the fill bytes, and gets
+   NACK.  Then the BSL must answer a sync byte again. */
+
+bool Resync(int handle, int index)
+{
+	unsigned char fill[70];
+	unsigned char syncbyte = NACK;
+	unsigned char reply;
+	int n, tries;
+
+	memset(fill, FILL, sizeof(fill));
+	for (tries=0; tries<3; tries++)
+	{
+		msleep(50);
+		do ReadData(handle, &reply, 1, &n, 20); while (n > 0);	/* flush input */
+		WriteData(handle, fill, sizeof(fill), &n);
+		msleep(50);
+		do ReadData(handle, &reply, 1, &n, 20); while (n > 0);
+		if (FastCommand(handle, &syncbyte, 1, 200, index) == Version) return true;
+	}
+	return false;
+}
+
+/*======== Flash the image in buf to the Fast BSL. ==========================*/
+
+/* The Fast BSL is switched to the rate of the -b option first, and must then
+   answer a sync byte at that rate.  After the erase, the image is sent in
+   records of up to 64 bytes, each with its address, length and CRC, which do
+   not cross the boundary of a 64-byte row.  Runs of 0xFF longer than RECGAP
+   are left out, since flash is 0xFF after the erase, and a record costs about
+   RECGAP bytes on the line besides its data.  Nothing is sent for the BSL
+   segment, and the BSL does not write the reset vector.
+
+   The BSL receives a record into RAM, and checks and writes it before it
+   replies.  Rather than wait for the reply, each record is followed by enough
+   fill bytes to cover that time, and then the next record is sent, up to
+   WINDOW records ahead of the replies.  A NACK, any other reply or none at all
+   means the BSL may be out of step.  Then it is brought back in step, and the
+   records are sent again from the first one not acknowledged.  The BSL writes
+   a record as one block, and flash should not be written twice without an
+   erase, so the records which may have been written before the error are
+   checked with the CRC of their range first, and only those which are not in
+   place are sent again.  At the end, the CRC of MAIN computed by the BSL must
+   match the one of the image.  The update is left out if they match already
+   before. */
+
+#define RECGAP 7            /* command, address, length, CRC and reply */
+#define WINDOW 4            /* records sent but not yet acknowledged */
+#define MAXERRORS 20        /* transfer errors before giving up */
+#define MAXRECORDS 2048
+
+long RecAddr[MAXRECORDS];
+int RecLen[MAXRECORDS];
+bool RecDone[MAXRECORDS];
+
+/* Fill bytes to send after a record while the BSL checks and writes it, and
+   sends the reply.  The CRC takes about 70 cycles per byte at 8 MHz.  The
+   block write takes 13 cycles of the flash timing generator at 444 kHz, and
+   18 more per byte.  10% is added for the tolerance of the DCO. */
+
+int FillCount(int length, int index)
+{
+	double busy;
+
+	busy = 1.1 * ((length + 5) * 70 / 8e6 + (13 + 18 * length) / 444e3);
+	return (int)(busy * Bauds[index] / 10) + 1 + 3;		/* reply, margin */
+}
+
+bool FlashFast(int handle, unsigned char* buf)
+{
+	unsigned char row[256];
+	unsigned char syncbyte = NACK;
+	unsigned char reply;
+	unsigned int crc;
+	long addr, end, rowend;
+	long sent = 0;
+	int records = 0, next, acked, errors = 0, resent = 0;
+	int index = 0;
+	int length, fills, timeout;
+	int i, n;
+
+	if (baudindex != 0)
+	{
+		row[0] = cmdbaud;
+		row[1] = baudindex;
+		if (FastCommand(handle, row, 2, 1000, 0) != ACK)
+		{
+			printf("Baudrate %ld not accepted \n", Bauds[baudindex]);
+			return false;
+		}
+		SetBaud(handle, baudindex);
+		index = baudindex;
+		if (FastCommand(handle, &syncbyte, 1, 1000, index) != Version)
+		{
+			printf("No sync at %ld baud - reset the MCU, and try a lower rate with -b \n", Bauds[index]);
+			return false;
+		}
+		printf("Sync at %ld baud \n", Bauds[index]);
+	}
+
+	if (CheckFast(handle, buf, false))
+	{
+		printf("Firmware already in place - MAIN left as it is \n");
+		return true;
+	}
+
+	for (addr = MainStart; addr < 0xFFFE; addr = end)		/* cut the image into records */
+	{
+		end = addr + 1;
+		if ((addr >= FastBSLStart) && (addr < FastBSLStart + 0x200))
+		{
+			end = FastBSLStart + 0x200;
+			continue;
+		}
+		if (buf[addr-MainStart] == 0xFF) continue;
+
+		rowend = (addr | 63) + 1;						/* record stays in its row */
+		if (rowend > 0xFFFE) rowend = 0xFFFE;
+		for (i = end; (i < rowend) && (i <= end + RECGAP); i++)
+		{
+			if (buf[i-MainStart] != 0xFF) end = i + 1;
+		}
+		RecAddr[records] = addr;
+		RecLen[records] = end - addr;
+		RecDone[records] = false;
+		sent = sent + RecLen[records];
+		records++;
+	}
+
+	printf("Erasing MAIN \n");
+	row[0] = cmdbyte;
+	row[1] = Version;
+	if (FastCommand(handle, row, 2, 2000, index) != ACK)
+	{
+		printf("No response to erase \n");
+		return false;
+	}
+
+	printf("Sending %ld bytes of firmware data in %d records \n", sent, records);
+	next = 0;
+	acked = 0;
+	while (acked < records)
+	{
+		if (RecDone[acked])								/* in place already */
+		{
+			if (next == acked) next++;
+			acked++;
+			continue;
+		}
+		while ((next < records) && RecDone[next]) next++;
+		timeout = 0;									/* just look for replies */
+		if ((next < records) && (next - acked < WINDOW))
+		{
+			addr = RecAddr[next];
+			length = RecLen[next];
+			row[0] = cmdwrite;
+			row[1] = addr & 0xFF;
+			row[2] = addr >> 8;
+			row[3] = length;
+			memcpy(&row[4], &buf[addr-MainStart], length);
+			crc = Crc16(0xFFFF, &row[1], 3 + length);
+			row[4+length] = crc >> 8;
+			row[5+length] = crc & 0xFF;
+			fills = FillCount(length, index);
+			memset(&row[6+length], FILL, fills);
+			WriteData(handle, row, 6 + length + fills, &n);
+			next++;
+		}
+		else timeout = 1000 + (WINDOW * 250 * 10000L) / Bauds[index];
+
+		ReadData(handle, &reply, 1, &n, timeout);
+		if (n == 0)
+		{
+			if (timeout == 0) continue;
+			printf("No response to record %lX \n", RecAddr[acked]);
+		}
+		else if (reply == ACK)
+		{
+			acked++;
+			continue;
+		}
+		else if (reply == NACK) printf("Record %lX not accepted \n", RecAddr[acked]);
+		else printf("Invalid response to record %lX: %X \n", RecAddr[acked], reply);
+
+		errors++;
+		if ((errors > MAXERRORS) || !Resync(handle, index))
+		{
+			printf("Too many transfer errors - update failed \n");
+			return false;
+		}
+		for (i = acked; i < next; i++)					/* written before the error? */
+		{
+			if (RecDone[i]) continue;
+			addr = RecAddr[i];
+			if (FastRange(handle, addr, addr + RecLen[i], NULL)
+				== Crc16(0xFFFF, &buf[addr-MainStart], RecLen[i])) RecDone[i] = true;
+			else resent++;
+		}
+		next = acked;
+	}
+	if (errors > 0) printf("%d transfer errors, %d records sent again \n", errors, resent);
+
+	if (!CheckFast(handle, buf, true))
+	{
+		printf("Flashing performed, but CRC did not match \n");
+		return false;
+	}
+	printf("Update Successful \n");
+	return true;
+}
+
+/*======== Time in milliseconds. ===========================================*/
+
+unsigned long Millis(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000UL + tv.tv_usec / 1000;
+}
+
+/*======== Send data to the boards of the set. ==============================*/
+
+/* With -s, the data goes out on the first device only, which reaches all the
+   boards.  Else it goes out on the device of each board in the set, a piece at
+   a time, so that all lines are busy at once.  Returns the number of bytes
+   sent on the line which took the fewest. */
+
+int SendAll(bool* set, unsigned char* data, int length)
+{
+	int sent[MAXBOARDS];
+	int b, n, pos, part;
+	int fewest = length;
+	unsigned long start;
+
+	for (b=0; b<boards; b++) sent[b] = 0;
+	for (pos = 0; pos < length; pos = pos + part)
+	{
+		part = length - pos;
+		if (part > 256) part = 256;
+		for (b=0; b<boards; b++)
+		{
+			if (!sharedtx && !set[b]) continue;
+			while (sent[b] < pos + part)
+			{
+				start = Micros();
+				n = write(hBoard[b], data + sent[b], pos + part - sent[b]);
+				if (n <= 0) break;
+				Record(hBoard[b], 'T', data + sent[b], n, start);
+				sent[b] += n;
+			}
+			if (sharedtx) break;
+		}
+	}
+	for (b=0; b<boards; b++)
+	{
+		if (!sharedtx && !set[b]) continue;
+		tcdrain(hBoard[b]);
+		if (sent[b] < fewest) fewest = sent[b];
+		if (sharedtx) break;
+	}
+	return fewest;
+}
+
+/*======== Read one reply from each board of the set. =======================*/
+
+/* reply[b] is the byte, or -1 if none came.  The boards reply at the same
+   time, so the timeout counts for all of them together. */
+
+void ReadAll(bool* set, int* reply, unsigned int timeout)
+{
+	unsigned long deadline = Millis() + timeout;
+	unsigned char inbyte;
+	long wait;
+	int b, n;
+
+	for (b=0; b<boards; b++)
+	{
+		reply[b] = -1;
+		if (!set[b]) continue;
+		wait = (long)(deadline - Millis());
+		ReadData(hBoard[b], &inbyte, 1, &n, (wait > 0) ? wait : 0);
+		if (n > 0) reply[b] = inbyte;
+	}
+}
+
+/*======== Reset the boards of the set, and sync with their BSL. ============*/
+
+/* The first version code decides the BSL type and MAIN for the firmware file.
+   Boards which do not answer, or have another BSL, are taken out of the set.
+   Returns false if no board is left. */
+
+bool SyncBoards(bool* set)
+{
+	unsigned char syncbyte = NACK;		/* anything but the command byte */
+	unsigned char inbyte;
+	int reply[MAXBOARDS];
+	bool waiting[MAXBOARDS];
+	int b, i, n, tries;
+	int left = 0;
+	bool any = false;
+
+	printf("Resetting MCU via DTR, if connected to /Reset \n");
+	for (b=0; b<boards; b++)
+	{
+		if (!set[b]) continue;
+		SetDTR(hBoard[b], true);								/* toggle DTR (Reset) */
+		SetDTR(hBoard[b], false);
+	}
+	msleep(100);
+	for (b=0; b<boards; b++)
+	{
+		waiting[b] = set[b];
+		if (!set[b]) continue;
+		left++;
+		do ReadData(hBoard[b], &inbyte, 1, &n, 100); while (n > 0);	/* flush input */
+	}
+
+	for (tries=0; (tries<3) && (left>0); tries++)
+	{
+		printf("Sending sync \n");
+		SendAll(waiting, &syncbyte, 1);							/* wait for version code */
+		ReadAll(waiting, reply, 1000);
+		for (b=0; b<boards; b++)
+		{
+			if (!waiting[b]) continue;
+			if (reply[b] < 0)
+			{
+				printf("%sNo response \n", Prefix[b]);
+				continue;
+			}
+			for (i=0; (i<12) && (reply[b] != Response[i]); i++);
+			if (i == 12)
+			{
+				printf("%sInvalid response %X \n", Prefix[b], reply[b]);
+				continue;
+			}
+			waiting[b] = false;
+			left--;
+			if (Version < 0)
+			{
+				BSL = BSLType[i];
+				Version = reply[b];
+				MainStart = MainBeg[i];
+				if (BSL==2) splitsize = 0x50;
+				SplitStart = MainStart + splitsize;
+				firmwarelen = 0xFFFF - MainStart;
+			}
+			else if (reply[b] != Version)
+			{
+				printf("%sBSL version %X differs from %X \n", Prefix[b], reply[b], Version);
+				if (sharedtx) return false;				/* it would get the data too */
+				set[b] = false;
+				otherbsl[b] = true;
+				continue;
+			}
+			any = true;
+
+			if (BSL == 0) printf("%sSync acknowledged - INFO BSL, MAIN = %lX, AppStart = %lX \n", Prefix[b], MainStart, MainStart);
+			else if (BSL == 3) printf("%sSync acknowledged - Fast BSL, MAIN = %lX, AppStart = %lX \n", Prefix[b], MainStart, MainStart);
+			else printf("%sSync acknowledged - Split BSL, MAIN = %lX, AppStart = %lX \n", Prefix[b], MainStart,SplitStart);
+		}
+	}
+	for (b=0; b<boards; b++)
+	{
+		if (waiting[b]) set[b] = false;
+	}
+	return any;
+}
+
+/*======== Flash the image in buf to the boards of the set. =================*/
+
+/* INFO and Split BSL.  Boards which do not reply ACK are taken out of the
+   set. */
+
+void FlashBoards(bool* set, unsigned char* buf)
+{
+	int reply[MAXBOARDS];
+	int b, sent;
+
+	printf("Sending command byte \n");
+	SendAll(set, &cmdbyte, 1);
+
+	/* The BSL sends its version code again when MAIN has been erased.  BSLs
+	   installed before that send nothing, so go on after 2 seconds anyway. */
+
+	ReadAll(set, reply, 2000);
+	for (b=0; b<boards; b++)
+	{
+		if (set[b] && (reply[b] < 0)) printf("%sNo ready signal - older BSL, erase assumed done \n", Prefix[b]);
+	}
+
+	printf("Sending firmware data and checksum \n");
+
+	sent = SendAll(set, buf, filelen);
+
+	printf("%d bytes sent \n",sent);
+	if(filelen != sent) printf("Should have sent %d \n",filelen);
+
+	/* tcdrain() may return before the data is on the wire (pseudo terminals,
+	   some USB adapters), so allow for the transfer time as well: */
+	ReadAll(set, reply, 2000 + (filelen * 10000L) / 9600);
+
+	for (b=0; b<boards; b++)
+	{
+		if (!set[b]) continue;
+		if (reply[b] == ACK)
+		{
+			printf("%sUpdate Successful \n", Prefix[b]);
+			continue;
+		}
+		set[b] = false;
+		if (reply[b] < 0) printf("%sNo response received \n", Prefix[b]);
+		else if (reply[b] == NACK) printf("%sFlashing performed, but checksum did not match \n", Prefix[b]);
+		else printf("%sInvalid response received: %d \n", Prefix[b], reply[b]);
+	}
+}
+
+/*======== Convert the firmware file into the MAIN image. ===================*/
+
+/* buf holds MAIN from MainStart on, erased before, and xorsum the XOR of its
+   bytes.  Returns false if the file locates data below MainStart. */
+
+bool ReadFirmware(FILE *infile, unsigned char* buf, unsigned char* xorsum)
+{
+	int linelen= 0;
+	int linepos= 0;
+	unsigned long currentAddr = MainStart;
+	unsigned long netAddr = 0;
+	char strdata[128];
+	unsigned char temp = 0;
+	unsigned char temp1 = 0;
+
+	/* Convert data for MSP430, file is parsed line by line: */
+	while (true)
+	{
+		/* Read one line: */
+		if ((fgets(strdata, 127, infile) == 0) || (strdata[0] == 'q'))
+			/* if End Of File or if q (last character in file)	*/
+		{
+			break;
+		}
+
+		if (strdata[0] == ':')                  /* is this a hex file */
+		{									    /* yes - process the lines */
+			sscanf(&strdata[1], "%02x", &linelen);  /*number of data bytes in line */
+			if (linelen == 0)					/* if zero, it's the last line */
+			{
+				break;
+			}
+			sscanf(&strdata[3], "%04lx", &currentAddr);  /* the address for this line's data */
+			if (currentAddr < MainStart)				/* must not be below F800 */
+			{
+				printf("File locates data below %lX \n", MainStart);
+				return false;
+			}
+
+			netAddr = currentAddr - MainStart;			/* calculate position in binary image */
+
+			for (linepos= 9; linepos < 9+(linelen*2); linepos+= 2, netAddr++)
+			{
+				*xorsum = *xorsum ^ buf[netAddr];		/* take out existing byte */
+
+				temp = strdata[linepos] - 0x30;		/* replace FF with new byte */
+				if (temp > 9) temp -= 7;			/* hex to binary */
+				temp1 = strdata[linepos+1] - 0x30;
+				if (temp1 > 9) temp1 -= 7;
+				buf[netAddr] = (temp << 4) + temp1;
+
+				*xorsum = *xorsum ^ buf[netAddr];		/* add in replacement byte */
+			}
+			continue;								/* go back to *while* */
+		}
+
+		else										/* if a TI-TXT file */
+		{
+			linelen= strlen(strdata);				/* basically same process */
+
+			if (strdata[0] == '@')
+			{
+				sscanf(&strdata[1], "%lx\n", &currentAddr);
+				if (currentAddr < MainStart)
+				{
+					printf("File locates data below %lX \n", MainStart);
+					return false;
+				}
+				netAddr = currentAddr - MainStart;
+				continue;
+			}
+
+			/* Transfer data in line into binary inage: */
+			for (linepos= 0; linepos < linelen-3; linepos+= 3, netAddr++)
+			{
+				*xorsum = *xorsum ^ buf[netAddr];    /* take out existing byte */
+
+				temp = strdata[linepos] - 0x30;
+				if (temp > 9) temp -= 7;
+				temp1 = strdata[linepos+1] - 0x30;
+				if (temp1 > 9) temp1 -= 7;
+				buf[netAddr] = (temp << 4) + temp1;
+
+				*xorsum = *xorsum ^ buf[netAddr];    /* add in replacement byte */
+			}
+		}
+	}			/* end of While */
+	return true;
+}
+
+/*======== Time the conversion of the firmware file (-u). ===================*/
+
+/* The file is read into memory once and converted from there again and again
+   for a second, as for MAIN at E000, so the time is that of the parsing and
+   conversion only. */
+
+int TimeFirmware(char *filename)
+{
+	static char text[0x40000];
+	unsigned char buf[0x10000];
+	unsigned char xorsum;
+	FILE *infile;
+	size_t size;
+	long passes = 0;
+	unsigned long start, elapsed;
+
+	infile = fopen(filename, "rb");
+	if (infile == NULL)
+	{
+		printf("File Not Found.\n");
+		return 1;
+	}
+	size = fread(text, 1, sizeof(text), infile);
+	fclose(infile);
+
+	start = Micros();
+	do
+	{
+		memset(buf, 0xFF, sizeof(buf));
+		xorsum = 0;
+		infile = fmemopen(text, size, "rb");
+		if (infile == NULL) return 1;
+		if (!ReadFirmware(infile, buf, &xorsum))
+		{
+			fclose(infile);
+			return 1;
+		}
+		fclose(infile);
+		passes++;
+		elapsed = Micros() - start;
+	} while (elapsed < 1000000);
+
+	printf("Conversion of %s: %ld bytes, %ld passes, %.1f us per pass, %.1f ns/byte \n",
+			filename, (long)size, passes, (double)elapsed / passes,
+			elapsed * 1000.0 / ((double)passes * size));
+	return 0;
+}
+
+/*============MAIN==========*/
+
+int main(int argc,char *argv[])
+{
+	int i;
+	int j;
+	int b;
+	unsigned char buf[0x10000];
+	bool active[MAXBOARDS];		/* boards being flashed */
+	bool one[MAXBOARDS];
+	int updated = 0;
+	int result = 1;				/* exit code: 0 only if all boards made it */
+
+	/*handle the program options*/
+	HandleOptions(argc,argv);
+	if (timing && (filearg != 0)) return TimeFirmware(argv[filearg]);
+	if (comport == 0)
+	{
+		Usage(argv[0]);
+		return 0;
+	}
+
+	/*Init 8K buffer to all FFs */
+
+	for (i = 0; i < firmwarelen+1; i++)   /* create binary 8K MAIN image*/
+	{									  /*  with all FFs*/
+		buf[i] = 0xff;
+	}
+
+	/* Open serial ports */
+
+	struct termios dcbMasterInitState[MAXBOARDS];
+	struct termios dcbMaster;
+
+	for (b=0; b<boards; b++)
+	{
+		Prefix[b][0] = 0;
+		if (boards > 1) snprintf(Prefix[b], sizeof(Prefix[b]), "%s: ", argv[boardarg[b]]);
+
+		hBoard[b] = open(argv[boardarg[b]], O_RDWR | O_NOCTTY);
+		if (hBoard[b] < 0)
+		{
+			printf("%sError opening port \n", Prefix[b]);
+			while (b-- > 0)
+			{
+				tcsetattr(hBoard[b], TCSANOW, &dcbMasterInitState[b]);
+				close(hBoard[b]);
+			}
+			return 1;
+		}
+		printf("%sSerial port Opened \n", Prefix[b]);
+
+		tcflush(hBoard[b], TCIOFLUSH);
+		tcgetattr(hBoard[b], &dcbMasterInitState[b]);
+
+		dcbMaster = dcbMasterInitState[b];
+		cfmakeraw(&dcbMaster);
+		cfsetispeed(&dcbMaster, B9600);
+		cfsetospeed(&dcbMaster, B9600);
+		dcbMaster.c_cflag &= ~(PARENB | CSTOPB | CRTSCTS);	/* 8N1, no handshake */
+		dcbMaster.c_cflag |= CS8 | CLOCAL | CREAD;
+		dcbMaster.c_cc[VMIN] = 0;
+		dcbMaster.c_cc[VTIME] = 0;
+		tcsetattr(hBoard[b], TCSANOW, &dcbMaster);
+		active[b] = true;
+	}
+
+	if (recordname != NULL)
+	{
+		recordfile = fopen(recordname, "wb");
+		if (recordfile == NULL) printf("Error creating %s \n", recordname);
+		else fwrite("WTR1", 1, 4, recordfile);
+		recordstart = Micros();
+	}
+
+	msleep(400);
+
+	if (!SyncBoards(active)) goto CloseExit;
+
+	if (filearg == 0)							/* sync only */
+	{
+		for (b=0; b<boards; b++) if (active[b]) updated++;
+		result = (updated < boards) ? 1 : 0;
+		goto CloseExit;
+	}
+
+	/*Open firmware new firmware file for reading, process contents*/
+
+	unsigned char xorsum = 0;
+	unsigned long resetAdr = 0xE000;
+	unsigned char temp = 0;
+
+	FILE *infile;						//open the file
+
+	infile = fopen(argv[filearg], "rb");
+	if (infile == NULL)
+	{
+		printf("File Not Found.\n");
+		Usage(argv[0]);
+		goto CloseExit;
+	}
+	if (!ReadFirmware(infile, buf, &xorsum))
+	{
+		fclose(infile);
+		goto CloseExit;
+	}
+	fclose(infile);
+
+	/* "break" goes here */
+
+	/* now check to see if data makes sense */
+
+	resetAdr = buf[firmwarelen-1] + (buf[firmwarelen] * 256);
+	temp = 0xFF;
+
+	if ((resetAdr != MainStart) && ((BSL == 0) || (BSL == 3)))
+	{
+		printf("Reset vector %lX must show program starts at %lX for %s BSL \n",
+				resetAdr, MainStart, (BSL == 0) ? "INFO" : "Fast");
+		goto CloseExit;
+	}
+
+	if ((resetAdr != SplitStart) && ((BSL == 1) || (BSL == 2)))
+	{
+		printf("Reset vector %lX must show program starts at %lX for Split BSL \n",
+				resetAdr, SplitStart);
+		goto CloseExit;
+	}
+	for (i=0; i<4; i++)
+	{
+		temp = temp & buf[resetAdr-MainStart + i];
+	}
+
+	if (temp == 0xFF)
+	{
+		printf("No code stored where reset vector points - %lX \n", resetAdr);
+		goto CloseExit;
+	}
+
+	if (resetAdr == SplitStart)
+	{
+		temp = 0xFF;
+		for (i=0; i<splitsize; i++)
+		{
+			temp = temp & buf[i];                      /* should be no bytes below SplitStart */
+		}
+
+		if (temp != 0xFF)
+		{
+			printf("Code stored below where reset vector points - %lX \n",resetAdr);
+			goto CloseExit;
+		}
+	}
+
+	if (BSL == 3)
+	{
+		temp = 0xFF;
+		for (i=0; i<0x200; i++)
+		{
+			temp = temp & buf[FastBSLStart-MainStart + i];	/* BSL segment must stay free */
+		}
+
+		if (temp != 0xFF)
+		{
+			printf("Code stored in the BSL segment %lX - %lX \n", FastBSLStart, FastBSLStart+0x1FF);
+			goto CloseExit;
+		}
+
+		if (sharedtx && (boards > 1))
+		{
+			printf("The Fast BSL replies to each record - one TX line per board, no -s \n");
+			goto CloseExit;
+		}
+		for (b=0; b<boards; b++)
+		{
+			if (!active[b]) continue;
+			if (boards > 1) printf("%sFlashing \n", Prefix[b]);
+			if (FlashFast(hBoard[b], buf)) updated++;
+		}
+		goto Summary;
+	}
+
+	xorsum = xorsum ^ buf[firmwarelen-1] ^ buf[firmwarelen];	/* Remove reset vector from checksum */
+	buf[firmwarelen-1] = xorsum;								/* place checksum as last byte */
+	filelen = firmwarelen;
+
+	if (resetAdr == SplitStart)                                 /* if Split, move code to buf beginning */
+	{
+		filelen = filelen - splitsize;
+		for (i=0, j=splitsize; i<(filelen+1); i++,j++)
+		{
+			buf[i] = buf[j];
+		}
+	}
+
+	FlashBoards(active, buf);
+
+	for (b=0; b<boards; b++)									/* failed boards one by one */
+	{
+		for (j=0; (boards > 1) && !active[b] && !otherbsl[b] && (j < RETRIES); j++)
+		{
+			printf("%sTrying again \n", Prefix[b]);
+			for (i=0; i<boards; i++) one[i] = (i == b);
+			if (SyncBoards(one)) FlashBoards(one, buf);
+			active[b] = one[b];
+		}
+		if (active[b]) updated++;
+	}
+
+Summary:
+
+	if (boards > 1) printf("%d of %d boards updated \n", updated, boards);
+	result = (updated < boards) ? 1 : 0;
+
+CloseExit:
+
+	for (b=0; b<boards; b++)
+	{
+		tcsetattr(hBoard[b], TCSANOW, &dcbMasterInitState[b]);
+	}
+
+	msleep(60);
+
+	for (b=0; b<boards; b++)
+	{
+		close(hBoard[b]);
+		hBoard[b] = -1;
+	}
+
+	if (recordfile != NULL)
+	{
+		fclose(recordfile);
+		printf("Session recorded in %s \n", recordname);
+	}
+
+	return result;
+}
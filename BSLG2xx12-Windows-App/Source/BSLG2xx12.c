@@ -2,6 +2,9 @@
 
 BSLG2xx12.exe COMn              (Read BSL version and AppStart location)
 BSLG2xx12.exe COMn filename     (Flash new firmware)
+BSLG2xx12.exe COMn filename -b57600   (Flash at 57600 baud, Fast BSL only)
+BSLG2xx12.exe COMn COMm ... filename [-s]   (Flash several boards)
+BSLG2xx12.exe COMn filename -wsession.wtr   (Record the session)
 
 This is software for the Windows console that flashes firmware to MSP430G
 flash-memory Value Line microcontrollers in which the matching "custom" BSL
@@ -34,12 +37,33 @@ always begin at the start of MAIN + 0x60.  [This program will also work with an
 earlier BSL written specifically for the G2231, the Split version of which only
 used 80 (0x50) bytes of MAIN memory.]
 
+The "Fast" version is located in the MAIN segment 0xFC00 - 0xFDFF, so it needs
+a part with 2K or more of flash.  Firmware compatible with this version must
+begin at the start of MAIN memory, and must leave that segment empty.  The Fast
+BSL runs at 8 MHz.  After the sync at 9600 baud, this program switches it and
+the COM port to the rate of the -b option (115200 by default), checks the sync
+at that rate, and then sends the non-blank parts of the firmware in records of
+up to 64 bytes, each with a CRC.  Records are sent ahead of the replies, and
+after a transfer error the BSL is brought back in step and the records not
+acknowledged are sent again.  At the end, the BSL reports the CRC of MAIN.
+See Installer-G2xx12-Fast.m43 for the commands.
+
 The firmware file may be in Intel-HEX or TI-TXT format. The program will read in
 from the chip and display the BSL version installed and the address where the
 app must begin, and then perform error checking to make sure the firmware file
 complies.  The reset vector at 0xFFFE as specified in the firmware file must
 always point to MAIN, or to MAIN + 0x60 for Split BSL.
 
+Up to 16 boards, each on its own COM port, are flashed at once.  The INFO and
+Split BSLs only reply to the sync, when MAIN is erased and at the end, so the
+firmware goes out to all boards in one stream, and takes no longer than for one
+board.  It is sent on each port, or with -s only on the first one, whose TX
+line then drives the RXD pins of all boards.  The replies are read from each
+port.  Boards which fail are reset and tried again one by one.  With -s, that
+goes out to all boards, and those already done are flashed once more, so they
+all need the same BSL.  The Fast BSL replies to each record, so with it the
+boards are flashed one after the other, and -s can not be used.
+
 A USB driver will also have to be installed for the USB-to-UART adapter being
 used.
 
@@ -48,6 +72,20 @@ processor if DTR is connected to its /Reset pin.  The special signalling pattern
 on /Reset and Test or TCK, used to initiate BSL in parts with embedded BSLs, is
 not used in this system.
 
+After the command byte, the firmware data is sent as soon as the BSL reports
+that MAIN has been erased by sending its version code once more.  BSLs installed
+with earlier versions of the installers do not do that, and for them the data
+follows after two seconds.  This program version has to be used with BSLs
+installed by the current installers, since earlier versions of it would take
+that second version code for the reply to the firmware data.
+
+With -w{file}, the bytes sent and received on the first COM port are recorded
+with their times, in the format of the wire trace of BSLDEMO (see
+BSLDEMO-2.01c/Source/wiretrace.h, BSLDEMO -l lists such a file).  The Linux
+simulator BSLG2xx12-Sim -r{file} plays the part of the device in such a session
+back, with the timing recorded, so that changes of the host side can be timed
+against real sessions without the hardware.
+
 A PDF file with further information accompanies this program.
 
 This program was written in C for the LCC-Win32 compiler.
@@ -56,6 +94,7 @@ This program was written in C for the LCC-Win32 compiler.
 
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <conio.h>
 
 long MainStart = 0xE000;
@@ -69,10 +108,85 @@ unsigned char cmdbyte = 0xBA;
 unsigned char ACK = 0xF8;
 unsigned char NACK = 0xFE;
 
-unsigned char Response[9] = {0xFF,0,0xC0,0x80,0xFC,0xF8,0xF0,0xE0,0xFE};   /* Split/Info, 1k-8k */
-long MainBeg[9] = {0xFC00,0xF800,0xF000,0xE000,0xFC00,0xF800,0xF000,0xE000,0xF800};
-int BSLType[9] = {1,1,1,1,0,0,0,0,2};
-int BSL = 3;                /* 0 = INFO, 1 = Split, 2 = old 2231Split-0x50, 3 = undefined */
+unsigned char Response[12] = {0xFF,0,0xC0,0x80,0xFC,0xF8,0xF0,0xE0,0xFE,0xAE,0xAF,0xA8};   /* Split/Info 1k-8k, Fast 2k-8k */
+long MainBeg[12] = {0xFC00,0xF800,0xF000,0xE000,0xFC00,0xF800,0xF000,0xE000,0xF800,0xE000,0xF000,0xF800};
+int BSLType[12] = {1,1,1,1,0,0,0,0,2,3,3,3};
+int BSL = 4;                /* 0 = INFO, 1 = Split, 2 = old 2231Split-0x50, 3 = Fast, 4 = undefined */
+
+/* Fast BSL only: */
+unsigned char cmdbaud = 0xB1;
+unsigned char cmdwrite = 0xB2;
+unsigned char cmdread = 0xB3;
+unsigned char cmdcrc = 0xB4;
+unsigned char FILL = 0xFF;
+long Bauds[5] = {9600,19200,38400,57600,115200};
+int baudindex = 4;          /* -b option, 115200 by default */
+long FastBSLStart = 0xFC00; /* BSL segment, no firmware there */
+int Version = -1;           /* reply to sync */
+
+/* Several boards: */
+#define MAXBOARDS 16
+#define RETRIES 2           /* tries one by one after the broadcast */
+int boardarg[MAXBOARDS];    /* argv index of the COM port of each board */
+int boards = 0;
+HANDLE hBoard[MAXBOARDS];
+char Prefix[MAXBOARDS][64]; /* COM port for messages, if several boards */
+bool sharedtx = false;      /* -s option: TX line of the first port to all */
+bool otherbsl[MAXBOARDS];   /* not worth trying again */
+
+/* -w option, recording of the first port: */
+char *recordname = NULL;
+FILE *recordfile = NULL;
+LARGE_INTEGER recordstart, recordfreq;
+long recordbaud = 9600;
+
+/*======== Time in microseconds since the recording started. ================*/
+
+DWORD Micros(void)
+{
+	LARGE_INTEGER now;
+
+	QueryPerformanceCounter(&now);
+	return (DWORD)((now.QuadPart - recordstart.QuadPart) * 1000000 / recordfreq.QuadPart);
+}
+
+/*======== Record bytes sent ('T') or received ('R'), or the line ('L'). ====*/
+
+/* Each record: kind, length, time in us since the start (4 bytes, low byte
+   first), the bytes.  'L' holds the baudrate (4 bytes) and 0x02 if DTR is on. */
+
+void Record(HANDLE handle, char kind, BYTE* data, DWORD length, DWORD time)
+{
+	BYTE header[6];
+	DWORD n;
+
+	if ((recordfile == NULL) || (handle != hBoard[0])) return;
+	do
+	{
+		n = (length > 255) ? 255 : length;
+		header[0] = kind;
+		header[1] = (BYTE)n;
+		header[2] = (BYTE)time; header[3] = (BYTE)(time >> 8);
+		header[4] = (BYTE)(time >> 16); header[5] = (BYTE)(time >> 24);
+		fwrite(header, 1, 6, recordfile);
+		fwrite(data, 1, n, recordfile);
+		data = data + n;
+		length = length - n;
+	} while (length > 0);
+}
+
+/*======== Record the line state. ===========================================*/
+
+void RecordLine(HANDLE handle, bool dtr)
+{
+	BYTE line[5];
+
+	if (recordfile == NULL) return;
+	line[0] = (BYTE)recordbaud; line[1] = (BYTE)(recordbaud >> 8);
+	line[2] = (BYTE)(recordbaud >> 16); line[3] = (BYTE)(recordbaud >> 24);
+	line[4] = dtr ? 0x02 : 0;
+	Record(handle, 'L', line, 5, Micros());
+}
 
 /*======== Receive data from COM port - code per Silicon Labs AN197.pdf. ====*/
 
@@ -86,9 +200,11 @@ bool ReadData(HANDLE handle, BYTE* data, DWORD length, DWORD* dwRead, UINT timeo
 		if (GetLastError() == ERROR_IO_PENDING)
 		if (WaitForSingleObject(o.hEvent, timeout) == WAIT_OBJECT_0)
 			success = true;
+		else CancelIo(handle);				/* no stray read left pending */
 		GetOverlappedResult(handle, &o, dwRead, FALSE);
 	}
 	else success = true;
+	if ((recordfile != NULL) && (*dwRead > 0)) Record(handle, 'R', data, *dwRead, Micros());
 	CloseHandle(o.hEvent);
 	return success;
 }
@@ -97,6 +213,7 @@ bool ReadData(HANDLE handle, BYTE* data, DWORD length, DWORD* dwRead, UINT timeo
 
 bool WriteData(HANDLE handle, BYTE* data, DWORD length, DWORD* dwWritten)
 {
+	DWORD start = (recordfile != NULL) ? Micros() : 0;
 	bool success = false;
 	OVERLAPPED o = {0};
 	o.hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
@@ -109,6 +226,7 @@ bool WriteData(HANDLE handle, BYTE* data, DWORD length, DWORD* dwWritten)
 	}
 	else success = true;
 	if (*dwWritten != length) success = false;
+	if (recordfile != NULL) Record(handle, 'T', data, *dwWritten, start);
 	CloseHandle(o.hEvent);
 	return success;
 }
@@ -120,6 +238,10 @@ void Usage(char *programName)
 	printf("\n%s usage:\n \n",programName);
 	printf("Get BSL info:      %s COMn \n",programName);
 	printf("Flash firmware:    %s COMn filename \n",programName);
+	printf("Fast BSL rate:     -b9600, -b19200, -b38400, -b57600 or -b115200 (default) \n");
+	printf("Several boards:    %s COMn COMm ... filename \n",programName);
+	printf("                   -s  all boards on the TX line of the first port \n");
+	printf("Record session:    -wfile  bytes of the first port, for BSLG2xx12-Sim -r \n");
 }
 
 /*======== Process command line arguments. ==========*/
@@ -132,11 +254,21 @@ void HandleOptions(int argc,char *argv[])
 	{
 		if (argv[i][0] == '/' || argv[i][0] == '-')
 		{
+			if (argv[i][1] == 'b')
+			{
+				for (baudindex = 4; baudindex > 0; baudindex--)
+				{
+					if (atol(&argv[i][2]) == Bauds[baudindex]) break;
+				}
+			}
+			if (argv[i][1] == 's') sharedtx = true;
+			if (argv[i][1] == 'w') recordname = &argv[i][2];
 			continue;
 		}
 		else if (strnicmp(argv[i], "COM", 3) == 0)
 		{
-			comport = i;
+			if (boards < MAXBOARDS) boardarg[boards++] = i;
+			comport = boardarg[0];
 		}
 
 		else if (strlen(argv[i]) > 3)
@@ -148,127 +280,641 @@ void HandleOptions(int argc,char *argv[])
 	return;
 }
 
-/*============MAIN==========*/
+/*======== Change the baudrate of the COM port. ============================*/
 
-int main(int argc,char *argv[])
+void SetBaud(HANDLE handle, int index)
 {
+	DCB dcb;
 
-	/*handle the program options*/
-	HandleOptions(argc,argv);
-	if (comport == 0)
+	GetCommState(handle, &dcb);
+	dcb.BaudRate = Bauds[index];
+	SetCommState(handle, &dcb);
+	recordbaud = Bauds[index];
+	RecordLine(handle, false);
+}
+
+/*======== Send a command to the Fast BSL, return its reply or -1. ==========*/
+
+int FastCommand(HANDLE handle, BYTE* data, DWORD length, UINT timeout, int index)
+{
+	BYTE reply;
+	DWORD n;
+
+	WriteData(handle, data, length, &n);
+	if (!ReadData(handle, &reply, 1, &n, timeout + (length * 10000L) / Bauds[index])) return -1;
+	if (n == 0) return -1;
+	return reply;
+}
+
+/*======== CRC-16 (CCITT) as computed by the Fast BSL. =======================*/
+
+unsigned int Crc16(unsigned int crc, BYTE* data, long length)
+{
+	int bit;
+
+	while (length-- > 0)
 	{
-		Usage(argv[0]);
-		return 0;
+		crc = crc ^ (*data++ << 8);
+		for (bit=0; bit<8; bit++)
+		{
+			if (crc & 0x8000) crc = (crc << 1) ^ 0x1021;
+			else crc = crc << 1;
+		}
 	}
+	return crc & 0xFFFF;
+}
 
-	/*Init 8K buffer to all FFs */
+/*======== CRC of a range in the Fast BSL, and its bytes too if data. ======*/
+
+/* The range is from start up to but not including end.  Returns the CRC sent
+   by the BSL, or -1 if it did not reply in time. */
+
+long FastRange(HANDLE handle, long start, long end, BYTE* data, int index)
+{
+	BYTE cmd[5];
+	BYTE crc[2];
+	long length = 0;
+	DWORD n;
+
+	cmd[0] = cmdcrc;
+	if (data != NULL)
+	{
+		cmd[0] = cmdread;
+		length = end - start;
+	}
+	cmd[1] = start & 0xFF;
+	cmd[2] = start >> 8;
+	cmd[3] = end & 0xFF;
+	cmd[4] = end >> 8;
+	WriteData(handle, cmd, 5, &n);
+
+	if (length > 0)
+	{
+		ReadData(handle, data, length, &n, 1000 + (length * 10000L) / Bauds[index]);
+		if (n < length) return -1;
+	}
+	ReadData(handle, crc, 2, &n, 1000 + (end - start) / 100);	/* 9 us per byte */
+	if (n < 2) return -1;
+	return crc[0] | (crc[1] << 8);
+}
+
+/*======== Compare MAIN of the Fast BSL with the image in buf. ==============*/
+
+/* MAIN is checked below and above the BSL segment, without the reset vector.
+   If report, the first byte which differs is found by reading MAIN back. */
+
+bool CheckFast(HANDLE handle, unsigned char* buf, int index, bool report)
+{
+	BYTE data[0x2000];
+	long start[2], end[2];
+	long crc, i;
+	int part;
+	bool same = true;
+
+	start[0] = MainStart;
+	end[0] = FastBSLStart;
+	start[1] = FastBSLStart + 0x200;
+	end[1] = 0xFFFE;
+	for (part=0; part<2; part++)
+	{
+		crc = Crc16(0xFFFF, &buf[start[part]-MainStart], end[part] - start[part]);
+		if (FastRange(handle, start[part], end[part], NULL, index) == crc) continue;
+		if (!report) return false;
+
+		crc = FastRange(handle, start[part], end[part], data, index);
+		if ((crc < 0) || (crc != Crc16(0xFFFF, data, end[part] - start[part])))
+		{
+			printf("MAIN %X - %X could not be read back \n", start[part], end[part] - 1);
+			same = false;
+			continue;
+		}
+		for (i=0; i < end[part] - start[part]; i++)
+		{
+			if (data[i] != buf[start[part]-MainStart + i])
+			{
+				printf("MAIN differs first at %X \n", start[part] + i);
+				same = false;
+				break;
+			}
+		}
+	}
+	return same;
+}
 
+/*======== Get the Fast BSL back in step after a transfer error. ============*/
+
+/* Any record the BSL is still receiving is ended by the fill bytes, and gets
+   NACK.  Then the BSL must answer a sync byte again. */
+
+bool Resync(HANDLE handle, int index)
+{
+	BYTE fill[70];
+	BYTE syncbyte = NACK;
+	BYTE reply;
+	DWORD n;
+	int i, tries;
+
+	for (i=0; i<70; i++) fill[i] = FILL;
+	for (tries=0; tries<3; tries++)
+	{
+		sleep(50);
+		do ReadData(handle, &reply, 1, &n, 20); while (n > 0);	/* flush input */
+		WriteData(handle, fill, 70, &n);
+		sleep(50);
+		do ReadData(handle, &reply, 1, &n, 20); while (n > 0);
+		if (FastCommand(handle, &syncbyte, 1, 200, index) == Version) return true;
+	}
+	return false;
+}
+
+/*======== Flash the image in buf to the Fast BSL. ==========================*/
+
+/* The Fast BSL is switched to the rate of the -b option first, and must then
+   answer a sync byte at that rate.  After the erase, the image is sent in
+   records of up to 64 bytes, each with its address, length and CRC, which do
+   not cross the boundary of a 64-byte row.  Runs of 0xFF longer than RECGAP
+   are left out, since flash is 0xFF after the erase, and a record costs about
+   RECGAP bytes on the line besides its data.  Nothing is sent for the BSL
+   segment, and the BSL does not write the reset vector.
+
+   The BSL receives a record into RAM, and checks and writes it before it
+   replies.  Rather than wait for the reply, each record is followed by enough
+   fill bytes to cover that time, and then the next record is sent, up to
+   WINDOW records ahead of the replies.  A NACK, any other reply or none at all
+   means the BSL may be out of step.  Then it is brought back in step, and the
+   records are sent again from the first one not acknowledged.  The BSL writes
+   a record as one block, and flash should not be written twice without an
+   erase, so the records which may have been written before the error are
+   checked with the CRC of their range first, and only those which are not in
+   place are sent again.  At the end, the CRC of MAIN computed by the BSL must
+   match the one of the image.  The update is left out if they match already
+   before. */
+
+#define RECGAP 7            /* command, address, length, CRC and reply */
+#define WINDOW 4            /* records sent but not yet acknowledged */
+#define MAXERRORS 20        /* transfer errors before giving up */
+#define MAXRECORDS 2048
+
+long RecAddr[MAXRECORDS];
+int RecLen[MAXRECORDS];
+bool RecDone[MAXRECORDS];
+
+/* Fill bytes to send after a record while the BSL checks and writes it, and
+   sends the reply.  The CRC takes about 70 cycles per byte at 8 MHz.  The
+   block write takes 13 cycles of the flash timing generator at 444 kHz, and
+   18 more per byte.  10% is added for the tolerance of the DCO. */
+
+int FillCount(int length, int index)
+{
+	double busy;
+
+	busy = 1.1 * ((length + 5) * 70 / 8e6 + (13 + 18 * length) / 444e3);
+	return (int)(busy * Bauds[index] / 10) + 1 + 3;		/* reply, margin */
+}
+
+bool FlashFast(HANDLE handle, unsigned char* buf)
+{
+	BYTE row[256];
+	BYTE syncbyte = NACK;
+	BYTE reply;
+	unsigned int crc;
+	long addr, end, rowend;
+	long sent = 0;
+	int records = 0, next, acked, errors = 0, resent = 0;
+	int index = 0;
+	int length, fills;
+	UINT timeout;
+	DWORD n;
 	int i;
-	int j;
-	unsigned char buf[firmwarelen+1];
 
-	for (i = 0; i < firmwarelen+1; i++)   /* create binary 8K MAIN image*/
-    {									  /*  with all FFs*/
-		buf[i] = 0xff;
+	if (baudindex != 0)
+	{
+		row[0] = cmdbaud;
+		row[1] = baudindex;
+		if (FastCommand(handle, row, 2, 1000, 0) != ACK)
+		{
+			printf("Baudrate %d not accepted \n", Bauds[baudindex]);
+			return false;
+		}
+		SetBaud(handle, baudindex);
+		index = baudindex;
+		if (FastCommand(handle, &syncbyte, 1, 1000, index) != Version)
+		{
+			printf("No sync at %d baud - reset the MCU, and try a lower rate with -b \n", Bauds[index]);
+			return false;
+		}
+		printf("Sync at %d baud \n", Bauds[index]);
+	}
+
+	if (CheckFast(handle, buf, index, false))
+	{
+		printf("Firmware already in place - MAIN left as it is \n");
+		return true;
+	}
+
+	for (addr = MainStart; addr < 0xFFFE; addr = end)		/* cut the image into records */
+	{
+		end = addr + 1;
+		if ((addr >= FastBSLStart) && (addr < FastBSLStart + 0x200))
+		{
+			end = FastBSLStart + 0x200;
+			continue;
+		}
+		if (buf[addr-MainStart] == 0xFF) continue;
+
+		rowend = (addr | 63) + 1;						/* record stays in its row */
+		if (rowend > 0xFFFE) rowend = 0xFFFE;
+		for (i = end; (i < rowend) && (i <= end + RECGAP); i++)
+		{
+			if (buf[i-MainStart] != 0xFF) end = i + 1;
+		}
+		RecAddr[records] = addr;
+		RecLen[records] = end - addr;
+		RecDone[records] = false;
+		sent = sent + RecLen[records];
+		records++;
 	}
 
-	/*Open port, send NAK, read Response byte*/
+	printf("Erasing MAIN \n");
+	row[0] = cmdbyte;
+	row[1] = Version;
+	if (FastCommand(handle, row, 2, 2000, index) != ACK)
+	{
+		printf("No response to erase \n");
+		return false;
+	}
 
-	unsigned char Outbyte = NACK;   /* anything but the command byte */
-	char *pOutbyte = &Outbyte;
-	int Outwrote = 0;
-	int *pOutwrote = &Outwrote;
-	unsigned char Inbyte = 0;
-	char *pInbyte = &Inbyte;
-	int Fetched = 0;
-	int *pFetched = &Fetched;
+	printf("Sending %d bytes of firmware data in %d records \n", sent, records);
+	next = 0;
+	acked = 0;
+	while (acked < records)
+	{
+		if (RecDone[acked])								/* in place already */
+		{
+			if (next == acked) next++;
+			acked++;
+			continue;
+		}
+		while ((next < records) && RecDone[next]) next++;
+		timeout = 0;									/* just look for replies */
+		if ((next < records) && (next - acked < WINDOW))
+		{
+			addr = RecAddr[next];
+			length = RecLen[next];
+			row[0] = cmdwrite;
+			row[1] = addr & 0xFF;
+			row[2] = addr >> 8;
+			row[3] = length;
+			for (i=0; i<length; i++) row[4+i] = buf[addr-MainStart + i];
+			crc = Crc16(0xFFFF, &row[1], 3 + length);
+			row[4+length] = crc >> 8;
+			row[5+length] = crc & 0xFF;
+			fills = FillCount(length, index);
+			for (i=0; i<fills; i++) row[6+length+i] = FILL;
+			WriteData(handle, row, 6 + length + fills, &n);
+			next++;
+		}
+		else timeout = 1000 + (WINDOW * 250 * 10000L) / Bauds[index];
 
-	char CFcomport[20] = "\\\\.\\";
-	strcat (CFcomport,argv[comport]);
+		ReadData(handle, &reply, 1, &n, timeout);
+		if (n == 0)
+		{
+			if (timeout == 0) continue;
+			printf("No response to record %X \n", RecAddr[acked]);
+		}
+		else if (reply == ACK)
+		{
+			acked++;
+			continue;
+		}
+		else if (reply == NACK) printf("Record %X not accepted \n", RecAddr[acked]);
+		else printf("Invalid response to record %X: %X \n", RecAddr[acked], reply);
+
+		errors++;
+		if ((errors > MAXERRORS) || !Resync(handle, index))
+		{
+			printf("Too many transfer errors - update failed \n");
+			return false;
+		}
+		for (i = acked; i < next; i++)					/* written before the error? */
+		{
+			if (RecDone[i]) continue;
+			addr = RecAddr[i];
+			if (FastRange(handle, addr, addr + RecLen[i], NULL, index)
+				== Crc16(0xFFFF, &buf[addr-MainStart], RecLen[i])) RecDone[i] = true;
+			else resent++;
+		}
+		next = acked;
+	}
+	if (errors > 0) printf("%d transfer errors, %d records sent again \n", errors, resent);
 
+	if (!CheckFast(handle, buf, index, true))
+	{
+		printf("Flashing performed, but CRC did not match \n");
+		return false;
+	}
+	printf("Update Successful \n");
+	return true;
+}
+
+/*======== Send data to the boards of the set. ==============================*/
 
-	/* Open COM port */
+/* With -s, the data goes out on the first port only, which reaches all the
+   boards.  Else a write is started on the port of each board in the set, and
+   then waited for, so that all lines are busy at once.  Returns the number of
+   bytes sent on the line which took the fewest. */
 
-	HANDLE hMasterCOM = CreateFile(CFcomport,
-    GENERIC_READ | GENERIC_WRITE,
-    0,
-    0,
-    OPEN_EXISTING,
-    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED,
-    0);
+int SendAll(bool* set, BYTE* data, DWORD length)
+{
+	OVERLAPPED o[MAXBOARDS];
+	DWORD sent[MAXBOARDS];
+	bool pending[MAXBOARDS];
+	int b;
+	int fewest = length;
 
-	if (hMasterCOM == INVALID_HANDLE_VALUE)
+	for (b=0; b<boards; b++)
 	{
-		int err = GetLastError();
-		printf("Error opening port \n");
-		return err;
+		sent[b] = 0;
+		pending[b] = false;
+		if (!sharedtx && !set[b]) continue;
+		ZeroMemory(&o[b], sizeof(OVERLAPPED));
+		o[b].hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+		if ((b == 0) && (recordfile != NULL)) Record(hBoard[b], 'T', data, length, Micros());
+		if (!WriteFile(hBoard[b], (LPCVOID)data, length, &sent[b], &o[b]))
+			pending[b] = (GetLastError() == ERROR_IO_PENDING);
+		if (!pending[b]) CloseHandle(o[b].hEvent);
+		if (sharedtx) break;
 	}
-	else
+	for (b=0; b<boards; b++)
 	{
-		printf("COM port Opened \n");
+		if (!sharedtx && !set[b]) continue;
+		if (pending[b])
+		{
+			if (WaitForSingleObject(o[b].hEvent, INFINITE) == WAIT_OBJECT_0)
+				GetOverlappedResult(hBoard[b], &o[b], &sent[b], FALSE);
+			CloseHandle(o[b].hEvent);
+		}
+		if (sent[b] < fewest) fewest = sent[b];
+		if (sharedtx) break;
 	}
+	return fewest;
+}
 
-	PurgeComm(hMasterCOM, PURGE_TXABORT | PURGE_RXABORT | PURGE_TXCLEAR | PURGE_RXCLEAR);
+/*======== Read one reply from each board of the set. =======================*/
 
-	DCB dcbMasterInitState;
-	GetCommState(hMasterCOM, &dcbMasterInitState);
+/* reply[b] is the byte, or -1 if none came.  The boards reply at the same
+   time, so the timeout counts for all of them together. */
 
-	DCB dcbMaster = dcbMasterInitState;
-	dcbMaster.BaudRate = 9600;
-	dcbMaster.Parity = NOPARITY;
-	dcbMaster.ByteSize = 8;
-	dcbMaster.StopBits = ONESTOPBIT;
-	SetCommState(hMasterCOM, &dcbMaster);
+void ReadAll(bool* set, int* reply, UINT timeout)
+{
+	DWORD deadline = GetTickCount() + timeout;
+	BYTE inbyte;
+	long wait;
+	DWORD n;
+	int b;
 
-	sleep(400);
+	for (b=0; b<boards; b++)
+	{
+		reply[b] = -1;
+		if (!set[b]) continue;
+		wait = (long)(deadline - GetTickCount());
+		ReadData(hBoard[b], &inbyte, 1, &n, (wait > 0) ? wait : 0);
+		if (n > 0) reply[b] = inbyte;
+	}
+}
+
+/*======== Reset the boards of the set, and sync with their BSL. ============*/
+
+/* The first version code decides the BSL type and MAIN for the firmware file.
+   Boards which do not answer, or have another BSL, are taken out of the set.
+   Returns false if no board is left. */
+
+bool SyncBoards(bool* set)
+{
+	BYTE syncbyte = NACK;				/* anything but the command byte */
+	BYTE inbyte;
+	int reply[MAXBOARDS];
+	bool waiting[MAXBOARDS];
+	DWORD n;
+	int b, i, tries;
+	int left = 0;
+	bool any = false;
 
 	printf("Resetting MCU via DTR, if connected to /Reset \n");
-	EscapeCommFunction(hMasterCOM, SETDTR);						/* toggle DTR (Reset) */
-	EscapeCommFunction(hMasterCOM, CLRDTR);
+	for (b=0; b<boards; b++)
+	{
+		if (!set[b]) continue;
+		RecordLine(hBoard[b], true);
+		EscapeCommFunction(hBoard[b], SETDTR);					/* toggle DTR (Reset) */
+		RecordLine(hBoard[b], false);
+		EscapeCommFunction(hBoard[b], CLRDTR);
+	}
 	sleep(100);
+	for (b=0; b<boards; b++)
+	{
+		waiting[b] = set[b];
+		if (!set[b]) continue;
+		left++;
+		do ReadData(hBoard[b], &inbyte, 1, &n, 100); while (n > 0);	/* flush input */
+	}
 
-	do															/* flush input buffer */
+	for (tries=0; (tries<3) && (left>0); tries++)
 	{
-		ReadData(hMasterCOM,pInbyte,1,pFetched,100);
+		printf("Sending sync \n");
+		SendAll(waiting, &syncbyte, 1);							/* wait for version code */
+		ReadAll(waiting, reply, 1000);
+		for (b=0; b<boards; b++)
+		{
+			if (!waiting[b]) continue;
+			if (reply[b] < 0)
+			{
+				printf("%sNo response \n", Prefix[b]);
+				continue;
+			}
+			for (i=0; (i<12) && (reply[b] != Response[i]); i++);
+			if (i == 12)
+			{
+				printf("%sInvalid response %X \n", Prefix[b], reply[b]);
+				continue;
+			}
+			waiting[b] = false;
+			left--;
+			if (Version < 0)
+			{
+				BSL = BSLType[i];
+				Version = reply[b];
+				MainStart = MainBeg[i];
+				if (BSL==2) splitsize = 0x50;
+				SplitStart = MainStart + splitsize;
+				firmwarelen = 0xFFFF - MainStart;
+			}
+			else if (reply[b] != Version)
+			{
+				printf("%sBSL version %X differs from %X \n", Prefix[b], reply[b], Version);
+				if (sharedtx) return false;				/* it would get the data too */
+				set[b] = false;
+				otherbsl[b] = true;
+				continue;
+			}
+			any = true;
+
+			if (BSL == 0) printf("%sSync acknowledged - INFO BSL, MAIN = %X, AppStart = %X \n", Prefix[b], MainStart, MainStart);
+			else if (BSL == 3) printf("%sSync acknowledged - Fast BSL, MAIN = %X, AppStart = %X \n", Prefix[b], MainStart, MainStart);
+			else printf("%sSync acknowledged - Split BSL, MAIN = %X, AppStart = %X \n", Prefix[b], MainStart,SplitStart);
+		}
+	}
+	for (b=0; b<boards; b++)
+	{
+		if (waiting[b]) set[b] = false;
 	}
-	while (Fetched > 0);
+	return any;
+}
 
-	j=0;
+/*======== Flash the image in buf to the boards of the set. =================*/
 
-	do
+/* INFO and Split BSL.  Boards which do not reply ACK are taken out of the
+   set. */
+
+void FlashBoards(bool* set, unsigned char* buf)
+{
+	int reply[MAXBOARDS];
+	int b, sent;
+
+	printf("Sending command byte \n");
+	SendAll(set, &cmdbyte, 1);
+
+	/* The BSL sends its version code again when MAIN has been erased.  BSLs
+	   installed before that send nothing, so go on after 2 seconds anyway. */
+
+	ReadAll(set, reply, 2000);
+	for (b=0; b<boards; b++)
 	{
-		printf("Sending sync \n");
-		WriteData(hMasterCOM,pOutbyte,1,pOutwrote);			/* send wrong byte, wait for ACK/NACK */
-		ReadData(hMasterCOM,pInbyte,1,pFetched,1000);
-		if (Fetched == 0) printf("No response \n");
+		if (set[b] && (reply[b] < 0)) printf("%sNo ready signal - older BSL, erase assumed done \n", Prefix[b]);
+	}
 
-		else
+	printf("Sending firmware data and checksum \n");
+
+	sent = SendAll(set, buf, filelen);
+
+	printf("%d bytes sent \n",sent);
+	if(filelen != sent) printf("Should have sent %d \n",filelen);
+
+	ReadAll(set, reply, 2000);
+
+	for (b=0; b<boards; b++)
+	{
+		if (!set[b]) continue;
+		if (reply[b] == ACK)
+		{
+			printf("%sUpdate Successful \n", Prefix[b]);
+			continue;
+		}
+		set[b] = false;
+		if (reply[b] < 0) printf("%sNo response received \n", Prefix[b]);
+		else if (reply[b] == NACK) printf("%sFlashing performed, but checksum did not match \n", Prefix[b]);
+		else printf("%sInvalid response received: %d \n", Prefix[b], reply[b]);
+	}
+}
+
+/*============MAIN==========*/
+
+int main(int argc,char *argv[])
+{
+	bool active[MAXBOARDS];		/* boards being flashed */
+	bool one[MAXBOARDS];
+	int updated = 0;
+	int result = 1;				/* exit code: 0 only if all boards made it */
+	int b;
+
+	/*handle the program options*/
+	HandleOptions(argc,argv);
+	if (comport == 0)
+	{
+		Usage(argv[0]);
+		return 0;
+	}
+
+	/*Init 8K buffer to all FFs */
+
+	int i;
+	int j;
+	unsigned char buf[firmwarelen+1];
+
+	for (i = 0; i < firmwarelen+1; i++)   /* create binary 8K MAIN image*/
+    {									  /*  with all FFs*/
+		buf[i] = 0xff;
+	}
+
+	/* Open COM ports */
+
+	DCB dcbMasterInitState[MAXBOARDS];
+	DCB dcbMaster;
+	char CFcomport[20];
+
+	for (b=0; b<boards; b++)
+	{
+		Prefix[b][0] = 0;
+		if (boards > 1) sprintf(Prefix[b], "%s: ", argv[boardarg[b]]);
+
+		strcpy(CFcomport, "\\\\.\\");
+		strcat(CFcomport, argv[boardarg[b]]);
+
+		hBoard[b] = CreateFile(CFcomport,
+		GENERIC_READ | GENERIC_WRITE,
+		0,
+		0,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED,
+		0);
+
+		if (hBoard[b] == INVALID_HANDLE_VALUE)
 		{
-			for (i=0; i<9; i++)
+			int err = GetLastError();
+			printf("%sError opening port \n", Prefix[b]);
+			while (b-- > 0)
 			{
-				if (Inbyte == Response[i])
-				{
-					BSL = BSLType[i];
-					MainStart = MainBeg[i];
-					if (BSL==2) splitsize = 0x50;
-					SplitStart = MainStart + splitsize;
-					firmwarelen = 0xFFFF - MainStart;
-				}
+				SetCommState(hBoard[b], &dcbMasterInitState[b]);
+				CloseHandle(hBoard[b]);
 			}
+			return err;
+		}
+		else
+		{
+			printf("%sCOM port Opened \n", Prefix[b]);
+		}
 
-			if (BSL == 0) printf("Sync acknowledged - INFO BSL, MAIN = %X, AppStart = %X \n", MainStart, MainStart);
-			else if (BSL == 3) printf("Invalid response %X \n", Inbyte);
-			else printf("Sync acknowledged - Split BSL, MAIN = %X, AppStart = %X \n", MainStart,SplitStart);
+		PurgeComm(hBoard[b], PURGE_TXABORT | PURGE_RXABORT | PURGE_TXCLEAR | PURGE_RXCLEAR);
 
-		}
-		j = j + 1;
+		GetCommState(hBoard[b], &dcbMasterInitState[b]);
+
+		dcbMaster = dcbMasterInitState[b];
+		dcbMaster.BaudRate = 9600;
+		dcbMaster.Parity = NOPARITY;
+		dcbMaster.ByteSize = 8;
+		dcbMaster.StopBits = ONESTOPBIT;
+		SetCommState(hBoard[b], &dcbMaster);
+		active[b] = true;
 	}
 
-	while ((BSL==3) && (j<3));
+	if (recordname != NULL)
+	{
+		recordfile = fopen(recordname, "wb");
+		if (recordfile == NULL) printf("Error creating %s \n", recordname);
+		else fwrite("WTR1", 1, 4, recordfile);
+		QueryPerformanceFrequency(&recordfreq);
+		QueryPerformanceCounter(&recordstart);
+	}
+
+	sleep(400);
 
-	if (BSL == 3) goto CloseExit;
+	if (!SyncBoards(active)) goto CloseExit;
 
-	if (filearg == 0) goto CloseExit;
+	if (filearg == 0)							/* sync only */
+	{
+		for (b=0; b<boards; b++) if (active[b]) updated++;
+		result = (updated < boards) ? 1 : 0;
+		goto CloseExit;
+	}
 
 	/*Open firmware new firmware file for reading, process contents*/
 
@@ -376,14 +1022,14 @@ int main(int argc,char *argv[])
 	resetAdr = buf[firmwarelen-1] + (buf[firmwarelen] * 256);
 	temp = 0xFF;
 
-	if ((resetAdr != MainStart) && (BSL == 0))
+	if ((resetAdr != MainStart) && ((BSL == 0) || (BSL == 3)))
 	{
-		printf("Reset vector %X must show program starts at %X for INFO BSL \n",
-				resetAdr, MainStart);
+		printf("Reset vector %X must show program starts at %X for %s BSL \n",
+				resetAdr, MainStart, (BSL == 0) ? "INFO" : "Fast");
 		goto CloseExit;
 	}
 
-	if ((resetAdr != SplitStart) && (BSL > 0))
+	if ((resetAdr != SplitStart) && ((BSL == 1) || (BSL == 2)))
 	{
 		printf("Reset vector %X must show program starts at %X for Split BSL \n",
 				resetAdr, SplitStart);
@@ -415,6 +1061,34 @@ int main(int argc,char *argv[])
 		}
 	}
 
+	if (BSL == 3)
+	{
+		temp = 0xFF;
+		for (i=0; i<0x200; i++)
+		{
+			temp = temp & buf[FastBSLStart-MainStart + i];	/* BSL segment must stay free */
+		}
+
+		if (temp != 0xFF)
+		{
+			printf("Code stored in the BSL segment %X - %X \n", FastBSLStart, FastBSLStart+0x1FF);
+			goto CloseExit;
+		}
+
+		if (sharedtx && (boards > 1))
+		{
+			printf("The Fast BSL replies to each record - one TX line per board, no -s \n");
+			goto CloseExit;
+		}
+		for (b=0; b<boards; b++)
+		{
+			if (!active[b]) continue;
+			if (boards > 1) printf("%sFlashing \n", Prefix[b]);
+			if (FlashFast(hBoard[b], buf)) updated++;
+		}
+		goto Summary;
+	}
+
 	xorsum = xorsum ^ buf[firmwarelen-1] ^ buf[firmwarelen];	/* Remove reset vector from checksum */
 	buf[firmwarelen-1] = xorsum;								/* place checksum as last byte */
 	filelen = firmwarelen;
@@ -434,37 +1108,45 @@ int main(int argc,char *argv[])
 	fclose(fp);
 */
 
-	Outbyte = cmdbyte;				/* now send correct byte */
+	FlashBoards(active, buf);
 
-	printf("Sending command byte \n");
-
-	WriteData(hMasterCOM,pOutbyte,1,pOutwrote);
-
-	sleep(2000);
-
-	printf("Sending firmware data and checksum \n");
-
-	WriteData(hMasterCOM,buf,filelen,pOutwrote);
-
-	printf("%d bytes sent \n",Outwrote);
-	if(filelen != Outwrote) printf("Should have sent %d \n",filelen);
+	for (b=0; b<boards; b++)									/* failed boards one by one */
+	{
+		for (j=0; (boards > 1) && !active[b] && !otherbsl[b] && (j < RETRIES); j++)
+		{
+			printf("%sTrying again \n", Prefix[b]);
+			for (i=0; i<boards; i++) one[i] = (i == b);
+			if (SyncBoards(one)) FlashBoards(one, buf);
+			active[b] = one[b];
+		}
+		if (active[b]) updated++;
+	}
 
-	ReadData(hMasterCOM,pInbyte,1,pFetched,2000);
+Summary:
 
-	if(Fetched == 0) printf("No response received \n");
-	else if (Inbyte == ACK) printf("Update Successful \n");
-	else if (Inbyte == NACK) printf("Flashing performed, but checksum did not match \n");
-	else printf("Invalid response received: %d \n", Inbyte);
+	if (boards > 1) printf("%d of %d boards updated \n", updated, boards);
+	result = (updated < boards) ? 1 : 0;
 
 CloseExit:
 
-	SetCommState(hMasterCOM, &dcbMasterInitState);
+	for (b=0; b<boards; b++)
+	{
+		SetCommState(hBoard[b], &dcbMasterInitState[b]);
+	}
 
 	sleep(60);
 
-	CloseHandle(hMasterCOM);
+	for (b=0; b<boards; b++)
+	{
+		CloseHandle(hBoard[b]);
+		hBoard[b] = INVALID_HANDLE_VALUE;
+	}
 
-	hMasterCOM = INVALID_HANDLE_VALUE;
+	if (recordfile != NULL)
+	{
+		fclose(recordfile);
+		printf("Session recorded in %s \n", recordname);
+	}
 
-	return 0;
+	return result;
 }